@@ -32,6 +32,7 @@ check_symbol_exists(strsignal "string.h" HAVE_STRSIGNAL)
 check_symbol_exists(updwtmpx "utmpx.h" HAVE_UPDWTMPX)
 check_symbol_exists(fstatat "sys/types.h;sys/stat.h;unistd.h" HAVE_FSTATAT)
 check_symbol_exists(dirfd "sys/types.h;dirent.h" HAVE_DIRFD)
+check_symbol_exists(posix_fadvise "fcntl.h" HAVE_POSIX_FADVISE)
 check_symbol_exists(setpwent "sys/types.h;pwd.h" HAVE_SETPWENT)
 check_symbol_exists(endpwent "sys/types.h;pwd.h" HAVE_ENDPWENT)
 check_symbol_exists(getauxval "sys/auxv.h" HAVE_GETAUXVAL)
@@ -51,6 +52,22 @@ int main(int argc, char **argv) {
            cr.pid + cr.uid + cr.gid;
 }" HAVE_SO_PEERCRED)
 
+check_c_source_compiles("
+#define _GNU_SOURCE
+#include <features.h>
+#include <fcntl.h>
+int main(int argc, char **argv) {
+    return splice(0, 0, 1, 0, 4096, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}" HAVE_SPLICE)
+
+check_c_source_compiles("
+#define _GNU_SOURCE
+#include <features.h>
+#include <unistd.h>
+int main(int argc, char **argv) {
+    return copy_file_range(0, 0, 1, 0, 4096, 0);
+}" HAVE_COPY_FILE_RANGE)
+
 check_c_source_compiles("
 #include <sys/types.h>
 #include <unistd.h>
@@ -66,6 +83,17 @@ int main(int argc, char **argv) {
     setpgrp(0, 0);
 }" HAVE_BINARY_SETPGRP)
 
+# The SFTP server can farm out file reads and writes to a pool of
+# worker threads, and prime generation can test several candidates at
+# once, if we have POSIX threads available.
+set(THREADS_PREFER_PTHREAD_FLAG ON)
+find_package(Threads)
+if(CMAKE_USE_PTHREADS_INIT)
+  set(HAVE_PTHREAD ON)
+else()
+  set(HAVE_PTHREAD OFF)
+endif()
+
 if(HAVE_GETADDRINFO AND PUTTY_IPV6)
   set(NO_IPV6 OFF)
 else()
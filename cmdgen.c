@@ -156,6 +156,7 @@ void help(void)
            "        proven         numbers that have been proven to be prime\n"
            "        proven-even    also try harder for an even distribution\n"
            "  --strong-rsa         use \"strong\" primes as RSA key factors\n"
+           "  --prime-threads <n>  test prime candidates on n threads\n"
            "  --ppk-param <key>=<value>[,<key>=<value>,...]\n"
            "        specify parameters when writing PuTTY private key file "
            "format:\n"
@@ -260,6 +261,7 @@ int main(int argc, char **argv)
     bool remove_cert = false;
     int exit_status = 0;
     const PrimeGenerationPolicy *primegen = &primegen_probabilistic;
+    unsigned prime_threads = 1;
     bool strong_rsa = false;
     ppk_save_parameters params = ppk_save_default_parameters;
     FingerprintType fptype = SSH_FPTYPE_DEFAULT;
@@ -404,6 +406,20 @@ int main(int argc, char **argv)
                         }
                     } else if (!strcmp(opt, "-strong-rsa")) {
                         strong_rsa = true;
+                    } else if (!strcmp(opt, "-prime-threads")) {
+                        if (!val && argc > 1)
+                            --argc, val = *++argv;
+                        if (!val) {
+                            errs = true;
+                            fprintf(stderr, "puttygen: option `-%s'"
+                                    " expects an argument\n", opt);
+                        } else if (atoi(val) < 1) {
+                            errs = true;
+                            fprintf(stderr, "puttygen: invalid thread count"
+                                    " `%s'\n", val);
+                        } else {
+                            prime_threads = atoi(val);
+                        }
                     } else if (!strcmp(opt, "-certificate")) {
                         if (!val && argc > 1)
                             --argc, val = *++argv;
@@ -936,6 +952,7 @@ int main(int argc, char **argv)
         sfree(entropy);
 
         PrimeGenerationContext *pgc = primegen_new_context(primegen);
+        primegen_set_threads(pgc, prime_threads);
 
         if (keytype == DSA) {
             struct dsa_key *dsakey = snew(struct dsa_key);
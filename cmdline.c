@@ -680,6 +680,13 @@ int cmdline_process_param(const char *p, char *value,
         SAVEABLE(0);
         conf_set_bool(conf, CONF_ssh_connection_sharing, false);
     }
+    if (!strcmp(p, "-sharepersist")) {
+        RETURN(2);
+        UNAVAILABLE_IN(TOOLTYPE_FILETRANSFER | TOOLTYPE_NONNETWORK);
+        SAVEABLE(0);
+        conf_set_bool(conf, CONF_ssh_connection_sharing, true);
+        conf_set_int(conf, CONF_ssh_connection_sharing_persist, atoi(value));
+    }
     if (!strcmp(p, "-A")) {
         RETURN(1);
         UNAVAILABLE_IN(TOOLTYPE_FILETRANSFER | TOOLTYPE_NONNETWORK);
@@ -196,6 +196,16 @@ CONF_OPTION(ssh_prefer_known_hostkeys,
     DEFAULT_BOOL(true),
     SAVE_KEYWORD("PreferKnownHostKeys"),
 )
+CONF_OPTION(ssh_cache_verified_certs,
+    /*
+     * Remember host certificates whose CA signatures have been
+     * verified, in persistent storage, so that later sessions need
+     * not verify them again.
+     */
+    VALUE_TYPE(BOOL),
+    DEFAULT_BOOL(false),
+    SAVE_KEYWORD("CacheVerifiedCerts"),
+)
 CONF_OPTION(ssh_rekey_time,
     VALUE_TYPE(INT), /* in minutes */
     DEFAULT_INT(60),
@@ -290,6 +300,29 @@ CONF_OPTION(ssh_connection_sharing_downstream,
     DEFAULT_BOOL(true),
     SAVE_KEYWORD("ConnectionSharingDownstream"),
 )
+CONF_OPTION(ssh_connection_sharing_persist,
+    /*
+     * Number of seconds a connection-sharing upstream with no session
+     * of its own (see ssh_no_shell) stays open after its last
+     * downstream goes away. Zero means the historical behaviour of
+     * staying open indefinitely. Plink on Unix also uses a nonzero
+     * setting as a request to start such an upstream automatically.
+     */
+    VALUE_TYPE(INT),
+    DEFAULT_INT(0),
+    SAVE_KEYWORD("ConnectionSharingPersist"),
+)
+CONF_OPTION(ssh_connection_sharing_upstream_only,
+    /*
+     * Set internally by a process that exists only to be a
+     * connection-sharing upstream, so that it gives up, instead of
+     * becoming a downstream or making an unshared connection, if it
+     * finds it can't be one.
+     */
+    VALUE_TYPE(BOOL),
+    DEFAULT_BOOL(false),
+    NOT_SAVED,
+)
 CONF_OPTION(ssh_manual_hostkeys,
     /*
      * Manually configured host keys to accept regardless of the state
@@ -2708,6 +2708,11 @@ void setup_config_box(struct controlbox *b, bool midsession,
                           HELPCTX(ssh_share),
                           conf_checkbox_handler,
                           I(CONF_ssh_connection_sharing_downstream));
+            ctrl_editbox(s, "Seconds an idle upstream lingers (0 = forever)",
+                         'l', 20,
+                         HELPCTX(ssh_share),
+                         conf_editbox_handler,
+                         I(CONF_ssh_connection_sharing_persist), ED_INT);
         }
 
         if (!midsession) {
@@ -2785,6 +2790,10 @@ void setup_config_box(struct controlbox *b, bool midsession,
             ctrl_checkbox(s, "Prefer algorithms for which a host key is known",
                           'p', HELPCTX(ssh_hk_known), conf_checkbox_handler,
                           I(CONF_ssh_prefer_known_hostkeys));
+            ctrl_checkbox(s, "Remember verified host certificates",
+                          'v', HELPCTX(ssh_hk_certcache),
+                          conf_checkbox_handler,
+                          I(CONF_ssh_cache_verified_certs));
         }
 
         /*
@@ -7,6 +7,8 @@
 #       Creates a Windows .REG file (double-click to install).
 #     kh2reg.py --unix    known_hosts1 2 3 4 ... > sshhostkeys
 #       Creates data suitable for storing in ~/.putty/sshhostkeys (Unix).
+#     kh2reg.py --merge-into ~/.putty/sshhostkeys known_hosts1 2 3 ...
+#       Adds the keys to an existing sshhostkeys file in place (Unix).
 # Line endings are someone else's problem as is traditional.
 # Should run under either Python 2 or 3.
 
@@ -16,6 +18,8 @@ import struct
 import string
 import re
 import sys
+import os
+import errno
 import argparse
 import itertools
 import collections
@@ -213,6 +217,13 @@ def handle_line(line, output_formatter, try_hosts):
         # Split line on spaces.
         fields = line.split(' ')
 
+        # Lines starting with a marker (@cert-authority or @revoked)
+        # aren't plain host keys, and PuTTY's host key store has no
+        # equivalent of either.
+        if fields[0].startswith('@'):
+            warn("skipping '%s' line" % fields[0])
+            raise BlankInputLine
+
         # Common fields
         hostpat = fields[0]
         keyparams = []      # placeholder
@@ -407,6 +418,44 @@ class UnixOutputFormatter(OutputFormatter):
     def key(self, key, value):
         self.fh.write('%s %s\n' % (key, value))
 
+class UnixMergeOutputFormatter(OutputFormatter):
+    # Merge the keys into an existing sshhostkeys file. Keys PuTTY
+    # already has are left alone, even if known_hosts disagrees,
+    # since the user presumably confirmed those. The new file is
+    # written under a temporary name and renamed into place, so that
+    # PuTTY never sees half of it; PuTTY will notice the file has
+    # changed and rebuild its index of it on the next lookup.
+    def __init__(self, filename):
+        self.filename = filename
+        self.lines = []
+        self.existing = {}
+        try:
+            with open(filename) as fh:
+                for line in fh:
+                    if not line.endswith("\n"):
+                        line += "\n"
+                    self.lines.append(line)
+                    fields = line.rstrip("\n").split(" ", 1)
+                    if len(fields) == 2:
+                        self.existing.setdefault(fields[0], fields[1])
+        except IOError as e:
+            if e.errno != errno.ENOENT:
+                raise
+
+    def key(self, key, value):
+        if key in self.existing:
+            if self.existing[key] != value:
+                warn("keeping existing key for '%s', which differs" % key)
+            return
+        self.existing[key] = value
+        self.lines.append('%s %s\n' % (key, value))
+
+    def trailer(self):
+        tmpname = "%s.tmp.%d" % (self.filename, os.getpid())
+        with open(tmpname, "w") as fh:
+            fh.writelines(self.lines)
+        os.rename(tmpname, self.filename)
+
 def main():
     parser = argparse.ArgumentParser(
         description="Convert OpenSSH known hosts files to PuTTY's format.")
@@ -420,6 +469,10 @@ def main():
         "--unix", action='store_const',
         dest="output_formatter_class", const=UnixOutputFormatter,
         help="Produce a file suitable for use as ~/.putty/sshhostkeys.")
+    group.add_argument(
+        "--merge-into", metavar="SSHHOSTKEYS",
+        help="Add the keys to an existing ~/.putty/sshhostkeys file,"
+        " leaving any keys already in it unchanged.")
     parser.add_argument("-o", "--output", type=argparse.FileType("w"),
                         default=argparse.FileType("w")("-"),
                         help="Output file to write to (default stdout).")
@@ -432,7 +485,10 @@ def main():
                         hostname=[])
     args = parser.parse_args()
 
-    output_formatter = args.output_formatter_class(args.output)
+    if args.merge_into is not None:
+        output_formatter = UnixMergeOutputFormatter(args.merge_into)
+    else:
+        output_formatter = args.output_formatter_class(args.output)
     output_formatter.header()
     for line in fileinput.input(args.infile):
         handle_line(line, output_formatter, args.hostname)
@@ -7,6 +7,7 @@
 #include "ssh.h"
 #include "mpint.h"
 #include "ecc.h"
+#include "ecc-field.h"
 
 /* ----------------------------------------------------------------------
  * Weierstrass curves.
@@ -51,6 +52,11 @@ struct WeierstrassCurve {
     /* Parameters of the curve, in Montgomery-multiplication
      * transformed form. */
     mp_int *a, *b;
+
+    /* Specialised field arithmetic for this p, if any, and a in the
+     * form it wants. */
+    const EccField *field;
+    EccFieldElt field_a;
 };
 
 WeierstrassCurve *ecc_weierstrass_curve(
@@ -67,6 +73,10 @@ WeierstrassCurve *ecc_weierstrass_curve(
     else
         wc->sc = NULL;
 
+    wc->field = ecc_field_find(p);
+    if (wc->field)
+        wc->field->import(&wc->field_a, wc->a);
+
     return wc;
 }
 
@@ -212,6 +222,254 @@ static void ecc_weierstrass_cond_swap(
     mp_cond_swap(P->Z, Q->Z, swap);
 }
 
+/* ----------------------------------------------------------------------
+ * Versions of the Weierstrass point arithmetic for curves whose field
+ * has a specialised implementation in ecc-field.c. These follow the
+ * general-purpose functions further down formula for formula, and
+ * have the same semantics; they just keep all the intermediate values
+ * in fixed-size EccFieldElts instead of allocating an mp_int for each.
+ */
+
+typedef struct WeierstrassFieldPoint {
+    EccFieldElt X, Y, Z;
+} WeierstrassFieldPoint;
+
+static void ecc_weierstrass_field_load(
+    WeierstrassFieldPoint *fp, WeierstrassPoint *wp)
+{
+    const EccField *f = wp->wc->field;
+    f->import(&fp->X, wp->X);
+    f->import(&fp->Y, wp->Y);
+    f->import(&fp->Z, wp->Z);
+}
+
+static WeierstrassPoint *ecc_weierstrass_field_store(
+    WeierstrassCurve *wc, WeierstrassFieldPoint *fp)
+{
+    WeierstrassPoint *wp = ecc_weierstrass_point_new_empty(wc);
+    size_t bits = mp_max_bits(wc->p);
+    wp->X = mp_new(bits);
+    wp->Y = mp_new(bits);
+    wp->Z = mp_new(bits);
+    wc->field->export(wp->X, &fp->X);
+    wc->field->export(wp->Y, &fp->Y);
+    wc->field->export(wp->Z, &fp->Z);
+    smemclr(fp, sizeof(*fp));
+    return wp;
+}
+
+static void ecc_weierstrass_field_select(
+    WeierstrassFieldPoint *dest, const WeierstrassFieldPoint *P,
+    const WeierstrassFieldPoint *Q, unsigned choose_Q)
+{
+    ecc_field_select(&dest->X, &P->X, &Q->X, choose_Q);
+    ecc_field_select(&dest->Y, &P->Y, &Q->Y, choose_Q);
+    ecc_field_select(&dest->Z, &P->Z, &Q->Z, choose_Q);
+}
+
+static void ecc_weierstrass_field_cond_swap(
+    WeierstrassFieldPoint *P, WeierstrassFieldPoint *Q, unsigned swap)
+{
+    ecc_field_cond_swap(&P->X, &Q->X, swap);
+    ecc_field_cond_swap(&P->Y, &Q->Y, swap);
+    ecc_field_cond_swap(&P->Z, &Q->Z, swap);
+}
+
+/* As ecc_weierstrass_epilogue. 'out' must not alias any input. */
+static void ecc_weierstrass_field_epilogue(
+    const EccField *f, const EccFieldElt *Px, const EccFieldElt *Qx,
+    const EccFieldElt *Py, const EccFieldElt *common_Z,
+    const EccFieldElt *lambda_n, const EccFieldElt *lambda_d,
+    WeierstrassFieldPoint *out)
+{
+    EccFieldElt lambda_n2, lambda_d2, lambda_d3, t, u;
+
+    ecc_field_mul(f, &lambda_n2, lambda_n, lambda_n);
+    ecc_field_mul(f, &lambda_d2, lambda_d, lambda_d);
+    ecc_field_mul(f, &lambda_d3, lambda_d, &lambda_d2);
+
+    ecc_field_add(f, &t, Px, Qx);
+    ecc_field_mul(f, &t, &lambda_d2, &t);
+    ecc_field_sub(f, &out->X, &lambda_n2, &t);
+
+    ecc_field_mul(f, &t, &lambda_d2, Px);
+    ecc_field_sub(f, &t, &t, &out->X);
+    ecc_field_mul(f, &t, lambda_n, &t);
+    ecc_field_mul(f, &u, &lambda_d3, Py);
+    ecc_field_sub(f, &out->Y, &t, &u);
+
+    ecc_field_mul(f, &out->Z, common_Z, lambda_d);
+
+    smemclr(&lambda_n2, sizeof(lambda_n2));
+    smemclr(&lambda_d2, sizeof(lambda_d2));
+    smemclr(&lambda_d3, sizeof(lambda_d3));
+    smemclr(&t, sizeof(t));
+    smemclr(&u, sizeof(u));
+}
+
+/* As ecc_weierstrass_add_prologue */
+static void ecc_weierstrass_field_add_prologue(
+    const EccField *f, const WeierstrassFieldPoint *P,
+    const WeierstrassFieldPoint *Q, EccFieldElt *Px, EccFieldElt *Py,
+    EccFieldElt *Qx, EccFieldElt *denom,
+    EccFieldElt *lambda_n, EccFieldElt *lambda_d)
+{
+    EccFieldElt Pz2, Pz3, Qz2, Qz3, Qy;
+
+    ecc_field_mul(f, &Pz2, &P->Z, &P->Z);
+    ecc_field_mul(f, &Pz3, &Pz2, &P->Z);
+    ecc_field_mul(f, &Qz2, &Q->Z, &Q->Z);
+    ecc_field_mul(f, &Qz3, &Qz2, &Q->Z);
+
+    ecc_field_mul(f, Px, &P->X, &Qz2);
+    ecc_field_mul(f, Py, &P->Y, &Qz3);
+    ecc_field_mul(f, Qx, &Q->X, &Pz2);
+    ecc_field_mul(f, &Qy, &Q->Y, &Pz3);
+
+    ecc_field_mul(f, denom, &P->Z, &Q->Z);
+
+    ecc_field_sub(f, lambda_n, &Qy, Py);
+    ecc_field_sub(f, lambda_d, Qx, Px);
+
+    smemclr(&Pz2, sizeof(Pz2));
+    smemclr(&Pz3, sizeof(Pz3));
+    smemclr(&Qz2, sizeof(Qz2));
+    smemclr(&Qz3, sizeof(Qz3));
+    smemclr(&Qy, sizeof(Qy));
+}
+
+/* As ecc_weierstrass_tangent_slope */
+static void ecc_weierstrass_field_tangent_slope(
+    WeierstrassCurve *wc, const WeierstrassFieldPoint *P,
+    EccFieldElt *lambda_n, EccFieldElt *lambda_d)
+{
+    const EccField *f = wc->field;
+    EccFieldElt X2, threeX2, Z4;
+
+    ecc_field_mul(f, &X2, &P->X, &P->X);
+    ecc_field_add(f, &threeX2, &X2, &X2);
+    ecc_field_add(f, &threeX2, &threeX2, &X2);
+    ecc_field_mul(f, &Z4, &P->Z, &P->Z);
+    ecc_field_mul(f, &Z4, &Z4, &Z4);
+    ecc_field_mul(f, &Z4, &wc->field_a, &Z4);
+
+    ecc_field_add(f, lambda_n, &threeX2, &Z4);
+    ecc_field_add(f, lambda_d, &P->Y, &P->Y);
+
+    smemclr(&X2, sizeof(X2));
+    smemclr(&threeX2, sizeof(threeX2));
+    smemclr(&Z4, sizeof(Z4));
+}
+
+static void ecc_weierstrass_field_add(
+    WeierstrassCurve *wc, WeierstrassFieldPoint *S,
+    const WeierstrassFieldPoint *P, const WeierstrassFieldPoint *Q)
+{
+    const EccField *f = wc->field;
+    EccFieldElt Px, Py, Qx, denom, lambda_n, lambda_d;
+
+    ecc_weierstrass_field_add_prologue(
+        f, P, Q, &Px, &Py, &Qx, &denom, &lambda_n, &lambda_d);
+    assert(!ecc_field_is_zero(&lambda_n));
+    ecc_weierstrass_field_epilogue(
+        f, &Px, &Qx, &Py, &denom, &lambda_n, &lambda_d, S);
+
+    smemclr(&Px, sizeof(Px));
+    smemclr(&Py, sizeof(Py));
+    smemclr(&Qx, sizeof(Qx));
+    smemclr(&denom, sizeof(denom));
+    smemclr(&lambda_n, sizeof(lambda_n));
+    smemclr(&lambda_d, sizeof(lambda_d));
+}
+
+static void ecc_weierstrass_field_double(
+    WeierstrassCurve *wc, WeierstrassFieldPoint *D,
+    const WeierstrassFieldPoint *P)
+{
+    EccFieldElt lambda_n, lambda_d;
+
+    ecc_weierstrass_field_tangent_slope(wc, P, &lambda_n, &lambda_d);
+    ecc_weierstrass_field_epilogue(
+        wc->field, &P->X, &P->X, &P->Y, &P->Z, &lambda_n, &lambda_d, D);
+
+    smemclr(&lambda_n, sizeof(lambda_n));
+    smemclr(&lambda_d, sizeof(lambda_d));
+}
+
+static void ecc_weierstrass_field_add_general(
+    WeierstrassCurve *wc, WeierstrassFieldPoint *S,
+    const WeierstrassFieldPoint *P, const WeierstrassFieldPoint *Q)
+{
+    const EccField *f = wc->field;
+    EccFieldElt Px, Py, Qx, denom, lambda_n, lambda_d;
+    EccFieldElt lambda_n_tangent, lambda_d_tangent, zero = {{ 0 }};
+
+    ecc_weierstrass_field_add_prologue(
+        f, P, Q, &Px, &Py, &Qx, &denom, &lambda_n, &lambda_d);
+    ecc_weierstrass_field_tangent_slope(
+        wc, P, &lambda_n_tangent, &lambda_d_tangent);
+
+    unsigned equality = (ecc_field_is_zero(&lambda_d) &
+                         ecc_field_is_zero(&lambda_n));
+    ecc_field_select(&lambda_n, &lambda_n, &lambda_n_tangent, equality);
+    ecc_field_select(&lambda_d, &lambda_d, &lambda_d_tangent, equality);
+
+    ecc_weierstrass_field_epilogue(
+        f, &Px, &Qx, &Py, &denom, &lambda_n, &lambda_d, S);
+
+    ecc_weierstrass_field_select(S, S, Q, ecc_field_is_zero(&P->Z));
+    ecc_weierstrass_field_select(S, S, P, ecc_field_is_zero(&Q->Z));
+
+    unsigned output_id = ecc_field_is_zero(&S->Z);
+    ecc_field_select(&S->X, &S->X, &zero, output_id);
+    ecc_field_select(&S->Y, &S->Y, &zero, output_id);
+
+    smemclr(&Px, sizeof(Px));
+    smemclr(&Py, sizeof(Py));
+    smemclr(&Qx, sizeof(Qx));
+    smemclr(&denom, sizeof(denom));
+    smemclr(&lambda_n, sizeof(lambda_n));
+    smemclr(&lambda_d, sizeof(lambda_d));
+    smemclr(&lambda_n_tangent, sizeof(lambda_n_tangent));
+    smemclr(&lambda_d_tangent, sizeof(lambda_d_tangent));
+}
+
+static WeierstrassPoint *ecc_weierstrass_field_multiply(
+    WeierstrassPoint *Bp, mp_int *n)
+{
+    WeierstrassCurve *wc = Bp->wc;
+    WeierstrassFieldPoint B, two_B, k_B, kplus1_B, sum, other;
+
+    ecc_weierstrass_field_load(&B, Bp);
+    ecc_weierstrass_field_double(wc, &two_B, &B);
+    k_B = B;
+    kplus1_B = two_B;
+
+    unsigned not_started_yet = 1;
+    for (size_t bitindex = mp_max_bits(n); bitindex-- > 0 ;) {
+        unsigned nbit = mp_get_bit(n, bitindex);
+
+        ecc_weierstrass_field_add(wc, &sum, &k_B, &kplus1_B);
+        ecc_weierstrass_field_cond_swap(&k_B, &kplus1_B, nbit);
+        ecc_weierstrass_field_double(wc, &other, &k_B);
+        k_B = other;
+        kplus1_B = sum;
+        ecc_weierstrass_field_cond_swap(&k_B, &kplus1_B, nbit);
+
+        ecc_weierstrass_field_select(&k_B, &k_B, &B, not_started_yet);
+        ecc_weierstrass_field_select(
+            &kplus1_B, &kplus1_B, &two_B, not_started_yet);
+        not_started_yet &= ~nbit;
+    }
+
+    smemclr(&B, sizeof(B));
+    smemclr(&two_B, sizeof(two_B));
+    smemclr(&kplus1_B, sizeof(kplus1_B));
+    smemclr(&sum, sizeof(sum));
+    smemclr(&other, sizeof(other));
+    return ecc_weierstrass_field_store(wc, &k_B);
+}
+
 /*
  * Shared code between all three of the basic arithmetic functions:
  * once we've determined the slope of the line that we're intersecting
@@ -302,6 +560,16 @@ WeierstrassPoint *ecc_weierstrass_add(WeierstrassPoint *P, WeierstrassPoint *Q)
     WeierstrassCurve *wc = P->wc;
     assert(Q->wc == wc);
 
+    if (wc->field) {
+        WeierstrassFieldPoint fP, fQ, fS;
+        ecc_weierstrass_field_load(&fP, P);
+        ecc_weierstrass_field_load(&fQ, Q);
+        ecc_weierstrass_field_add(wc, &fS, &fP, &fQ);
+        smemclr(&fP, sizeof(fP));
+        smemclr(&fQ, sizeof(fQ));
+        return ecc_weierstrass_field_store(wc, &fS);
+    }
+
     WeierstrassPoint *S = ecc_weierstrass_point_new_empty(wc);
 
     mp_int *Px, *Py, *Qx, *denom, *lambda_n, *lambda_d;
@@ -361,6 +629,15 @@ static inline void ecc_weierstrass_tangent_slope(
 WeierstrassPoint *ecc_weierstrass_double(WeierstrassPoint *P)
 {
     WeierstrassCurve *wc = P->wc;
+
+    if (wc->field) {
+        WeierstrassFieldPoint fP, fD;
+        ecc_weierstrass_field_load(&fP, P);
+        ecc_weierstrass_field_double(wc, &fD, &fP);
+        smemclr(&fP, sizeof(fP));
+        return ecc_weierstrass_field_store(wc, &fD);
+    }
+
     WeierstrassPoint *D = ecc_weierstrass_point_new_empty(wc);
 
     mp_int *lambda_n, *lambda_d;
@@ -387,6 +664,16 @@ WeierstrassPoint *ecc_weierstrass_add_general(
     WeierstrassCurve *wc = P->wc;
     assert(Q->wc == wc);
 
+    if (wc->field) {
+        WeierstrassFieldPoint fP, fQ, fS;
+        ecc_weierstrass_field_load(&fP, P);
+        ecc_weierstrass_field_load(&fQ, Q);
+        ecc_weierstrass_field_add_general(wc, &fS, &fP, &fQ);
+        smemclr(&fP, sizeof(fP));
+        smemclr(&fQ, sizeof(fQ));
+        return ecc_weierstrass_field_store(wc, &fS);
+    }
+
     WeierstrassPoint *S = ecc_weierstrass_point_new_empty(wc);
 
     /* Parameters for the epilogue, and slope of the line if P != Q */
@@ -437,6 +724,9 @@ WeierstrassPoint *ecc_weierstrass_add_general(
 
 WeierstrassPoint *ecc_weierstrass_multiply(WeierstrassPoint *B, mp_int *n)
 {
+    if (B->wc->field)
+        return ecc_weierstrass_field_multiply(B, n);
+
     WeierstrassPoint *two_B = ecc_weierstrass_double(B);
     WeierstrassPoint *k_B = ecc_weierstrass_point_copy(B);
     WeierstrassPoint *kplus1_B = ecc_weierstrass_point_copy(two_B);
@@ -472,6 +762,143 @@ WeierstrassPoint *ecc_weierstrass_multiply(WeierstrassPoint *B, mp_int *n)
     return k_B;
 }
 
+/*
+ * Fixed-base multiplication, shared between the Weierstrass and
+ * Edwards versions below.
+ *
+ * We split the (reduced) multiplier into 4-bit windows, and for each
+ * window w store the 16 points i * 16^w * B. Then n*B is just the sum
+ * of one table entry per window, which is about a quarter as many
+ * point additions as the ladder does, and no doublings at all. To
+ * keep it constant-time, each lookup reads every entry of that
+ * window's table and keeps the wanted one by masked selection.
+ *
+ * The table is only built when the multiply function has been called
+ * a few times, so that a one-off use of a curve (such as checking a
+ * single host key signature) doesn't pay for a table it won't reuse.
+ */
+#define ECC_BASE_WINDOW_BITS 4
+#define ECC_BASE_WINDOW_SIZE (1 << ECC_BASE_WINDOW_BITS)
+#define ECC_BASE_TABLE_LAZY_USES 2
+
+static inline unsigned ecc_base_window_digit(mp_int *n, size_t window)
+{
+    unsigned digit = 0;
+    for (unsigned i = 0; i < ECC_BASE_WINDOW_BITS; i++)
+        digit |= mp_get_bit(n, window * ECC_BASE_WINDOW_BITS + i) << i;
+    return digit;
+}
+
+/* Return 1 if i == digit, else 0, without branching. Both are < 16. */
+static inline unsigned ecc_base_digit_eq(unsigned i, unsigned digit)
+{
+    return 1 ^ (((i ^ digit) + ECC_BASE_WINDOW_SIZE - 1) >>
+                ECC_BASE_WINDOW_BITS);
+}
+
+static inline size_t ecc_base_nwindows(mp_int *order)
+{
+    return (mp_get_nbits(order) + ECC_BASE_WINDOW_BITS - 1) /
+        ECC_BASE_WINDOW_BITS;
+}
+
+struct WeierstrassBaseTable {
+    WeierstrassPoint *B;
+    mp_int *order;
+    unsigned uses;
+    size_t nwindows;
+    WeierstrassPoint **points;  /* points[w*16+i] = i * 16^w * B */
+};
+
+WeierstrassBaseTable *ecc_weierstrass_base_table_new(
+    WeierstrassPoint *B, mp_int *order)
+{
+    WeierstrassBaseTable *wt = snew(WeierstrassBaseTable);
+    wt->B = ecc_weierstrass_point_copy(B);
+    wt->order = mp_copy(order);
+    wt->uses = 0;
+    wt->nwindows = ecc_base_nwindows(order);
+    wt->points = NULL;
+    return wt;
+}
+
+void ecc_weierstrass_base_table_free(WeierstrassBaseTable *wt)
+{
+    if (wt->points) {
+        for (size_t i = 0; i < wt->nwindows * ECC_BASE_WINDOW_SIZE; i++)
+            ecc_weierstrass_point_free(wt->points[i]);
+        sfree(wt->points);
+    }
+    ecc_weierstrass_point_free(wt->B);
+    mp_free(wt->order);
+    sfree(wt);
+}
+
+static void ecc_weierstrass_base_table_build(WeierstrassBaseTable *wt)
+{
+    WeierstrassCurve *wc = wt->B->wc;
+    WeierstrassPoint *P = ecc_weierstrass_point_copy(wt->B);
+
+    wt->points = snewn(wt->nwindows * ECC_BASE_WINDOW_SIZE,
+                       WeierstrassPoint *);
+    for (size_t w = 0; w < wt->nwindows; w++) {
+        WeierstrassPoint **row = wt->points + w * ECC_BASE_WINDOW_SIZE;
+
+        /* None of these sums can be a doubling or hit the identity,
+         * except 2P, so we can use the fast functions. */
+        row[0] = ecc_weierstrass_point_new_identity(wc);
+        row[1] = ecc_weierstrass_point_copy(P);
+        row[2] = ecc_weierstrass_double(P);
+        for (size_t i = 3; i < ECC_BASE_WINDOW_SIZE; i++)
+            row[i] = ecc_weierstrass_add(row[i-1], P);
+
+        ecc_weierstrass_point_free(P);
+        P = ecc_weierstrass_add(row[ECC_BASE_WINDOW_SIZE-1], row[1]);
+    }
+    ecc_weierstrass_point_free(P);
+}
+
+WeierstrassPoint *ecc_weierstrass_base_table_multiply(
+    WeierstrassBaseTable *wt, mp_int *n)
+{
+    mp_int *r = mp_mod(n, wt->order);
+
+    if (!wt->points) {
+        if (wt->uses++ < ECC_BASE_TABLE_LAZY_USES) {
+            WeierstrassPoint *toret = ecc_weierstrass_multiply(wt->B, r);
+            mp_free(r);
+            return toret;
+        }
+        ecc_weierstrass_base_table_build(wt);
+    }
+
+    WeierstrassCurve *wc = wt->B->wc;
+    WeierstrassPoint *acc = ecc_weierstrass_point_new_identity(wc);
+    WeierstrassPoint *sel = ecc_weierstrass_point_new_identity(wc);
+
+    for (size_t w = 0; w < wt->nwindows; w++) {
+        WeierstrassPoint **row = wt->points + w * ECC_BASE_WINDOW_SIZE;
+        unsigned digit = ecc_base_window_digit(r, w);
+        for (unsigned i = 0; i < ECC_BASE_WINDOW_SIZE; i++)
+            ecc_weierstrass_cond_overwrite(sel, row[i],
+                                           ecc_base_digit_eq(i, digit));
+
+        /*
+         * acc is a multiple of B less than 16^w, and sel is a
+         * multiple of 16^w, so the sum can only be a doubling or
+         * reach the identity if both are the identity. But
+         * add_general copes with that without branching anyway.
+         */
+        WeierstrassPoint *sum = ecc_weierstrass_add_general(acc, sel);
+        ecc_weierstrass_point_free(acc);
+        acc = sum;
+    }
+
+    ecc_weierstrass_point_free(sel);
+    mp_free(r);
+    return acc;
+}
+
 unsigned ecc_weierstrass_is_identity(WeierstrassPoint *wp)
 {
     return mp_eq_integer(wp->Z, 0);
@@ -485,7 +912,7 @@ unsigned ecc_weierstrass_is_identity(WeierstrassPoint *wp)
 static void ecc_weierstrass_normalise(WeierstrassPoint *wp)
 {
     WeierstrassCurve *wc = wp->wc;
-    mp_int *zinv = monty_invert(wc->mc, wp->Z);
+    mp_int *zinv = ecc_field_monty_invert(wc->field, wc->mc, wp->Z);
     mp_int *zinv2 = monty_mul(wc->mc, zinv, zinv);
     mp_int *zinv3 = monty_mul(wc->mc, zinv2, zinv);
     monty_mul_into(wc->mc, wp->X, wp->X, zinv2);
@@ -571,6 +998,11 @@ struct MontgomeryCurve {
 
     /* (a+2)/4, also in Montgomery-multiplication form. */
     mp_int *aplus2over4;
+
+    /* Specialised field arithmetic for this p, if any, and (a+2)/4 in
+     * the form it wants. */
+    const EccField *field;
+    EccFieldElt field_aplus2over4;
 };
 
 MontgomeryCurve *ecc_montgomery_curve(
@@ -593,6 +1025,10 @@ MontgomeryCurve *ecc_montgomery_curve(
     mp_free(aplus2);
     mp_free(aplus2over4);
 
+    mc->field = ecc_field_find(p);
+    if (mc->field)
+        mc->field->import(&mc->field_aplus2over4, mc->aplus2over4);
+
     return mc;
 }
 
@@ -758,10 +1194,140 @@ MontgomeryPoint *ecc_montgomery_double(MontgomeryPoint *P)
     return D;
 }
 
+/*
+ * Specialised-field versions of ecc_montgomery_diff_add,
+ * ecc_montgomery_double and ecc_montgomery_multiply, in the same way
+ * as the Weierstrass ones above. Only the whole ladder is dispatched:
+ * the individual operations aren't used anywhere hot enough to be
+ * worth it.
+ */
+
+typedef struct MontgomeryFieldPoint {
+    EccFieldElt X, Z;
+} MontgomeryFieldPoint;
+
+static void ecc_montgomery_field_select(
+    MontgomeryFieldPoint *dest, const MontgomeryFieldPoint *P,
+    const MontgomeryFieldPoint *Q, unsigned choose_Q)
+{
+    ecc_field_select(&dest->X, &P->X, &Q->X, choose_Q);
+    ecc_field_select(&dest->Z, &P->Z, &Q->Z, choose_Q);
+}
+
+static void ecc_montgomery_field_cond_swap(
+    MontgomeryFieldPoint *P, MontgomeryFieldPoint *Q, unsigned swap)
+{
+    ecc_field_cond_swap(&P->X, &Q->X, swap);
+    ecc_field_cond_swap(&P->Z, &Q->Z, swap);
+}
+
+/* 'S' must not alias any input. */
+static void ecc_montgomery_field_diff_add(
+    const EccField *f, MontgomeryFieldPoint *S,
+    const MontgomeryFieldPoint *P, const MontgomeryFieldPoint *Q,
+    const MontgomeryFieldPoint *PminusQ)
+{
+    EccFieldElt Px_m_Pz, Px_p_Pz, Qx_m_Qz, Qx_p_Qz, PmQp, PpQm, Xpre, Zpre;
+
+    ecc_field_sub(f, &Px_m_Pz, &P->X, &P->Z);
+    ecc_field_add(f, &Px_p_Pz, &P->X, &P->Z);
+    ecc_field_sub(f, &Qx_m_Qz, &Q->X, &Q->Z);
+    ecc_field_add(f, &Qx_p_Qz, &Q->X, &Q->Z);
+    ecc_field_mul(f, &PmQp, &Px_m_Pz, &Qx_p_Qz);
+    ecc_field_mul(f, &PpQm, &Px_p_Pz, &Qx_m_Qz);
+    ecc_field_add(f, &Xpre, &PmQp, &PpQm);
+    ecc_field_sub(f, &Zpre, &PmQp, &PpQm);
+    ecc_field_mul(f, &Xpre, &Xpre, &Xpre);
+    ecc_field_mul(f, &Zpre, &Zpre, &Zpre);
+    ecc_field_mul(f, &S->X, &Xpre, &PminusQ->Z);
+    ecc_field_mul(f, &S->Z, &Zpre, &PminusQ->X);
+
+    smemclr(&Px_m_Pz, sizeof(Px_m_Pz));
+    smemclr(&Px_p_Pz, sizeof(Px_p_Pz));
+    smemclr(&Qx_m_Qz, sizeof(Qx_m_Qz));
+    smemclr(&Qx_p_Qz, sizeof(Qx_p_Qz));
+    smemclr(&PmQp, sizeof(PmQp));
+    smemclr(&PpQm, sizeof(PpQm));
+    smemclr(&Xpre, sizeof(Xpre));
+    smemclr(&Zpre, sizeof(Zpre));
+}
+
+/* 'D' must not alias 'P'. */
+static void ecc_montgomery_field_double(
+    MontgomeryCurve *mc, MontgomeryFieldPoint *D,
+    const MontgomeryFieldPoint *P)
+{
+    const EccField *f = mc->field;
+    EccFieldElt Px_m_Pz_2, Px_p_Pz_2, fourXZ, t;
+
+    ecc_field_sub(f, &Px_m_Pz_2, &P->X, &P->Z);
+    ecc_field_add(f, &Px_p_Pz_2, &P->X, &P->Z);
+    ecc_field_mul(f, &Px_m_Pz_2, &Px_m_Pz_2, &Px_m_Pz_2);
+    ecc_field_mul(f, &Px_p_Pz_2, &Px_p_Pz_2, &Px_p_Pz_2);
+    ecc_field_mul(f, &D->X, &Px_m_Pz_2, &Px_p_Pz_2);
+    ecc_field_mul(f, &fourXZ, &P->X, &P->Z);
+    ecc_field_add(f, &fourXZ, &fourXZ, &fourXZ);
+    ecc_field_add(f, &fourXZ, &fourXZ, &fourXZ);
+    ecc_field_mul(f, &t, &fourXZ, &mc->field_aplus2over4);
+    ecc_field_add(f, &t, &Px_m_Pz_2, &t);
+    ecc_field_mul(f, &D->Z, &fourXZ, &t);
+
+    smemclr(&Px_m_Pz_2, sizeof(Px_m_Pz_2));
+    smemclr(&Px_p_Pz_2, sizeof(Px_p_Pz_2));
+    smemclr(&fourXZ, sizeof(fourXZ));
+    smemclr(&t, sizeof(t));
+}
+
+static MontgomeryPoint *ecc_montgomery_field_multiply(
+    MontgomeryPoint *Bp, mp_int *n)
+{
+    MontgomeryCurve *mc = Bp->mc;
+    const EccField *f = mc->field;
+    MontgomeryFieldPoint B, two_B, k_B, kplus1_B, sum, other;
+
+    f->import(&B.X, Bp->X);
+    f->import(&B.Z, Bp->Z);
+    ecc_montgomery_field_double(mc, &two_B, &B);
+    k_B = B;
+    kplus1_B = two_B;
+
+    unsigned not_started_yet = 1;
+    for (size_t bitindex = mp_max_bits(n); bitindex-- > 0 ;) {
+        unsigned nbit = mp_get_bit(n, bitindex);
+
+        ecc_montgomery_field_diff_add(f, &sum, &k_B, &kplus1_B, &B);
+        ecc_montgomery_field_cond_swap(&k_B, &kplus1_B, nbit);
+        ecc_montgomery_field_double(mc, &other, &k_B);
+        k_B = other;
+        kplus1_B = sum;
+        ecc_montgomery_field_cond_swap(&k_B, &kplus1_B, nbit);
+
+        ecc_montgomery_field_select(&k_B, &k_B, &B, not_started_yet);
+        ecc_montgomery_field_select(
+            &kplus1_B, &kplus1_B, &two_B, not_started_yet);
+        not_started_yet &= ~nbit;
+    }
+
+    MontgomeryPoint *toret = ecc_montgomery_point_new_empty(mc);
+    size_t bits = mp_max_bits(mc->p);
+    toret->X = mp_new(bits);
+    toret->Z = mp_new(bits);
+    f->export(toret->X, &k_B.X);
+    f->export(toret->Z, &k_B.Z);
+
+    smemclr(&B, sizeof(B));
+    smemclr(&two_B, sizeof(two_B));
+    smemclr(&k_B, sizeof(k_B));
+    smemclr(&kplus1_B, sizeof(kplus1_B));
+    smemclr(&sum, sizeof(sum));
+    smemclr(&other, sizeof(other));
+    return toret;
+}
+
 static void ecc_montgomery_normalise(MontgomeryPoint *mp)
 {
     MontgomeryCurve *mc = mp->mc;
-    mp_int *zinv = monty_invert(mc->mc, mp->Z);
+    mp_int *zinv = ecc_field_monty_invert(mc->field, mc->mc, mp->Z);
     monty_mul_into(mc->mc, mp->X, mp->X, zinv);
     monty_mul_into(mc->mc, mp->Z, mp->Z, zinv);
     mp_free(zinv);
@@ -800,6 +1366,9 @@ MontgomeryPoint *ecc_montgomery_multiply(MontgomeryPoint *B, mp_int *n)
      * with B and 2B again,
      */
 
+    if (B->mc->field)
+        return ecc_montgomery_field_multiply(B, n);
+
     MontgomeryPoint *two_B = ecc_montgomery_double(B);
     MontgomeryPoint *k_B = ecc_montgomery_point_copy(B);
     MontgomeryPoint *kplus1_B = ecc_montgomery_point_copy(two_B);
@@ -872,6 +1441,11 @@ struct EdwardsCurve {
     /* Parameters of the curve, in Montgomery-multiplication
      * transformed form. */
     mp_int *d, *a;
+
+    /* Specialised field arithmetic for this p, if any, and d,a in the
+     * form it wants. */
+    const EccField *field;
+    EccFieldElt field_d, field_a;
 };
 
 EdwardsCurve *ecc_edwards_curve(mp_int *p, mp_int *d, mp_int *a,
@@ -888,6 +1462,12 @@ EdwardsCurve *ecc_edwards_curve(mp_int *p, mp_int *d, mp_int *a,
     else
         ec->sc = NULL;
 
+    ec->field = ecc_field_find(p);
+    if (ec->field) {
+        ec->field->import(&ec->field_d, ec->d);
+        ec->field->import(&ec->field_a, ec->a);
+    }
+
     return ec;
 }
 
@@ -973,7 +1553,8 @@ EdwardsPoint *ecc_edwards_point_new_from_y(
     mp_int *dy2 = monty_mul(ec->mc, ec->d, y2);
     mp_int *dy2ma = monty_sub(ec->mc, dy2, ec->a);
     mp_int *y2m1 = monty_sub(ec->mc, y2, monty_identity(ec->mc));
-    mp_int *recip_denominator = monty_invert(ec->mc, dy2ma);
+    mp_int *recip_denominator = ecc_field_monty_invert(
+        ec->field, ec->mc, dy2ma);
     mp_int *radicand = monty_mul(ec->mc, y2m1, recip_denominator);
     mp_int *x = monty_modsqrt(ec->sc, radicand, &success);
     mp_free(y2);
@@ -1025,11 +1606,149 @@ static void ecc_edwards_cond_swap(
     mp_cond_swap(P->T, Q->T, swap);
 }
 
+/*
+ * Specialised-field versions of ecc_edwards_add and
+ * ecc_edwards_multiply, in the same way as the Weierstrass ones.
+ */
+
+typedef struct EdwardsFieldPoint {
+    EccFieldElt X, Y, Z, T;
+} EdwardsFieldPoint;
+
+static void ecc_edwards_field_load(EdwardsFieldPoint *fp, EdwardsPoint *ep)
+{
+    const EccField *f = ep->ec->field;
+    f->import(&fp->X, ep->X);
+    f->import(&fp->Y, ep->Y);
+    f->import(&fp->Z, ep->Z);
+    f->import(&fp->T, ep->T);
+}
+
+static EdwardsPoint *ecc_edwards_field_store(
+    EdwardsCurve *ec, EdwardsFieldPoint *fp)
+{
+    EdwardsPoint *ep = ecc_edwards_point_new_empty(ec);
+    size_t bits = mp_max_bits(ec->p);
+    ep->X = mp_new(bits);
+    ep->Y = mp_new(bits);
+    ep->Z = mp_new(bits);
+    ep->T = mp_new(bits);
+    ec->field->export(ep->X, &fp->X);
+    ec->field->export(ep->Y, &fp->Y);
+    ec->field->export(ep->Z, &fp->Z);
+    ec->field->export(ep->T, &fp->T);
+    smemclr(fp, sizeof(*fp));
+    return ep;
+}
+
+static void ecc_edwards_field_select(
+    EdwardsFieldPoint *dest, const EdwardsFieldPoint *P,
+    const EdwardsFieldPoint *Q, unsigned choose_Q)
+{
+    ecc_field_select(&dest->X, &P->X, &Q->X, choose_Q);
+    ecc_field_select(&dest->Y, &P->Y, &Q->Y, choose_Q);
+    ecc_field_select(&dest->Z, &P->Z, &Q->Z, choose_Q);
+    ecc_field_select(&dest->T, &P->T, &Q->T, choose_Q);
+}
+
+static void ecc_edwards_field_cond_swap(
+    EdwardsFieldPoint *P, EdwardsFieldPoint *Q, unsigned swap)
+{
+    ecc_field_cond_swap(&P->X, &Q->X, swap);
+    ecc_field_cond_swap(&P->Y, &Q->Y, swap);
+    ecc_field_cond_swap(&P->Z, &Q->Z, swap);
+    ecc_field_cond_swap(&P->T, &Q->T, swap);
+}
+
+/* As ecc_edwards_add. 'S' must not alias either input. */
+static void ecc_edwards_field_add(
+    EdwardsCurve *ec, EdwardsFieldPoint *S,
+    const EdwardsFieldPoint *P, const EdwardsFieldPoint *Q)
+{
+    const EccField *f = ec->field;
+    EccFieldElt PxQx, PyQy, PtQt, PzQz, Psum, Qsum, E, F, G, H;
+
+    ecc_field_mul(f, &PxQx, &P->X, &Q->X);
+    ecc_field_mul(f, &PyQy, &P->Y, &Q->Y);
+    ecc_field_mul(f, &PtQt, &P->T, &Q->T);
+    ecc_field_mul(f, &PzQz, &P->Z, &Q->Z);
+    ecc_field_add(f, &Psum, &P->X, &P->Y);
+    ecc_field_add(f, &Qsum, &Q->X, &Q->Y);
+    ecc_field_mul(f, &E, &Psum, &Qsum);
+    ecc_field_add(f, &Psum, &PxQx, &PyQy);
+    ecc_field_sub(f, &E, &E, &Psum);
+    ecc_field_mul(f, &PxQx, &ec->field_a, &PxQx);
+    ecc_field_mul(f, &PtQt, &ec->field_d, &PtQt);
+    ecc_field_sub(f, &F, &PzQz, &PtQt);
+    ecc_field_add(f, &G, &PzQz, &PtQt);
+    ecc_field_sub(f, &H, &PyQy, &PxQx);
+    ecc_field_mul(f, &S->X, &E, &F);
+    ecc_field_mul(f, &S->Z, &F, &G);
+    ecc_field_mul(f, &S->Y, &G, &H);
+    ecc_field_mul(f, &S->T, &H, &E);
+
+    smemclr(&PxQx, sizeof(PxQx));
+    smemclr(&PyQy, sizeof(PyQy));
+    smemclr(&PtQt, sizeof(PtQt));
+    smemclr(&PzQz, sizeof(PzQz));
+    smemclr(&Psum, sizeof(Psum));
+    smemclr(&Qsum, sizeof(Qsum));
+    smemclr(&E, sizeof(E));
+    smemclr(&F, sizeof(F));
+    smemclr(&G, sizeof(G));
+    smemclr(&H, sizeof(H));
+}
+
+static EdwardsPoint *ecc_edwards_field_multiply(EdwardsPoint *Bp, mp_int *n)
+{
+    EdwardsCurve *ec = Bp->ec;
+    EdwardsFieldPoint B, two_B, k_B, kplus1_B, sum, other;
+
+    ecc_edwards_field_load(&B, Bp);
+    ecc_edwards_field_add(ec, &two_B, &B, &B);
+    k_B = B;
+    kplus1_B = two_B;
+
+    unsigned not_started_yet = 1;
+    for (size_t bitindex = mp_max_bits(n); bitindex-- > 0 ;) {
+        unsigned nbit = mp_get_bit(n, bitindex);
+
+        ecc_edwards_field_add(ec, &sum, &k_B, &kplus1_B);
+        ecc_edwards_field_cond_swap(&k_B, &kplus1_B, nbit);
+        ecc_edwards_field_add(ec, &other, &k_B, &k_B);
+        k_B = other;
+        kplus1_B = sum;
+        ecc_edwards_field_cond_swap(&k_B, &kplus1_B, nbit);
+
+        ecc_edwards_field_select(&k_B, &k_B, &B, not_started_yet);
+        ecc_edwards_field_select(
+            &kplus1_B, &kplus1_B, &two_B, not_started_yet);
+        not_started_yet &= ~nbit;
+    }
+
+    smemclr(&B, sizeof(B));
+    smemclr(&two_B, sizeof(two_B));
+    smemclr(&kplus1_B, sizeof(kplus1_B));
+    smemclr(&sum, sizeof(sum));
+    smemclr(&other, sizeof(other));
+    return ecc_edwards_field_store(ec, &k_B);
+}
+
 EdwardsPoint *ecc_edwards_add(EdwardsPoint *P, EdwardsPoint *Q)
 {
     EdwardsCurve *ec = P->ec;
     assert(Q->ec == ec);
 
+    if (ec->field) {
+        EdwardsFieldPoint fP, fQ, fS;
+        ecc_edwards_field_load(&fP, P);
+        ecc_edwards_field_load(&fQ, Q);
+        ecc_edwards_field_add(ec, &fS, &fP, &fQ);
+        smemclr(&fP, sizeof(fP));
+        smemclr(&fQ, sizeof(fQ));
+        return ecc_edwards_field_store(ec, &fS);
+    }
+
     EdwardsPoint *S = ecc_edwards_point_new_empty(ec);
 
     /*
@@ -1089,7 +1808,7 @@ EdwardsPoint *ecc_edwards_add(EdwardsPoint *P, EdwardsPoint *Q)
 static void ecc_edwards_normalise(EdwardsPoint *ep)
 {
     EdwardsCurve *ec = ep->ec;
-    mp_int *zinv = monty_invert(ec->mc, ep->Z);
+    mp_int *zinv = ecc_field_monty_invert(ec->field, ec->mc, ep->Z);
     monty_mul_into(ec->mc, ep->X, ep->X, zinv);
     monty_mul_into(ec->mc, ep->Y, ep->Y, zinv);
     monty_mul_into(ec->mc, ep->Z, ep->Z, zinv);
@@ -1099,6 +1818,9 @@ static void ecc_edwards_normalise(EdwardsPoint *ep)
 
 EdwardsPoint *ecc_edwards_multiply(EdwardsPoint *B, mp_int *n)
 {
+    if (B->ec->field)
+        return ecc_edwards_field_multiply(B, n);
+
     EdwardsPoint *two_B = ecc_edwards_add(B, B);
     EdwardsPoint *k_B = ecc_edwards_point_copy(B);
     EdwardsPoint *kplus1_B = ecc_edwards_point_copy(two_B);
@@ -1133,6 +1855,221 @@ EdwardsPoint *ecc_edwards_multiply(EdwardsPoint *B, mp_int *n)
     return k_B;
 }
 
+struct EdwardsBaseTable {
+    EdwardsPoint *B;
+    mp_int *order;
+    unsigned uses;
+    size_t nwindows;
+    EdwardsPoint **points;      /* points[w*16+i] = i * 16^w * B */
+};
+
+EdwardsBaseTable *ecc_edwards_base_table_new(EdwardsPoint *B, mp_int *order)
+{
+    EdwardsBaseTable *et = snew(EdwardsBaseTable);
+    et->B = ecc_edwards_point_copy(B);
+    et->order = mp_copy(order);
+    et->uses = 0;
+    et->nwindows = ecc_base_nwindows(order);
+    et->points = NULL;
+    return et;
+}
+
+void ecc_edwards_base_table_free(EdwardsBaseTable *et)
+{
+    if (et->points) {
+        for (size_t i = 0; i < et->nwindows * ECC_BASE_WINDOW_SIZE; i++)
+            ecc_edwards_point_free(et->points[i]);
+        sfree(et->points);
+    }
+    ecc_edwards_point_free(et->B);
+    mp_free(et->order);
+    sfree(et);
+}
+
+static EdwardsPoint *ecc_edwards_identity(EdwardsCurve *ec)
+{
+    mp_int *zero = mp_from_integer(0), *one = mp_from_integer(1);
+    EdwardsPoint *ep = ecc_edwards_point_new(ec, zero, one);
+    mp_free(zero);
+    mp_free(one);
+    return ep;
+}
+
+static void ecc_edwards_base_table_build(EdwardsBaseTable *et)
+{
+    EdwardsCurve *ec = et->B->ec;
+    EdwardsPoint *P = ecc_edwards_point_copy(et->B);
+
+    et->points = snewn(et->nwindows * ECC_BASE_WINDOW_SIZE, EdwardsPoint *);
+    for (size_t w = 0; w < et->nwindows; w++) {
+        EdwardsPoint **row = et->points + w * ECC_BASE_WINDOW_SIZE;
+
+        row[0] = ecc_edwards_identity(ec);
+        for (size_t i = 1; i < ECC_BASE_WINDOW_SIZE; i++)
+            row[i] = ecc_edwards_add(row[i-1], P);
+
+        ecc_edwards_point_free(P);
+        P = ecc_edwards_add(row[ECC_BASE_WINDOW_SIZE-1], row[1]);
+    }
+    ecc_edwards_point_free(P);
+}
+
+EdwardsPoint *ecc_edwards_base_table_multiply(EdwardsBaseTable *et, mp_int *n)
+{
+    mp_int *r = mp_mod(n, et->order);
+
+    if (!et->points) {
+        if (et->uses++ < ECC_BASE_TABLE_LAZY_USES) {
+            EdwardsPoint *toret = ecc_edwards_multiply(et->B, r);
+            mp_free(r);
+            return toret;
+        }
+        ecc_edwards_base_table_build(et);
+    }
+
+    EdwardsCurve *ec = et->B->ec;
+    EdwardsPoint *acc = ecc_edwards_identity(ec);
+    EdwardsPoint *sel = ecc_edwards_identity(ec);
+
+    for (size_t w = 0; w < et->nwindows; w++) {
+        EdwardsPoint **row = et->points + w * ECC_BASE_WINDOW_SIZE;
+        unsigned digit = ecc_base_window_digit(r, w);
+        for (unsigned i = 0; i < ECC_BASE_WINDOW_SIZE; i++)
+            ecc_edwards_cond_overwrite(sel, row[i],
+                                       ecc_base_digit_eq(i, digit));
+
+        /* Edwards addition is complete, so no special cases here */
+        EdwardsPoint *sum = ecc_edwards_add(acc, sel);
+        ecc_edwards_point_free(acc);
+        acc = sum;
+    }
+
+    ecc_edwards_point_free(sel);
+    mp_free(r);
+    return acc;
+}
+
+/*
+ * Multi-scalar multiplication, by the interleaved method usually
+ * credited to Straus: each point gets its own table of multiples
+ * 0,1,...,15 times itself, and then a single accumulator is run down
+ * all the scalars a 4-bit window at a time, quadrupling it four times
+ * between windows and adding in one table entry per point. So the
+ * doublings are shared between all the terms, and each term costs one
+ * addition per window.
+ *
+ * The table lookups are done by the same constant-time scan as in the
+ * base-table code, and the loop counts depend only on the sizes of
+ * the scalars. A scalar allocated shorter than the others skips the
+ * additions for the windows it doesn't reach, which makes it cheaper
+ * to mix 128-bit and full-length scalars in one call.
+ */
+static EdwardsPoint *ecc_edwards_field_multiscalar(
+    EdwardsCurve *ec, size_t n, EdwardsPoint *const *points,
+    mp_int *const *scalars, size_t nwindows)
+{
+    EdwardsFieldPoint *tables = snewn(n * ECC_BASE_WINDOW_SIZE,
+                                      EdwardsFieldPoint);
+    EdwardsFieldPoint acc, sel, tmp;
+
+    EdwardsPoint *id = ecc_edwards_identity(ec);
+    ecc_edwards_field_load(&acc, id);
+    ecc_edwards_point_free(id);
+
+    for (size_t i = 0; i < n; i++) {
+        EdwardsFieldPoint *row = tables + i * ECC_BASE_WINDOW_SIZE;
+        row[0] = acc;
+        ecc_edwards_field_load(&row[1], points[i]);
+        for (size_t j = 2; j < ECC_BASE_WINDOW_SIZE; j++)
+            ecc_edwards_field_add(ec, &row[j], &row[j-1], &row[1]);
+    }
+
+    for (size_t w = nwindows; w-- > 0 ;) {
+        for (unsigned k = 0; k < ECC_BASE_WINDOW_BITS; k++) {
+            ecc_edwards_field_add(ec, &tmp, &acc, &acc);
+            acc = tmp;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (w * ECC_BASE_WINDOW_BITS >= mp_max_bits(scalars[i]))
+                continue;      /* this scalar is too short to reach here */
+            EdwardsFieldPoint *row = tables + i * ECC_BASE_WINDOW_SIZE;
+            unsigned digit = ecc_base_window_digit(scalars[i], w);
+            sel = row[0];
+            for (unsigned j = 1; j < ECC_BASE_WINDOW_SIZE; j++)
+                ecc_edwards_field_select(&sel, &sel, &row[j],
+                                         ecc_base_digit_eq(j, digit));
+            ecc_edwards_field_add(ec, &tmp, &acc, &sel);
+            acc = tmp;
+        }
+    }
+
+    smemclr(tables, n * ECC_BASE_WINDOW_SIZE * sizeof(*tables));
+    sfree(tables);
+    smemclr(&sel, sizeof(sel));
+    smemclr(&tmp, sizeof(tmp));
+    return ecc_edwards_field_store(ec, &acc);
+}
+
+EdwardsPoint *ecc_edwards_multiscalar(
+    size_t n, EdwardsPoint *const *points, mp_int *const *scalars)
+{
+    assert(n > 0);
+    EdwardsCurve *ec = points[0]->ec;
+
+    size_t maxbits = 0;
+    for (size_t i = 0; i < n; i++) {
+        assert(points[i]->ec == ec);
+        size_t bits = mp_max_bits(scalars[i]);
+        if (maxbits < bits)
+            maxbits = bits;
+    }
+    size_t nwindows = (maxbits + ECC_BASE_WINDOW_BITS - 1) /
+        ECC_BASE_WINDOW_BITS;
+
+    if (ec->field)
+        return ecc_edwards_field_multiscalar(ec, n, points, scalars, nwindows);
+
+    EdwardsPoint **tables = snewn(n * ECC_BASE_WINDOW_SIZE, EdwardsPoint *);
+    for (size_t i = 0; i < n; i++) {
+        EdwardsPoint **row = tables + i * ECC_BASE_WINDOW_SIZE;
+        row[0] = ecc_edwards_identity(ec);
+        row[1] = ecc_edwards_point_copy(points[i]);
+        for (size_t j = 2; j < ECC_BASE_WINDOW_SIZE; j++)
+            row[j] = ecc_edwards_add(row[j-1], row[1]);
+    }
+
+    EdwardsPoint *acc = ecc_edwards_identity(ec);
+    EdwardsPoint *sel = ecc_edwards_identity(ec);
+
+    for (size_t w = nwindows; w-- > 0 ;) {
+        for (unsigned k = 0; k < ECC_BASE_WINDOW_BITS; k++) {
+            EdwardsPoint *dbl = ecc_edwards_add(acc, acc);
+            ecc_edwards_point_free(acc);
+            acc = dbl;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (w * ECC_BASE_WINDOW_BITS >= mp_max_bits(scalars[i]))
+                continue;
+            EdwardsPoint **row = tables + i * ECC_BASE_WINDOW_SIZE;
+            unsigned digit = ecc_base_window_digit(scalars[i], w);
+            for (unsigned j = 0; j < ECC_BASE_WINDOW_SIZE; j++)
+                ecc_edwards_cond_overwrite(sel, row[j],
+                                           ecc_base_digit_eq(j, digit));
+            EdwardsPoint *sum = ecc_edwards_add(acc, sel);
+            ecc_edwards_point_free(acc);
+            acc = sum;
+        }
+    }
+
+    for (size_t i = 0; i < n * ECC_BASE_WINDOW_SIZE; i++)
+        ecc_edwards_point_free(tables[i]);
+    sfree(tables);
+    ecc_edwards_point_free(sel);
+    return acc;
+}
+
 /*
  * Helper routine to determine whether two values each given as a pair
  * of projective coordinates represent the same affine value.
@@ -0,0 +1,273 @@
+/*
+ * Fixed-size arithmetic for the prime fields of Curve25519 and NIST
+ * P-256. See ecc-field.h for the interface and the reasoning.
+ */
+
+#include <assert.h>
+
+#include "defs.h"
+#include "misc.h"
+#include "mpint.h"
+#include "ecc-field.h"
+
+/*
+ * Write field constants as four 64-bit words, least significant
+ * first, and have them split up into however many BignumInts that
+ * makes.
+ */
+#define FIELD_W64(x, shift) (BignumInt)((uint64_t)(x) >> (shift))
+#if BIGNUM_INT_BITS == 64
+#define FIELD_WORD64(x) FIELD_W64(x, 0)
+#elif BIGNUM_INT_BITS == 32
+#define FIELD_WORD64(x) FIELD_W64(x, 0), FIELD_W64(x, 32)
+#elif BIGNUM_INT_BITS == 16
+#define FIELD_WORD64(x) FIELD_W64(x, 0), FIELD_W64(x, 16), \
+        FIELD_W64(x, 32), FIELD_W64(x, 48)
+#else
+#error Unsupported BIGNUM_INT_BITS for ecc-field.c
+#endif
+#define FIELD_CONST(w0, w1, w2, w3) {{ FIELD_WORD64(w0), FIELD_WORD64(w1), \
+                FIELD_WORD64(w2), FIELD_WORD64(w3) }}
+
+#define NW ECC_FIELD_WORDS
+
+/* ----------------------------------------------------------------------
+ * Representation-independent operations.
+ */
+
+void ecc_field_invert(const EccField *f, EccFieldElt *r, const EccFieldElt *x)
+{
+    /*
+     * Fermat: x^(p-2) = 1/x for nonzero x, and 0 for zero. The
+     * exponent is public, so it's fine to branch on its bits.
+     */
+    EccFieldElt acc = f->one, base = *x;
+    for (size_t bit = ECC_FIELD_BITS; bit-- > 0 ;) {
+        ecc_field_mul(f, &acc, &acc, &acc);
+        if ((f->p_minus_2.w[bit / BIGNUM_INT_BITS] >>
+             (bit % BIGNUM_INT_BITS)) & 1)
+            ecc_field_mul(f, &acc, &acc, &base);
+    }
+    *r = acc;
+    smemclr(&acc, sizeof(acc));
+    smemclr(&base, sizeof(base));
+}
+
+/* Full NW x NW -> 2NW word schoolbook multiplication */
+static void field_mul_wide(BignumInt *t, const BignumInt *a,
+                           const BignumInt *b)
+{
+    for (size_t i = 0; i < 2*NW; i++)
+        t[i] = 0;
+    for (size_t i = 0; i < NW; i++) {
+        BignumInt carry = 0;
+        for (size_t j = 0; j < NW; j++)
+            BignumMULADD2(carry, t[i+j], a[i], b[j], t[i+j], carry);
+        t[i+NW] = carry;
+    }
+}
+
+static void field_load_words(BignumInt *r, mp_int *x)
+{
+    for (size_t i = 0; i < NW; i++)
+        r[i] = i < x->nw ? x->w[i] : 0;
+    for (size_t i = NW; i < x->nw; i++)
+        assert(x->w[i] == 0);
+}
+
+static void field_store_words(mp_int *r, const BignumInt *x)
+{
+    assert(r->nw >= NW);
+    for (size_t i = 0; i < NW; i++)
+        r->w[i] = x[i];
+    for (size_t i = NW; i < r->nw; i++)
+        r->w[i] = 0;
+}
+
+/* ----------------------------------------------------------------------
+ * p = 2^255-19, used by Curve25519 and Ed25519.
+ *
+ * Elements are stored as plain integers mod p. (The usual choice for
+ * 64-bit code is five limbs of 51 bits with lazy carrying, but that
+ * needs a 64x64->128 multiply specifically; doing it in whole
+ * BignumInts keeps us on the same portable multiply macros as the
+ * rest of the bignum code.) Reduction uses 2^256 == 38 (mod p) to fold
+ * the top half of a product back into the bottom half.
+ */
+
+static const EccFieldElt field25519_38 = FIELD_CONST(38, 0, 0, 0);
+
+/* 38^-1 mod p, i.e. 2^-256, for getting out of MontyContext form */
+static const EccFieldElt field25519_inv38 = FIELD_CONST(
+    0x435e50d79435e50a, 0x5e50d79435e50d79,
+    0x50d79435e50d7943, 0x179435e50d79435e);
+
+static const EccField field25519;
+
+static void field25519_mul(EccFieldElt *r, const EccFieldElt *a,
+                           const EccFieldElt *b)
+{
+    BignumInt t[2*NW], carry;
+    field_mul_wide(t, a->w, b->w);
+
+    /* Fold the top half in: now t[0..NW] is at most 39 * 2^256 */
+    carry = 0;
+    for (size_t i = 0; i < NW; i++)
+        BignumMULADD2(carry, t[i], t[i+NW], 38, t[i], carry);
+
+    /* Fold the remaining top word in, twice, after which no carry can
+     * be left over */
+    for (unsigned pass = 0; pass < 2; pass++) {
+        BignumCarry c = 0;
+        BignumInt addend = carry * 38;
+        BignumADC(t[0], c, t[0], addend, 0);
+        for (size_t i = 1; i < NW; i++)
+            BignumADC(t[i], c, t[i], 0, c);
+        carry = c;
+    }
+
+    /* Now t < 2^256 < 3p, so at most two subtractions of p finish it */
+    ecc_field_reduce_once(&field25519, t, 0);
+    ecc_field_reduce_once(&field25519, t, 0);
+
+    for (size_t i = 0; i < NW; i++)
+        r->w[i] = t[i];
+}
+
+static void field25519_import(EccFieldElt *r, mp_int *x)
+{
+    /* MontyContext form is x*2^256 mod p */
+    field_load_words(r->w, x);
+    field25519_mul(r, r, &field25519_inv38);
+}
+
+static void field25519_export(mp_int *r, const EccFieldElt *x)
+{
+    EccFieldElt t;
+    field25519_mul(&t, x, &field25519_38);
+    field_store_words(r, t.w);
+    smemclr(&t, sizeof(t));
+}
+
+static const EccField field25519 = {
+    .mul = field25519_mul,
+    .import = field25519_import,
+    .export = field25519_export,
+    .p = FIELD_CONST(0xffffffffffffffed, 0xffffffffffffffff,
+                     0xffffffffffffffff, 0x7fffffffffffffff),
+    .one = FIELD_CONST(1, 0, 0, 0),
+    .p_minus_2 = FIELD_CONST(0xffffffffffffffeb, 0xffffffffffffffff,
+                             0xffffffffffffffff, 0x7fffffffffffffff),
+};
+
+/* ----------------------------------------------------------------------
+ * p = 2^256 - 2^224 + 2^192 + 2^96 - 1, used by NIST P-256.
+ *
+ * Elements are kept in Montgomery form with R = 2^256, the same as
+ * MontyContext uses for a modulus of this size, so import and export
+ * are just copies. The low word of p is all 1s, so -1/p is 1 mod any
+ * power of 2 up to the word size, which saves a multiplication per
+ * word in the reduction.
+ */
+
+static const EccField fieldp256;
+
+static void fieldp256_mul(EccFieldElt *r, const EccFieldElt *a,
+                          const EccFieldElt *b)
+{
+    const BignumInt *p = fieldp256.p.w;
+    BignumInt t[NW+2];
+
+    for (size_t i = 0; i < NW+2; i++)
+        t[i] = 0;
+
+    /* Interleaved multiply and Montgomery reduce, one word at a time */
+    for (size_t i = 0; i < NW; i++) {
+        BignumInt carry = 0, dummy;
+        BignumCarry c;
+
+        for (size_t j = 0; j < NW; j++)
+            BignumMULADD2(carry, t[j], a->w[j], b->w[i], t[j], carry);
+        BignumADC(t[NW], c, t[NW], carry, 0);
+        t[NW+1] = c;
+
+        /* Add the multiple m*p of p that zeroes the bottom word, and
+         * shift down by a word */
+        BignumInt m = t[0];
+        BignumMULADD(carry, dummy, m, p[0], t[0]);
+        (void)dummy;
+        for (size_t j = 1; j < NW; j++)
+            BignumMULADD2(carry, t[j-1], m, p[j], t[j], carry);
+        BignumADC(t[NW-1], c, t[NW], carry, 0);
+        t[NW] = t[NW+1] + c;
+    }
+
+    /* Result is less than 2p */
+    ecc_field_reduce_once(&fieldp256, t, t[NW]);
+
+    for (size_t i = 0; i < NW; i++)
+        r->w[i] = t[i];
+}
+
+static void fieldp256_import(EccFieldElt *r, mp_int *x)
+{
+    field_load_words(r->w, x);
+}
+
+static void fieldp256_export(mp_int *r, const EccFieldElt *x)
+{
+    field_store_words(r, x->w);
+}
+
+static const EccField fieldp256 = {
+    .mul = fieldp256_mul,
+    .import = fieldp256_import,
+    .export = fieldp256_export,
+    .p = FIELD_CONST(0xffffffffffffffff, 0x00000000ffffffff,
+                     0x0000000000000000, 0xffffffff00000001),
+    .one = FIELD_CONST(0x0000000000000001, 0xffffffff00000000,
+                       0xffffffffffffffff, 0x00000000fffffffe),
+    .p_minus_2 = FIELD_CONST(0xfffffffffffffffd, 0x00000000ffffffff,
+                             0x0000000000000000, 0xffffffff00000001),
+};
+
+/* ----------------------------------------------------------------------
+ * Lookup and MontyContext interop.
+ */
+
+const EccField *ecc_field_find(mp_int *p)
+{
+    static const EccField *const fields[] = { &field25519, &fieldp256 };
+
+    if (mp_max_bits(p) > ECC_FIELD_BITS)
+        return NULL;
+
+    /* The modulus is public, so a variable-time comparison is fine */
+    for (size_t i = 0; i < lenof(fields); i++) {
+        bool match = true;
+        for (size_t j = 0; j < NW; j++)
+            if ((j < p->nw ? p->w[j] : 0) != fields[i]->p.w[j])
+                match = false;
+        for (size_t j = NW; j < p->nw; j++)
+            if (p->w[j])
+                match = false;
+        if (match)
+            return fields[i];
+    }
+    return NULL;
+}
+
+mp_int *ecc_field_monty_invert(const EccField *f, MontyContext *mc,
+                               mp_int *x)
+{
+    if (!f)
+        return monty_invert(mc, x);
+
+    EccFieldElt xf;
+    f->import(&xf, x);
+    ecc_field_invert(f, &xf, &xf);
+    mp_int *toret = mp_make_sized(mc->rw);
+    f->export(toret, &xf);
+    smemclr(&xf, sizeof(xf));
+    return toret;
+}
@@ -0,0 +1,171 @@
+/*
+ * ecc-field.h: fixed-size arithmetic in the particular prime fields
+ * that PuTTY's most heavily used elliptic curves are defined over.
+ *
+ * The general code in ecc-arithmetic.c does all its field operations
+ * via MontyContext, which works for any modulus but pays for that in
+ * loops over variable-length mp_ints and an allocation for every
+ * intermediate value. For the 256-bit fields of Curve25519 / Ed25519
+ * (p = 2^255-19) and NIST P-256, this module provides replacements
+ * that keep everything in fixed-size arrays on the stack. The curve
+ * constructors in ecc-arithmetic.c look their modulus up with
+ * ecc_field_find, and use these routines in the hot paths if it
+ * returns non-NULL.
+ *
+ * Like everything else in the ECC code, all of this is constant-time
+ * with respect to the values being processed.
+ */
+
+#ifndef PUTTY_ECC_FIELD_H
+#define PUTTY_ECC_FIELD_H
+
+#include "mpint_i.h"
+
+#define ECC_FIELD_BITS 256
+#define ECC_FIELD_WORDS (ECC_FIELD_BITS / BIGNUM_INT_BITS)
+
+/*
+ * An element of one of these fields, in whatever internal
+ * representation the field uses. Always fully reduced mod p.
+ */
+typedef struct EccFieldElt {
+    BignumInt w[ECC_FIELD_WORDS];
+} EccFieldElt;
+
+typedef struct EccField EccField;
+struct EccField {
+    /* r = a*b. r may alias either input. */
+    void (*mul)(EccFieldElt *r, const EccFieldElt *a, const EccFieldElt *b);
+
+    /* Convert to and from the MontyContext representation of the
+     * same value, which is what ecc-arithmetic.c keeps in its point
+     * structures. export writes into an existing mp_int, which must
+     * be at least ECC_FIELD_WORDS words long. */
+    void (*import)(EccFieldElt *r, mp_int *x);
+    void (*export)(mp_int *r, const EccFieldElt *x);
+
+    /* The modulus itself; the representation of 1; and p-2, as the
+     * exponent used for inversion. */
+    EccFieldElt p, one, p_minus_2;
+};
+
+/*
+ * Return the specialised field implementation for arithmetic mod p,
+ * or NULL if there isn't one.
+ */
+const EccField *ecc_field_find(mp_int *p);
+
+static inline void ecc_field_mul(const EccField *f, EccFieldElt *r,
+                                 const EccFieldElt *a, const EccFieldElt *b)
+{ f->mul(r, a, b); }
+
+/*
+ * The cheap linear operations are all inline, so that the compiler
+ * can flatten them into the point arithmetic that calls them. All
+ * outputs may alias inputs.
+ */
+
+static inline BignumInt ecc_field_mask(unsigned bit)
+{
+    return -(BignumInt)(1 & bit);
+}
+
+/* r = a + b, returning the carry out of the top word */
+static inline BignumCarry ecc_field_add_words(
+    BignumInt *r, const BignumInt *a, const BignumInt *b)
+{
+    BignumCarry carry = 0;
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        BignumADC(r[i], carry, a[i], b[i], carry);
+    return carry;
+}
+
+/* r = a - b, returning 1 if that borrowed out of the top word */
+static inline BignumCarry ecc_field_sub_words(
+    BignumInt *r, const BignumInt *a, const BignumInt *b)
+{
+    BignumCarry carry = 1;
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        BignumADC(r[i], carry, a[i], ~b[i], carry);
+    return 1 ^ carry;
+}
+
+/*
+ * Subtract p from a value x_top:x one word longer than a field
+ * element, if that doesn't make it negative. The result is written
+ * back to x, so the caller must know that it will fit, e.g. because
+ * the input was less than 2p.
+ */
+static inline void ecc_field_reduce_once(
+    const EccField *f, BignumInt *x, BignumInt x_top)
+{
+    BignumInt t[ECC_FIELD_WORDS];
+    BignumCarry borrow = ecc_field_sub_words(t, x, f->p.w);
+    /* Keep the subtracted value unless it borrowed from a zero top word */
+    unsigned top_nonzero =
+        (BignumInt)(x_top | -x_top) >> (BIGNUM_INT_BITS - 1);
+    BignumInt mask = ecc_field_mask(borrow & (1 ^ top_nonzero));
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        x[i] = t[i] ^ ((x[i] ^ t[i]) & mask);
+}
+
+static inline void ecc_field_add(const EccField *f, EccFieldElt *r,
+                                 const EccFieldElt *a, const EccFieldElt *b)
+{
+    BignumCarry carry = ecc_field_add_words(r->w, a->w, b->w);
+    ecc_field_reduce_once(f, r->w, carry);
+}
+
+static inline void ecc_field_sub(const EccField *f, EccFieldElt *r,
+                                 const EccFieldElt *a, const EccFieldElt *b)
+{
+    BignumCarry borrow = ecc_field_sub_words(r->w, a->w, b->w);
+
+    /* If that went negative, add p back on */
+    BignumInt mask = ecc_field_mask(borrow), padd[ECC_FIELD_WORDS];
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        padd[i] = f->p.w[i] & mask;
+    ecc_field_add_words(r->w, r->w, padd);
+}
+
+static inline unsigned ecc_field_is_zero(const EccFieldElt *x)
+{
+    BignumInt bits = 0;
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        bits |= x->w[i];
+    return 1 ^ (unsigned)((BignumInt)(bits | -bits) >> (BIGNUM_INT_BITS - 1));
+}
+
+static inline void ecc_field_select(
+    EccFieldElt *r, const EccFieldElt *a, const EccFieldElt *b,
+    unsigned choose_b)
+{
+    BignumInt mask = ecc_field_mask(choose_b);
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++)
+        r->w[i] = a->w[i] ^ ((a->w[i] ^ b->w[i]) & mask);
+}
+
+static inline void ecc_field_cond_swap(
+    EccFieldElt *a, EccFieldElt *b, unsigned swap)
+{
+    volatile BignumInt mask = ecc_field_mask(swap);
+    for (size_t i = 0; i < ECC_FIELD_WORDS; i++) {
+        BignumInt diff = (a->w[i] ^ b->w[i]) & mask;
+        a->w[i] ^= diff;
+        b->w[i] ^= diff;
+    }
+}
+
+/* r = 1/x, or 0 if x = 0. */
+void ecc_field_invert(const EccField *f, EccFieldElt *r, const EccFieldElt *x);
+
+/*
+ * Convenience wrapper for the inversions done when converting a
+ * projective point back to affine coordinates: takes and returns
+ * MontyContext representation, and falls back to monty_invert if f
+ * is NULL.
+ */
+mp_int *ecc_field_monty_invert(const EccField *f, MontyContext *mc,
+                               mp_int *x);
+
+#endif /* PUTTY_ECC_FIELD_H */
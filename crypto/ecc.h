@@ -96,6 +96,20 @@ WeierstrassPoint *ecc_weierstrass_double(WeierstrassPoint *);
  */
 WeierstrassPoint *ecc_weierstrass_multiply(WeierstrassPoint *, mp_int *);
 
+/*
+ * Faster multiplication of a fixed point, such as a curve's
+ * generator, using a table of its precomputed multiples. You have to
+ * provide the order of the point; multipliers are reduced mod that
+ * order, so unlike ecc_weierstrass_multiply, these can be any size.
+ * But they should still not be zero mod the order. The table lookups
+ * are constant-time, as the rest of this module is.
+ */
+WeierstrassBaseTable *ecc_weierstrass_base_table_new(
+    WeierstrassPoint *B, mp_int *order);
+void ecc_weierstrass_base_table_free(WeierstrassBaseTable *);
+WeierstrassPoint *ecc_weierstrass_base_table_multiply(
+    WeierstrassBaseTable *, mp_int *);
+
 /*
  * Query functions to get the value of a point back out. is_identity
  * tells you whether the point is the identity; if it isn't, then
@@ -233,6 +247,23 @@ void ecc_edwards_point_free(EdwardsPoint *point);
 EdwardsPoint *ecc_edwards_add(EdwardsPoint *, EdwardsPoint *);
 EdwardsPoint *ecc_edwards_multiply(EdwardsPoint *, mp_int *);
 
+/*
+ * Multiplication of a fixed point using a table of its precomputed
+ * multiples, with the same rules as for Weierstrass curves above.
+ */
+EdwardsBaseTable *ecc_edwards_base_table_new(EdwardsPoint *B, mp_int *order);
+void ecc_edwards_base_table_free(EdwardsBaseTable *);
+EdwardsPoint *ecc_edwards_base_table_multiply(EdwardsBaseTable *, mp_int *);
+
+/*
+ * Compute the sum of scalars[i] * points[i] for 0 <= i < n, sharing
+ * the doublings between all the terms, which makes it a lot cheaper
+ * than n separate calls to ecc_edwards_multiply. (Used for batch
+ * signature verification.)
+ */
+EdwardsPoint *ecc_edwards_multiscalar(
+    size_t n, EdwardsPoint *const *points, mp_int *const *scalars);
+
 /*
  * Query functions: compare two points for equality, and return the
  * affine coordinates of a point.
@@ -0,0 +1,134 @@
+/*
+ * x86-64 kernel for the innermost multiply-accumulate loop of the
+ * bignum code, using the BMI2 MULX instruction (which multiplies
+ * without touching the flags) and the ADX instructions ADCX and ADOX
+ * (two add-with-carry instructions using separate carry flags). That
+ * combination lets the low and high halves of each row of partial
+ * products be accumulated in two interleaved carry chains, instead
+ * of the one serialised chain the portable code in mpint.c has to
+ * make do with.
+ *
+ * The kernel is in GNU-style inline assembler, because compilers
+ * given the corresponding intrinsics tend to merge the two chains
+ * back into one. So this file is only compiled if the CMake test finds
+ * a compiler that supports that, and mpint.c only calls into it after
+ * checking mp_mul_adx_available at run time.
+ *
+ * Like the portable code, every loop count depends only on the sizes
+ * of the inputs, never their values.
+ */
+
+#include "defs.h"
+#include "misc.h"
+#include "mpint.h"
+#include "mpint_i.h"
+
+#if BIGNUM_INT_BITS == 64
+
+#include <cpuid.h>
+#define GET_CPU_ID_0(out)                               \
+    __cpuid(0, (out)[0], (out)[1], (out)[2], (out)[3])
+#define GET_CPU_ID_7(out)                                               \
+    __cpuid_count(7, 0, (out)[0], (out)[1], (out)[2], (out)[3])
+
+bool mp_mul_adx_available(void)
+{
+    unsigned int CPUInfo[4];
+    GET_CPU_ID_0(CPUInfo);
+    if (CPUInfo[0] < 7)
+        return false;
+
+    /* BMI2 is bit 8 of EBX, and ADX is bit 19 */
+    GET_CPU_ID_7(CPUInfo);
+    return (CPUInfo[1] & (1 << 8)) && (CPUInfo[1] & (1 << 19));
+}
+
+/* One word of a row: the CF chain adds in the high word of the
+ * previous product, and the OF chain adds in the existing word of r */
+#define ROW_STEP(off)                                   \
+        "mulx " off "(%[b]), %[lo], %[hi]\n\t"          \
+        "adcx %[hp], %[lo]\n\t"                         \
+        "adox " off "(%[r]), %[lo]\n\t"                 \
+        "mov %[lo], " off "(%[r])\n\t"                  \
+        "mov %[hi], %[hp]\n\t"
+
+/*
+ * Multiply the n-word vector b by the single word a and add the
+ * result into r[0..n-1]. Returns the top word of the product row, and
+ * the two carry bits left in CF and OF, all of which the caller still
+ * has to add in at r[n].
+ */
+static inline BignumInt mul_add_row(BignumInt *r, const BignumInt *b,
+                                    size_t n, BignumInt a,
+                                    unsigned char *c_lo, unsigned char *c_hi)
+{
+    BignumInt hi_prev, lo, hi;
+    size_t blocks = n / 4, rest = n % 4;
+
+    /*
+     * The loop control uses only LEA and JRCXZ, neither of which
+     * touches the flags, so that CF and OF can carry the two chains
+     * all the way along the row. The main loop does four words per
+     * iteration, and a second loop mops up the rest.
+     */
+    __asm__ volatile(
+        "xor %k[hp], %k[hp]\n\t"      /* zero hi_prev; clear CF and OF */
+        "1:\n\t"
+        "jrcxz 2f\n\t"
+        ROW_STEP("0")
+        ROW_STEP("8")
+        ROW_STEP("16")
+        ROW_STEP("24")
+        "lea 32(%[b]), %[b]\n\t"
+        "lea 32(%[r]), %[r]\n\t"
+        "lea -1(%%rcx), %%rcx\n\t"
+        "jmp 1b\n\t"
+        "2:\n\t"
+        "mov %[rest], %%rcx\n\t"
+        "3:\n\t"
+        "jrcxz 4f\n\t"
+        ROW_STEP("0")
+        "lea 8(%[b]), %[b]\n\t"
+        "lea 8(%[r]), %[r]\n\t"
+        "lea -1(%%rcx), %%rcx\n\t"
+        "jmp 3b\n\t"
+        "4:\n\t"
+        "setc %[clo]\n\t"
+        "seto %[chi]\n\t"
+        : [hp] "=&r" (hi_prev), [lo] "=&r" (lo), [hi] "=&r" (hi),
+          [r] "+r" (r), [b] "+r" (b), "+c" (blocks),
+          [clo] "=m" (*c_lo), [chi] "=m" (*c_hi)
+        : "d" (a), [rest] "r" (rest)
+        : "cc", "memory");
+
+    return hi_prev;
+}
+
+#undef ROW_STEP
+
+/*
+ * r <- r + a*b, discarding anything that doesn't fit in rw words:
+ * exactly the same semantics, and the same data-independent loop
+ * structure, as mp_mul_add_simple.
+ */
+void mp_mul_add_adx(BignumInt *r, size_t rw, const BignumInt *a, size_t aw,
+                    const BignumInt *b, size_t bw)
+{
+    for (size_t i = 0; i < aw && i < rw; i++) {
+        size_t n = bw < rw - i ? bw : rw - i;
+        unsigned char c_lo, c_hi;
+        BignumInt top = mul_add_row(r + i, b, n, a[i], &c_lo, &c_hi);
+
+        /* Add the top word of the row, and both carries, into the
+         * rest of r. (The top word of a product is at most 2^64-2, so
+         * adding one of the carry bits to it can't overflow.) */
+        BignumInt carry = top + c_hi;
+        BignumCarry c = c_lo;
+        for (size_t k = i + n; k < rw; k++) {
+            BignumADC(r[k], c, r[k], carry, c);
+            carry = 0;
+        }
+    }
+}
+
+#endif /* BIGNUM_INT_BITS == 64 */
@@ -946,12 +946,58 @@ mp_int *mp_sub(mp_int *x, mp_int *y)
     return r;
 }
 
+#if HAVE_MULX_ADX && BIGNUM_INT_BITS == 64
+/*
+ * Whether mp_mul_add_simple hands off to the MULX/ADX kernel. The CPU
+ * check is done on first use, and mp_mul_set_accel can override it
+ * in the downward direction.
+ */
+static enum { MUL_ACCEL_UNKNOWN, MUL_ACCEL_OFF, MUL_ACCEL_ON } mul_accel;
+
+static inline bool mp_mul_use_adx(void)
+{
+    if (mul_accel == MUL_ACCEL_UNKNOWN)
+        mul_accel = mp_mul_adx_available() ? MUL_ACCEL_ON : MUL_ACCEL_OFF;
+    return mul_accel == MUL_ACCEL_ON;
+}
+
+bool mp_mul_set_accel(bool enable)
+{
+    mul_accel = MUL_ACCEL_UNKNOWN;
+    if (!enable)
+        mul_accel = MUL_ACCEL_OFF;
+    return mp_mul_use_adx();
+}
+
+const char *mp_mul_kernel_name(void)
+{
+    return mp_mul_use_adx() ? "mulx_adx" : "portable";
+}
+#else
+bool mp_mul_set_accel(bool enable)
+{
+    return false;
+}
+
+const char *mp_mul_kernel_name(void)
+{
+    return "portable";
+}
+#endif
+
 /*
  * Internal routine: multiply and accumulate in the trivial O(N^2)
  * way. Sets r <- r + a*b.
  */
 static void mp_mul_add_simple(mp_int *r, mp_int *a, mp_int *b)
 {
+#if HAVE_MULX_ADX && BIGNUM_INT_BITS == 64
+    if (mp_mul_use_adx()) {
+        mp_mul_add_adx(r->w, r->nw, a->w, a->nw, b->w, b->nw);
+        return;
+    }
+#endif
+
     BignumInt *aend = a->w + a->nw, *bend = b->w + b->nw, *rend = r->w + r->nw;
 
     for (BignumInt *ap = a->w, *rp = r->w;
@@ -1657,6 +1703,25 @@ mp_int *monty_pow(MontyContext *mc, mp_int *base, mp_int *exponent)
     return out;
 }
 
+mp_int *monty_pow_public(MontyContext *mc, mp_int *base, mp_int *exponent)
+{
+    /*
+     * Plain left-to-right square-and-multiply, branching on the
+     * exponent bits and stopping at its real length, both of which
+     * are fine when the exponent is public.
+     */
+    mp_int *out = mp_make_sized(mc->rw);
+    mp_copy_into(out, monty_identity(mc));
+
+    for (size_t i = mp_get_nbits(exponent); i-- > 0 ;) {
+        monty_mul_into(mc, out, out, out);
+        if (mp_get_bit(exponent, i))
+            monty_mul_into(mc, out, out, base);
+    }
+
+    return out;
+}
+
 mp_int *mp_modpow(mp_int *base, mp_int *exponent, mp_int *modulus)
 {
     assert(modulus->nw > 0);
@@ -2415,9 +2480,11 @@ uint32_t mp_mod_known_integer(mp_int *x, uint32_t m)
      * quot is at most A/m, so quot*m <= A < 2^64. []
      */
 
-    uint32_t result = accumulator;
-    uint32_t reduced = result - m;
-    uint32_t select = -(reduced >> 31);
+    /* The accumulator can still be as large as 2^33, so do the final
+     * subtraction in 64 bits */
+    uint64_t result = accumulator;
+    uint64_t reduced = result - m;
+    uint64_t select = -(reduced >> 63);
     result = reduced ^ ((result ^ reduced) & select);
     assert(result < m);
     return result;
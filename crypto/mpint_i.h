@@ -322,3 +322,10 @@ struct MontyContext {
 
 /* Functions shared between mpint.c and mpunsafe.c */
 mp_int *mp_make_sized(size_t nw);
+
+#if HAVE_MULX_ADX && BIGNUM_INT_BITS == 64
+/* The x86-64 multiplication kernel in mpint-adx.c */
+bool mp_mul_adx_available(void);
+void mp_mul_add_adx(BignumInt *r, size_t rw, const BignumInt *a, size_t aw,
+                    const BignumInt *b, size_t bw);
+#endif
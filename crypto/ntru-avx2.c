@@ -0,0 +1,296 @@
+/*
+ * AVX2 versions of the two expensive quotient-ring operations in
+ * ntru.c: multiplication, and the inner loop of inversion.
+ *
+ * These follow the portable versions in ntru.c step for step, and
+ * produce identical output; see there for how the algorithms work.
+ * The comments here only discuss how the work is spread across
+ * vector lanes. As in ntru.c, nothing branches on secret data or
+ * uses it as an array index, and every loop count depends only on
+ * the public parameters p and q.
+ *
+ * Coefficients are held as 16-bit values, which is enough because q
+ * is less than 2^15 (checked by assertion). Products and sums of
+ * products are formed in 32-bit lanes using VPMADDWD, which
+ * multiplies adjacent pairs of 16-bit values and adds each pair of
+ * products, and reduced mod q in bulk by reduce_epu32 below.
+ *
+ * ntru.c only calls into this file after checking ntru_avx2_available
+ * at run time.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "putty.h"
+#include "ssh.h"
+#include "ntru.h"
+
+#if defined(__clang__) || defined(__GNUC__)
+#include <cpuid.h>
+#define GET_CPU_ID_0(out)                               \
+    __cpuid(0, (out)[0], (out)[1], (out)[2], (out)[3])
+#define GET_CPU_ID_1(out)                               \
+    __cpuid(1, (out)[0], (out)[1], (out)[2], (out)[3])
+#define GET_CPU_ID_7(out)                                               \
+    __cpuid_count(7, 0, (out)[0], (out)[1], (out)[2], (out)[3])
+static inline uint64_t get_xcr0(void)
+{
+    uint32_t lo, hi;
+    __asm__("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+    return ((uint64_t)hi << 32) | lo;
+}
+#else
+#define GET_CPU_ID_0(out) __cpuid(out, 0)
+#define GET_CPU_ID_1(out) __cpuid(out, 1)
+#define GET_CPU_ID_7(out) __cpuidex(out, 7, 0)
+#define get_xcr0() _xgetbv(0)
+#endif
+
+bool ntru_avx2_available(void)
+{
+    unsigned int CPUInfo[4];
+    GET_CPU_ID_0(CPUInfo);
+    if (CPUInfo[0] < 7)
+        return false;
+
+    /*
+     * As well as the CPU supporting AVX (bit 28 of ECX) and AVX2 (bit
+     * 5 of EBX in leaf 7), the OS must have enabled saving of the YMM
+     * registers, which we find out via OSXSAVE (bit 27 of ECX) and
+     * then bits 1 and 2 of XCR0.
+     */
+    GET_CPU_ID_1(CPUInfo);
+    if (!(CPUInfo[2] & (1 << 27)) || !(CPUInfo[2] & (1 << 28)))
+        return false;
+    if ((get_xcr0() & 6) != 6)
+        return false;
+
+    GET_CPU_ID_7(CPUInfo);
+    return CPUInfo[1] & (1 << 5);
+}
+
+/*
+ * Reduce each 32-bit lane of x mod q, where qrecip32 holds
+ * floor(2^32/q) in every lane and qv holds q.
+ *
+ * Multiplying by the reciprocal and keeping the top half gives a
+ * quotient at most 1 too small (the error in the reciprocal is less
+ * than 1, and x is less than 2^32), so one trial subtraction finishes
+ * the job, exactly as in reduce() in ntru.c. VPMULUDQ only multiplies
+ * the even lanes, so the odd ones are shifted down and done
+ * separately.
+ */
+static inline __m256i reduce_epu32(__m256i x, __m256i qrecip32, __m256i qv,
+                                   __m256i qminus1)
+{
+    __m256i even = _mm256_mul_epu32(x, qrecip32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), qrecip32);
+    __m256i quot = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    __m256i r = _mm256_sub_epi32(x, _mm256_mullo_epi32(quot, qv));
+    __m256i toobig = _mm256_cmpgt_epi32(r, qminus1);
+    return _mm256_sub_epi32(r, _mm256_and_si256(toobig, qv));
+}
+
+#define SETUP_AVX2                                                      \
+    __m256i qv = _mm256_set1_epi32(q);                                  \
+    __m256i qminus1 = _mm256_set1_epi32(q - 1);                         \
+    __m256i qrecip32 = _mm256_set1_epi32(                               \
+        (uint32_t)(((uint64_t)1 << 32) / q))
+#define REDUCE_AVX2(x) reduce_epu32(x, qrecip32, qv, qminus1)
+
+/*
+ * Multiply two elements of the quotient ring.
+ *
+ * The schoolbook product is accumulated in 32-bit lanes, two rows at
+ * a time: for each pair of coefficients a[i],a[i+1], the
+ * coefficient of x^(i+k) gets a[i]*b[k] + a[i+1]*b[k-1], which is one
+ * VPMADDWD if b is laid out beforehand as the pairs (b[k],b[k-1]).
+ *
+ * The accumulators aren't reduced after every addition, as they are
+ * in ntru.c, but only as often as is needed to stop them overflowing.
+ */
+void ntru_ring_multiply_avx2(uint16_t *out, const uint16_t *a,
+                             const uint16_t *b, unsigned p, unsigned q)
+{
+    SETUP_AVX2;
+    assert(q < 0x8000);
+
+    /* bpairs[k] = (b[k], b[k-1]) for 0 <= k <= p, padded with zeroes
+     * to a whole number of vectors */
+    size_t npairs = (p + 1 + 7) & ~(size_t)7;
+    uint32_t *bpairs = snewn(npairs, uint32_t);
+    for (size_t k = 0; k < npairs; k++) {
+        uint32_t lo = k < p ? b[k] : 0;
+        uint32_t hi = k >= 1 && k-1 < p ? b[k-1] : 0;
+        bpairs[k] = lo | (hi << 16);
+    }
+
+    /* The product has 2p-1 coefficients, but the last pair of rows
+     * writes a whole number of vectors beyond that */
+    size_t nacc = (((p + 1) & ~(size_t)1) + npairs + 7) & ~(size_t)7;
+    uint32_t *acc = snewn(nacc, uint32_t);
+    memset(acc, 0, nacc * sizeof(*acc));
+
+    /* Each pair of rows adds at most 2(q-1)^2 to an accumulator, and
+     * after a reduction each one is already up to q-1 */
+    uint32_t maxpair = 2 * (q-1) * (q-1);
+    size_t rows_per_reduce = maxpair ? (0xFFFFFFFF - (q-1)) / maxpair : p;
+
+    size_t rows_since_reduce = 0;
+    for (size_t i = 0; i < p; i += 2) {
+        uint32_t hi = i+1 < p ? a[i+1] : 0;
+        __m256i coeffs = _mm256_set1_epi32(a[i] | (hi << 16));
+        for (size_t k = 0; k < npairs; k += 8) {
+            __m256i *accp = (__m256i *)(acc + i + k);
+            __m256i bv = _mm256_loadu_si256((const __m256i *)(bpairs + k));
+            _mm256_storeu_si256(accp, _mm256_add_epi32(
+                _mm256_loadu_si256(accp), _mm256_madd_epi16(bv, coeffs)));
+        }
+
+        if (++rows_since_reduce == rows_per_reduce) {
+            for (size_t k = 0; k < nacc; k += 8) {
+                __m256i *accp = (__m256i *)(acc + k);
+                _mm256_storeu_si256(
+                    accp, REDUCE_AVX2(_mm256_loadu_si256(accp)));
+            }
+            rows_since_reduce = 0;
+        }
+    }
+
+    /*
+     * Reduce mod x^p-x-1. Once everything is reduced mod q, each
+     * x^{p+k} folds straight into x^{k+1} and x^k, giving each of the
+     * low coefficients at most two additions.
+     */
+    for (size_t k = 0; k < nacc; k += 8) {
+        __m256i *accp = (__m256i *)(acc + k);
+        _mm256_storeu_si256(accp, REDUCE_AVX2(_mm256_loadu_si256(accp)));
+    }
+    for (size_t k = 0; k < p; k++)
+        acc[k] += acc[k+p] + (k ? acc[k+p-1] : 0);
+    for (size_t k = 0; k < nacc; k += 8) {
+        __m256i *accp = (__m256i *)(acc + k);
+        _mm256_storeu_si256(accp, REDUCE_AVX2(_mm256_loadu_si256(accp)));
+    }
+
+    for (size_t k = 0; k < p; k++)
+        out[k] = acc[k];
+
+    smemclr(bpairs, npairs * sizeof(*bpairs));
+    sfree(bpairs);
+    smemclr(acc, nacc * sizeof(*acc));
+    sfree(acc);
+}
+
+/*
+ * Find the largest value in any 16-bit lane, given that they're all
+ * non-negative.
+ */
+static inline unsigned hmax_epi16(__m256i v)
+{
+    v = _mm256_max_epi16(v, _mm256_permute2x128_si256(v, v, 1));
+    v = _mm256_max_epi16(v, _mm256_srli_si256(v, 8));
+    v = _mm256_max_epi16(v, _mm256_srli_si256(v, 4));
+    v = _mm256_max_epi16(v, _mm256_srli_si256(v, 2));
+    return _mm256_extract_epi16(v, 0);
+}
+
+/*
+ * Replace each coefficient of X with (Xmult * X[j] + Ymult * Y[j]) mod q.
+ *
+ * Interleaving X and Y within each 128-bit lane makes VPMADDWD do
+ * both multiplications and the addition, and VPACKUSDW undoes the
+ * interleaving afterwards.
+ */
+static inline void combine(uint16_t *X, const uint16_t *Y, size_t size,
+                           uint16_t Xmult, uint16_t Ymult, unsigned q)
+{
+    SETUP_AVX2;
+    __m256i mults = _mm256_set1_epi32(Xmult | ((uint32_t)Ymult << 16));
+    for (size_t j = 0; j < size; j += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(X + j));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(Y + j));
+        __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(x, y), mults);
+        __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(x, y), mults);
+        _mm256_storeu_si256((__m256i *)(X + j), _mm256_packus_epi32(
+                                REDUCE_AVX2(lo), REDUCE_AVX2(hi)));
+    }
+}
+
+/*
+ * The main loop of ntru_ring_invert: run 'steps' steps of the gcd
+ * algorithm on the working polynomials A,B and their coefficients
+ * Ac,Bc.
+ *
+ * All four arrays have 'size' elements, a multiple of 16, with zeroes
+ * beyond the ones ntru_ring_invert uses.
+ */
+void ntru_ring_invert_steps_avx2(uint16_t *A, uint16_t *B,
+                                 uint16_t *Ac, uint16_t *Bc,
+                                 size_t size, size_t steps,
+                                 unsigned p, unsigned q)
+{
+    assert(q < 0x8000);
+    assert(size % 16 == 0);
+
+    for (size_t i = 0; i < steps; i++) {
+        /*
+         * Decide whether to swap. Rather than scanning down for the
+         * top nonzero term as ntru.c does, find the degree of each
+         * polynomial (plus 1, so that 0 means the zero polynomial) as
+         * the maximum of j+1 over the nonzero terms A[j].
+         */
+        unsigned x_divides_A = 1 & ~((A[0] + 0xFFFF) >> 16);
+        unsigned x_divides_B = 1 & ~((B[0] + 0xFFFF) >> 16);
+        __m256i zero = _mm256_setzero_si256();
+        __m256i index = _mm256_setr_epi16(
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+        __m256i step = _mm256_set1_epi16(16);
+        __m256i degA = zero, degB = zero;
+        for (size_t j = 0; j < size; j += 16) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(A + j));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(B + j));
+            degA = _mm256_max_epi16(degA, _mm256_andnot_si256(
+                                        _mm256_cmpeq_epi16(a, zero), index));
+            degB = _mm256_max_epi16(degB, _mm256_andnot_si256(
+                                        _mm256_cmpeq_epi16(b, zero), index));
+            index = _mm256_add_epi16(index, step);
+        }
+        unsigned B_is_bigger = (hmax_epi16(degA) - hmax_epi16(degB)) >> 31;
+
+        unsigned need_swap = x_divides_B | (~x_divides_A & B_is_bigger);
+        __m256i swap_mask = _mm256_set1_epi16(-(int16_t)need_swap);
+        for (size_t j = 0; j < size; j += 16) {
+            __m256i *ap = (__m256i *)(A + j), *bp = (__m256i *)(B + j);
+            __m256i *acp = (__m256i *)(Ac + j), *bcp = (__m256i *)(Bc + j);
+            __m256i a = _mm256_loadu_si256(ap), b = _mm256_loadu_si256(bp);
+            __m256i ac = _mm256_loadu_si256(acp);
+            __m256i bc = _mm256_loadu_si256(bcp);
+            __m256i diff = _mm256_and_si256(_mm256_xor_si256(a, b),
+                                            swap_mask);
+            __m256i cdiff = _mm256_and_si256(_mm256_xor_si256(ac, bc),
+                                             swap_mask);
+            _mm256_storeu_si256(ap, _mm256_xor_si256(a, diff));
+            _mm256_storeu_si256(bp, _mm256_xor_si256(b, diff));
+            _mm256_storeu_si256(acp, _mm256_xor_si256(ac, cdiff));
+            _mm256_storeu_si256(bcp, _mm256_xor_si256(bc, cdiff));
+        }
+
+        /* Eliminate A's constant term, and the same for Ac */
+        uint16_t Amult = B[0], Bmult = q - A[0];
+        combine(A, B, size, Amult, Bmult, q);
+        combine(Ac, Bc, size, Amult, Bmult, q);
+
+        /* Divide A by x, and multiply Ac by x^{p-1}-1 */
+        memmove(A, A + 1, (size - 1) * sizeof(*A));
+        A[size - 1] = 0;
+        uint16_t Ac0 = Ac[0];
+        memmove(Ac, Ac + 1, (p - 1) * sizeof(*Ac));
+        Ac[p-1] = Ac0;
+        uint32_t t = Ac[0] + q - Ac0;
+        t -= q & -((q - 1 - t) >> 31);
+        Ac[0] = t;
+    }
+}
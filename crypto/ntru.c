@@ -164,6 +164,45 @@ static unsigned iszero(uint16_t x)
 #define REDUCE(x) reduce(x, q, qrecip)
 #define INVERT(x) invert(x, q, qrecip)
 
+#if HAVE_AVX2
+/*
+ * Whether the quotient-ring multiplication and inversion hand off to
+ * the AVX2 versions in ntru-avx2.c. The CPU check is done on first
+ * use, and ntru_set_accel can override it in the downward direction.
+ */
+static enum { NTRU_ACCEL_UNKNOWN, NTRU_ACCEL_OFF, NTRU_ACCEL_ON } ntru_accel;
+
+static inline bool ntru_use_avx2(void)
+{
+    if (ntru_accel == NTRU_ACCEL_UNKNOWN)
+        ntru_accel = ntru_avx2_available() ? NTRU_ACCEL_ON : NTRU_ACCEL_OFF;
+    return ntru_accel == NTRU_ACCEL_ON;
+}
+
+bool ntru_set_accel(bool enable)
+{
+    ntru_accel = NTRU_ACCEL_UNKNOWN;
+    if (!enable)
+        ntru_accel = NTRU_ACCEL_OFF;
+    return ntru_use_avx2();
+}
+
+const char *ntru_kernel_name(void)
+{
+    return ntru_use_avx2() ? "avx2" : "portable";
+}
+#else
+bool ntru_set_accel(bool enable)
+{
+    return false;
+}
+
+const char *ntru_kernel_name(void)
+{
+    return "portable";
+}
+#endif
+
 /* ----------------------------------------------------------------------
  * Quotient-ring functions.
  *
@@ -195,6 +234,13 @@ void ntru_ring_multiply(uint16_t *out, const uint16_t *a, const uint16_t *b,
 {
     SETUP;
 
+#if HAVE_AVX2
+    if (ntru_use_avx2()) {
+        ntru_ring_multiply_avx2(out, a, b, p, q);
+        return;
+    }
+#endif
+
     /*
      * Strategy: just compute the full product with 2p coefficients,
      * and then reduce it mod x^p-x-1 by working downwards from the
@@ -276,13 +322,17 @@ unsigned ntru_ring_invert(uint16_t *out, const uint16_t *in,
      * deg A + deg B + 2, where deg A <= p-1 and deg B = p */
     const size_t STEPS = 2*p + 1;
 
+    /* The arrays are allocated with room for a whole number of AVX2
+     * vectors, with the extra elements kept at zero */
+    const size_t ALLOC = (SIZE + 15) & ~(size_t)15;
+
     /* Our two working polynomials */
-    uint16_t *A = snewn(SIZE, uint16_t);
-    uint16_t *B = snewn(SIZE, uint16_t);
+    uint16_t *A = snewn(ALLOC, uint16_t);
+    uint16_t *B = snewn(ALLOC, uint16_t);
 
     /* Coefficient of the input value in each one */
-    uint16_t *Ac = snewn(SIZE, uint16_t);
-    uint16_t *Bc = snewn(SIZE, uint16_t);
+    uint16_t *Ac = snewn(ALLOC, uint16_t);
+    uint16_t *Bc = snewn(ALLOC, uint16_t);
 
     /* Initialise A to the input, and Ac correspondingly to 1 */
     memcpy(A, in, p*sizeof(uint16_t));
@@ -300,7 +350,15 @@ unsigned ntru_ring_invert(uint16_t *out, const uint16_t *in,
     for (size_t i = 0; i < SIZE; i++)
         Bc[i] = 0;
 
+    for (size_t i = SIZE; i < ALLOC; i++)
+        A[i] = B[i] = Ac[i] = Bc[i] = 0;
+
     /* Run the gcd-finding algorithm. */
+#if HAVE_AVX2
+    if (ntru_use_avx2())
+        ntru_ring_invert_steps_avx2(A, B, Ac, Bc, ALLOC, STEPS, p, q);
+    else
+#endif
     for (size_t i = 0; i < STEPS; i++) {
         /*
          * First swap round so that A is the one we'll be dividing by x.
@@ -391,13 +449,13 @@ unsigned ntru_ring_invert(uint16_t *out, const uint16_t *in,
     for (size_t i = 0; i < p; i++)
         out[i] = REDUCE(scale * Bc[i]);
 
-    smemclr(A, SIZE * sizeof(*A));
+    smemclr(A, ALLOC * sizeof(*A));
     sfree(A);
-    smemclr(B, SIZE * sizeof(*B));
+    smemclr(B, ALLOC * sizeof(*B));
     sfree(B);
-    smemclr(Ac, SIZE * sizeof(*Ac));
+    smemclr(Ac, ALLOC * sizeof(*Ac));
     sfree(Ac);
-    smemclr(Bc, SIZE * sizeof(*Bc));
+    smemclr(Bc, ALLOC * sizeof(*Bc));
     sfree(Bc);
 
     return success;
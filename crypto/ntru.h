@@ -50,4 +50,26 @@ void ntru_encode_plaintext(const uint16_t *plaintext, unsigned p,
 unsigned ntru_keypair_p(NTRUKeyPair *keypair);
 const uint16_t *ntru_pubkey(NTRUKeyPair *keypair);
 
+/*
+ * ntru_ring_multiply and ntru_ring_invert can use an AVX2
+ * implementation, if one was compiled in and the CPU supports it.
+ * That's the default; ntru_set_accel(false) forces the portable
+ * version instead, so that test programs can compare the two. It
+ * returns true if the accelerated version is in use afterwards.
+ * ntru_kernel_name says which version is currently selected.
+ */
+bool ntru_set_accel(bool enable);
+const char *ntru_kernel_name(void);
+
+#if HAVE_AVX2
+/* The AVX2 versions in ntru-avx2.c */
+bool ntru_avx2_available(void);
+void ntru_ring_multiply_avx2(uint16_t *out, const uint16_t *a,
+                             const uint16_t *b, unsigned p, unsigned q);
+void ntru_ring_invert_steps_avx2(uint16_t *A, uint16_t *B,
+                                 uint16_t *Ac, uint16_t *Bc,
+                                 size_t size, size_t steps,
+                                 unsigned p, unsigned q);
+#endif
+
 #endif /* PUTTY_CRYPTO_NTRU_H */
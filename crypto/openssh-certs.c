@@ -944,6 +944,63 @@ static char *opensshcert_invalid(ssh_key *key, unsigned flags)
     return ssh_key_invalid(ck->basekey, flags);
 }
 
+/*
+ * Cache of certificates whose CA signatures are already known to be
+ * valid, so that a client making many connections to the same hosts
+ * doesn't have to verify the same signature every time.
+ *
+ * An entry is a hash of the entire certificate blob, which includes
+ * the CA public key and the signature itself. So an entry can never
+ * go stale: if anything about the certificate or its signer changes,
+ * so does the hash. All the other checks in opensshcert_check_cert
+ * (the CA signature algorithm, the certificate type and validity
+ * period, principals and critical options) are cheap, and are still
+ * done every time. And it's up to the caller to decide whether the
+ * CA is trusted in the first place, which it does by looking the CA
+ * key up in its current configuration, so changing that takes effect
+ * immediately too.
+ *
+ * The cache is a fixed-size ring, discarding the oldest entry when
+ * it fills up.
+ */
+#define CERT_SIG_CACHE_SIZE 64
+
+static unsigned char cert_sig_cache[CERT_SIG_CACHE_SIZE][CERT_SIG_CACHE_ID_LEN];
+static size_t cert_sig_cache_used, cert_sig_cache_next;
+
+void opensshcert_sig_cache_id(ssh_key *key, unsigned char *id)
+{
+    strbuf *blob = strbuf_new();
+    ssh_key_public_blob(key, BinarySink_UPCAST(blob));
+    hash_simple(&ssh_sha256, ptrlen_from_strbuf(blob), id);
+    strbuf_free(blob);
+}
+
+bool opensshcert_sig_cache_check(const unsigned char *id)
+{
+    for (size_t i = 0; i < cert_sig_cache_used; i++)
+        if (!memcmp(cert_sig_cache[i], id, CERT_SIG_CACHE_ID_LEN))
+            return true;
+    return false;
+}
+
+void opensshcert_sig_cache_add(const unsigned char *id)
+{
+    if (opensshcert_sig_cache_check(id))
+        return;
+
+    memcpy(cert_sig_cache[cert_sig_cache_next], id, CERT_SIG_CACHE_ID_LEN);
+    cert_sig_cache_next = (cert_sig_cache_next + 1) % CERT_SIG_CACHE_SIZE;
+    if (cert_sig_cache_used < CERT_SIG_CACHE_SIZE)
+        cert_sig_cache_used++;
+}
+
+void opensshcert_sig_cache_clear(void)
+{
+    smemclr(cert_sig_cache, sizeof(cert_sig_cache));
+    cert_sig_cache_used = cert_sig_cache_next = 0;
+}
+
 static bool opensshcert_check_cert(
     ssh_key *key, bool host, ptrlen principal, uint64_t time,
     const ca_options *opts, BinarySink *error)
@@ -1003,11 +1060,18 @@ static bool opensshcert_check_cert(
         goto out;
     }
 
-    opensshcert_signature_preimage(ck, BinarySink_UPCAST(preimage));
+    unsigned char cache_id[CERT_SIG_CACHE_ID_LEN];
+    opensshcert_sig_cache_id(key, cache_id);
+    if (!opensshcert_sig_cache_check(cache_id)) {
+        opensshcert_signature_preimage(ck, BinarySink_UPCAST(preimage));
 
-    if (!ssh_key_verify(ca_key, signature, ptrlen_from_strbuf(preimage))) {
-        put_fmt(error, "Certificate's signature is invalid");
-        goto out;
+        if (!ssh_key_verify(ca_key, signature,
+                            ptrlen_from_strbuf(preimage))) {
+            put_fmt(error, "Certificate's signature is invalid");
+            goto out;
+        }
+
+        opensshcert_sig_cache_add(cache_id);
     }
 
     uint32_t expected_type = host ? SSH_CERT_TYPE_HOST : SSH_CERT_TYPE_USER;
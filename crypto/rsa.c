@@ -30,6 +30,7 @@ void BinarySource_get_rsa_ssh1_pub(
         rsa->bits = bits;
         rsa->exponent = e;
         rsa->modulus = m;
+        rsa->pub_mc = NULL;
         rsa->bytes = (mp_get_nbits(m) + 7) / 8;
     } else {
         mp_free(e);
@@ -41,6 +42,7 @@ void BinarySource_get_rsa_ssh1_priv(
     BinarySource *src, RSAKey *rsa)
 {
     rsa->private_exponent = get_mp_ssh1(src);
+    rsa->crt = NULL;
 }
 
 key_components *rsa_components(RSAKey *rsa)
@@ -87,10 +89,32 @@ void duprsakey(RSAKey *dst, const RSAKey *src)
     dst->p = mp_copy(src->p);
     dst->q = mp_copy(src->q);
     dst->iqmp = mp_copy(src->iqmp);
+    dst->crt = NULL;
+    dst->pub_mc = NULL;
     dst->comment = src->comment ? dupstr(src->comment) : NULL;
     dst->sshk.vt = src->sshk.vt;
 }
 
+/*
+ * The public-key operation, input ^ exponent mod modulus. The
+ * MontyContext for the modulus costs several times as much to set up
+ * as the exponentiation itself (the public exponent being short), so
+ * the key keeps it in its 'pub_mc' field after the first use, which
+ * pays off for a host key or CA key that verifies many signatures.
+ */
+static mp_int *rsa_pubkey_op(mp_int *input, RSAKey *key)
+{
+    if (!key->pub_mc)
+        key->pub_mc = monty_new(key->modulus);
+
+    mp_int *m_in = monty_import(key->pub_mc, input);
+    mp_int *m_out = monty_pow_public(key->pub_mc, m_in, key->exponent);
+    mp_int *out = monty_export(key->pub_mc, m_out);
+    mp_free(m_in);
+    mp_free(m_out);
+    return out;
+}
+
 bool rsa_ssh1_encrypt(unsigned char *data, int length, RSAKey *key)
 {
     mp_int *b1, *b2;
@@ -139,7 +163,7 @@ bool rsa_ssh1_encrypt(unsigned char *data, int length, RSAKey *key)
 
     b1 = mp_from_bytes_be(make_ptrlen(data, key->bytes));
 
-    b2 = mp_modpow(b1, key->exponent, key->modulus);
+    b2 = rsa_pubkey_op(b1, key);
 
     p = data;
     for (i = key->bytes; i--;) {
@@ -153,16 +177,27 @@ bool rsa_ssh1_encrypt(unsigned char *data, int length, RSAKey *key)
 }
 
 /*
- * Compute (base ^ exp) % mod, provided mod == p * q, with p,q
- * distinct primes, and iqmp is the multiplicative inverse of q mod p.
- * Uses Chinese Remainder Theorem to speed computation up over the
- * obvious implementation of a single big modpow.
+ * Everything about a private key that crt_modpow needs, other than
+ * the input, and that doesn't change between calls. Building this
+ * costs about as much as the two Montgomery contexts it contains, so
+ * an RSAKey keeps one around (in its 'crt' field) once it's been
+ * used for a private-key operation, which pays off when the same key
+ * signs or decrypts repeatedly (e.g. in Pageant, or as a host key).
+ *
+ * It's all as secret as the key itself, so it's freed (and wiped) by
+ * freersapriv.
  */
-static mp_int *crt_modpow(mp_int *base, mp_int *exp, mp_int *mod,
-                          mp_int *p, mp_int *q, mp_int *iqmp)
+struct RSACrtContext {
+    MontyContext *pmc, *qmc;   /* Montgomery contexts mod p and mod q */
+    mp_int *pexp, *qexp;       /* private exponent mod p-1 and q-1 */
+    mp_int *multiplier;        /* iqmp * q */
+};
+
+static RSACrtContext *rsa_crt_new(mp_int *exp, mp_int *p, mp_int *q,
+                                  mp_int *iqmp)
 {
-    mp_int *pm1, *qm1, *pexp, *qexp, *presult, *qresult;
-    mp_int *diff, *multiplier, *ret0, *ret;
+    RSACrtContext *crt = snew(RSACrtContext);
+    mp_int *pm1, *qm1;
 
     /*
      * Reduce the exponent mod phi(p) and phi(q), to save time when
@@ -173,18 +208,59 @@ static mp_int *crt_modpow(mp_int *base, mp_int *exp, mp_int *mod,
     mp_sub_integer_into(pm1, pm1, 1);
     qm1 = mp_copy(q);
     mp_sub_integer_into(qm1, qm1, 1);
-    pexp = mp_mod(exp, pm1);
-    qexp = mp_mod(exp, qm1);
+    crt->pexp = mp_mod(exp, pm1);
+    crt->qexp = mp_mod(exp, qm1);
+    mp_free(pm1);
+    mp_free(qm1);
+
+    crt->pmc = monty_new(p);
+    crt->qmc = monty_new(q);
+    crt->multiplier = mp_mul(iqmp, q);
+
+    return crt;
+}
+
+static void rsa_crt_free(RSACrtContext *crt)
+{
+    monty_free(crt->pmc);
+    monty_free(crt->qmc);
+    mp_free(crt->pexp);
+    mp_free(crt->qexp);
+    mp_free(crt->multiplier);
+    smemclr(crt, sizeof(*crt));
+    sfree(crt);
+}
+
+/* One half of the CRT computation: (base mod m) ^ exp, mod m. */
+static mp_int *crt_half_modpow(mp_int *base, MontyContext *mc, mp_int *exp)
+{
+    mp_int *base_mod = mp_mod(base, monty_modulus(mc));
+    mp_int *m_base = monty_import(mc, base_mod);
+    mp_int *m_out = monty_pow(mc, m_base, exp);
+    mp_int *out = monty_export(mc, m_out);
+    mp_free(base_mod);
+    mp_free(m_base);
+    mp_free(m_out);
+    return out;
+}
+
+/*
+ * Compute (base ^ exp) % mod, provided mod == p * q, with p,q
+ * distinct primes, and crt was made by rsa_crt_new from exp, p, q,
+ * and iqmp (the multiplicative inverse of q mod p). Uses Chinese
+ * Remainder Theorem to speed computation up over the obvious
+ * implementation of a single big modpow.
+ */
+static mp_int *crt_modpow(mp_int *base, mp_int *mod, mp_int *p, mp_int *q,
+                          RSACrtContext *crt)
+{
+    mp_int *presult, *qresult, *diff, *ret0, *ret;
 
     /*
      * Do the two modpows.
      */
-    mp_int *base_mod_p = mp_mod(base, p);
-    presult = mp_modpow(base_mod_p, pexp, p);
-    mp_free(base_mod_p);
-    mp_int *base_mod_q = mp_mod(base, q);
-    qresult = mp_modpow(base_mod_q, qexp, q);
-    mp_free(base_mod_q);
+    presult = crt_half_modpow(base, crt->pmc, crt->pexp);
+    qresult = crt_half_modpow(base, crt->qmc, crt->qexp);
 
     /*
      * Recombine the results. We want a value which is congruent to
@@ -202,8 +278,7 @@ static mp_int *crt_modpow(mp_int *base, mp_int *exp, mp_int *mod,
     mp_cond_add_into(presult, presult, p, presult_too_small);
 
     diff = mp_sub(presult, qresult);
-    multiplier = mp_mul(iqmp, q);
-    ret0 = mp_mul(multiplier, diff);
+    ret0 = mp_mul(crt->multiplier, diff);
     mp_add_into(ret0, ret0, qresult);
 
     /*
@@ -214,27 +289,45 @@ static mp_int *crt_modpow(mp_int *base, mp_int *exp, mp_int *mod,
     /*
      * Free all the intermediate results before returning.
      */
-    mp_free(pm1);
-    mp_free(qm1);
-    mp_free(pexp);
-    mp_free(qexp);
     mp_free(presult);
     mp_free(qresult);
     mp_free(diff);
-    mp_free(multiplier);
     mp_free(ret0);
 
     return ret;
 }
 
+/*
+ * Whether RSAKeys keep their RSACrtContext between operations. This
+ * is only ever turned off by test programs, to measure what the
+ * cache is worth.
+ */
+static bool rsa_crt_cache = true;
+
+bool rsa_set_crt_cache(bool enable)
+{
+    rsa_crt_cache = enable;
+    return rsa_crt_cache;
+}
+
 /*
  * Wrapper on crt_modpow that looks up all the right values from an
- * RSAKey.
+ * RSAKey, setting up its RSACrtContext the first time round.
  */
 static mp_int *rsa_privkey_op(mp_int *input, RSAKey *key)
 {
-    return crt_modpow(input, key->private_exponent,
-                      key->modulus, key->p, key->q, key->iqmp);
+    if (!rsa_crt_cache) {
+        RSACrtContext *crt = rsa_crt_new(key->private_exponent,
+                                         key->p, key->q, key->iqmp);
+        mp_int *out = crt_modpow(input, key->modulus, key->p, key->q, crt);
+        rsa_crt_free(crt);
+        return out;
+    }
+
+    if (!key->crt)
+        key->crt = rsa_crt_new(key->private_exponent,
+                               key->p, key->q, key->iqmp);
+    return crt_modpow(input, key->modulus, key->p, key->q, key->crt);
 }
 
 mp_int *rsa_ssh1_decrypt(mp_int *input, RSAKey *key)
@@ -397,6 +490,10 @@ bool rsa_verify(RSAKey *key)
     mp_free(key->p);
     mp_free(key->q);
     mp_free(key->iqmp);
+    if (key->crt) {
+        rsa_crt_free(key->crt);        /* made from the old p and q */
+        key->crt = NULL;
+    }
     key->p = p_new;
     key->q = q_new;
     key->iqmp = mp_invert(key->q, key->p);
@@ -451,6 +548,10 @@ void freersapriv(RSAKey *key)
     if (key->private_exponent) {
         mp_free(key->private_exponent);
         key->private_exponent = NULL;
+        if (key->crt) {
+            rsa_crt_free(key->crt);
+            key->crt = NULL;
+        }
     }
     if (key->p) {
         mp_free(key->p);
@@ -469,6 +570,10 @@ void freersapriv(RSAKey *key)
 void freersakey(RSAKey *key)
 {
     freersapriv(key);
+    if (key->pub_mc) {
+        monty_free(key->pub_mc);
+        key->pub_mc = NULL;
+    }
     if (key->modulus) {
         mp_free(key->modulus);
         key->modulus = NULL;
@@ -508,6 +613,8 @@ static ssh_key *rsa2_new_pub(const ssh_keyalg *self, ptrlen data)
     rsa->modulus = get_mp_ssh2(src);
     rsa->private_exponent = NULL;
     rsa->p = rsa->q = rsa->iqmp = NULL;
+    rsa->crt = NULL;
+    rsa->pub_mc = NULL;
     rsa->comment = NULL;
 
     if (get_err(src)) {
@@ -603,6 +710,8 @@ static ssh_key *rsa2_new_priv_openssh(const ssh_keyalg *self,
     rsa->iqmp = get_mp_ssh2(src);
     rsa->p = get_mp_ssh2(src);
     rsa->q = get_mp_ssh2(src);
+    rsa->crt = NULL;
+    rsa->pub_mc = NULL;
 
     if (get_err(src) || !rsa_verify(rsa)) {
         rsa2_freekey(&rsa->sshk);
@@ -795,7 +904,7 @@ static bool rsa2_verify(ssh_key *key, ptrlen sig, ptrlen data)
         return false;
 
     in = mp_from_bytes_be(in_pl);
-    out = mp_modpow(in, rsa->exponent, rsa->modulus);
+    out = rsa_pubkey_op(in, rsa);
     mp_free(in);
 
     unsigned diff = 0;
@@ -1050,7 +1159,7 @@ strbuf *ssh_rsakex_encrypt(RSAKey *rsa, const ssh_hashalg *h, ptrlen in)
      * RSA-encrypt.
      */
     b1 = mp_from_bytes_be(make_ptrlen(out, outlen));
-    b2 = mp_modpow(b1, rsa->exponent, rsa->modulus);
+    b2 = rsa_pubkey_op(b1, rsa);
     p = (char *)out;
     for (i = outlen; i--;) {
         *p++ = mp_get_byte(b2, i);
@@ -90,6 +90,7 @@ typedef struct strbuf strbuf;
 typedef struct LoadedFile LoadedFile;
 
 typedef struct RSAKey RSAKey;
+typedef struct RSACrtContext RSACrtContext;
 
 typedef struct BinarySink BinarySink;
 typedef struct BinarySource BinarySource;
@@ -143,10 +144,12 @@ typedef struct MontyContext MontyContext;
 
 typedef struct WeierstrassCurve WeierstrassCurve;
 typedef struct WeierstrassPoint WeierstrassPoint;
+typedef struct WeierstrassBaseTable WeierstrassBaseTable;
 typedef struct MontgomeryCurve MontgomeryCurve;
 typedef struct MontgomeryPoint MontgomeryPoint;
 typedef struct EdwardsCurve EdwardsCurve;
 typedef struct EdwardsPoint EdwardsPoint;
+typedef struct EdwardsBaseTable EdwardsBaseTable;
 
 typedef struct SshServerConfig SshServerConfig;
 typedef struct SftpServer SftpServer;
@@ -10,6 +10,276 @@
 #include "mpunsafe.h"
 #include "sshkeygen.h"
 
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* ----------------------------------------------------------------------
+ * Testing several candidates at once.
+ *
+ * Both policies below spend most of their time running Miller-Rabin
+ * on candidates that turn out to be composite. If the caller has
+ * asked for more than one thread, an MRBatch keeps a window of
+ * upcoming candidates being tested by worker threads, and hands the
+ * verdicts back strictly in the order the candidates were generated.
+ * So the generation loop sees the same sequence of events as if it
+ * had tested each candidate itself, and the first one it accepts has
+ * exactly the distribution it would have had in the serial loop.
+ *
+ * The workers never touch the random number generator, which isn't
+ * thread-safe. The calling thread draws each candidate and all the
+ * witnesses its test might need before queueing it. A test that stops
+ * early leaves some witnesses unused, but since every witness is
+ * independent of everything else, that doesn't change any of the
+ * probabilities.
+ */
+
+typedef struct MRBatch MRBatch;
+
+/*
+ * Candidates smaller than this are tested so quickly that handing
+ * them to another thread costs more than it saves.
+ */
+#define MRBATCH_MIN_BITS 512
+
+/*
+ * When looking for a potential primitive root for Pocklington, each
+ * witness has at least an even chance of being one. So we pre-draw
+ * this many, and in the rare case that none of them is suitable, the
+ * caller just goes on looking serially.
+ */
+#define MRBATCH_ROOT_WITNESSES 8
+
+#if HAVE_PTHREAD
+
+typedef struct MRJob {
+    mp_int *p;
+    mp_int **witnesses;
+    size_t nwitnesses;
+
+    bool done, passed;
+    mp_int *root;
+} MRJob;
+
+struct MRBatch {
+    PrimeCandidateSource *pcs;
+    bool want_root;
+
+    pthread_t *threads;
+    unsigned nthreads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stopping;
+
+    /*
+     * Ring buffer of jobs. Sequence numbers in [head,started) are
+     * being tested, or have been; [started,tail) are waiting for a
+     * worker. Only the calling thread changes head and tail.
+     */
+    MRJob *jobs;
+    size_t window, head, started, tail;
+    bool exhausted;
+};
+
+static void mrjob_run(MRBatch *b, MRJob *job)
+{
+    MillerRabin *mr = miller_rabin_new(job->p);
+
+    job->passed = true;
+    for (size_t i = 0; i < job->nwitnesses; i++) {
+        struct mr_result result = miller_rabin_test(mr, job->witnesses[i]);
+        if (!result.passed) {
+            job->passed = false;
+            break;
+        }
+        if (b->want_root && result.potential_primitive_root) {
+            job->root = mp_copy(job->witnesses[i]);
+            break;
+        }
+    }
+
+    miller_rabin_free(mr);
+}
+
+static void mrjob_clear(MRJob *job)
+{
+    if (job->p)
+        mp_free(job->p);
+    for (size_t i = 0; i < job->nwitnesses; i++)
+        mp_free(job->witnesses[i]);
+    sfree(job->witnesses);
+    if (job->root)
+        mp_free(job->root);
+    memset(job, 0, sizeof(*job));
+}
+
+static void *mrbatch_thread(void *vctx)
+{
+    MRBatch *b = (MRBatch *)vctx;
+
+    pthread_mutex_lock(&b->mutex);
+    while (true) {
+        while (!b->stopping && b->started == b->tail)
+            pthread_cond_wait(&b->cond, &b->mutex);
+        if (b->stopping)
+            break;
+
+        MRJob *job = &b->jobs[b->started++ % b->window];
+        pthread_mutex_unlock(&b->mutex);
+        mrjob_run(b, job);
+        pthread_mutex_lock(&b->mutex);
+        job->done = true;
+        pthread_cond_broadcast(&b->cond);
+    }
+    pthread_mutex_unlock(&b->mutex);
+
+    return NULL;
+}
+
+static MRBatch *mrbatch_new(PrimeCandidateSource *pcs, unsigned threads,
+                            bool want_root)
+{
+    if (threads < 2 || pcs_get_bits(pcs) < MRBATCH_MIN_BITS)
+        return NULL;
+
+    /* Make mpint.c settle its choice of multiplication kernel now,
+     * rather than have the first few workers race to do it */
+    mp_mul_kernel_name();
+
+    MRBatch *b = snew(MRBatch);
+    b->pcs = pcs;
+    b->want_root = want_root;
+    b->stopping = false;
+    b->window = 2 * (size_t)threads;
+    b->jobs = snewn(b->window, MRJob);
+    memset(b->jobs, 0, b->window * sizeof(*b->jobs));
+    b->head = b->started = b->tail = 0;
+    b->exhausted = false;
+    pthread_mutex_init(&b->mutex, NULL);
+    pthread_cond_init(&b->cond, NULL);
+
+    b->threads = snewn(threads, pthread_t);
+    for (b->nthreads = 0; b->nthreads < threads; b->nthreads++)
+        if (pthread_create(&b->threads[b->nthreads], NULL,
+                           mrbatch_thread, b) != 0)
+            break;
+
+    if (!b->nthreads) {
+        /* Couldn't start any threads, so just test serially */
+        pthread_cond_destroy(&b->cond);
+        pthread_mutex_destroy(&b->mutex);
+        sfree(b->threads);
+        sfree(b->jobs);
+        sfree(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+static bool mrbatch_add_job(MRBatch *b)
+{
+    mp_int *p = pcs_generate(b->pcs);
+    if (!p)
+        return false;
+
+    MRJob *job = &b->jobs[b->tail % b->window];
+    job->p = p;
+    job->nwitnesses = (b->want_root ? MRBATCH_ROOT_WITNESSES :
+                       miller_rabin_checks_needed(mp_get_nbits(p)));
+    job->witnesses = snewn(job->nwitnesses, mp_int *);
+
+    mp_int *two = mp_from_integer(2);
+    mp_int *pm1 = mp_copy(p);
+    mp_sub_integer_into(pm1, pm1, 1);
+    for (size_t i = 0; i < job->nwitnesses; i++)
+        job->witnesses[i] = mp_random_in_range(two, pm1);
+    mp_free(two);
+    mp_free(pm1);
+
+    pthread_mutex_lock(&b->mutex);
+    b->tail++;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->mutex);
+    return true;
+}
+
+/*
+ * Return the next candidate, and whether it passed. If the batch was
+ * made with want_root, *root is set to a witness that was found to be
+ * a potential primitive root, or NULL if none of the pre-drawn ones
+ * was. Returns NULL once the PrimeCandidateSource runs out.
+ */
+static mp_int *mrbatch_next(MRBatch *b, bool *passed, mp_int **root)
+{
+    while (!b->exhausted && b->tail - b->head < b->window)
+        if (!mrbatch_add_job(b))
+            b->exhausted = true;
+
+    if (b->head == b->tail)
+        return NULL;
+
+    MRJob *job = &b->jobs[b->head % b->window];
+    pthread_mutex_lock(&b->mutex);
+    while (!job->done)
+        pthread_cond_wait(&b->cond, &b->mutex);
+    pthread_mutex_unlock(&b->mutex);
+
+    mp_int *p = job->p;
+    job->p = NULL;
+    *passed = job->passed;
+    if (root) {
+        *root = job->root;
+        job->root = NULL;
+    }
+    mrjob_clear(job);
+    b->head++;
+    return p;
+}
+
+static void mrbatch_free(MRBatch *b)
+{
+    if (!b)
+        return;
+
+    pthread_mutex_lock(&b->mutex);
+    b->stopping = true;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->mutex);
+
+    for (unsigned i = 0; i < b->nthreads; i++)
+        pthread_join(b->threads[i], NULL);
+
+    for (; b->head < b->tail; b->head++)
+        mrjob_clear(&b->jobs[b->head % b->window]);
+
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->mutex);
+    sfree(b->threads);
+    sfree(b->jobs);
+    sfree(b);
+}
+
+#else /* HAVE_PTHREAD */
+
+static MRBatch *mrbatch_new(PrimeCandidateSource *pcs, unsigned threads,
+                            bool want_root)
+{
+    return NULL;
+}
+
+static mp_int *mrbatch_next(MRBatch *b, bool *passed, mp_int **root)
+{
+    unreachable("no MRBatch without threads");
+}
+
+static void mrbatch_free(MRBatch *b)
+{
+}
+
+#endif /* HAVE_PTHREAD */
+
 /* ----------------------------------------------------------------------
  * Standard probabilistic prime-generation algorithm:
  *
@@ -28,6 +298,7 @@ static PrimeGenerationContext *probprime_new_context(
 {
     PrimeGenerationContext *ctx = snew(PrimeGenerationContext);
     ctx->vt = policy;
+    ctx->threads = 1;
     return ctx;
 }
 
@@ -71,30 +342,41 @@ static mp_int *probprime_generate(
 {
     pcs_ready(pcs);
 
+    MRBatch *batch = mrbatch_new(pcs, ctx->threads, false);
+
     while (true) {
         progress_report_attempt(prog);
 
-        mp_int *p = pcs_generate(pcs);
+        mp_int *p;
+        bool known_bad = false;
+
+        if (batch) {
+            bool passed;
+            p = mrbatch_next(batch, &passed, NULL);
+            known_bad = !passed;
+        } else if ((p = pcs_generate(pcs)) != NULL) {
+            MillerRabin *mr = miller_rabin_new(p);
+            unsigned nchecks = miller_rabin_checks_needed(mp_get_nbits(p));
+            for (unsigned check = 0; check < nchecks; check++) {
+                if (!miller_rabin_test_random(mr)) {
+                    known_bad = true;
+                    break;
+                }
+            }
+            miller_rabin_free(mr);
+        }
+
         if (!p) {
+            mrbatch_free(batch);
             pcs_free(pcs);
             return NULL;
         }
 
-        MillerRabin *mr = miller_rabin_new(p);
-        bool known_bad = false;
-        unsigned nchecks = miller_rabin_checks_needed(mp_get_nbits(p));
-        for (unsigned check = 0; check < nchecks; check++) {
-            if (!miller_rabin_test_random(mr)) {
-                known_bad = true;
-                break;
-            }
-        }
-        miller_rabin_free(mr);
-
         if (!known_bad) {
             /*
              * We have a prime!
              */
+            mrbatch_free(batch);
             pcs_free(pcs);
             return p;
         }
@@ -146,6 +428,7 @@ static PrimeGenerationContext *provableprime_new_context(
 {
     ProvablePrimeContext *ppc = snew(ProvablePrimeContext);
     ppc->pgc.vt = policy;
+    ppc->pgc.threads = 1;
     ppc->pockle = pockle_new();
     ppc->extra = policy->extra;
     return &ppc->pgc;
@@ -633,19 +916,31 @@ static mp_int *provableprime_generate_inner(
             bits, pcs_get_bits_remaining(pcs));
     pcs_ready(pcs);
 
+    MRBatch *batch = mrbatch_new(pcs, ppc->pgc.threads, true);
+
     while (true) {
-        mp_int *p = pcs_generate(pcs);
+        mp_int *p, *witness = NULL;
+        bool passed = true;
+
+        if (batch)
+            p = mrbatch_next(batch, &passed, &witness);
+        else
+            p = pcs_generate(pcs);
+
         if (!p) {
+            mrbatch_free(batch);
             pcs_free(pcs);
             return NULL;
         }
 
         debug_f_mp("provable_step p=", p);
 
-        MillerRabin *mr = miller_rabin_new(p);
-        debug_f("provable_step mr setup done");
-        mp_int *witness = miller_rabin_find_potential_primitive_root(mr);
-        miller_rabin_free(mr);
+        if (passed && !witness) {
+            MillerRabin *mr = miller_rabin_new(p);
+            debug_f("provable_step mr setup done");
+            witness = miller_rabin_find_potential_primitive_root(mr);
+            miller_rabin_free(mr);
+        }
 
         if (!witness) {
             debug_f("provable_step mr failed");
@@ -680,6 +975,7 @@ static mp_int *provableprime_generate_inner(
         }
 
         mp_free(witness);
+        mrbatch_free(batch);
         pcs_free(pcs);
         debug_f_mp("ppgi(%u) done, got ", p, bits);
         progress_report(prog, progress_origin + progress_scale);
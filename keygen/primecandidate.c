@@ -13,6 +13,18 @@ struct avoid {
     unsigned mod, res;
 };
 
+/*
+ * A run of consecutive entries in the avoid list whose distinct
+ * moduli multiply to something that fits in a uint32_t. We reduce
+ * each candidate mod that product with a single pass over the
+ * bignum, and then get the residues mod the individual moduli from
+ * the result with ordinary C arithmetic.
+ */
+struct avoid_group {
+    uint32_t mod;
+    size_t start, end;
+};
+
 struct PrimeCandidateSource {
     unsigned bits;
     bool ready, try_sophie_germain;
@@ -33,6 +45,8 @@ struct PrimeCandidateSource {
      * (modulus, residue) pairs we want to avoid. */
     struct avoid *avoids;
     size_t navoids, avoidsize;
+    struct avoid_group *groups;
+    size_t ngroups, groupsize;
 
     /* List of known primes that our number will be congruent to 1 modulo */
     mp_int **kps;
@@ -57,6 +71,8 @@ PrimeCandidateSource *pcs_new_with_firstbits(unsigned bits,
 
     s->avoids = NULL;
     s->navoids = s->avoidsize = 0;
+    s->groups = NULL;
+    s->ngroups = s->groupsize = 0;
 
     /* Make the number that's the lower limit of our range */
     mp_int *firstmp = mp_from_integer(first);
@@ -97,6 +113,7 @@ void pcs_free(PrimeCandidateSource *s)
     for (size_t i = 0; i < s->nkps; i++)
         mp_free(s->kps[i]);
     sfree(s->avoids);
+    sfree(s->groups);
     sfree(s->kps);
     sfree(s);
 }
@@ -362,6 +379,33 @@ void pcs_ready(PrimeCandidateSource *s)
 
     s->navoids = out;
 
+    /*
+     * Divide the list into runs whose moduli we can reduce by all at
+     * once. The list is still sorted, so the small primes that reject
+     * most candidates end up sharing the first group or two, and the
+     * large ones mostly pair up.
+     */
+    uint64_t product = 0;
+    last_mod = 0;
+    for (size_t i = 0; i < s->navoids; i++) {
+        uint64_t mod = s->avoids[i].mod;
+
+        /* A repeated modulus is already a factor of the current group */
+        if (mod != last_mod) {
+            last_mod = mod;
+            if (s->ngroups && product * mod <= 0xFFFFFFFF) {
+                product *= mod;
+            } else {
+                sgrowarray(s->groups, s->groupsize, s->ngroups);
+                s->groups[s->ngroups].start = i;
+                s->ngroups++;
+                product = mod;
+            }
+            s->groups[s->ngroups - 1].mod = product;
+        }
+        s->groups[s->ngroups - 1].end = i + 1;
+    }
+
     s->ready = true;
 }
 
@@ -377,20 +421,17 @@ mp_int *pcs_generate(PrimeCandidateSource *s)
     while (true) {
         mp_int *x = mp_random_upto(s->limit);
 
-        int64_t x_res = 0, last_mod = 0;
         bool ok = true;
 
-        for (size_t i = 0; i < s->navoids; i++) {
-            int64_t mod = s->avoids[i].mod, avoid_res = s->avoids[i].res;
-
-            if (mod != last_mod) {
-                last_mod = mod;
-                x_res = mp_mod_known_integer(x, mod);
-            }
+        for (size_t g = 0; g < s->ngroups && ok; g++) {
+            const struct avoid_group *group = &s->groups[g];
+            uint32_t group_res = mp_mod_known_integer(x, group->mod);
 
-            if (x_res == avoid_res) {
-                ok = false;
-                break;
+            for (size_t i = group->start; i < group->end; i++) {
+                if (group_res % s->avoids[i].mod == s->avoids[i].res) {
+                    ok = false;
+                    break;
+                }
             }
         }
 
@@ -172,6 +172,8 @@ int rsa_generate(RSAKey *key, int bits, bool strong,
     key->p = p;
     key->q = q;
     key->iqmp = iqmp;
+    key->crt = NULL;
+    key->pub_mc = NULL;
 
     key->bits = mp_get_nbits(modulus);
     key->bytes = (key->bits + 7) / 8;
@@ -211,6 +211,18 @@ mp_int *mp_add(mp_int *x, mp_int *y);
 mp_int *mp_sub(mp_int *x, mp_int *y);
 mp_int *mp_mul(mp_int *x, mp_int *y);
 
+/*
+ * The innermost multiply-accumulate loop used by all multiplication
+ * (including Montgomery reduction and hence modpow) can be done by a
+ * hardware-specific kernel, if one was compiled in and the CPU
+ * supports it. That's the default; mp_mul_set_accel(false) forces the
+ * portable C version instead, so that test programs can compare the
+ * two. It returns true if an accelerated kernel is in use afterwards.
+ * mp_mul_kernel_name says which version is currently selected.
+ */
+bool mp_mul_set_accel(bool enable);
+const char *mp_mul_kernel_name(void);
+
 /*
  * Bitwise operations.
  */
@@ -386,6 +398,13 @@ mp_int *monty_add(MontyContext *, mp_int *, mp_int *);
 mp_int *monty_sub(MontyContext *, mp_int *, mp_int *);
 mp_int *monty_mul(MontyContext *, mp_int *, mp_int *);
 mp_int *monty_pow(MontyContext *, mp_int *base, mp_int *exponent);
+/*
+ * Like monty_pow, but for an exponent that is not secret, such as an
+ * RSA public exponent. The running time depends on the exponent
+ * (though not on the base), which makes it a great deal faster for
+ * short exponents like 65537.
+ */
+mp_int *monty_pow_public(MontyContext *, mp_int *base, mp_int *exponent);
 mp_int *monty_invert(MontyContext *, mp_int *);
 mp_int *monty_modsqrt(ModsqrtContext *sc, mp_int *mx, unsigned *success);
 
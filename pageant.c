@@ -37,6 +37,7 @@ typedef struct PageantPrivateKeySort PageantPrivateKeySort;
 typedef struct PageantPublicKeySort PageantPublicKeySort;
 typedef struct PageantPrivateKey PageantPrivateKey;
 typedef struct PageantPublicKey PageantPublicKey;
+typedef struct PageantSignKeys PageantSignKeys;
 typedef struct PageantAsyncOp PageantAsyncOp;
 typedef struct PageantAsyncOpVtable PageantAsyncOpVtable;
 typedef struct PageantClientRequestNode PageantClientRequestNode;
@@ -52,6 +53,7 @@ struct PageantKeyRequestNode {
 struct PageantClientInfo {
     PageantClient *pc; /* goes to NULL when client is unregistered */
     PageantClientRequestNode head;
+    bool synchronous;  /* ops must finish without waiting for callbacks */
 };
 
 struct PageantAsyncOp {
@@ -173,9 +175,32 @@ struct PageantPrivateKey {
     bool decryption_prompt_active;
     PageantKeyRequestNode blocked_requests;
     PageantClientDialogId dlgid;
+    PageantSignKeys *signkeys;     /* copies of skey for the sign worker */
 };
 static tree234 *privkeytree;
 
+/*
+ * Copies of a decrypted SSH-2 key for sign worker jobs to use. A key
+ * can't be used by two threads at once (RSA keeps scratch space in
+ * its Montgomery contexts), so each job has a copy to itself. But
+ * rather than make a fresh one every time, which would have to redo
+ * all of RSA's CRT precomputation, a finished job hands its copy back
+ * here for the next job to reuse. So there are only ever as many
+ * copies as there have been jobs outstanding at once.
+ *
+ * A job can outlive the key, or the key's decrypted form, so this is
+ * reference-counted, with one reference held by the PageantPrivateKey
+ * and one by each job. When the key is freed or re-encrypted, it
+ * drops its reference and sets 'discard', so that copies still out
+ * with jobs are freed when they come back, instead of being kept.
+ */
+struct PageantSignKeys {
+    ssh_key **spare;
+    size_t nspare, sparesize;
+    unsigned refcount;
+    bool discard;
+};
+
 struct PageantPublicKey {
     PageantPublicKeySort sort;
     strbuf *base_pub;            /* the true owner of sort.priv.base_pub */
@@ -191,11 +216,40 @@ struct PageantSignOp {
     unsigned flags;
     int crLine;
     unsigned char failure_type;
+    bool scheduled;
+    PageantSignJob *job;           /* if the sign worker has it */
+    bool job_done;
 
     PageantKeyRequestNode pkr;
+    PageantKeyRequestNode ready;   /* link on signops_ready */
     PageantAsyncOp pao;
 };
 
+/*
+ * Sign operations that are ready to do their actual computation wait
+ * on this queue, and are run one per toplevel callback by
+ * signop_runner. Doing a signature can take a long time (RSA-4096 in
+ * particular), and if a burst of them were all run back to back, any
+ * other request arriving in the meantime - even a trivial one such as
+ * listing keys - would have to wait for the whole lot. This way, at
+ * most one signature is ahead of it.
+ */
+static PageantKeyRequestNode signops_ready =
+    { &signops_ready, &signops_ready };
+static bool signop_runner_queued = false;
+
+/*
+ * If the front end has supplied one, signop_runner passes slow
+ * signatures on to this, so that several can be computed at once
+ * instead of merely taking turns.
+ */
+static PageantSignWorker sign_worker = NULL;
+
+void pageant_set_sign_worker(PageantSignWorker worker)
+{
+    sign_worker = worker;
+}
+
 /* Master lock that indicates whether a GUI request is currently in
  * progress */
 static bool gui_request_in_progress = false;
@@ -207,6 +261,55 @@ static void failure(PageantClient *pc, PageantClientRequestId *reqid,
 static void fail_requests_for_key(PageantPrivateKey *priv, const char *reason);
 static PageantPublicKey *pageant_nth_pubkey(int ssh_version, int i);
 
+static void signkeys_unref(PageantSignKeys *sk)
+{
+    if (--sk->refcount > 0)
+        return;
+    assert(sk->nspare == 0);
+    sfree(sk->spare);
+    sfree(sk);
+}
+
+/* Get a copy of priv->skey that nothing else is using */
+static ssh_key *signkeys_get(PageantPrivateKey *priv, PageantSignKeys **skp)
+{
+    PageantSignKeys *sk = priv->signkeys;
+    if (!sk) {
+        sk = priv->signkeys = snew(PageantSignKeys);
+        sk->spare = NULL;
+        sk->nspare = sk->sparesize = 0;
+        sk->refcount = 1;
+        sk->discard = false;
+    }
+    sk->refcount++;
+    *skp = sk;
+    return sk->nspare ? sk->spare[--sk->nspare] : ssh_key_clone(priv->skey);
+}
+
+static void signkeys_put(PageantSignKeys *sk, ssh_key *key)
+{
+    if (sk->discard) {
+        ssh_key_free(key);
+    } else {
+        sgrowarray(sk->spare, sk->sparesize, sk->nspare);
+        sk->spare[sk->nspare++] = key;
+    }
+    signkeys_unref(sk);
+}
+
+/* Called when priv->skey is about to go away */
+static void signkeys_forget(PageantPrivateKey *priv)
+{
+    PageantSignKeys *sk = priv->signkeys;
+    if (!sk)
+        return;
+    while (sk->nspare > 0)
+        ssh_key_free(sk->spare[--sk->nspare]);
+    sk->discard = true;
+    priv->signkeys = NULL;
+    signkeys_unref(sk);
+}
+
 static void pk_priv_free(PageantPrivateKey *priv)
 {
     if (priv->base_pub)
@@ -216,6 +319,7 @@ static void pk_priv_free(PageantPrivateKey *priv)
         sfree(priv->rkey);
     }
     if (priv->sort.ssh_version == 2 && priv->skey) {
+        signkeys_forget(priv);
         ssh_key_free(priv->skey);
     }
     if (priv->encrypted_key_file)
@@ -578,6 +682,7 @@ void pageant_register_client(PageantClient *pc)
     pc->info = snew(PageantClientInfo);
     pc->info->pc = pc;
     pc->info->head.prev = pc->info->head.next = &pc->info->head;
+    pc->info->synchronous = false;
 }
 
 void pageant_unregister_client(PageantClient *pc)
@@ -645,9 +750,100 @@ static void signop_unlink(PageantSignOp *so)
     }
 }
 
+static void signop_unlink_ready(PageantSignOp *so)
+{
+    if (so->ready.next) {
+        so->ready.next->prev = so->ready.prev;
+        so->ready.prev->next = so->ready.next;
+        so->ready.prev = so->ready.next = NULL;
+    }
+}
+
+static void signop_runner(void *ctx);
+
+static void signop_queue_runner(void)
+{
+    if (!signop_runner_queued && signops_ready.next != &signops_ready) {
+        queue_toplevel_callback(signop_runner, NULL);
+        signop_runner_queued = true;
+    }
+}
+
+static void signop_link_to_ready(PageantSignOp *so)
+{
+    assert(!so->ready.prev);
+    assert(!so->ready.next);
+
+    so->ready.prev = signops_ready.prev;
+    so->ready.next = &signops_ready;
+    so->ready.prev->next = &so->ready;
+    so->ready.next->prev = &so->ready;
+
+    signop_queue_runner();
+}
+
+static void signop_runner(void *ctx)
+{
+    signop_runner_queued = false;
+    if (signops_ready.next == &signops_ready)
+        return;
+
+    PageantSignOp *so = container_of(signops_ready.next,
+                                     PageantSignOp, ready);
+    signop_unlink_ready(so);
+    so->scheduled = true;
+
+    /* Requeue ourself first, behind anything that's arrived since,
+     * because the coroutine may free 'so'. */
+    signop_queue_runner();
+    pageant_async_op_coroutine(&so->pao);
+}
+
+static void signop_job_free(PageantSignJob *job)
+{
+    signkeys_put(job->keys, job->key);
+    strbuf_free(job->data);
+    if (job->signature)
+        strbuf_free(job->signature);
+    sfree(job);
+}
+
+static void signop_job_done(PageantSignJob *job)
+{
+    PageantSignOp *so = (PageantSignOp *)job->ctx;
+    if (!so) {
+        /* The request went away while the worker had it */
+        signop_job_free(job);
+        return;
+    }
+    so->job_done = true;
+    pageant_async_op_coroutine(&so->pao);
+}
+
+/*
+ * Decide whether a signature is worth sending to the sign worker.
+ * That's only RSA: everything else is quick enough not to hold
+ * anything up, and the elliptic-curve code builds shared tables on
+ * the fly, which mustn't happen in two threads at once.
+ */
+static bool signop_use_worker(PageantSignOp *so)
+{
+    if (!sign_worker || so->pao.info->synchronous)
+        return false;
+    const ssh_keyalg *alg = ssh_key_alg(so->priv->skey);
+    if (alg->is_certificate)
+        alg = alg->base_alg;
+    return alg == &ssh_rsa || alg == &ssh_rsa_sha256 ||
+        alg == &ssh_rsa_sha512;
+}
+
 static void signop_free(PageantAsyncOp *pao)
 {
     PageantSignOp *so = container_of(pao, PageantSignOp, pao);
+    signop_unlink(so);
+    signop_unlink_ready(so);
+    if (so->job)
+        so->job->ctx = NULL;       /* signop_job_done will free it */
     strbuf_free(so->data_to_sign);
     sfree(so);
 }
@@ -677,48 +873,102 @@ static void signop_coroutine(PageantAsyncOp *pao)
 
     crBegin(so->crLine);
 
-    while (!so->priv->skey && gui_request_in_progress) {
-        signop_link_to_pending_gui_request(so);
-        crReturnV;
-        signop_unlink(so);
-    }
+    while (true) {
+        while (!so->priv->skey && gui_request_in_progress) {
+            signop_link_to_pending_gui_request(so);
+            crReturnV;
+            signop_unlink(so);
+        }
+
+        if (!so->priv->skey) {
+            assert(so->priv->encrypted_key_file);
 
-    if (!so->priv->skey) {
-        assert(so->priv->encrypted_key_file);
+            if (!request_passphrase(so->pao.info->pc, so->priv)) {
+                response = strbuf_new();
+                failure(so->pao.info->pc, so->pao.reqid, response,
+                        so->failure_type, "on-demand decryption could not "
+                        "prompt for a passphrase");
+                goto respond;
+            }
 
-        if (!request_passphrase(so->pao.info->pc, so->priv)) {
+            signop_link_to_key(so);
+            crReturnV;
+            signop_unlink(so);
+        }
+
+        uint32_t supported_flags = ssh_key_supported_flags(so->priv->skey);
+        if (so->flags & ~supported_flags) {
+            /*
+             * We MUST reject any message containing flags we don't
+             * understand.
+             */
             response = strbuf_new();
             failure(so->pao.info->pc, so->pao.reqid, response,
-                    so->failure_type, "on-demand decryption could not "
-                    "prompt for a passphrase");
+                    so->failure_type, "unsupported flag bits 0x%08"PRIx32,
+                    so->flags & ~supported_flags);
             goto respond;
         }
 
-        signop_link_to_key(so);
-        crReturnV;
-        signop_unlink(so);
-    }
+        char *invalid = ssh_key_invalid(so->priv->skey, so->flags);
+        if (invalid) {
+            response = strbuf_new();
+            failure(so->pao.info->pc, so->pao.reqid, response,
+                    so->failure_type, "key invalid: %s", invalid);
+            sfree(invalid);
+            goto respond;
+        }
+
+        if (so->pao.info->synchronous)
+            break;
 
-    uint32_t supported_flags = ssh_key_supported_flags(so->priv->skey);
-    if (so->flags & ~supported_flags) {
         /*
-         * We MUST reject any message containing flags we don't
-         * understand.
+         * Wait our turn on signops_ready. We stay linked to the key
+         * meanwhile, so that deleting it fails this request as usual;
+         * that also means unblock_requests_for_key might wake us
+         * early, hence the loop on 'scheduled'.
          */
-        response = strbuf_new();
-        failure(so->pao.info->pc, so->pao.reqid, response, so->failure_type,
-                "unsupported flag bits 0x%08"PRIx32,
-                so->flags & ~supported_flags);
-        goto respond;
+        signop_link_to_key(so);
+        signop_link_to_ready(so);
+        while (!so->scheduled)
+            crReturnV;
+        so->scheduled = false;
+        signop_unlink(so);
+
+        /* The key might have been re-encrypted while we waited */
+        if (so->priv->skey)
+            break;
     }
 
-    char *invalid = ssh_key_invalid(so->priv->skey, so->flags);
-    if (invalid) {
-        response = strbuf_new();
-        failure(so->pao.info->pc, so->pao.reqid, response, so->failure_type,
-                "key invalid: %s", invalid);
-        sfree(invalid);
-        goto respond;
+    if (signop_use_worker(so)) {
+        PageantSignJob *job = snew(PageantSignJob);
+        job->key = signkeys_get(so->priv, &job->keys);
+        job->data = strbuf_dup(ptrlen_from_strbuf(so->data_to_sign));
+        job->flags = so->flags;
+        job->signature = strbuf_new();
+        job->done = signop_job_done;
+        job->ctx = so;
+        job->next = NULL;
+
+        if (sign_worker(job)) {
+            /*
+             * Wait for signop_job_done. A callback queued while we
+             * were linked to the key might wake us sooner.
+             */
+            so->job = job;
+            so->job_done = false;
+            while (!so->job_done)
+                crReturnV;
+
+            response = strbuf_new();
+            put_byte(response, SSH2_AGENT_SIGN_RESPONSE);
+            put_stringsb(response, so->job->signature);
+            so->job->signature = NULL;
+            signop_job_free(so->job);
+            so->job = NULL;
+            goto respond;
+        }
+
+        signop_job_free(job);
     }
 
     strbuf *signature = strbuf_new();
@@ -910,6 +1160,7 @@ static bool reencrypt_key(PageantPublicKey *pub)
      * regardless, so that 'please ensure this key isn't stored
      * decrypted' is idempotent. */
     if (priv->skey) {
+        signkeys_forget(priv);
         ssh_key_free(priv->skey);
         priv->skey = NULL;
     }
@@ -1120,6 +1371,10 @@ static PageantAsyncOp *pageant_make_op(
         so->pao.reqid = reqid;
         so->priv = pub_to_priv(pub);
         so->pkr.prev = so->pkr.next = NULL;
+        so->ready.prev = so->ready.next = NULL;
+        so->scheduled = false;
+        so->job = NULL;
+        so->job_done = false;
         so->data_to_sign = strbuf_dup(sigdata);
         so->flags = flags;
         so->failure_type = failure_type;
@@ -2041,6 +2296,7 @@ static unsigned pageant_client_op_query(PageantClientOp *pco)
         pic.response = pco->buf;
         pic.got_response = false;
         pageant_register_client(&pic.pc);
+        pic.pc.info->synchronous = true;
 
         assert(pco->buf->len > 4);
         PageantAsyncOp *pao = pageant_make_op(
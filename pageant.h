@@ -134,6 +134,41 @@ void pageant_reencrypt_all(void);
  */
 void keylist_update(void);
 
+/*
+ * Optional background signing. A front end able to run code on other
+ * threads can call pageant_set_sign_worker to give the core a
+ * function that accepts a PageantSignJob and computes the signature
+ * somewhere other than the main thread. When it's done, it must call
+ * the job's 'done' method back on the main thread (e.g. from the
+ * event loop). If the worker function can't take the job after all,
+ * it returns false, and the core signs in the ordinary way.
+ *
+ * The core only hands over signatures slow enough to be worth it, and
+ * gives each job its own copy of the key and data, so that the worker
+ * never touches any of Pageant's own data structures. (The copy of
+ * the key is only the job's own while it runs: the core reuses it for
+ * a later job, so that whatever the key has precomputed is kept.)
+ * Each client still receives its responses in the order of its
+ * requests.
+ */
+typedef struct PageantSignJob PageantSignJob;
+struct PageantSignJob {
+    /* Inputs, which the worker must not modify */
+    ssh_key *key;
+    strbuf *data;
+    unsigned flags;
+
+    /* Output: the worker writes the signature here */
+    strbuf *signature;
+
+    void (*done)(PageantSignJob *job);
+    void *ctx;                         /* for the core's use */
+    struct PageantSignKeys *keys;      /* for the core's use */
+    PageantSignJob *next;              /* for the worker's use */
+};
+typedef bool (*PageantSignWorker)(PageantSignJob *job);
+void pageant_set_sign_worker(PageantSignWorker worker);
+
 /*
  * Functions to establish a listening socket speaking the SSH agent
  * protocol. Call pageant_listener_new() to set up a state; then
@@ -33,6 +33,7 @@ static bool targetshouldbedirectory = false;
 static bool statistics = true;
 static int prev_stats_len = 0;
 static bool scp_unsafe_mode = false;
+static bool compress_files = false;
 static int errs = 0;
 static bool try_scp = true;
 static bool try_sftp = true;
@@ -802,6 +803,8 @@ int scp_send_filename(const char *name, uint64_t size, int permissions)
             errs++;
             return 1;
         }
+        if (compress_files)
+            fxp_try_compression(scp_sftp_filehandle, fullname);
         scp_sftp_fileoffset = 0;
         scp_sftp_xfer = xfer_upload_init(scp_sftp_filehandle,
                                          scp_sftp_fileoffset);
@@ -1470,6 +1473,8 @@ int scp_accept_filexfer(void)
             errs++;
             return 1;
         }
+        if (compress_files)
+            fxp_try_compression(scp_sftp_filehandle, scp_sftp_currentname);
         scp_sftp_fileoffset = 0;
         scp_sftp_xfer = xfer_download_init(scp_sftp_filehandle,
                                            scp_sftp_fileoffset);
@@ -1488,35 +1493,43 @@ int scp_recv_filedata(char *data, int len)
         int ret, actuallen;
         void *vbuf;
 
-        xfer_download_queue(scp_sftp_xfer);
-        pktin = sftp_recv();
-        ret = xfer_download_gotpkt(scp_sftp_xfer, pktin);
-        if (ret <= 0) {
-            tell_user(stderr, "pscp: error while reading: %s", fxp_error());
-            if (ret == INT_MIN)        /* pktin not even freed */
-                sfree(pktin);
-            errs++;
-            return -1;
-        }
-
-        if (xfer_download_data(scp_sftp_xfer, &vbuf, &actuallen)) {
-            if (actuallen <= 0) {
-                tell_user(stderr, "pscp: end of file while reading");
+        /*
+         * The server may answer our outstanding reads in any order,
+         * so keep receiving until the one at the head of the queue
+         * has come back; returning 0 would look like a lost
+         * connection to our caller.
+         */
+        while (!xfer_download_data(scp_sftp_xfer, &vbuf, &actuallen)) {
+            if (xfer_done(scp_sftp_xfer))
+                return 0;
+            xfer_download_queue(scp_sftp_xfer);
+            pktin = sftp_recv();
+            ret = xfer_download_gotpkt(scp_sftp_xfer, pktin);
+            if (ret <= 0) {
+                tell_user(stderr, "pscp: error while reading: %s",
+                          fxp_error());
+                if (ret == INT_MIN)        /* pktin not even freed */
+                    sfree(pktin);
                 errs++;
-                sfree(vbuf);
                 return -1;
             }
-            /*
-             * This assertion relies on the fact that the natural
-             * block size used in the xfer manager is at most that
-             * used in this module. I don't like crossing layers in
-             * this way, but it'll do for now.
-             */
-            assert(actuallen <= len);
-            memcpy(data, vbuf, actuallen);
+        }
+
+        if (actuallen <= 0) {
+            tell_user(stderr, "pscp: end of file while reading");
+            errs++;
             sfree(vbuf);
-        } else
-            actuallen = 0;
+            return -1;
+        }
+        /*
+         * This assertion relies on the fact that the natural
+         * block size used in the xfer manager is at most that
+         * used in this module. I don't like crossing layers in
+         * this way, but it'll do for now.
+         */
+        assert(actuallen <= len);
+        memcpy(data, vbuf, actuallen);
+        sfree(vbuf);
 
         scp_sftp_fileoffset += actuallen;
 
@@ -1665,10 +1678,11 @@ static void source(const char *src)
     stat_starttime = time(NULL);
     stat_lasttime = 0;
 
-#define PSCP_SEND_BLOCK 4096
-    for (i = 0; i < size; i += PSCP_SEND_BLOCK) {
-        char transbuf[PSCP_SEND_BLOCK];
-        int j, k = PSCP_SEND_BLOCK;
+    /* In SFTP mode, send in the largest chunks the server will take */
+    int sendblock = using_sftp ? fxp_write_blocksize() : 4096;
+    char *transbuf = snewn(sendblock, char);
+    for (i = 0; i < size; i += sendblock) {
+        int j, k = sendblock;
 
         if (i + k > size)
             k = size - i;
@@ -1688,6 +1702,7 @@ static void source(const char *src)
         }
 
     }
+    sfree(transbuf);
     close_rfile(f);
 
     (void) scp_send_finish();
@@ -1908,12 +1923,15 @@ static void sink(const char *targ, const char *src)
         stat_name = stripctrl_string(
             string_scc, stripslashes(destfname, true));
 
+        /* In SFTP mode, this must be at least the size of the reads
+         * done by the xfer system (see scp_recv_filedata) */
+        int transbufsize = fxp_read_blocksize();
+        char *transbuf = snewn(transbufsize, char);
         received = 0;
         while (received < act.size) {
-            char transbuf[32768];
             uint64_t blksize;
             int read;
-            blksize = 32768;
+            blksize = transbufsize;
             if (blksize > act.size - received)
                 blksize = act.size - received;
             read = scp_recv_filedata(transbuf, (int)blksize);
@@ -1944,6 +1962,7 @@ static void sink(const char *targ, const char *src)
             }
             received += read;
         }
+        sfree(transbuf);
         if (act.settime) {
             set_file_times(f, act.mtime, act.atime);
         }
@@ -2201,6 +2220,7 @@ static void usage(void)
     printf("            force use of particular SSH protocol variant\n");
     printf("  -4 -6     force use of IPv4 or IPv6\n");
     printf("  -C        enable compression\n");
+    printf("  -Z        compress file data where worthwhile (SFTP only)\n");
     printf("  -i key    private key file for user authentication\n");
     printf("  -noagent  disable use of Pageant\n");
     printf("  -agent    enable use of Pageant\n");
@@ -2300,6 +2320,8 @@ int psftp_main(int argc, char *argv[])
             list = true;
         } else if (strcmp(argv[i], "-unsafe") == 0) {
             scp_unsafe_mode = true;
+        } else if (strcmp(argv[i], "-Z") == 0) {
+            compress_files = true;
         } else if (strcmp(argv[i], "-sftp") == 0) {
             try_scp = false; try_sftp = true;
         } else if (strcmp(argv[i], "-scp") == 0) {
@@ -34,6 +34,7 @@ static LogContext *psftp_logctx = NULL;
 static Backend *backend;
 static Conf *conf;
 static bool sent_eof = false;
+static bool compress_files = false;
 
 /* ------------------------------------------------------------
  * Seat vtable.
@@ -234,7 +235,412 @@ static void not_connected(void)
 /* ----------------------------------------------------------------------
  * The meat of the `get' and `put' commands.
  */
-bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
+
+/*
+ * Run a download to completion, writing the data to the local file
+ * at its current position.
+ */
+static bool sftp_download_xfer(struct fxp_xfer *xfer, WFile *file)
+{
+    struct sftp_packet *pktin;
+    bool toret = true, shown_err = false;
+
+    while (!xfer_done(xfer)) {
+        void *vbuf;
+        int retd, len;
+        int wpos, wlen;
+
+        xfer_download_queue(xfer);
+        pktin = sftp_recv();
+        retd = xfer_download_gotpkt(xfer, pktin);
+        if (retd <= 0) {
+            if (!shown_err) {
+                printf("error while reading: %s\n", fxp_error());
+                shown_err = true;
+            }
+            if (retd == INT_MIN)        /* pktin not even freed */
+                sfree(pktin);
+            toret = false;
+        }
+
+        while (xfer_download_data(xfer, &vbuf, &len)) {
+            unsigned char *buf = (unsigned char *)vbuf;
+
+            wpos = 0;
+            while (wpos < len) {
+                wlen = write_to_file(file, buf + wpos, len - wpos);
+                if (wlen <= 0) {
+                    printf("error while writing local file\n");
+                    toret = false;
+                    xfer_set_error(xfer);
+                    break;
+                }
+                wpos += wlen;
+            }
+            if (wpos < len) {          /* we had an error */
+                toret = false;
+                xfer_set_error(xfer);
+            }
+
+            sfree(vbuf);
+        }
+    }
+
+    return toret;
+}
+
+/*
+ * Run an upload to completion, sending at most 'length' bytes of the
+ * local file starting from its current position.
+ */
+static bool sftp_upload_xfer(struct fxp_xfer *xfer, RFile *file,
+                             uint64_t length)
+{
+    struct sftp_packet *pktin;
+    bool err = false, eof = false;
+    int blocksize = fxp_write_blocksize();
+    char *buffer = snewn(blocksize, char);
+
+    while ((!err && !eof) || !xfer_done(xfer)) {
+        int len, ret;
+
+        while (xfer_upload_ready(xfer) && !err && !eof) {
+            int want = (length < blocksize ? length : blocksize);
+            len = (want > 0 ? read_from_file(file, buffer, want) : 0);
+            if (len == -1) {
+                printf("error while reading local file\n");
+                err = true;
+            } else if (len == 0) {
+                eof = true;
+            } else {
+                xfer_upload_data(xfer, buffer, len);
+                length -= len;
+            }
+        }
+
+        if (toplevel_callback_pending() && !err && !eof) {
+            /* If we have pending callbacks, they might make
+             * xfer_upload_ready start to return true. So we should
+             * run them and then re-check xfer_upload_ready, before
+             * we go as far as waiting for an entire packet to
+             * arrive. */
+            run_toplevel_callbacks();
+            continue;
+        }
+
+        if (!xfer_done(xfer)) {
+            pktin = sftp_recv();
+            ret = xfer_upload_gotpkt(xfer, pktin);
+            if (ret <= 0) {
+                if (ret == INT_MIN)        /* pktin not even freed */
+                    sfree(pktin);
+                if (!err) {
+                    printf("error while writing: %s\n", fxp_error());
+                    err = true;
+                }
+            }
+        }
+    }
+
+    sfree(buffer);
+    return !err;
+}
+
+/*
+ * Delta transfers, for bringing an existing copy of a file up to
+ * date. The server hashes its copy a block at a time (using the
+ * check-file extension), we hash the local copy the same way, and
+ * then only the blocks whose hashes differ are transferred.
+ *
+ * Blocks are compared at the same offset in both files, which suits
+ * files that get modified in place or appended to (disk images,
+ * database files, logs), but won't find anything to reuse after a
+ * point where data has been inserted or deleted, as it typically is
+ * throughout a text dump of a database. Finding moved blocks would
+ * need a rolling checksum of the file with the new data, in the
+ * manner of rsync; for a download that's the server's copy, and
+ * check-file only offers ordinary hashes of fixed blocks.
+ */
+#define DELTA_BLOCKSIZE 65536
+#define DELTA_BLOCKS_PER_REQUEST 1024
+#define DELTA_HASHES "sha256,sha1,md5"
+
+struct delta_run {
+    uint64_t offset, length;
+};
+
+struct delta_runs {
+    struct delta_run *runs;
+    size_t nruns, size;
+    uint64_t total;
+};
+
+static const ssh_hashalg *delta_hashalg(const char *name)
+{
+    if (!strcmp(name, "sha256"))
+        return &ssh_sha256;
+    if (!strcmp(name, "sha1"))
+        return &ssh_sha1;
+    if (!strcmp(name, "md5"))
+        return &ssh_md5;
+    return NULL;
+}
+
+static void delta_add_run(struct delta_runs *dr,
+                          uint64_t offset, uint64_t length)
+{
+    dr->total += length;
+    if (dr->nruns && dr->runs[dr->nruns-1].offset +
+        dr->runs[dr->nruns-1].length == offset) {
+        dr->runs[dr->nruns-1].length += length;
+        return;
+    }
+    sgrowarray(dr->runs, dr->size, dr->nruns);
+    dr->runs[dr->nruns].offset = offset;
+    dr->runs[dr->nruns].length = length;
+    dr->nruns++;
+}
+
+/*
+ * Compare the first 'length' bytes of a remote file with the local
+ * file, which is read from its start, and list the ranges that
+ * differ. Returns false (having printed an error) if the comparison
+ * couldn't be done.
+ */
+static bool sftp_delta_compare(struct fxp_handle *fh, RFile *file,
+                               uint64_t length, struct delta_runs *dr)
+{
+    struct sftp_packet *pktin;
+    struct sftp_request *req;
+    strbuf *hashes = strbuf_new();
+    char *buf = snewn(DELTA_BLOCKSIZE, char);
+    unsigned char digest[MAX_HASH_LEN];
+    uint64_t pos = 0;
+    bool toret = true;
+
+    while (toret && pos < length) {
+        uint64_t rangelen = length - pos;
+        if (rangelen > (uint64_t)DELTA_BLOCKSIZE * DELTA_BLOCKS_PER_REQUEST)
+            rangelen = (uint64_t)DELTA_BLOCKSIZE * DELTA_BLOCKS_PER_REQUEST;
+        size_t nblocks = (rangelen + DELTA_BLOCKSIZE - 1) / DELTA_BLOCKSIZE;
+
+        strbuf_clear(hashes);
+        req = fxp_check_file_send(fh, DELTA_HASHES, pos, rangelen,
+                                  DELTA_BLOCKSIZE);
+        pktin = sftp_wait_for_reply(req);
+        char *algname = fxp_check_file_recv(pktin, req, hashes);
+        if (!algname) {
+            printf("check-file: %s\n", fxp_error());
+            toret = false;
+            break;
+        }
+        const ssh_hashalg *alg = delta_hashalg(algname);
+        sfree(algname);
+        if (!alg || hashes->len != nblocks * alg->hlen) {
+            printf("check-file: unexpected reply from server\n");
+            toret = false;
+            break;
+        }
+
+        for (size_t i = 0; i < nblocks; i++) {
+            uint64_t offset = pos + (uint64_t)i * DELTA_BLOCKSIZE;
+            int blocklen = (rangelen - (offset - pos) < DELTA_BLOCKSIZE ?
+                            rangelen - (offset - pos) : DELTA_BLOCKSIZE);
+            int got = 0, ret;
+
+            while (got < blocklen &&
+                   (ret = read_from_file(file, buf + got,
+                                         blocklen - got)) > 0)
+                got += ret;
+            if (got < blocklen) {
+                printf("error while reading local file\n");
+                toret = false;
+                break;
+            }
+
+            hash_simple(alg, make_ptrlen(buf, blocklen), digest);
+            if (memcmp(digest, hashes->u + i * alg->hlen, alg->hlen))
+                delta_add_run(dr, offset, blocklen);
+        }
+
+        pos += rangelen;
+    }
+
+    smemclr(buf, DELTA_BLOCKSIZE);
+    sfree(buf);
+    strbuf_free(hashes);
+    return toret;
+}
+
+/*
+ * Update an existing local file to match a remote one. Returns 1 or 0
+ * for success or failure, or -1 if a delta download isn't possible
+ * and the caller should just fetch the whole file.
+ */
+static int sftp_get_file_delta(struct fxp_handle *fh, char *fname,
+                               char *outfname, const struct fxp_attrs *attrs)
+{
+    RFile *rfile;
+    WFile *wfile;
+    uint64_t localsize, remotesize, common;
+    struct delta_runs dr[1];
+    bool toret = true;
+
+    if (file_type(outfname) != FILE_TYPE_FILE ||
+        !(attrs->flags & SSH_FILEXFER_ATTR_SIZE))
+        return -1;
+    if (!fxp_has_extension(SFTP_EXT_CHECK_FILE)) {
+        printf("server does not support check-file; "
+               "fetching whole file\n");
+        return -1;
+    }
+
+    rfile = open_existing_file(outfname, &localsize, NULL, NULL, NULL);
+    if (!rfile)
+        return -1;
+
+    remotesize = attrs->size;
+    common = (localsize < remotesize ? localsize : remotesize);
+    memset(dr, 0, sizeof(dr));
+    if (!sftp_delta_compare(fh, rfile, common, dr)) {
+        close_rfile(rfile);
+        sfree(dr->runs);
+        return -1;
+    }
+    close_rfile(rfile);
+    if (remotesize > localsize)
+        delta_add_run(dr, localsize, remotesize - localsize);
+
+    wfile = open_update_wfile(outfname);
+    if (!wfile) {
+        with_stripctrl(san, outfname)
+            printf("local: unable to open %s\n", san);
+        sfree(dr->runs);
+        return 0;
+    }
+
+    with_stripctrl(san, fname) {
+        with_stripctrl(sano, outfname)
+            printf("remote:%s => local:%s (delta: %"PRIu64" of %"PRIu64
+                   " bytes)\n", san, sano, dr->total, remotesize);
+    }
+
+    for (size_t i = 0; i < dr->nruns && toret; i++) {
+        struct fxp_xfer *xfer;
+
+        if (seek_file(wfile, dr->runs[i].offset, FROM_START) != 0) {
+            printf("error while seeking in local file\n");
+            toret = false;
+            break;
+        }
+        xfer = xfer_download_range_init(fh, dr->runs[i].offset,
+                                        dr->runs[i].length);
+        toret = sftp_download_xfer(xfer, wfile);
+        xfer_cleanup(xfer);
+    }
+
+    if (toret && localsize > remotesize &&
+        set_file_size(wfile, remotesize) != 0) {
+        printf("error while truncating local file\n");
+        toret = false;
+    }
+
+    close_wfile(wfile);
+    sfree(dr->runs);
+    return toret;
+}
+
+/*
+ * Update an existing remote file to match a local one. Returns as for
+ * sftp_get_file_delta. On -1, the local file has been rewound.
+ */
+static int sftp_put_file_delta(RFile *file, char *fname, char *outfname,
+                               uint64_t localsize)
+{
+    struct fxp_handle *fh;
+    struct sftp_packet *pktin;
+    struct sftp_request *req;
+    struct fxp_attrs attrs;
+    uint64_t remotesize, common;
+    struct delta_runs dr[1];
+    bool compared = false, toret = true;
+
+    if (!fxp_has_extension(SFTP_EXT_CHECK_FILE)) {
+        printf("server does not support check-file; "
+               "sending whole file\n");
+        return -1;
+    }
+
+    /* If there's no remote file to update, do an ordinary upload */
+    req = fxp_open_send(outfname, SSH_FXF_READ | SSH_FXF_WRITE, NULL);
+    pktin = sftp_wait_for_reply(req);
+    fh = fxp_open_recv(pktin, req);
+    if (!fh)
+        return -1;
+    if (compress_files)
+        fxp_try_compression(fh, outfname);
+
+    memset(dr, 0, sizeof(dr));
+    remotesize = 0;
+    req = fxp_fstat_send(fh);
+    pktin = sftp_wait_for_reply(req);
+    if (fxp_fstat_recv(pktin, req, &attrs) &&
+        (attrs.flags & SSH_FILEXFER_ATTR_SIZE)) {
+        remotesize = attrs.size;
+        common = (localsize < remotesize ? localsize : remotesize);
+        compared = sftp_delta_compare(fh, file, common, dr);
+    }
+    if (!compared) {
+        seek_file((WFile *)file, 0, FROM_START);
+        sfree(dr->runs);
+        req = fxp_close_send(fh);
+        pktin = sftp_wait_for_reply(req);
+        fxp_close_recv(pktin, req);
+        return -1;
+    }
+    if (localsize > remotesize)
+        delta_add_run(dr, remotesize, localsize - remotesize);
+
+    printf("local:%s => remote:%s (delta: %"PRIu64" of %"PRIu64" bytes)\n",
+           fname, outfname, dr->total, localsize);
+
+    for (size_t i = 0; i < dr->nruns && toret; i++) {
+        struct fxp_xfer *xfer;
+
+        if (seek_file((WFile *)file, dr->runs[i].offset, FROM_START) != 0) {
+            printf("error while seeking in local file\n");
+            toret = false;
+            break;
+        }
+        xfer = xfer_upload_init(fh, dr->runs[i].offset);
+        toret = sftp_upload_xfer(xfer, file, dr->runs[i].length);
+        xfer_cleanup(xfer);
+    }
+
+    if (toret && remotesize > localsize) {
+        attrs.flags = SSH_FILEXFER_ATTR_SIZE;
+        attrs.size = localsize;
+        req = fxp_fsetstat_send(fh, attrs);
+        pktin = sftp_wait_for_reply(req);
+        if (!fxp_fsetstat_recv(pktin, req)) {
+            printf("error while truncating: %s\n", fxp_error());
+            toret = false;
+        }
+    }
+    sfree(dr->runs);
+
+    req = fxp_close_send(fh);
+    pktin = sftp_wait_for_reply(req);
+    if (!fxp_close_recv(pktin, req) && toret) {
+        printf("error while closing: %s\n", fxp_error());
+        toret = false;
+    }
+
+    return toret;
+}
+
+bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart,
+                   bool delta)
 {
     struct fxp_handle *fh;
     struct sftp_packet *pktin;
@@ -242,7 +648,7 @@ bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
     struct fxp_xfer *xfer;
     uint64_t offset;
     WFile *file;
-    bool toret, shown_err = false;
+    bool toret;
     struct fxp_attrs attrs;
 
     /*
@@ -387,7 +793,7 @@ bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
                 nextfname = dupcat(fname, "/", ournames[i]->filename);
                 nextoutfname = dir_file_cat(outfname, ournames[i]->filename);
                 retd = sftp_get_file(
-                    nextfname, nextoutfname, recurse, restart);
+                    nextfname, nextoutfname, recurse, restart, delta);
                 restart = false;       /* after first partial file, do full */
                 sfree(nextoutfname);
                 sfree(nextfname);
@@ -427,6 +833,21 @@ bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
         return false;
     }
 
+    if (compress_files)
+        fxp_try_compression(fh, fname);
+
+    if (delta) {
+        int retd = sftp_get_file_delta(fh, fname, outfname, &attrs);
+        if (retd >= 0) {
+            req = fxp_close_send(fh);
+            pktin = sftp_wait_for_reply(req);
+            fxp_close_recv(pktin, req);
+
+            return retd;
+        }
+        /* otherwise, fall back to fetching the whole file */
+    }
+
     if (restart) {
         file = open_existing_wfile(outfname, NULL);
     } else {
@@ -471,49 +892,8 @@ bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
      * FIXME: we can use FXP_FSTAT here to get the file size, and
      * thus put up a progress bar.
      */
-    toret = true;
     xfer = xfer_download_init(fh, offset);
-    while (!xfer_done(xfer)) {
-        void *vbuf;
-        int retd, len;
-        int wpos, wlen;
-
-        xfer_download_queue(xfer);
-        pktin = sftp_recv();
-        retd = xfer_download_gotpkt(xfer, pktin);
-        if (retd <= 0) {
-            if (!shown_err) {
-                printf("error while reading: %s\n", fxp_error());
-                shown_err = true;
-            }
-            if (retd == INT_MIN)        /* pktin not even freed */
-                sfree(pktin);
-            toret = false;
-        }
-
-        while (xfer_download_data(xfer, &vbuf, &len)) {
-            unsigned char *buf = (unsigned char *)vbuf;
-
-            wpos = 0;
-            while (wpos < len) {
-                wlen = write_to_file(file, buf + wpos, len - wpos);
-                if (wlen <= 0) {
-                    printf("error while writing local file\n");
-                    toret = false;
-                    xfer_set_error(xfer);
-                    break;
-                }
-                wpos += wlen;
-            }
-            if (wpos < len) {          /* we had an error */
-                toret = false;
-                xfer_set_error(xfer);
-            }
-
-            sfree(vbuf);
-        }
-    }
-
+    toret = sftp_download_xfer(xfer, file);
     xfer_cleanup(xfer);
 
     close_wfile(file);
@@ -525,15 +905,16 @@ bool sftp_get_file(char *fname, char *outfname, bool recurse, bool restart)
     return toret;
 }
 
-bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart)
+bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart,
+                   bool delta)
 {
     struct fxp_handle *fh;
     struct fxp_xfer *xfer;
     struct sftp_packet *pktin;
     struct sftp_request *req;
-    uint64_t offset;
+    uint64_t offset, size;
     RFile *file;
-    bool err = false, eof;
+    bool err = false;
     struct fxp_attrs attrs;
     long permissions;
 
@@ -634,7 +1015,8 @@ bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart)
 
             nextfname = dir_file_cat(fname, ournames[i]);
             nextoutfname = dupcat(outfname, "/", ournames[i]);
-            retd = sftp_put_file(nextfname, nextoutfname, recurse, restart);
+            retd = sftp_put_file(nextfname, nextoutfname, recurse, restart,
+                                 delta);
             restart = false;           /* after first partial file, do full */
             sfree(nextoutfname);
             sfree(nextfname);
@@ -658,11 +1040,20 @@ bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart)
         return true;
     }
 
-    file = open_existing_file(fname, NULL, NULL, NULL, &permissions);
+    file = open_existing_file(fname, &size, NULL, NULL, &permissions);
     if (!file) {
         printf("local: unable to open %s\n", fname);
         return false;
     }
+
+    if (delta) {
+        int retd = sftp_put_file_delta(file, fname, outfname, size);
+        if (retd >= 0) {
+            close_rfile(file);
+            return retd;
+        }
+        /* otherwise, fall back to sending the whole file */
+    }
     attrs.flags = 0;
     PUT_PERMISSIONS(attrs, permissions);
     if (restart) {
@@ -680,6 +1071,8 @@ bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart)
         printf("%s: open for write: %s\n", outfname, fxp_error());
         return false;
     }
+    if (compress_files)
+        fxp_try_compression(fh, outfname);
 
     if (restart) {
         struct fxp_attrs attrs;
@@ -715,47 +1108,7 @@ bool sftp_put_file(char *fname, char *outfname, bool recurse, bool restart)
      * thus put up a progress bar.
      */
     xfer = xfer_upload_init(fh, offset);
-    eof = false;
-    while ((!err && !eof) || !xfer_done(xfer)) {
-        char buffer[4096];
-        int len, ret;
-
-        while (xfer_upload_ready(xfer) && !err && !eof) {
-            len = read_from_file(file, buffer, sizeof(buffer));
-            if (len == -1) {
-                printf("error while reading local file\n");
-                err = true;
-            } else if (len == 0) {
-                eof = true;
-            } else {
-                xfer_upload_data(xfer, buffer, len);
-            }
-        }
-
-        if (toplevel_callback_pending() && !err && !eof) {
-            /* If we have pending callbacks, they might make
-             * xfer_upload_ready start to return true. So we should
-             * run them and then re-check xfer_upload_ready, before
-             * we go as far as waiting for an entire packet to
-             * arrive. */
-            run_toplevel_callbacks();
-            continue;
-        }
-
-        if (!xfer_done(xfer)) {
-            pktin = sftp_recv();
-            ret = xfer_upload_gotpkt(xfer, pktin);
-            if (ret <= 0) {
-                if (ret == INT_MIN)        /* pktin not even freed */
-                    sfree(pktin);
-                if (!err) {
-                    printf("error while writing: %s\n", fxp_error());
-                    err = true;
-                }
-            }
-        }
-    }
-
+    err = !sftp_upload_xfer(xfer, file, UINT64_MAX);
     xfer_cleanup(xfer);
 
   cleanup:
@@ -1218,7 +1571,7 @@ int sftp_general_get(struct sftp_command *cmd, bool restart, bool multiple)
 {
     char *fname, *unwcfname, *origfname, *origwfname, *outfname;
     int i, toret;
-    bool recurse = false;
+    bool recurse = false, delta = false;
 
     if (!backend) {
         not_connected();
@@ -1233,6 +1586,8 @@ int sftp_general_get(struct sftp_command *cmd, bool restart, bool multiple)
             break;
         } else if (!strcmp(cmd->words[i], "-r")) {
             recurse = true;
+        } else if (!strcmp(cmd->words[i], "-d") && !restart) {
+            delta = true;
         } else {
             printf("%s: unrecognised option '%s'\n", cmd->words[0], cmd->words[i]);
             return 0;
@@ -1279,7 +1634,7 @@ int sftp_general_get(struct sftp_command *cmd, bool restart, bool multiple)
             else
                 outfname = stripslashes(origwfname, false);
 
-            toret = sftp_get_file(fname, outfname, recurse, restart);
+            toret = sftp_get_file(fname, outfname, recurse, restart, delta);
 
             sfree(fname);
 
@@ -1327,7 +1682,7 @@ int sftp_general_put(struct sftp_command *cmd, bool restart, bool multiple)
     char *fname, *wfname, *origoutfname, *outfname;
     int i;
     int toret;
-    bool recurse = false;
+    bool recurse = false, delta = false;
 
     if (!backend) {
         not_connected();
@@ -1342,6 +1697,8 @@ int sftp_general_put(struct sftp_command *cmd, bool restart, bool multiple)
             break;
         } else if (!strcmp(cmd->words[i], "-r")) {
             recurse = true;
+        } else if (!strcmp(cmd->words[i], "-d") && !restart) {
+            delta = true;
         } else {
             printf("%s: unrecognised option '%s'\n", cmd->words[0], cmd->words[i]);
             return 0;
@@ -1380,7 +1737,7 @@ int sftp_general_put(struct sftp_command *cmd, bool restart, bool multiple)
                 origoutfname = stripslashes(wfname, true);
 
             outfname = canonify(origoutfname);
-            toret = sftp_put_file(wfname, outfname, recurse, restart);
+            toret = sftp_put_file(wfname, outfname, recurse, restart, delta);
             sfree(outfname);
 
             if (wcm) {
@@ -1645,6 +2002,160 @@ int sftp_cmd_mv(struct sftp_command *cmd)
     return ret;
 }
 
+/*
+ * Copy files on the server, using the copy-data extension so that the
+ * data never has to come across the network to us.
+ */
+static bool sftp_action_cp(void *vctx, char *srcfname)
+{
+    struct sftp_context_mv *ctx = (struct sftp_context_mv *)vctx;
+    struct sftp_packet *pktin;
+    struct sftp_request *req;
+    struct fxp_handle *srcfh, *dstfh;
+    struct fxp_attrs attrs;
+    char *finalfname, *newcanon = NULL;
+    uint64_t srcsize;
+    bool result;
+
+    if (ctx->dest_is_dir) {
+        char *p;
+        char *newname;
+
+        p = srcfname + strlen(srcfname);
+        while (p > srcfname && p[-1] != '/') p--;
+        newname = dupcat(ctx->dstfname, "/", p);
+        newcanon = canonify(newname);
+        sfree(newname);
+
+        finalfname = newcanon;
+    } else {
+        finalfname = ctx->dstfname;
+    }
+
+    if (!strcmp(srcfname, finalfname)) {
+        printf("cp %s: source and destination are the same file\n",
+               srcfname);
+        sfree(newcanon);
+        return false;
+    }
+
+    req = fxp_open_send(srcfname, SSH_FXF_READ, NULL);
+    pktin = sftp_wait_for_reply(req);
+    srcfh = fxp_open_recv(pktin, req);
+    if (!srcfh) {
+        printf("%s: open for read: %s\n", srcfname, fxp_error());
+        sfree(newcanon);
+        return false;
+    }
+
+    req = fxp_fstat_send(srcfh);
+    pktin = sftp_wait_for_reply(req);
+    if (!fxp_fstat_recv(pktin, req, &attrs) ||
+        !(attrs.flags & SSH_FILEXFER_ATTR_SIZE)) {
+        printf("%s: unable to find file size\n", srcfname);
+        req = fxp_close_send(srcfh);
+        pktin = sftp_wait_for_reply(req);
+        fxp_close_recv(pktin, req);
+        sfree(newcanon);
+        return false;
+    }
+    srcsize = attrs.size;
+
+    /*
+     * Give the copy the same permissions as the original. Don't
+     * truncate it on opening: if the destination turns out to be the
+     * source under another name, truncating it would destroy the
+     * data before the server could notice. Instead, the server
+     * refuses to copy a file over itself, and we set the size of the
+     * destination once the copy has succeeded.
+     */
+    attrs.flags &= SSH_FILEXFER_ATTR_PERMISSIONS;
+    req = fxp_open_send(finalfname, SSH_FXF_WRITE | SSH_FXF_CREAT, &attrs);
+    pktin = sftp_wait_for_reply(req);
+    dstfh = fxp_open_recv(pktin, req);
+    if (!dstfh) {
+        with_stripctrl(san, finalfname)
+            printf("%s: open for write: %s\n", san, fxp_error());
+        result = false;
+    } else {
+        req = fxp_copy_data_send(srcfh, 0, srcsize, dstfh, 0);
+        pktin = sftp_wait_for_reply(req);
+        result = fxp_copy_data_recv(pktin, req);
+
+        if (result) {
+            attrs.flags = SSH_FILEXFER_ATTR_SIZE;
+            attrs.size = srcsize;
+            req = fxp_fsetstat_send(dstfh, attrs);
+            pktin = sftp_wait_for_reply(req);
+            result = fxp_fsetstat_recv(pktin, req);
+        }
+
+        with_stripctrl(san, finalfname) {
+            if (result)
+                printf("%s -> %s\n", srcfname, san);
+            else
+                printf("cp %s %s: %s\n", srcfname, san, fxp_error());
+        }
+
+        req = fxp_close_send(dstfh);
+        pktin = sftp_wait_for_reply(req);
+        if (!fxp_close_recv(pktin, req) && result) {
+            with_stripctrl(san, finalfname)
+                printf("%s: close: %s\n", san, fxp_error());
+            result = false;
+        }
+    }
+
+    req = fxp_close_send(srcfh);
+    pktin = sftp_wait_for_reply(req);
+    fxp_close_recv(pktin, req);
+
+    sfree(newcanon);
+    return result;
+}
+
+int sftp_cmd_cp(struct sftp_command *cmd)
+{
+    struct sftp_context_mv ctx[1];
+    int i, ret;
+
+    if (!backend) {
+        not_connected();
+        return 0;
+    }
+
+    if (cmd->nwords < 3) {
+        printf("cp: expects two filenames\n");
+        return 0;
+    }
+
+    if (!fxp_has_extension(SFTP_EXT_COPY_DATA)) {
+        printf("cp: server does not support copying files remotely\n");
+        return 0;
+    }
+
+    ctx->dstfname = canonify(cmd->words[cmd->nwords-1]);
+
+    /*
+     * As with mv, several sources or a wildcard mean the destination
+     * has to be a directory.
+     */
+    ctx->dest_is_dir = check_is_dir(ctx->dstfname);
+    if ((cmd->nwords > 3 || is_wildcard(cmd->words[1])) && !ctx->dest_is_dir) {
+        printf("cp: multiple or wildcard arguments require the destination"
+               " to be a directory\n");
+        sfree(ctx->dstfname);
+        return 0;
+    }
+
+    ret = 1;
+    for (i = 1; i < cmd->nwords-1; i++)
+        ret &= wildcard_iterate(cmd->words[i], sftp_action_cp, ctx);
+
+    sfree(ctx->dstfname);
+    return ret;
+}
+
 struct sftp_context_chmod {
     unsigned attrs_clr, attrs_xor;
 };
@@ -1974,6 +2485,17 @@ static struct sftp_cmd_lookup {
             "  session, to the same server or to a different one.\n",
             sftp_cmd_close
     },
+    {
+        "cp", true, "copy file(s) on the remote server",
+            " <source> [ <source>... ] <destination>\n"
+            "  Copies <source>(s) on the server to <destination>, also on the\n"
+            "  server, without transferring the data to and from this machine.\n"
+            "  If <destination> specifies an existing directory, then <source>\n"
+            "  may be a wildcard, and multiple <source>s may be given; all\n"
+            "  source files are copied into <destination>.\n"
+            "  This only works if the server supports the copy-data extension.\n",
+            sftp_cmd_cp
+    },
     {
         "del", true, "delete files on the remote server",
             " <filename-or-wildcard> [ <filename-or-wildcard>... ]\n"
@@ -1998,11 +2520,15 @@ static struct sftp_cmd_lookup {
     },
     {
         "get", true, "download a file from the server to your local machine",
-            " [ -r ] [ -- ] <filename> [ <local-filename> ]\n"
+            " [ -r ] [ -d ] [ -- ] <filename> [ <local-filename> ]\n"
             "  Downloads a file on the server and stores it locally under\n"
             "  the same name, or under a different one if you supply the\n"
             "  argument <local-filename>.\n"
-            "  If -r specified, recursively fetch a directory.\n",
+            "  If -r specified, recursively fetch a directory.\n"
+            "  If -d specified, update an existing local file by fetching\n"
+            "  only the blocks that differ from the remote one. Blocks are\n"
+            "  compared at the same offsets, so this doesn't help if data\n"
+            "  has been inserted or removed.\n",
             sftp_cmd_get
     },
     {
@@ -2033,11 +2559,12 @@ static struct sftp_cmd_lookup {
     },
     {
         "mget", true, "download multiple files at once",
-            " [ -r ] [ -- ] <filename-or-wildcard> [ <filename-or-wildcard>... ]\n"
+            " [ -r ] [ -d ] [ -- ] <filename-or-wildcard> [ <filename-or-wildcard>... ]\n"
             "  Downloads many files from the server, storing each one under\n"
             "  the same name it has on the server side. You can use wildcards\n"
             "  such as \"*.c\" to specify lots of files at once.\n"
-            "  If -r specified, recursively fetch files and directories.\n",
+            "  If -r specified, recursively fetch files and directories.\n"
+            "  If -d specified, only fetch the parts of files that differ.\n",
             sftp_cmd_mget
     },
     {
@@ -2048,11 +2575,12 @@ static struct sftp_cmd_lookup {
     },
     {
         "mput", true, "upload multiple files at once",
-            " [ -r ] [ -- ] <filename-or-wildcard> [ <filename-or-wildcard>... ]\n"
+            " [ -r ] [ -d ] [ -- ] <filename-or-wildcard> [ <filename-or-wildcard>... ]\n"
             "  Uploads many files to the server, storing each one under the\n"
             "  same name it has on the client side. You can use wildcards\n"
             "  such as \"*.c\" to specify lots of files at once.\n"
-            "  If -r specified, recursively store files and directories.\n",
+            "  If -r specified, recursively store files and directories.\n"
+            "  If -d specified, only send the parts of files that differ.\n",
             sftp_cmd_mput
     },
     {
@@ -2076,11 +2604,15 @@ static struct sftp_cmd_lookup {
     },
     {
         "put", true, "upload a file from your local machine to the server",
-            " [ -r ] [ -- ] <filename> [ <remote-filename> ]\n"
+            " [ -r ] [ -d ] [ -- ] <filename> [ <remote-filename> ]\n"
             "  Uploads a file to the server and stores it there under\n"
             "  the same name, or under a different one if you supply the\n"
             "  argument <remote-filename>.\n"
-            "  If -r specified, recursively store a directory.\n",
+            "  If -r specified, recursively store a directory.\n"
+            "  If -d specified, update an existing remote file by sending\n"
+            "  only the blocks that differ from the local one. Blocks are\n"
+            "  compared at the same offsets, so this doesn't help if data\n"
+            "  has been inserted or removed.\n",
             sftp_cmd_put
     },
     {
@@ -2547,6 +3079,7 @@ static void usage(void)
     printf("            force use of particular SSH protocol variant\n");
     printf("  -4 -6     force use of IPv4 or IPv6\n");
     printf("  -C        enable compression\n");
+    printf("  -Z        compress file data where worthwhile\n");
     printf("  -i key    private key file for user authentication\n");
     printf("  -noagent  disable use of Pageant\n");
     printf("  -agent    enable use of Pageant\n");
@@ -2847,6 +3380,8 @@ int psftp_main(int argc, char *argv[])
             modeflags = modeflags | 1;
         } else if (strcmp(argv[i], "-be") == 0) {
             modeflags = modeflags | 2;
+        } else if (strcmp(argv[i], "-Z") == 0) {
+            compress_files = true;
         } else if (strcmp(argv[i], "-sanitise-stderr") == 0) {
             sanitise_stderr = true;
         } else if (strcmp(argv[i], "-no-sanitise-stderr") == 0) {
@@ -95,6 +95,10 @@ RFile *open_existing_file(const char *name, uint64_t *size,
                           unsigned long *mtime, unsigned long *atime,
                           long *perms);
 WFile *open_existing_wfile(const char *name, uint64_t *size);
+/* Unlike open_existing_wfile, which may only be able to append, this
+ * opens a file so that seek_file and write_to_file can overwrite
+ * parts of it in place */
+WFile *open_update_wfile(const char *name);
 /* Returns <0 on error, 0 on eof, or number of bytes read, as usual */
 int read_from_file(RFile *f, void *buffer, int length);
 /* Closes and frees the RFile */
@@ -110,6 +114,8 @@ enum { FROM_START, FROM_CURRENT, FROM_END };
 int seek_file(WFile *f, uint64_t offset, int whence);
 /* Get file position */
 uint64_t get_file_posn(WFile *f);
+/* Truncate or extend the file to the given size. Returns 0 or -1 */
+int set_file_size(WFile *f, uint64_t size);
 /*
  * Determine the type of a file: nonexistent, file, directory or
  * weird. `weird' covers anything else - named pipes, Unix sockets,
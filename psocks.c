@@ -24,6 +24,14 @@
 
 #define BUFLIMIT 16384
 
+/*
+ * The most data we let sit in the kernel between the two sockets of a
+ * directly relayed connection. The ordinary path can have BUFLIMIT
+ * plus one network read outstanding before it freezes a socket, so
+ * this is about equivalent.
+ */
+#define RELAY_LIMIT 65536
+
 #define LOGBITS(X)                              \
     X(CONNSTATUS)                               \
     X(DIALOGUE)                                 \
@@ -50,6 +58,7 @@ struct psocks_state {
     unsigned log_flags;
     RecordDestination rec_dest;
     char *rec_cmd;
+    bool relay;
     strbuf *subcmd;
 
     ConnectionLayer cl;
@@ -320,6 +329,31 @@ static void psocks_sc_unthrottle(SshChannel *sc, size_t bufsize)
 	sk_set_frozen(conn->socket, false);
 }
 
+/*
+ * Once a connection is up, and we aren't being asked to look at the
+ * data passing through it, we can ask the platform to relay it
+ * directly between the two sockets. After that, neither our plug nor
+ * the port forwarding's will see any more data, only EOF and errors.
+ */
+static void psocks_try_relay(void *vctx)
+{
+    psocks_connection *conn = (psocks_connection *)vctx;
+    Socket *local;
+
+    if (!conn->socket || conn->rec_sink ||
+        (conn->ps->log_flags & LOG_DIALOGUE) ||
+        conn->eof_pfmgr_to_socket || conn->eof_socket_to_pfmgr)
+        return;
+
+    local = portfwd_get_socket(conn->chan);
+    if (!local)
+        return;
+
+    if (conn->ps->platform->start_relay(local, conn->socket, RELAY_LIMIT) &&
+        (conn->ps->log_flags & LOG_CONNSTATUS))
+        psocks_conn_log(conn, "relaying directly");
+}
+
 static void psocks_plug_log(Plug *plug, PlugLogType type, SockAddr *addr,
                             int port, const char *error_msg, int error_code)
 {
@@ -346,6 +380,8 @@ static void psocks_plug_log(Plug *plug, PlugLogType type, SockAddr *addr,
         if (conn->connecting) {
             chan_open_confirmation(conn->chan);
             conn->connecting = false;
+            if (conn->ps->relay)
+                queue_toplevel_callback(psocks_try_relay, conn);
         }
         break;
       case PLUGLOG_PROXY_MSG:
@@ -438,6 +474,13 @@ void psocks_cmdline(psocks_state *ps, int argc, char **argv)
 		ps->log_flags |= LOG_DIALOGUE;
             } else if (!strcmp(p, "-f")) {
 		ps->rec_dest = REC_FILE;
+            } else if (!strcmp(p, "--splice")) {
+                if (!ps->platform->start_relay) {
+		    fprintf(stderr, "psocks: '--splice' is not supported on "
+                            "this platform\n");
+		    exit(1);
+                }
+                ps->relay = true;
             } else if (!strcmp(p, "-p")) {
                 if (!ps->platform->open_pipes) {
 		    fprintf(stderr, "psocks: '-p' is not supported on this "
@@ -465,7 +508,10 @@ void psocks_cmdline(psocks_state *ps, int argc, char **argv)
                 printf("usage: psocks [ -d ] [ -f");
                 if (ps->platform->open_pipes)
                     printf(" | -p pipe-cmd");
-                printf(" ] [ -g ] port-number");
+                printf(" ] [ -g ]");
+                if (ps->platform->start_relay)
+                    printf(" [ --splice ]");
+                printf(" port-number");
                 printf("\n");
                 printf("where: -d           log all connection contents to"
                        " standard output\n");
@@ -476,6 +522,9 @@ void psocks_cmdline(psocks_state *ps, int argc, char **argv)
                            " to 'pipe-cmd [in|out] N'\n");
                 printf("       -g           accept connections from anywhere,"
                        " not just localhost\n");
+                if (ps->platform->start_relay)
+                    printf("       --splice     relay connection data inside"
+                           " the kernel where possible\n");
                 if (ps->platform->start_subcommand)
                     printf("       --exec subcmd [args...]   run command, and "
                            "terminate when it exits\n");
@@ -20,6 +20,9 @@ struct PsocksPlatform {
         const char *cmd, const char *const *direction_args,
         const char *index_arg, char **err);
     void (*start_subcommand)(strbuf *args);
+    /* Optional: pass data directly between two sockets (see
+     * sk_net_start_relay on Unix). Returns false if it can't. */
+    bool (*start_relay)(Socket *a, Socket *b, size_t limit);
 };
 
 psocks_state *psocks_new(const PsocksPlatform *);
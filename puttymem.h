@@ -105,6 +105,35 @@ void *safegrowarray(void *array, size_t *size, size_t eltsize,
 #define sgrowarrayn_nm(a, s, n, m) sgrowarray_general(a, s, n, m, true )
 #define sgrowarray_nm( a, s, n   ) sgrowarray_general(a, s, n, 1, true )
 
+/*
+ * Pooled allocation, for small objects that are allocated and freed
+ * at a high rate (bufchain granules, SSH packets). Blocks obtained
+ * from spool_alloc must be freed with spool_free, which wipes them
+ * before either recycling them for a later spool_alloc of a similar
+ * size or returning them to the system. So callers need not (and
+ * should not) smemclr them first.
+ *
+ * spool_usable_size returns the real capacity of a block, which may
+ * be more than was asked for; callers may then use all of it (and it
+ * will all be wiped on free).
+ *
+ * spool_get_stats reports counters that let you work out the hit
+ * rate of the free lists. spool_release_all returns every idle block
+ * to the system.
+ */
+typedef struct SpoolStats {
+    size_t allocs;     /* total calls to spool_alloc */
+    size_t hits;       /* ... of which were served from a free list */
+    size_t frees;      /* total calls to spool_free with non-NULL */
+    size_t recycled;   /* ... of which put the block on a free list */
+    size_t idle_bytes; /* block capacity currently sitting on free lists */
+} SpoolStats;
+void *spool_alloc(size_t size);
+void spool_free(void *p);
+size_t spool_usable_size(void *p);
+void spool_get_stats(SpoolStats *stats);
+void spool_release_all(void);
+
 /*
  * This function is called by the innermost safemalloc/saferealloc
  * functions when allocation fails. Usually it's provided by an
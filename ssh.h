@@ -164,6 +164,14 @@ int ssh2_censor_packet(
 PktOut *ssh_new_packet(void);
 void ssh_free_pktout(PktOut *pkt);
 
+/*
+ * Allocate and free incoming packets, with 'extra' bytes of packet
+ * data available at snew_plus_get_aux(pkt). These come from the
+ * spool_alloc pool, so the packet is wiped when it's freed.
+ */
+PktIn *ssh_new_pktin(size_t extra);
+void ssh_free_pktin(PktIn *pkt);
+
 Socket *ssh_connection_sharing_init(
     const char *host, int port, Conf *conf, LogContext *logctx,
     Plug *sshplug, ssh_sharing_state **state);
@@ -176,6 +184,9 @@ void share_activate(ssh_sharing_state *sharestate,
                     const char *server_verstring);
 void sharestate_free(ssh_sharing_state *state);
 int share_ndownstreams(ssh_sharing_state *state);
+void share_retire(ssh_sharing_state *state);
+void share_set_upstream_throttled(ssh_sharing_state *sharestate,
+                                  bool throttled);
 
 void ssh_connshare_log(Ssh *ssh, int event, const char *logtext,
                        const char *ds_err, const char *us_err);
@@ -397,6 +408,7 @@ bool portfwdmgr_unlisten(PortFwdManager *mgr, const char *host, int port);
 Channel *portfwd_raw_new(ConnectionLayer *cl, Plug **plug, bool start_ready);
 void portfwd_raw_free(Channel *pfchan);
 void portfwd_raw_setup(Channel *pfchan, Socket *s, SshChannel *sc);
+Socket *portfwd_get_socket(Channel *chan);
 
 Socket *platform_make_agent_socket(Plug *plug, const char *dirprefix,
                                    char **error, char **name);
@@ -455,6 +467,8 @@ struct RSAKey {
     mp_int *p;
     mp_int *q;
     mp_int *iqmp;
+    RSACrtContext *crt;    /* built on first private-key operation */
+    MontyContext *pub_mc;  /* built on first public-key operation */
     char *comment;
     ssh_key sshk;
 };
@@ -472,6 +486,7 @@ struct ec_wcurve
     WeierstrassCurve *wc;
     WeierstrassPoint *G;
     mp_int *G_order;
+    WeierstrassBaseTable *G_table;
 };
 
 /* Montgomery form curve */
@@ -488,6 +503,7 @@ struct ec_ecurve
     EdwardsCurve *ec;
     EdwardsPoint *G;
     mp_int *G_order;
+    EdwardsBaseTable *G_table;
     unsigned log2_cofactor;
 };
 
@@ -542,6 +558,22 @@ struct eddsa_key {
 WeierstrassPoint *ecdsa_public(mp_int *private_key, const ssh_keyalg *alg);
 EdwardsPoint *eddsa_public(mp_int *private_key, const ssh_keyalg *alg);
 
+/*
+ * Verify n EdDSA signatures at once: sigs[i] should be a signature
+ * on data[i] by keys[i]. All the keys must be of the same EdDSA
+ * algorithm. Returns true if every signature is valid, and false if
+ * any of them isn't, in which case the caller must use ssh_key_verify
+ * on each one to find out which. Much faster per signature than
+ * separate ssh_key_verify calls for batches of more than a few.
+ *
+ * The batch check multiplies through by the curve's cofactor, so in
+ * contrast to ssh_key_verify, it can accept a signature made using a
+ * point with a small-order component. Honestly generated signatures
+ * get the same answer from both.
+ */
+bool eddsa_verify_batch(size_t n, ssh_key *const *keys,
+                        const ptrlen *sigs, const ptrlen *data);
+
 typedef enum KeyComponentType {
     KCT_TEXT, KCT_BINARY, KCT_MPINT
 } KeyComponentType;
@@ -598,6 +630,10 @@ void rsa_ssh1_public_blob(BinarySink *bs, RSAKey *key, RsaSsh1Order order);
 int rsa_ssh1_public_blob_len(ptrlen data);
 void rsa_ssh1_private_blob_agent(BinarySink *bs, RSAKey *key);
 void duprsakey(RSAKey *dst, const RSAKey *src);
+/* For test programs: turn off the caching of an RSAKey's CRT
+ * precomputation, so that every private-key operation redoes it.
+ * Returns whether caching is on afterwards. */
+bool rsa_set_crt_cache(bool enable);
 void freersapriv(RSAKey *key);
 void freersakey(RSAKey *key);
 key_components *rsa_components(RSAKey *key);
@@ -964,6 +1000,21 @@ bool nullkey_variable_size_yes(const ssh_keyalg *self);
 /* Utility functions implemented centrally */
 ssh_key *ssh_key_clone(ssh_key *key);
 
+/*
+ * In-process cache of certificates whose CA signatures have already
+ * been verified, which ssh_key_check_cert consults so as not to
+ * verify the same one twice. An entry is identified by a hash of the
+ * whole certificate, which opensshcert_sig_cache_id computes. Callers
+ * that keep their own longer-term record of verified certificates
+ * (see check_verified_cert in storage.h) can feed it back in with
+ * opensshcert_sig_cache_add.
+ */
+#define CERT_SIG_CACHE_ID_LEN 32
+void opensshcert_sig_cache_id(ssh_key *cert, unsigned char *id);
+bool opensshcert_sig_cache_check(const unsigned char *id);
+void opensshcert_sig_cache_add(const unsigned char *id);
+void opensshcert_sig_cache_clear(void);
+
 /*
  * SSH2 ECDH key exchange vtable
  */
@@ -1622,6 +1673,11 @@ int platform_ssh_share(const char *name, Conf *conf,
                        char **logtext, char **ds_err, char **us_err,
                        bool can_upstream, bool can_downstream);
 void platform_ssh_share_cleanup(const char *name);
+/*
+ * Stop new downstreams from connecting to the upstream with the given
+ * name, while leaving any already-open connections alone.
+ */
+void platform_ssh_share_retire(const char *name);
 
 /*
  * List macro defining the SSH-1 message type codes.
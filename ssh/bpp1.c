@@ -68,7 +68,7 @@ static void ssh1_bpp_free(BinaryPacketProtocol *bpp)
         ssh_decompressor_free(s->decompctx);
     if (s->crcda_ctx)
         crcda_free_context(s->crcda_ctx);
-    sfree(s->pktin);
+    ssh_free_pktin(s->pktin);
     sfree(s);
 }
 
@@ -158,7 +158,7 @@ static void ssh1_bpp_handle_input(BinaryPacketProtocol *bpp)
         /*
          * Allocate the packet to return, now we know its length.
          */
-        s->pktin = snew_plus(PktIn, s->biglen);
+        s->pktin = ssh_new_pktin(s->biglen);
         s->pktin->qnode.prev = s->pktin->qnode.next = NULL;
         s->pktin->qnode.on_free_queue = false;
         s->pktin->type = 0;
@@ -204,12 +204,11 @@ static void ssh1_bpp_handle_input(BinaryPacketProtocol *bpp)
                 PktIn *old_pktin = s->pktin;
 
                 s->maxlen = s->pad + decomplen;
-                s->pktin = snew_plus(PktIn, s->maxlen);
+                s->pktin = ssh_new_pktin(s->maxlen);
                 *s->pktin = *old_pktin; /* structure copy */
                 s->data = snew_plus_get_aux(s->pktin);
 
-                smemclr(old_pktin, s->biglen);
-                sfree(old_pktin);
+                ssh_free_pktin(old_pktin);
             }
 
             memcpy(s->data + s->pad, decompblk, decomplen);
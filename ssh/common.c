@@ -65,7 +65,7 @@ static void pktin_free_queue_callback(void *vctx)
         PacketQueueNode *node = pktin_freeq_head.next;
         PktIn *pktin = container_of(node, PktIn, qnode);
         pktin_freeq_head.next = node->next;
-        sfree(pktin);
+        ssh_free_pktin(pktin);
     }
 
     pktin_freeq_head.prev = &pktin_freeq_head;
@@ -241,9 +241,20 @@ void pq_base_concatenate(PacketQueueBase *qdest,
 
 static void ssh_pkt_BinarySink_write(BinarySink *bs,
                                      const void *data, size_t len);
+PktIn *ssh_new_pktin(size_t extra)
+{
+    assert(extra <= SIZE_MAX - sizeof(PktIn));
+    return (PktIn *)spool_alloc(sizeof(PktIn) + extra);
+}
+
+void ssh_free_pktin(PktIn *pkt)
+{
+    spool_free(pkt);
+}
+
 PktOut *ssh_new_packet(void)
 {
-    PktOut *pkt = snew(PktOut);
+    PktOut *pkt = spool_alloc(sizeof(PktOut));
 
     BinarySink_INIT(pkt, ssh_pkt_BinarySink_write);
     pkt->data = NULL;
@@ -259,7 +270,27 @@ PktOut *ssh_new_packet(void)
 
 static void ssh_pkt_adddata(PktOut *pkt, const void *data, int len)
 {
-    sgrowarrayn_nm(pkt->data, pkt->maxlen, pkt->length, len);
+    if (pkt->maxlen < pkt->length ||
+        pkt->maxlen - pkt->length < (size_t)len) {
+        /*
+         * Grow the data buffer by hand rather than with
+         * sgrowarray_nm, so that it can come from the pool. The old
+         * buffer is wiped by spool_free.
+         */
+        size_t newlen = pkt->maxlen < 256 ? 256 : pkt->maxlen * 2;
+        unsigned char *newdata;
+
+        assert(pkt->length <= SIZE_MAX / 2 - len);
+        if (newlen < pkt->length + len)
+            newlen = pkt->length + len;
+        newdata = spool_alloc(newlen);
+        /* (length can exceed maxlen, if a BPP reserved header space) */
+        if (pkt->maxlen)
+            memcpy(newdata, pkt->data, min(pkt->length, pkt->maxlen));
+        spool_free(pkt->data);
+        pkt->data = newdata;
+        pkt->maxlen = spool_usable_size(newdata);
+    }
     memcpy(pkt->data + pkt->length, data, len);
     pkt->length += len;
     pkt->qnode.formal_size = pkt->length;
@@ -274,8 +305,8 @@ static void ssh_pkt_BinarySink_write(BinarySink *bs,
 
 void ssh_free_pktout(PktOut *pkt)
 {
-    sfree(pkt->data);
-    sfree(pkt);
+    spool_free(pkt->data);
+    spool_free(pkt);
 }
 
 /* ----------------------------------------------------------------------
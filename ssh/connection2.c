@@ -260,6 +260,14 @@ PacketProtocolLayer *ssh2_connection_new(
      */
     s->persistent = conf_get_bool(s->conf, CONF_ssh_no_shell);
 
+    /*
+     * A persistent connection-sharing upstream can also be configured
+     * to go away after it's been idle for a while.
+     */
+    if (s->persistent && connshare)
+        s->share_persist = conf_get_int(
+            s->conf, CONF_ssh_connection_sharing_persist);
+
     s->connshare = connshare;
     s->peer_verstring = dupstr(peer_verstring);
 
@@ -318,6 +326,7 @@ static void ssh2_connection_free(PacketProtocolLayer *ppl)
         free_prompts(s->antispoof_prompt);
 
     delete_callbacks_for_context(s);
+    expire_timer_context(s);
 
     sfree(s);
 }
@@ -1021,6 +1030,17 @@ static void ssh2_connection_process_queue(PacketProtocolLayer *ppl)
         s->ssh_is_simple, &s->mainchan_sc);
     s->started = true;
 
+    /*
+     * With no main channel, nothing else will tell the seat that
+     * the session is up and running, so do it now. Also, if we're an
+     * upstream that only lives for a limited time while idle, start
+     * that clock, since we haven't got any downstreams yet.
+     */
+    if (!s->mainchan) {
+        seat_notify_session_started(s->ppl.seat);
+        ssh2_check_termination(s);
+    }
+
     /*
      * Transfer data!
      */
@@ -1063,7 +1083,7 @@ static void ssh2_channel_check_close(struct ssh2_channel *c)
 
     if (chan_want_close(c->chan, (c->closes & CLOSES_SENT_EOF),
                         (c->closes & CLOSES_RCVD_EOF)) &&
-        !c->chanreq_head &&
+        !c->chanreq_head && !c->pending_eof &&
         !(c->closes & CLOSES_SENT_CLOSE)) {
         /*
          * We have both sent and received EOF (or the channel is a
@@ -1107,16 +1127,57 @@ static void ssh2_channel_try_eof(struct ssh2_channel *c)
 }
 
 /*
- * Attempt to send data on an SSH-2 channel.
+ * Outgoing channel data is prioritised so that typing into the main
+ * session isn't stuck behind a window's worth of port-forwarded or X
+ * data already handed to the BPP.
+ *
+ * The main channel always sends as much as its window allows. Every
+ * other channel sends at most SSH2_BULK_BURST bytes at a time, and
+ * nothing at all while the SSH connection's own output is backed up
+ * (all_channels_throttled); whatever it couldn't send waits in its
+ * outbuffer until ssh2_resume_bulk_channels gives each such channel
+ * another turn, after the BPP has had a chance to write out what was
+ * already queued. A channel whose outbuffer grows beyond
+ * SSH2_CHANNEL_MAX_BACKLOG stops reading local input until it drains.
  */
-static size_t ssh2_try_send(struct ssh2_channel *c)
+#define SSH2_BULK_BURST 16384
+#define SSH2_CHANNEL_MAX_BACKLOG (4 * OUR_V2_PACKETLIMIT)
+
+static bool ssh2_channel_is_interactive(struct ssh2_channel *c)
+{
+    return &c->sc == c->connlayer->mainchan_sc;
+}
+
+static void ssh2_resume_bulk_channels(void *vctx)
+{
+    struct ssh2_connection_state *s = (struct ssh2_connection_state *)vctx;
+    struct ssh2_channel *c;
+
+    s->bulk_resume_pending = false;
+    if (s->all_channels_throttled)
+        return;            /* ssh2_throttle_all_channels will call us again */
+
+    for (int i = 0; NULL != (c = index234(s->channels, i)); i++) {
+        if (c->bulk_deferred) {
+            c->bulk_deferred = false;
+            ssh2_try_send_and_unthrottle(c);
+            if (index234(s->channels, i) != c)
+                i--;           /* sending an EOF finished the channel off */
+        }
+    }
+}
+
+/*
+ * Send up to 'burst' bytes of a channel's buffered data, as far as
+ * its window allows. Returns how much of the burst is left unused.
+ */
+static size_t ssh2_send_buffered(struct ssh2_channel *c, size_t burst)
 {
     struct ssh2_connection_state *s = c->connlayer;
     PktOut *pktout;
-    size_t bufsize;
 
     if (!c->halfopen) {
-        while (c->remwindow > 0 &&
+        while (c->remwindow > 0 && burst > 0 &&
                (bufchain_size(&c->outbuffer) > 0 ||
                 bufchain_size(&c->errbuffer) > 0)) {
             bufchain *buf = (bufchain_size(&c->errbuffer) > 0 ?
@@ -1140,15 +1201,51 @@ static size_t ssh2_try_send(struct ssh2_channel *c)
             pq_push(s->ppl.out_pq, pktout);
             bufchain_consume(buf, data.len);
             c->remwindow -= data.len;
+            burst -= (burst < data.len ? burst : data.len);
         }
     }
 
+    return burst;
+}
+
+/*
+ * Attempt to send data on an SSH-2 channel.
+ */
+static size_t ssh2_try_send(struct ssh2_channel *c)
+{
+    struct ssh2_connection_state *s = c->connlayer;
+    size_t bufsize;
+    size_t burst = SIZE_MAX;
+
+    if (!ssh2_channel_is_interactive(c))
+        burst = s->all_channels_throttled ? 0 : SSH2_BULK_BURST;
+
+    burst = ssh2_send_buffered(c, burst);
+
     /*
      * After having sent as much data as we can, return the amount
      * still buffered.
      */
     bufsize = bufchain_size(&c->outbuffer) + bufchain_size(&c->errbuffer);
 
+    /*
+     * If it was our own rationing that stopped us rather than the
+     * window, arrange to come back for the rest.
+     */
+    if (bufsize && burst == 0 && c->remwindow > 0 && !c->halfopen) {
+        c->bulk_deferred = true;
+        if (!s->all_channels_throttled && !s->bulk_resume_pending) {
+            s->bulk_resume_pending = true;
+            queue_toplevel_callback(ssh2_resume_bulk_channels, s);
+        }
+    }
+
+    if (bufsize > SSH2_CHANNEL_MAX_BACKLOG && !c->throttled_by_backlog &&
+        c->chan) {
+        c->throttled_by_backlog = true;
+        ssh2_channel_check_throttle(c);
+    }
+
     /*
      * And if there's no data pending but we need to send an EOF, send
      * it.
@@ -1178,12 +1275,14 @@ static void ssh2_channel_check_throttle(struct ssh2_channel *c)
      * We don't want this channel to read further input if this
      * particular channel has a backed-up SSH window, or if the
      * outgoing side of the whole SSH connection is currently
-     * throttled, or if this channel already has an outgoing EOF
-     * either sent or pending.
+     * throttled (unless this is the interactive channel, which is
+     * allowed to jump that queue), or if this channel already has an
+     * outgoing EOF either sent or pending.
      */
     chan_set_input_wanted(c->chan,
                           !c->throttled_by_backlog &&
-                          !c->connlayer->all_channels_throttled &&
+                          !(c->connlayer->all_channels_throttled &&
+                            !ssh2_channel_is_interactive(c)) &&
                           !c->pending_eof &&
                           !(c->closes & CLOSES_SENT_EOF));
 }
@@ -1238,6 +1337,35 @@ static void ssh2_channel_destroy(struct ssh2_channel *c)
     queue_toplevel_callback(ssh2_check_termination_callback, s);
 }
 
+static void ssh2_share_idle_timer(void *ctx, unsigned long now)
+{
+    struct ssh2_connection_state *s = (struct ssh2_connection_state *)ctx;
+    PacketProtocolLayer *ppl = &s->ppl; /* for ppl_logevent */
+
+    if (now != s->share_idle_expiry)
+        return;                        /* superseded by a later timer */
+    if (count234(s->channels) != 0 || share_ndownstreams(s->connshare) != 0)
+        return;                        /* not idle any more */
+
+    if (!s->share_retired) {
+        /*
+         * Stop new downstreams finding us, and then wait a moment, in
+         * case one connected just before that and we haven't yet
+         * accepted it. If one does turn up, we'll close as soon as
+         * it's finished.
+         */
+        ppl_logevent("Shared connection idle for %d seconds, closing",
+                     s->share_persist);
+        share_retire(s->connshare);
+        s->share_retired = true;
+        s->share_idle_expiry = schedule_timer(
+            TICKSPERSEC / 4, ssh2_share_idle_timer, s);
+        return;
+    }
+
+    ssh_user_close(s->ppl.ssh, "Shared connection idle");
+}
+
 static void ssh2_check_termination(struct ssh2_connection_state *s)
 {
     /*
@@ -1246,8 +1374,26 @@ static void ssh2_check_termination(struct ssh2_connection_state *s)
      * policy is that we terminate when none of either is left.
      */
 
-    if (s->persistent)
-        return;     /* persistent mode: never proactively terminate */
+    if (s->persistent) {
+        /*
+         * Persistent mode: never proactively terminate, unless we're
+         * a connection-sharing upstream configured with a timeout,
+         * in which case, start (or restart) the clock whenever we
+         * become idle.
+         */
+        if (s->share_persist > 0 && count234(s->channels) == 0 &&
+            share_ndownstreams(s->connshare) == 0) {
+            if (s->share_retired) {
+                /* Already past the timeout, and our late arrivals
+                 * have finished */
+                ssh_user_close(s->ppl.ssh, "Shared connection idle");
+                return;
+            }
+            s->share_idle_expiry = schedule_timer(
+                s->share_persist * TICKSPERSEC, ssh2_share_idle_timer, s);
+        }
+        return;
+    }
 
     if (!s->started) {
         /* At startup, we don't have any channels open because we
@@ -1286,6 +1432,7 @@ void ssh2_channel_init(struct ssh2_channel *c)
     c->pending_eof = false;
     c->throttling_conn = false;
     c->throttled_by_backlog = false;
+    c->bulk_deferred = false;
     c->sharectx = NULL;
     c->locwindow = c->locmaxwin = c->remlocwin =
         s->ssh_is_simple ? OUR_V2_BIGWIN : OUR_V2_WINSIZE;
@@ -1378,10 +1525,25 @@ static void ssh2channel_initiate_close(SshChannel *sc, const char *err)
     struct ssh2_channel *c = container_of(sc, struct ssh2_channel, sc);
     char *reason;
 
+    /*
+     * Data we were only holding back to ration bulk channels would be
+     * lost once we send CLOSE, so let it all go now.
+     */
+    if (!(c->closes & CLOSES_SENT_EOF))
+        ssh2_send_buffered(c, SIZE_MAX);
+
     reason = err ? dupprintf("due to local error: %s", err) : NULL;
     ssh2_channel_close_local(c, reason);
     sfree(reason);
-    c->pending_eof = false;   /* this will confuse a zombie channel */
+
+    /*
+     * If this is an orderly close, and we already have an EOF waiting
+     * for the window to take the rest of the data, leave it pending:
+     * ssh2_channel_check_close won't send CLOSE until it's gone. On
+     * an error, abandon whatever is still buffered.
+     */
+    if (err)
+        c->pending_eof = false;   /* this will confuse a zombie channel */
 
     ssh2_channel_check_close(c);
 }
@@ -1676,6 +1838,13 @@ static void ssh2_throttle_all_channels(ConnectionLayer *cl, bool throttled)
     for (i = 0; NULL != (c = index234(s->channels, i)); i++)
         if (!c->sharectx)
             ssh2_channel_check_throttle(c);
+
+    if (!throttled)
+        ssh2_resume_bulk_channels(s);
+
+    /* Sharing channels are throttled by the downstream scheduler. */
+    if (s->connshare)
+        share_set_upstream_throttled(s->connshare, throttled);
 }
 
 static bool ssh2_ldisc_option(ConnectionLayer *cl, int option)
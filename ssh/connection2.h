@@ -22,10 +22,16 @@ struct ssh2_connection_state {
     bool persistent;
     bool started;
 
+    /* Idle timeout for a persistent connection-sharing upstream */
+    int share_persist;                 /* seconds, or 0 to persist forever */
+    unsigned long share_idle_expiry;
+    bool share_retired;
+
     Conf *conf;
 
     tree234 *channels;                 /* indexed by local id */
     bool all_channels_throttled;
+    bool bulk_resume_pending;          /* ssh2_resume_bulk_channels queued */
 
     bool X11_fwd_enabled;
     tree234 *x11authtree;
@@ -99,6 +105,13 @@ struct ssh2_channel {
      */
     bool throttled_by_backlog;
 
+    /*
+     * True if this is a bulk (i.e. not interactive) channel which
+     * had data left over after its last turn at sending, and is
+     * waiting for ssh2_resume_bulk_channels to give it another.
+     */
+    bool bulk_deferred;
+
     bufchain outbuffer, errbuffer;
     unsigned remwindow, remmaxpkt;
     /* locwindow is signed so we can cope with excess data. */
@@ -946,6 +946,31 @@ void ssh2kex_coroutine(struct ssh2_transport_state *s, bool *aborted)
                 } else {
                     ppl_logevent("Certification authority matches '%s'",
                                  hca_found->name);
+
+                    /*
+                     * If we're keeping a persistent record of
+                     * certificates already verified, see if this one
+                     * is in it, so that ssh_key_check_cert can skip
+                     * checking its signature.
+                     */
+                    strbuf *cert_id_hex = NULL;
+                    bool cert_id_stored = false;
+                    if (conf_get_bool(s->conf,
+                                      CONF_ssh_cache_verified_certs)) {
+                        unsigned char cert_id[CERT_SIG_CACHE_ID_LEN];
+                        opensshcert_sig_cache_id(s->hkey, cert_id);
+                        cert_id_hex = strbuf_new();
+                        for (size_t i = 0; i < CERT_SIG_CACHE_ID_LEN; i++)
+                            put_fmt(cert_id_hex, "%02x", cert_id[i]);
+
+                        cert_id_stored = check_verified_cert(cert_id_hex->s);
+                        if (cert_id_stored) {
+                            ppl_logevent("Certificate signature was verified "
+                                         "in a previous session");
+                            opensshcert_sig_cache_add(cert_id);
+                        }
+                    }
+
                     cert_ok = ssh_key_check_cert(
                         s->hkey,
                         true, /* host certificate */
@@ -953,6 +978,12 @@ void ssh2kex_coroutine(struct ssh2_transport_state *s, bool *aborted)
                         time(NULL),
                         &hca_found->opts,
                         BinarySink_UPCAST(error));
+
+                    if (cert_id_hex) {
+                        if (cert_ok && !cert_id_stored)
+                            store_verified_cert(cert_id_hex->s);
+                        strbuf_free(cert_id_hex);
+                    }
                 }
                 if (cert_ok) {
                     strbuf_free(error);
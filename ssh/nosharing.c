@@ -23,3 +23,7 @@ int platform_ssh_share(const char *name, Conf *conf,
 void platform_ssh_share_cleanup(const char *name)
 {
 }
+
+void platform_ssh_share_retire(const char *name)
+{
+}
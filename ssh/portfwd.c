@@ -513,6 +513,20 @@ void portfwd_raw_setup(Channel *pfchan, Socket *s, SshChannel *sc)
     pf->c = sc;
 }
 
+/*
+ * Return the local socket of a port-forwarding channel, once it's
+ * finished any SOCKS dialogue and is passing data straight through.
+ * Returns NULL if the channel isn't of this type or isn't ready.
+ */
+Socket *portfwd_get_socket(Channel *chan)
+{
+    struct PortForwarding *pf;
+    if (chan->vt != &PortForwarding_channelvt)
+        return NULL;
+    pf = container_of(chan, struct PortForwarding, chan);
+    return pf->ready ? pf->s : NULL;
+}
+
 /*
  * called when someone connects to the local port
  */
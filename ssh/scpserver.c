@@ -261,6 +261,8 @@ struct ScpReplyReceiver {
     char *errmsg;
     struct fxp_attrs attrs;
     ptrlen name, handle, data;
+    strbuf *databuf;                   /* what 'data' points into */
+    bool reserved;                     /* data_buffer has been called */
 
     SftpReplyBuilder srb;
 };
@@ -277,6 +279,7 @@ static void scp_reply_error(
     ScpReplyReceiver *reply = container_of(srb, ScpReplyReceiver, srb);
     reply->err = true;
     reply->code = code;
+    reply->reserved = false;
     sfree(reply->errmsg);
     reply->errmsg = dupstr(msg);
 }
@@ -316,14 +319,31 @@ static void scp_reply_handle(SftpReplyBuilder *srb, ptrlen handle)
     reply->handle.len = handle.len;
 }
 
+/*
+ * File data is read straight into a buffer we keep for the purpose,
+ * and passed on to the channel from there.
+ */
+static void *scp_reply_data_buffer(SftpReplyBuilder *srb, size_t maxlen)
+{
+    ScpReplyReceiver *reply = container_of(srb, ScpReplyReceiver, srb);
+    strbuf_clear(reply->databuf);
+    reply->reserved = true;
+    return strbuf_append(reply->databuf, maxlen);
+}
+
 static void scp_reply_data(SftpReplyBuilder *srb, ptrlen data)
 {
     ScpReplyReceiver *reply = container_of(srb, ScpReplyReceiver, srb);
-    char *p;
     reply->err = false;
-    sfree((void *)reply->data.ptr);
-    reply->data.ptr = p = mkstr(data);
-    reply->data.len = data.len;
+    if (reply->reserved) {
+        assert(data.ptr == reply->databuf->u);
+        strbuf_shrink_to(reply->databuf, data.len);
+        reply->reserved = false;
+    } else {
+        strbuf_clear(reply->databuf);
+        put_datapl(reply->databuf, data);
+    }
+    reply->data = ptrlen_from_strbuf(reply->databuf);
 }
 
 static void scp_reply_attrs(
@@ -343,12 +363,14 @@ static const SftpReplyBuilderVtable ScpReplyReceiver_vt = {
     .reply_handle = scp_reply_handle,
     .reply_data = scp_reply_data,
     .reply_attrs = scp_reply_attrs,
+    .data_buffer = scp_reply_data_buffer,
 };
 
 static void scp_reply_setup(ScpReplyReceiver *reply)
 {
     memset(reply, 0, sizeof(*reply));
     reply->srb.vt = &ScpReplyReceiver_vt;
+    reply->databuf = strbuf_new_nm();
 }
 
 static void scp_reply_cleanup(ScpReplyReceiver *reply)
@@ -356,7 +378,7 @@ static void scp_reply_cleanup(ScpReplyReceiver *reply)
     sfree(reply->errmsg);
     sfree((void *)reply->name.ptr);
     sfree((void *)reply->handle.ptr);
-    sfree((void *)reply->data.ptr);
+    strbuf_free(reply->databuf);
 }
 
 /* ----------------------------------------------------------------------
@@ -364,6 +386,7 @@ static void scp_reply_cleanup(ScpReplyReceiver *reply)
  */
 
 #define SCP_MAX_BACKLOG 65536
+#define SCP_READ_CHUNK 32768
 
 typedef struct ScpSource ScpSource;
 typedef struct ScpSourceStackEntry ScpSourceStackEntry;
@@ -720,8 +743,8 @@ static void scp_source_process_stack(ScpSource *scp)
          */
         int backlog;
         uint64_t limit = scp->file_size - scp->file_offset;
-        if (limit > 4096)
-            limit = 4096;
+        if (limit > SCP_READ_CHUNK)
+            limit = SCP_READ_CHUNK;
         if (limit > 0) {
             sftpsrv_read(scp->sf, &scp->reply.srb, scp->head->handle,
                          scp->file_offset, limit);
@@ -772,7 +795,8 @@ static void scp_source_process_stack(ScpSource *scp)
     scp->head = node->next;
 
     if (node->type == SCP_READDIR) {
-        sftpsrv_readdir(scp->sf, &scp->reply.srb, node->handle, 1, true);
+        sftpsrv_readdir(scp->sf, &scp->reply.srb, node->handle, 1, true,
+                        false);
         if (scp->reply.err) {
             if (scp->reply.code != SSH_FX_EOF)
                 scp_source_err(scp, "%.*s: unable to list directory: %s",
@@ -72,6 +72,9 @@ void share_activate(ssh_sharing_state *sharestate,
 void ssh_connshare_provide_connlayer(ssh_sharing_state *sharestate,
                                      ConnectionLayer *cl) {}
 int share_ndownstreams(ssh_sharing_state *sharestate) { return 0; }
+void share_retire(ssh_sharing_state *sharestate) {}
+void share_set_upstream_throttled(ssh_sharing_state *sharestate,
+                                  bool throttled) {}
 void share_got_pkt_from_server(ssh_sharing_connstate *cs, int type,
                                const void *vpkt, int pktlen) {}
 void share_setup_x11_channel(ssh_sharing_connstate *cs, share_channel *chan,
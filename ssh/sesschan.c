@@ -47,6 +47,8 @@ typedef struct sesschan {
 
     bufchain subsys_input;
     SftpServer *sftpsrv;
+    SftpReplySink sftp_sink;
+    bool sftp_eof_pending;
     ScpServer *scpsrv;
     const SshServerConfig *ssc;
 
@@ -106,6 +108,7 @@ static size_t sftp_chan_send(
     Channel *chan, bool is_stderr, const void *, size_t);
 static void sftp_chan_send_eof(Channel *chan);
 static char *sftp_log_close_msg(Channel *chan);
+static void sftp_chan_deliver(SftpReplySink *sink, struct sftp_packet *reply);
 
 static const ChannelVtable sftp_channelvt = {
     .free = sesschan_free,
@@ -363,6 +366,8 @@ bool sesschan_run_subsystem(Channel *chan, ptrlen subsys)
 
     if (ptrlen_eq_string(subsys, "sftp") && sess->sftpserver_vt) {
         sess->sftpsrv = sftpsrv_new(sess->sftpserver_vt);
+        sess->sftp_sink.deliver = sftp_chan_deliver;
+        sess->sftp_sink.outstanding = 0;
         sess->chan.vt = &sftp_channelvt;
         logevent(sess->parent_logctx, "Starting built-in SFTP subsystem");
         return true;
@@ -727,6 +732,27 @@ static bool sesschan_get_window_pixel_size(Seat *seat, int *width, int *height)
  * Built-in SFTP subsystem.
  */
 
+static void sftp_chan_write_reply(sesschan *sess, struct sftp_packet *reply)
+{
+    sftp_send_prepare(reply);
+    sshfwd_write(sess->c, reply->data, reply->length);
+    sftp_pkt_free(reply);
+}
+
+static void sftp_chan_deliver(SftpReplySink *sink, struct sftp_packet *reply)
+{
+    sesschan *sess = container_of(sink, sesschan, sftp_sink);
+
+    sftp_chan_write_reply(sess, reply);
+
+    /* If the client has already sent EOF, pass it on once the last
+     * reply it's waiting for has gone out */
+    if (sess->sftp_eof_pending && sink->outstanding == 0) {
+        sess->sftp_eof_pending = false;
+        sshfwd_write_eof(sess->c);
+    }
+}
+
 static size_t sftp_chan_send(Channel *chan, bool is_stderr,
                              const void *data, size_t length)
 {
@@ -749,12 +775,11 @@ static size_t sftp_chan_send(Channel *chan, bool is_stderr,
         pkt = sftp_recv_prepare(pktlen);
         bufchain_fetch_consume(&sess->subsys_input, pkt->data, pktlen);
         sftp_recv_finish(pkt);
-        reply = sftp_handle_request(sess->sftpsrv, pkt);
+        reply = sftp_handle_request(sess->sftpsrv, pkt, &sess->sftp_sink);
         sftp_pkt_free(pkt);
 
-        sftp_send_prepare(reply);
-        sshfwd_write(sess->c, reply->data, reply->length);
-        sftp_pkt_free(reply);
+        if (reply)
+            sftp_chan_write_reply(sess, reply);
     }
 
     return 0;
@@ -763,7 +788,10 @@ static size_t sftp_chan_send(Channel *chan, bool is_stderr,
 static void sftp_chan_send_eof(Channel *chan)
 {
     sesschan *sess = container_of(chan, sesschan, chan);
-    sshfwd_write_eof(sess->c);
+    if (sess->sftp_sink.outstanding)
+        sess->sftp_eof_pending = true;
+    else
+        sshfwd_write_eof(sess->c);
 }
 
 static char *sftp_log_close_msg(Channel *chan)
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
 #include <limits.h>
 
@@ -15,6 +16,20 @@
 static const char *fxp_error_message;
 static int fxp_errtype;
 
+/* Extension names advertised by the server, each followed by a NUL */
+static strbuf *fxp_extensions;
+
+/*
+ * Every server must cope with reads and writes of 32K; if it tells
+ * us (via limits@openssh.com) that it can do more, we go up to this
+ * limit, which keeps the reply packets well inside what sftp_recv
+ * will accept.
+ */
+#define FXP_DEFAULT_BLOCKSIZE 32768
+#define FXP_MAX_BLOCKSIZE 262144
+static int fxp_read_size = FXP_DEFAULT_BLOCKSIZE;
+static int fxp_write_size = FXP_DEFAULT_BLOCKSIZE;
+
 static void fxp_internal_error(const char *msg);
 
 /* ----------------------------------------------------------------------
@@ -39,8 +54,8 @@ struct sftp_packet *sftp_recv(void)
         return NULL;
 
     /* Impose _some_ upper bound on packet size. We never expect to
-     * receive more than 32K of data in response to an FXP_READ,
-     * because we decide how much data to ask for. FXP_READDIR and
+     * receive more than FXP_MAX_BLOCKSIZE of data in response to an
+     * FXP_READ, because we decide how much data to ask for. FXP_READDIR and
      * pathname-returning things like FXP_REALPATH don't have an
      * explicit bound, so I suppose we just have to trust the server
      * to be sensible. */
@@ -287,17 +302,129 @@ bool fxp_init(void)
         sftp_pkt_free(pktin);
         return false;
     }
+
     /*
-     * In principle, this packet might also contain extension-
-     * string pairs. We should work through them and look for any
-     * we recognise. In practice we don't currently do so because
-     * we know we don't recognise _any_.
+     * The rest of the packet is extension-name, extension-data
+     * string pairs. Remember the names, so we know what we can use.
      */
+    if (fxp_extensions)
+        strbuf_clear(fxp_extensions);
+    else
+        fxp_extensions = strbuf_new();
+    while (get_avail(pktin)) {
+        ptrlen name = get_string(pktin);
+        get_string(pktin);             /* we don't look at the data */
+        if (get_err(pktin))
+            break;
+        put_datapl(fxp_extensions, name);
+        put_byte(fxp_extensions, '\0');
+    }
     sftp_pkt_free(pktin);
 
+    fxp_read_size = fxp_write_size = FXP_DEFAULT_BLOCKSIZE;
+    if (fxp_has_extension(SFTP_EXT_LIMITS)) {
+        /*
+         * Nothing else can be in flight yet, so we can just wait for
+         * the reply right here.
+         */
+        struct sftp_request *req = fxp_limits_send(), *rreq;
+        struct fxp_limits limits;
+
+        sftp_register(req);
+        pktin = sftp_recv();
+        rreq = sftp_find_request(pktin);
+        if (rreq != req) {
+            fxp_internal_error("unable to understand reply to "
+                               SFTP_EXT_LIMITS);
+            del234(sftp_requests, req);
+            sfree(req);
+            if (pktin)
+                sftp_pkt_free(pktin);
+            return false;
+        }
+        if (fxp_limits_recv(pktin, rreq, &limits)) {
+            /* Leave room for the packet headers around the data. A
+             * limit too small even for those leaves our defaults alone. */
+            uint64_t maxdata = FXP_MAX_BLOCKSIZE;
+            if (limits.max_packet_length)
+                maxdata = limits.max_packet_length > 1024 ?
+                    limits.max_packet_length - 1024 : 0;
+            uint64_t r = limits.max_read_length ?
+                limits.max_read_length : maxdata;
+            uint64_t w = limits.max_write_length ?
+                limits.max_write_length : maxdata;
+            if (r > maxdata)
+                r = maxdata;
+            if (w > maxdata)
+                w = maxdata;
+            if (r > FXP_DEFAULT_BLOCKSIZE)
+                fxp_read_size = r < FXP_MAX_BLOCKSIZE ? r : FXP_MAX_BLOCKSIZE;
+            if (w > FXP_DEFAULT_BLOCKSIZE)
+                fxp_write_size = w < FXP_MAX_BLOCKSIZE ? w : FXP_MAX_BLOCKSIZE;
+        }
+    }
+
     return true;
 }
 
+/*
+ * File name extensions of formats that are compressed already, so
+ * that compressing them again would only waste time.
+ */
+static const char *const fxp_precompressed_exts[] = {
+    "7z", "apk", "avi", "bz2", "deb", "docx", "flac", "gif", "gz", "heic",
+    "jar", "jpeg", "jpg", "lz", "lz4", "lzma", "m4a", "mkv", "mov", "mp3",
+    "mp4", "ogg", "pdf", "png", "rar", "rpm", "tbz", "tbz2", "tgz", "txz",
+    "webm", "webp", "xlsx", "xz", "z", "zip", "zst",
+};
+
+bool fxp_try_compression(struct fxp_handle *handle, const char *filename)
+{
+    handle->compress = false;
+
+    if (!fxp_has_extension(SFTP_EXT_COMPRESSED_READ) ||
+        !fxp_has_extension(SFTP_EXT_COMPRESSED_WRITE))
+        return false;
+
+    const char *base = strrchr(filename, '/');
+    base = base ? base + 1 : filename;
+    const char *dot = strrchr(base, '.');
+    if (dot && strlen(dot + 1) < 8) {
+        char ext[8];
+        size_t i;
+        for (i = 0; dot[i+1]; i++)
+            ext[i] = tolower((unsigned char)dot[i+1]);
+        ext[i] = '\0';
+        for (i = 0; i < lenof(fxp_precompressed_exts); i++)
+            if (!strcmp(ext, fxp_precompressed_exts[i]))
+                return false;
+    }
+
+    handle->compress = true;
+    return true;
+}
+
+bool fxp_has_extension(const char *name)
+{
+    if (!fxp_extensions)
+        return false;
+    for (size_t pos = 0; pos < fxp_extensions->len;
+         pos += strlen(fxp_extensions->s + pos) + 1)
+        if (!strcmp(fxp_extensions->s + pos, name))
+            return true;
+    return false;
+}
+
+int fxp_read_blocksize(void)
+{
+    return fxp_read_size;
+}
+
+int fxp_write_blocksize(void)
+{
+    return fxp_write_size;
+}
+
 /*
  * Canonify a pathname.
  */
@@ -378,6 +505,7 @@ static struct fxp_handle *fxp_got_handle(struct sftp_packet *pktin)
     handle = snew(struct fxp_handle);
     handle->hstring = mkstr(id);
     handle->hlen = id.len;
+    handle->compress = false;
     sftp_pkt_free(pktin);
     return handle;
 }
@@ -708,6 +836,44 @@ int fxp_read_recv(struct sftp_packet *pktin, struct sftp_request *req,
         memcpy(buffer, data.ptr, data.len);
         sftp_pkt_free(pktin);
         return data.len;
+    } else if (pktin->type == SSH_FXP_EXTENDED_REPLY) {
+        /* Only a compressed-read can get this reply */
+        ptrlen codec, data;
+        unsigned long rawlen;
+        bool ok;
+
+        codec = get_string(pktin);
+        rawlen = get_uint32(pktin);
+        data = get_string(pktin);
+        if (get_err(pktin)) {
+            fxp_internal_error("malformed " SFTP_EXT_COMPRESSED_READ
+                               " reply");
+            sftp_pkt_free(pktin);
+            return -1;
+        }
+
+        if (rawlen > len) {
+            fxp_internal_error("READ returned more bytes than requested");
+            sftp_pkt_free(pktin);
+            return -1;
+        }
+
+        if (ptrlen_eq_string(codec, "none")) {
+            ok = (data.len == rawlen);
+            if (ok)
+                memcpy(buffer, data.ptr, data.len);
+        } else if (ptrlen_eq_string(codec, SFTP_COMPRESSION_CODEC)) {
+            ok = lz4_block_decompress(data, buffer, rawlen);
+        } else {
+            ok = false;
+        }
+        sftp_pkt_free(pktin);
+        if (!ok) {
+            fxp_internal_error("unable to decompress data from "
+                               SFTP_EXT_COMPRESSED_READ);
+            return -1;
+        }
+        return rawlen;
     } else {
         fxp_got_status(pktin);
         sftp_pkt_free(pktin);
@@ -822,6 +988,209 @@ bool fxp_write_recv(struct sftp_packet *pktin, struct sftp_request *req)
     return fxp_errtype == SSH_FX_OK;
 }
 
+/*
+ * Extensions.
+ */
+static struct sftp_packet *fxp_extended_init(
+    struct sftp_request *req, const char *name)
+{
+    struct sftp_packet *pktout = sftp_pkt_init(SSH_FXP_EXTENDED);
+    put_uint32(pktout, req->id);
+    put_stringz(pktout, name);
+    return pktout;
+}
+
+/*
+ * compressed-read and compressed-write. The reply to a compressed
+ * read is decoded by fxp_read_recv, and a compressed write is
+ * answered just like a normal one.
+ */
+struct sftp_request *fxp_read_compressed_send(
+    struct fxp_handle *handle, uint64_t offset, int len)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(
+        req, SFTP_EXT_COMPRESSED_READ);
+    put_string(pktout, handle->hstring, handle->hlen);
+    put_uint64(pktout, offset);
+    put_uint32(pktout, len);
+    put_stringz(pktout, SFTP_COMPRESSION_CODEC);
+    sftp_send(pktout);
+    return req;
+}
+
+struct sftp_request *fxp_write_compressed_send(
+    struct fxp_handle *handle, void *buffer, uint64_t offset, int len)
+{
+    strbuf *z = strbuf_new_nm();
+    lz4_block_compress(make_ptrlen(buffer, len), z);
+
+    if (z->len >= len) {
+        /* Not worth it: send the data as it is */
+        strbuf_free(z);
+        return fxp_write_send(handle, buffer, offset, len);
+    }
+
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(
+        req, SFTP_EXT_COMPRESSED_WRITE);
+    put_string(pktout, handle->hstring, handle->hlen);
+    put_uint64(pktout, offset);
+    put_stringz(pktout, SFTP_COMPRESSION_CODEC);
+    put_uint32(pktout, len);
+    put_stringsb(pktout, z);
+    sftp_send(pktout);
+    return req;
+}
+
+struct sftp_request *fxp_limits_send(void)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    sftp_send(fxp_extended_init(req, SFTP_EXT_LIMITS));
+    return req;
+}
+
+bool fxp_limits_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                     struct fxp_limits *limits)
+{
+    sfree(req);
+    if (pktin->type == SSH_FXP_EXTENDED_REPLY) {
+        limits->max_packet_length = get_uint64(pktin);
+        limits->max_read_length = get_uint64(pktin);
+        limits->max_write_length = get_uint64(pktin);
+        limits->max_open_handles = get_uint64(pktin);
+        if (get_err(pktin)) {
+            fxp_internal_error("malformed " SFTP_EXT_LIMITS " reply");
+            sftp_pkt_free(pktin);
+            return false;
+        }
+        sftp_pkt_free(pktin);
+        return true;
+    } else {
+        fxp_got_status(pktin);
+        sftp_pkt_free(pktin);
+        return false;
+    }
+}
+
+struct sftp_request *fxp_statvfs_send(const char *path)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(req, SFTP_EXT_STATVFS);
+    put_stringz(pktout, path);
+    sftp_send(pktout);
+    return req;
+}
+
+bool fxp_statvfs_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                      struct fxp_statvfs *st)
+{
+    sfree(req);
+    if (pktin->type == SSH_FXP_EXTENDED_REPLY) {
+        st->bsize = get_uint64(pktin);
+        st->frsize = get_uint64(pktin);
+        st->blocks = get_uint64(pktin);
+        st->bfree = get_uint64(pktin);
+        st->bavail = get_uint64(pktin);
+        st->files = get_uint64(pktin);
+        st->ffree = get_uint64(pktin);
+        st->favail = get_uint64(pktin);
+        st->fsid = get_uint64(pktin);
+        st->flag = get_uint64(pktin);
+        st->namemax = get_uint64(pktin);
+        if (get_err(pktin)) {
+            fxp_internal_error("malformed " SFTP_EXT_STATVFS " reply");
+            sftp_pkt_free(pktin);
+            return false;
+        }
+        sftp_pkt_free(pktin);
+        return true;
+    } else {
+        fxp_got_status(pktin);
+        sftp_pkt_free(pktin);
+        return false;
+    }
+}
+
+struct sftp_request *fxp_fsync_send(struct fxp_handle *handle)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(req, SFTP_EXT_FSYNC);
+    put_string(pktout, handle->hstring, handle->hlen);
+    sftp_send(pktout);
+    return req;
+}
+
+bool fxp_fsync_recv(struct sftp_packet *pktin, struct sftp_request *req)
+{
+    sfree(req);
+    fxp_got_status(pktin);
+    sftp_pkt_free(pktin);
+    return fxp_errtype == SSH_FX_OK;
+}
+
+struct sftp_request *fxp_copy_data_send(
+    struct fxp_handle *src, uint64_t srcoffset, uint64_t length,
+    struct fxp_handle *dst, uint64_t dstoffset)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(req, SFTP_EXT_COPY_DATA);
+    put_string(pktout, src->hstring, src->hlen);
+    put_uint64(pktout, srcoffset);
+    put_uint64(pktout, length);
+    put_string(pktout, dst->hstring, dst->hlen);
+    put_uint64(pktout, dstoffset);
+    sftp_send(pktout);
+    return req;
+}
+
+bool fxp_copy_data_recv(struct sftp_packet *pktin, struct sftp_request *req)
+{
+    sfree(req);
+    fxp_got_status(pktin);
+    sftp_pkt_free(pktin);
+    return fxp_errtype == SSH_FX_OK;
+}
+
+struct sftp_request *fxp_check_file_send(
+    struct fxp_handle *handle, const char *algorithms,
+    uint64_t offset, uint64_t length, uint32_t blocksize)
+{
+    struct sftp_request *req = sftp_alloc_request();
+    struct sftp_packet *pktout = fxp_extended_init(
+        req, SFTP_EXT_CHECK_FILE_HANDLE);
+    put_string(pktout, handle->hstring, handle->hlen);
+    put_stringz(pktout, algorithms);
+    put_uint64(pktout, offset);
+    put_uint64(pktout, length);
+    put_uint32(pktout, blocksize);
+    sftp_send(pktout);
+    return req;
+}
+
+char *fxp_check_file_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                          strbuf *hashes)
+{
+    sfree(req);
+    if (pktin->type == SSH_FXP_EXTENDED_REPLY) {
+        ptrlen name = get_string(pktin);
+        ptrlen alg = get_string(pktin);
+        if (get_err(pktin) || !ptrlen_eq_string(name, SFTP_EXT_CHECK_FILE)) {
+            fxp_internal_error("malformed " SFTP_EXT_CHECK_FILE " reply");
+            sftp_pkt_free(pktin);
+            return NULL;
+        }
+        put_datapl(hashes, get_data(pktin, get_avail(pktin)));
+        char *toret = mkstr(alg);
+        sftp_pkt_free(pktin);
+        return toret;
+    } else {
+        fxp_got_status(pktin);
+        sftp_pkt_free(pktin);
+        return NULL;
+    }
+}
+
 /*
  * Free up an fxp_names structure.
  */
@@ -886,7 +1255,7 @@ struct req {
 };
 
 struct fxp_xfer {
-    uint64_t offset, furthestdata, filesize;
+    uint64_t offset, furthestdata, filesize, end;
     int req_totalsize, req_maxsize;
     bool eof, err;
     struct fxp_handle *fh;
@@ -902,8 +1271,11 @@ static struct fxp_xfer *xfer_init(struct fxp_handle *fh, uint64_t offset)
     xfer->head = xfer->tail = NULL;
     xfer->req_totalsize = 0;
     xfer->req_maxsize = 1048576;
+    if (xfer->req_maxsize < 8 * fxp_read_size)
+        xfer->req_maxsize = 8 * fxp_read_size;
     xfer->err = false;
     xfer->filesize = UINT64_MAX;
+    xfer->end = UINT64_MAX;
     xfer->furthestdata = 0;
 
     return xfer;
@@ -941,14 +1313,24 @@ void xfer_download_queue(struct fxp_xfer *xfer)
         xfer->tail = rr;
         rr->next = NULL;
 
-        rr->len = 32768;
+        rr->len = fxp_read_size;
+        if (rr->len > xfer->end - xfer->offset)
+            rr->len = xfer->end - xfer->offset;
         rr->buffer = snewn(rr->len, char);
-        sftp_register(req = fxp_read_send(xfer->fh, rr->offset, rr->len));
+        if (xfer->fh->compress)
+            req = fxp_read_compressed_send(xfer->fh, rr->offset, rr->len);
+        else
+            req = fxp_read_send(xfer->fh, rr->offset, rr->len);
+        sftp_register(req);
         fxp_set_userdata(req, rr);
 
         xfer->offset += rr->len;
         xfer->req_totalsize += rr->len;
 
+        /* A download of a limited range stops as if it had hit EOF */
+        if (xfer->offset >= xfer->end)
+            xfer->eof = true;
+
 #ifdef DEBUG_DOWNLOAD
         printf("queueing read request %p at %"PRIu64"\n", rr, rr->offset);
 #endif
@@ -965,6 +1347,18 @@ struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset)
     return xfer;
 }
 
+struct fxp_xfer *xfer_download_range_init(
+    struct fxp_handle *fh, uint64_t offset, uint64_t length)
+{
+    struct fxp_xfer *xfer = xfer_init(fh, offset);
+
+    xfer->end = offset + length;
+    xfer->eof = (length == 0);
+    xfer_download_queue(xfer);
+
+    return xfer;
+}
+
 /*
  * Returns INT_MIN to indicate that it didn't even get as far as
  * fxp_read_recv and hence has not freed pktin.
@@ -1134,7 +1528,11 @@ void xfer_upload_data(struct fxp_xfer *xfer, char *buffer, int len)
 
     rr->len = len;
     rr->buffer = NULL;
-    sftp_register(req = fxp_write_send(xfer->fh, buffer, rr->offset, len));
+    if (xfer->fh->compress)
+        req = fxp_write_compressed_send(xfer->fh, buffer, rr->offset, len);
+    else
+        req = fxp_write_send(xfer->fh, buffer, rr->offset, len);
+    sftp_register(req);
     fxp_set_userdata(req, rr);
 
     xfer->offset += rr->len;
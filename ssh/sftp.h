@@ -55,6 +55,53 @@
 
 #define SFTP_PROTO_VERSION 3
 
+/*
+ * Extended request (SSH_FXP_EXTENDED) supported by our own server:
+ * a READDIR which returns only the file names, with no longname and
+ * no attributes. Its single argument is the directory handle.
+ */
+#define SFTP_EXT_READDIR_NAMES "readdir-names@putty.projects.tartarus.org"
+
+/*
+ * More of our own extensions: READ and WRITE with the file data
+ * compressed, so that compressible files can be transferred faster
+ * over slow links without having to compress the whole SSH
+ * connection. Each block is compressed on its own, using the codec
+ * in sftpcompress.c, which the extension value names.
+ *
+ * compressed-read takes the same arguments as READ, followed by the
+ * name of the codec to use. It's answered with an EXTENDED_REPLY
+ * containing the name of the codec actually used ("none" if the data
+ * wouldn't compress), a uint32 giving the uncompressed length, and
+ * then the data as a string; or with a STATUS, just like READ.
+ *
+ * compressed-write takes a handle, an offset, a codec name, a uint32
+ * uncompressed length and the compressed data, and is answered like
+ * WRITE.
+ */
+#define SFTP_EXT_COMPRESSED_READ "compressed-read@putty.projects.tartarus.org"
+#define SFTP_EXT_COMPRESSED_WRITE \
+    "compressed-write@putty.projects.tartarus.org"
+#define SFTP_COMPRESSION_CODEC "lz4"
+/* The most data a compressed-write may expand to */
+#define SFTP_COMPRESSED_WRITE_MAX 1048576
+
+void lz4_block_compress(ptrlen input, strbuf *out);
+bool lz4_block_decompress(ptrlen input, void *output, size_t outlen);
+
+/*
+ * Other people's extensions which both our client and our server
+ * know about. copy-data and check-file are from
+ * draft-ietf-secsh-filexfer-extensions; the rest are OpenSSH's.
+ */
+#define SFTP_EXT_COPY_DATA "copy-data"
+#define SFTP_EXT_CHECK_FILE "check-file"
+#define SFTP_EXT_CHECK_FILE_HANDLE "check-file-handle"
+#define SFTP_EXT_CHECK_FILE_NAME "check-file-name"
+#define SFTP_EXT_STATVFS "statvfs@openssh.com"
+#define SFTP_EXT_FSYNC "fsync@openssh.com"
+#define SFTP_EXT_LIMITS "limits@openssh.com"
+
 #define PERMS_DIRECTORY   040000
 
 /*
@@ -106,6 +153,7 @@ extern const struct fxp_attrs no_attrs;
 struct fxp_handle {
     char *hstring;
     int hlen;
+    bool compress;           /* use compressed-read and -write for xfers */
 };
 
 struct fxp_name {
@@ -165,9 +213,34 @@ int fxp_error_type(void);
 
 /*
  * Perform exchange of init/version packets. Return false on failure.
+ *
+ * If the server supports limits@openssh.com, this also asks it for
+ * its limits, and sizes subsequent transfers to suit.
  */
 bool fxp_init(void);
 
+/*
+ * Find out whether the server advertised a given extension in its
+ * FXP_VERSION packet.
+ */
+bool fxp_has_extension(const char *name);
+
+/*
+ * Sizes of the individual requests the fxp_xfer system will use for
+ * reading and writing. Callers feeding xfer_upload_data should give
+ * it this much at a time.
+ */
+int fxp_read_blocksize(void);
+int fxp_write_blocksize(void);
+
+/*
+ * Ask for the data of an open file to be compressed in transit by
+ * the fxp_xfer system, if the server supports that and the file's
+ * name doesn't suggest it's compressed already. Returns whether
+ * compression was turned on.
+ */
+bool fxp_try_compression(struct fxp_handle *handle, const char *filename);
+
 /*
  * Canonify a pathname. Concatenate the two given path elements
  * with a separating slash, unless the second is NULL.
@@ -258,6 +331,63 @@ struct sftp_request *fxp_write_send(struct fxp_handle *handle,
                                     void *buffer, uint64_t offset, int len);
 bool fxp_write_recv(struct sftp_packet *pktin, struct sftp_request *req);
 
+/*
+ * Extensions. Only send these if fxp_has_extension says the server
+ * supports them.
+ */
+
+/* compressed-read and compressed-write. The fxp_xfer system uses
+ * these for handles that fxp_try_compression has been called on. */
+struct sftp_request *fxp_read_compressed_send(
+    struct fxp_handle *handle, uint64_t offset, int len);
+struct sftp_request *fxp_write_compressed_send(
+    struct fxp_handle *handle, void *buffer, uint64_t offset, int len);
+
+/* limits@openssh.com. A zero value means no particular limit. */
+struct fxp_limits {
+    uint64_t max_packet_length, max_read_length, max_write_length;
+    uint64_t max_open_handles;
+};
+struct sftp_request *fxp_limits_send(void);
+bool fxp_limits_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                     struct fxp_limits *limits);
+
+/* statvfs@openssh.com, with the fields of POSIX struct statvfs */
+struct fxp_statvfs {
+    uint64_t bsize, frsize, blocks, bfree, bavail;
+    uint64_t files, ffree, favail, fsid, flag, namemax;
+};
+#define SFTP_STATVFS_RDONLY 0x1
+#define SFTP_STATVFS_NOSUID 0x2
+struct sftp_request *fxp_statvfs_send(const char *path);
+bool fxp_statvfs_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                      struct fxp_statvfs *st);
+
+/* fsync@openssh.com: flush an open file to stable storage */
+struct sftp_request *fxp_fsync_send(struct fxp_handle *handle);
+bool fxp_fsync_recv(struct sftp_packet *pktin, struct sftp_request *req);
+
+/* copy-data: copy 'length' bytes (or up to EOF, if length is 0)
+ * between two open files on the server */
+struct sftp_request *fxp_copy_data_send(
+    struct fxp_handle *src, uint64_t srcoffset, uint64_t length,
+    struct fxp_handle *dst, uint64_t dstoffset);
+bool fxp_copy_data_recv(struct sftp_packet *pktin, struct sftp_request *req);
+
+/*
+ * check-file-handle: have the server hash part of an open file, using
+ * the first algorithm in the comma-separated list that it supports.
+ * If blocksize is nonzero, the range is split into blocks of that
+ * size and a hash is returned for each one. A length of 0 means up to
+ * EOF. On success, returns the name of the algorithm used (dynamically
+ * allocated), and appends the hash(es) to 'hashes'.
+ */
+struct sftp_request *fxp_check_file_send(
+    struct fxp_handle *handle, const char *algorithms,
+    uint64_t offset, uint64_t length, uint32_t blocksize);
+char *fxp_check_file_recv(struct sftp_packet *pktin, struct sftp_request *req,
+                          strbuf *hashes);
+
 /*
  * Read from a directory.
  */
@@ -299,6 +429,9 @@ struct sftp_packet *sftp_recv(void);
 struct fxp_xfer;
 
 struct fxp_xfer *xfer_download_init(struct fxp_handle *fh, uint64_t offset);
+/* Like xfer_download_init, but stops after 'length' bytes */
+struct fxp_xfer *xfer_download_range_init(
+    struct fxp_handle *fh, uint64_t offset, uint64_t length);
 void xfer_download_queue(struct fxp_xfer *xfer);
 int xfer_download_gotpkt(struct fxp_xfer *xfer, struct sftp_packet *pktin);
 bool xfer_download_data(struct fxp_xfer *xfer, void **buf, int *len);
@@ -317,6 +450,7 @@ void xfer_cleanup(struct fxp_xfer *xfer);
  * answers requests in an SFTP server.
  */
 typedef struct SftpReplyBuilder SftpReplyBuilder;
+typedef struct SftpReplySink SftpReplySink;
 struct SftpServer {
     const SftpServerVtable *vt;
 };
@@ -384,9 +518,25 @@ struct SftpServerVtable {
                   ptrlen handle, uint64_t offset, ptrlen data);
 
     /* Should call fxp_reply_error, or fxp_reply_name_count once and
-     * then fxp_reply_full_name that many times */
+     * then fxp_reply_full_name that many times. If omit_attrs is set,
+     * the caller only wants the names, so the server needn't stat
+     * anything (and no longname is wanted either). */
     void (*readdir)(SftpServer *srv, SftpReplyBuilder *reply, ptrlen handle,
-                    int max_entries, bool omit_longname);
+                    int max_entries, bool omit_longname, bool omit_attrs);
+
+    /* Should call fxp_reply_error or fxp_reply_ok. Flushes the file
+     * to stable storage (fsync@openssh.com). */
+    void (*fsync)(SftpServer *srv, SftpReplyBuilder *reply, ptrlen handle);
+
+    /* Should call fxp_reply_error or fxp_reply_statvfs */
+    void (*statvfs)(SftpServer *srv, SftpReplyBuilder *reply, ptrlen path);
+
+    /* Should call fxp_reply_error or fxp_reply_ok. Copies 'length'
+     * bytes (or everything up to EOF, if it's 0) from one open file
+     * to another, without the data passing through the client. */
+    void (*copy_data)(SftpServer *srv, SftpReplyBuilder *reply,
+                      ptrlen srchandle, uint64_t srcoffset, uint64_t length,
+                      ptrlen dsthandle, uint64_t dstoffset);
 };
 
 static inline SftpServer *sftpsrv_new(const SftpServerVtable *vt)
@@ -439,8 +589,21 @@ static inline void sftpsrv_write(SftpServer *srv, SftpReplyBuilder *reply,
 { srv->vt->write(srv, reply, handle, offset, data); }
 static inline void sftpsrv_readdir(
     SftpServer *srv, SftpReplyBuilder *reply, ptrlen handle,
-    int max_entries, bool omit_longname)
-{ srv->vt->readdir(srv, reply, handle, max_entries, omit_longname); }
+    int max_entries, bool omit_longname, bool omit_attrs)
+{ srv->vt->readdir(srv, reply, handle, max_entries,
+                   omit_longname, omit_attrs); }
+static inline void sftpsrv_fsync(
+    SftpServer *srv, SftpReplyBuilder *reply, ptrlen handle)
+{ srv->vt->fsync(srv, reply, handle); }
+static inline void sftpsrv_statvfs(
+    SftpServer *srv, SftpReplyBuilder *reply, ptrlen path)
+{ srv->vt->statvfs(srv, reply, path); }
+static inline void sftpsrv_copy_data(
+    SftpServer *srv, SftpReplyBuilder *reply,
+    ptrlen srchandle, uint64_t srcoffset, uint64_t length,
+    ptrlen dsthandle, uint64_t dstoffset)
+{ srv->vt->copy_data(srv, reply, srchandle, srcoffset, length,
+                     dsthandle, dstoffset); }
 
 typedef struct SftpReplyBuilderVtable SftpReplyBuilderVtable;
 struct SftpReplyBuilder {
@@ -457,6 +620,34 @@ struct SftpReplyBuilderVtable {
     void (*reply_handle)(SftpReplyBuilder *reply, ptrlen handle);
     void (*reply_data)(SftpReplyBuilder *reply, ptrlen data);
     void (*reply_attrs)(SftpReplyBuilder *reply, struct fxp_attrs attrs);
+    void (*reply_statvfs)(SftpReplyBuilder *reply,
+                          const struct fxp_statvfs *st);
+
+    /*
+     * Optional: return space for up to 'maxlen' bytes of file data
+     * inside the reply itself, so that a server answering FXP_READ
+     * can read straight into it rather than into a buffer of its own
+     * which reply_data then has to copy. Having asked for it, the
+     * server must go on to call either reply_data, with data starting
+     * at the returned pointer, or reply_error. A NULL return (or a
+     * NULL method) means the builder would rather be given a copy.
+     */
+    void *(*data_buffer)(SftpReplyBuilder *reply, size_t maxlen);
+
+    /*
+     * Optional support for answering a request later, so that a
+     * server can hand slow filesystem operations to a background
+     * worker. 'defer' returns a new SftpReplyBuilder for the same
+     * request, which the server fills in at its leisure (leaving the
+     * original one untouched) and then passes to fxp_reply_send. If
+     * the server is torn down before then, it must pass the builder
+     * to fxp_reply_abandon instead. If the caller needs its answer
+     * straight away, 'defer' is NULL (or returns NULL), and the
+     * server must reply synchronously as usual.
+     */
+    SftpReplyBuilder *(*defer)(SftpReplyBuilder *reply);
+    void (*send)(SftpReplyBuilder *reply);
+    void (*abandon)(SftpReplyBuilder *reply);
 };
 
 static inline void fxp_reply_ok(SftpReplyBuilder *reply)
@@ -479,6 +670,21 @@ static inline void fxp_reply_data(SftpReplyBuilder *reply, ptrlen data)
 static inline void fxp_reply_attrs(
     SftpReplyBuilder *reply, struct fxp_attrs attrs)
 { reply->vt->reply_attrs(reply, attrs); }
+static inline void fxp_reply_statvfs(
+    SftpReplyBuilder *reply, const struct fxp_statvfs *st)
+{ reply->vt->reply_statvfs(reply, st); }
+static inline void *fxp_reply_data_buffer(
+    SftpReplyBuilder *reply, size_t maxlen)
+{
+    return reply->vt->data_buffer ?
+        reply->vt->data_buffer(reply, maxlen) : NULL;
+}
+static inline SftpReplyBuilder *fxp_reply_defer(SftpReplyBuilder *reply)
+{ return reply->vt->defer ? reply->vt->defer(reply) : NULL; }
+static inline void fxp_reply_send(SftpReplyBuilder *reply)
+{ reply->vt->send(reply); }
+static inline void fxp_reply_abandon(SftpReplyBuilder *reply)
+{ reply->vt->abandon(reply); }
 
 /*
  * The usual implementation of an SftpReplyBuilder, containing a
@@ -490,6 +696,23 @@ typedef struct DefaultSftpReplyBuilder DefaultSftpReplyBuilder;
 struct DefaultSftpReplyBuilder {
     SftpReplyBuilder rb;
     struct sftp_packet *pkt;
+    unsigned id;
+    SftpReplySink *sink;
+    bool deferred;
+    bool compress_data;        /* answering a compressed-read */
+    size_t data_start;         /* where data_buffer put FXP_DATA, or 0 */
+};
+
+/*
+ * Destination for replies that were deferred by the SftpServer. The
+ * deliver function takes ownership of the packet, which has not yet
+ * had sftp_send_prepare called on it. 'outstanding' counts the
+ * replies still to come, so that the owner can tell when it's safe
+ * to send EOF.
+ */
+struct SftpReplySink {
+    void (*deliver)(SftpReplySink *sink, struct sftp_packet *reply);
+    size_t outstanding;
 };
 
 /*
@@ -497,9 +720,13 @@ struct DefaultSftpReplyBuilder {
  * implementation of the above SftpServer abstraction to do the actual
  * filesystem work. It handles all the marshalling and unmarshalling
  * of packets, and the copying of request ids into the responses.
+ *
+ * If 'sink' is not NULL, the server may choose to answer the request
+ * later, in which case this function returns NULL and the reply will
+ * turn up via the sink. (SFTP permits replies out of order.)
  */
 struct sftp_packet *sftp_handle_request(
-    SftpServer *srv, struct sftp_packet *request);
+    SftpServer *srv, struct sftp_packet *request, SftpReplySink *sink);
 
 /* ----------------------------------------------------------------------
  * Not exactly SFTP-related, but here's a system that implements an
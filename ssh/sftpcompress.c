@@ -0,0 +1,337 @@
+/*
+ * sftpcompress.c: the block compressor used by PuTTY's
+ * compressed-read and compressed-write SFTP extensions, shared
+ * between client and server.
+ *
+ * The format is the LZ4 block format: a sequence of (literals,
+ * match) pairs, each introduced by a token byte whose top four bits
+ * give the number of literals and whose bottom four give the match
+ * length minus 4, with 15 in either field meaning that more length
+ * bytes follow. Each match is given as a 2-byte little-endian offset
+ * back into the output. The last sequence has literals only.
+ *
+ * This is much cheaper than zlib in both directions (the compressor
+ * is a single greedy pass with a hash table, and the decompressor is
+ * little more than memcpy), which is what's wanted for compressing
+ * file data on the fly. Each block is compressed independently, so
+ * that pipelined SFTP requests can still complete in any order.
+ */
+
+#include <string.h>
+
+#include "misc.h"
+#include "sftp.h"
+
+#define LZ4_HASH_BITS 12
+#define LZ4_MIN_MATCH 4
+#define LZ4_MAX_OFFSET 65535
+/* The format requires the last 5 bytes to be literals, and the last
+ * match to start at least 12 bytes before the end */
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+/* Step further through input that isn't compressing, as the reference
+ * implementation does, so that incompressible data goes by quickly */
+#define LZ4_SKIP_SHIFT 6
+
+static inline unsigned lz4_hash(const unsigned char *p)
+{
+    return (GET_32BIT_LSB_FIRST(p) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static void lz4_put_length(strbuf *out, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        put_byte(out, 255);
+    put_byte(out, len);
+}
+
+static void lz4_put_sequence(strbuf *out, const unsigned char *lit,
+                             size_t litlen, size_t offset, size_t matchlen)
+{
+    size_t ml = matchlen ? matchlen - LZ4_MIN_MATCH : 0;
+
+    put_byte(out, ((litlen < 15 ? litlen : 15) << 4) | (ml < 15 ? ml : 15));
+    if (litlen >= 15)
+        lz4_put_length(out, litlen - 15);
+    put_data(out, lit, litlen);
+
+    if (matchlen) {
+        put_byte(out, offset & 0xFF);
+        put_byte(out, offset >> 8);
+        if (ml >= 15)
+            lz4_put_length(out, ml - 15);
+    }
+}
+
+void lz4_block_compress(ptrlen input, strbuf *out)
+{
+    const unsigned char *in = input.ptr, *end = in + input.len;
+    const unsigned char *anchor = in, *p = in;
+
+    if (input.len > LZ4_MF_LIMIT) {
+        const unsigned char *mflimit = end - LZ4_MF_LIMIT;
+        const unsigned char *matchlimit = end - LZ4_LAST_LITERALS;
+        uint32_t table[1 << LZ4_HASH_BITS];
+        unsigned misses = 0;
+
+        memset(table, 0, sizeof(table));
+
+        while (p < mflimit) {
+            unsigned h = lz4_hash(p);
+            const unsigned char *ref = in + table[h];
+            table[h] = p - in;
+
+            if (ref >= p || p - ref > LZ4_MAX_OFFSET ||
+                GET_32BIT_LSB_FIRST(ref) != GET_32BIT_LSB_FIRST(p)) {
+                p += 1 + (misses++ >> LZ4_SKIP_SHIFT);
+                continue;
+            }
+
+            /* Extend the match forwards, and then backwards over any
+             * literals we were about to emit */
+            const unsigned char *q = p + LZ4_MIN_MATCH;
+            const unsigned char *r = ref + LZ4_MIN_MATCH;
+            while (q < matchlimit && *q == *r) {
+                q++;
+                r++;
+            }
+            while (p > anchor && ref > in && p[-1] == ref[-1]) {
+                p--;
+                ref--;
+            }
+
+            lz4_put_sequence(out, anchor, p - anchor, p - ref, q - p);
+            anchor = p = q;
+            misses = 0;
+        }
+    }
+
+    lz4_put_sequence(out, anchor, end - anchor, 0, 0);
+}
+
+static size_t lz4_get_length(BinarySource *src, size_t len)
+{
+    unsigned char byte;
+    do {
+        byte = get_byte(src);
+        len += byte;
+    } while (byte == 255 && !get_err(src));
+    return len;
+}
+
+bool lz4_block_decompress(ptrlen input, void *output, size_t outlen)
+{
+    BinarySource src[1];
+    unsigned char *out = (unsigned char *)output, *op = out;
+    unsigned char *oend = out + outlen;
+
+    BinarySource_BARE_INIT_PL(src, input);
+
+    while (true) {
+        unsigned char token = get_byte(src);
+        size_t litlen = token >> 4;
+        if (litlen == 15)
+            litlen = lz4_get_length(src, litlen);
+        if (get_err(src) || litlen > (size_t)(oend - op))
+            return false;
+        ptrlen lit = get_data(src, litlen);
+        if (get_err(src))
+            return false;
+        memcpy(op, lit.ptr, lit.len);
+        op += lit.len;
+
+        if (!get_avail(src))
+            break;                     /* that was the last sequence */
+
+        size_t offset = get_byte(src);
+        offset |= (size_t)get_byte(src) << 8;
+        size_t matchlen = token & 15;
+        if (matchlen == 15)
+            matchlen = lz4_get_length(src, matchlen);
+        matchlen += LZ4_MIN_MATCH;
+        if (get_err(src) || offset == 0 || offset > (size_t)(op - out) ||
+            matchlen > (size_t)(oend - op))
+            return false;
+
+        /* Byte by byte, because the source may overlap the output */
+        const unsigned char *ref = op - offset;
+        while (matchlen-- > 0)
+            *op++ = *ref++;
+    }
+
+    return op == oend;
+}
+
+#ifdef TEST
+
+/*
+ * Test code for the LZ4 block codec. Run test_sftpcompress; it exits
+ * nonzero on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int fails, passes;
+
+void out_of_memory(void) { fprintf(stderr, "out of memory\n"); abort(); }
+
+#define CHECK(cond) do {                                        \
+        if (cond) {                                             \
+            passes++;                                           \
+        } else {                                                \
+            printf("%d: failed: %s\n", __LINE__, #cond);        \
+            fails++;                                            \
+        }                                                       \
+    } while (0)
+
+static uint32_t rngstate = 0x12345678;
+static unsigned char rng_byte(void)
+{
+    rngstate ^= rngstate << 13;
+    rngstate ^= rngstate >> 17;
+    rngstate ^= rngstate << 5;
+    return rngstate >> 24;
+}
+
+/* Compress and decompress, checking we get the input back, and that
+ * the decompressor won't accept the wrong output size */
+static void round_trip(const unsigned char *data, size_t len, int line)
+{
+    strbuf *z = strbuf_new();
+    unsigned char *out = snewn(len + 1, unsigned char);
+    ptrlen zpl;
+
+    lz4_block_compress(make_ptrlen(data, len), z);
+    zpl = ptrlen_from_strbuf(z);
+
+    /* Worst case expansion is one length byte per 255 literals */
+    if (z->len > len + len / 255 + 16) {
+        printf("%d: len %"SIZEu": compressed to %"SIZEu"\n",
+               line, len, z->len);
+        fails++;
+    } else
+        passes++;
+
+    if (!lz4_block_decompress(zpl, out, len) || memcmp(out, data, len)) {
+        printf("%d: len %"SIZEu": round trip failed\n", line, len);
+        fails++;
+    } else
+        passes++;
+
+    if (lz4_block_decompress(zpl, out, len + 1) ||
+        (len > 0 && lz4_block_decompress(zpl, out, len - 1))) {
+        printf("%d: len %"SIZEu": accepted wrong output size\n", line, len);
+        fails++;
+    } else
+        passes++;
+
+    sfree(out);
+    strbuf_free(z);
+}
+
+static bool decompress_lit(const char *input, size_t inlen, size_t outlen)
+{
+    unsigned char *out = snewn(outlen + 1, unsigned char);
+    bool toret = lz4_block_decompress(make_ptrlen(input, inlen), out, outlen);
+    sfree(out);
+    return toret;
+}
+
+#define DECOMPRESS(s, outlen) decompress_lit(s, sizeof(s) - 1, outlen)
+
+int main(void)
+{
+    static const size_t sizes[] = {
+        0, 1, 4, 12, 13, 17, 100, 4096, 65536, 65537, 200000,
+    };
+    size_t maxsize = 200000;
+    unsigned char *data = snewn(maxsize, unsigned char);
+
+    for (size_t i = 0; i < lenof(sizes); i++) {
+        size_t len = sizes[i];
+
+        /* Incompressible */
+        for (size_t j = 0; j < len; j++)
+            data[j] = rng_byte();
+        round_trip(data, len, __LINE__);
+
+        /* All one byte, so every match overlaps its own output */
+        memset(data, 'x', len);
+        round_trip(data, len, __LINE__);
+
+        /* Text, with matches of all sorts of lengths and offsets */
+        for (size_t j = 0; j < len; j++)
+            data[j] = "the quick brown fox "[(j * j / 7) % 20];
+        round_trip(data, len, __LINE__);
+
+        /* Repeats further apart than an offset can reach */
+        for (size_t j = 0; j < len; j++)
+            data[j] = j < 70000 ? rng_byte() : data[j - 70000];
+        round_trip(data, len, __LINE__);
+    }
+
+    /* A hand-assembled stream: 'a', then 8 more copied from offset 1 */
+    {
+        unsigned char out[9];
+        CHECK(lz4_block_decompress(PTRLEN_LITERAL("\x14" "a\x01\x00\x00"),
+                                   out, 9));
+        CHECK(!memcmp(out, "aaaaaaaaa", 9));
+    }
+
+    /* No token at all, even for empty output */
+    CHECK(!DECOMPRESS("", 0));
+    /* Truncated literals */
+    CHECK(!DECOMPRESS("\x50" "abc", 5));
+    /* Truncated literal length run */
+    CHECK(!DECOMPRESS("\xF0\xFF", 300));
+    /* Truncated match offset */
+    CHECK(!DECOMPRESS("\x10" "a\x01", 5));
+    /* Truncated match length run */
+    CHECK(!DECOMPRESS("\x1F" "a\x01\x00\xFF", 300));
+    /* Missing final literals-only sequence */
+    CHECK(!DECOMPRESS("\x14" "a\x01\x00", 9));
+    /* Zero offset */
+    CHECK(!DECOMPRESS("\x10" "a\x00\x00\x00", 5));
+    /* Offset further back than the start of the output */
+    CHECK(!DECOMPRESS("\x10" "a\x02\x00\x00", 5));
+    CHECK(!DECOMPRESS("\x10" "a\xFF\xFF\x00", 5));
+    /* Literal length running past the end of the output */
+    CHECK(!DECOMPRESS("\xF0\xFF\xFF\xFF\x00", 10));
+    /* Match length running past the end of the output */
+    CHECK(!DECOMPRESS("\x1F" "a\x01\x00\xFF\xFF\x00\x00", 10));
+    /* Literals alone overflowing the output */
+    CHECK(!DECOMPRESS("\x30" "abc", 2));
+    /* Trailing rubbish after what would have been the right output */
+    CHECK(!DECOMPRESS("\x14" "a\x01\x00\x00" "b", 9));
+
+    /* Corrupt a valid stream at random, and make sure the decompressor
+     * never writes outside its buffer (best checked under a sanitiser) */
+    {
+        size_t len = 4096;
+        strbuf *z = strbuf_new();
+        unsigned char *out = snewn(len, unsigned char);
+        for (size_t j = 0; j < len; j++)
+            data[j] = "the quick brown fox "[(j * j / 7) % 20];
+        lz4_block_compress(make_ptrlen(data, len), z);
+        for (int i = 0; i < 10000; i++) {
+            unsigned char *copy = snewn(z->len, unsigned char);
+            memcpy(copy, z->u, z->len);
+            for (int k = 0; k < 1 + i % 4; k++)
+                copy[(rng_byte() << 8 | rng_byte()) % z->len] = rng_byte();
+            size_t clen = (rng_byte() << 8 | rng_byte()) % (z->len + 1);
+            lz4_block_decompress(make_ptrlen(copy, clen), out, len);
+            sfree(copy);
+        }
+        passes++;
+        sfree(out);
+        strbuf_free(z);
+    }
+
+    sfree(data);
+
+    printf("passed %d failed %d total %d\n", passes, fails, passes+fails);
+    return fails != 0 ? 1 : 0;
+}
+
+#endif
@@ -10,14 +10,47 @@
 #include "ssh.h"
 #include "sftp.h"
 
+/*
+ * The limits we advertise via limits@openssh.com. Our own packet
+ * reader will accept anything, so these are only there to let
+ * clients know they can use bigger reads and writes than the 32K the
+ * protocol draft guarantees; 1K is left for the packet headers.
+ */
+#define SFTP_SERVER_MAX_PACKET 262144
+#define SFTP_SERVER_MAX_DATA (SFTP_SERVER_MAX_PACKET - 1024)
+
+/*
+ * Hash functions we can use for check-file, in the order we'd prefer
+ * them if the client doesn't say.
+ */
+static const struct {
+    const char *name;
+    const ssh_hashalg *alg;
+} check_file_hashes[] = {
+    { "sha256", &ssh_sha256 },
+    { "sha512", &ssh_sha512 },
+    { "sha384", &ssh_sha384 },
+    { "sha1", &ssh_sha1 },
+    { "md5", &ssh_md5 },
+};
+
+static void check_file_handle(
+    SftpServer *srv, SftpReplyBuilder *rb, struct sftp_packet *reply,
+    ptrlen handle, ptrlen algorithms, uint64_t offset, uint64_t length,
+    uint32_t blocksize);
+static void check_file_name(
+    SftpServer *srv, SftpReplyBuilder *rb, struct sftp_packet *reply,
+    ptrlen path, ptrlen algorithms, uint64_t offset, uint64_t length,
+    uint32_t blocksize);
+
 struct sftp_packet *sftp_handle_request(
-    SftpServer *srv, struct sftp_packet *req)
+    SftpServer *srv, struct sftp_packet *req, SftpReplySink *sink)
 {
     struct sftp_packet *reply;
     unsigned id;
     uint32_t flags;
-    ptrlen path, dstpath, handle, data;
-    uint64_t offset;
+    ptrlen path, dstpath, handle, dsthandle, data, extname;
+    uint64_t offset, dstoffset, length64;
     unsigned length;
     struct fxp_attrs attrs;
     DefaultSftpReplyBuilder dsrb;
@@ -35,6 +68,22 @@ struct sftp_packet *sftp_handle_request(
          * input packet.
          */
         put_uint32(reply, SFTP_PROTO_VERSION);
+        put_stringz(reply, SFTP_EXT_READDIR_NAMES);
+        put_stringz(reply, "1");
+        put_stringz(reply, SFTP_EXT_COPY_DATA);
+        put_stringz(reply, "1");
+        put_stringz(reply, SFTP_EXT_CHECK_FILE);
+        put_stringz(reply, "1");
+        put_stringz(reply, SFTP_EXT_STATVFS);
+        put_stringz(reply, "2");
+        put_stringz(reply, SFTP_EXT_FSYNC);
+        put_stringz(reply, "1");
+        put_stringz(reply, SFTP_EXT_LIMITS);
+        put_stringz(reply, "1");
+        put_stringz(reply, SFTP_EXT_COMPRESSED_READ);
+        put_stringz(reply, SFTP_COMPRESSION_CODEC);
+        put_stringz(reply, SFTP_EXT_COMPRESSED_WRITE);
+        put_stringz(reply, SFTP_COMPRESSION_CODEC);
         return reply;
     }
 
@@ -48,6 +97,11 @@ struct sftp_packet *sftp_handle_request(
 
     dsrb.rb.vt = &DefaultSftpReplyBuilder_vt;
     dsrb.pkt = reply;
+    dsrb.id = id;
+    dsrb.sink = sink;
+    dsrb.deferred = false;
+    dsrb.compress_data = false;
+    dsrb.data_start = 0;
     rb = &dsrb.rb;
 
     switch (req->type) {
@@ -165,6 +219,9 @@ struct sftp_packet *sftp_handle_request(
         length = get_uint32(req);
         if (get_err(req))
             goto decode_error;
+        /* Short reads are allowed, and we advertise this limit */
+        if (length > SFTP_SERVER_MAX_DATA)
+            length = SFTP_SERVER_MAX_DATA;
         sftpsrv_read(srv, rb, handle, offset, length);
         break;
 
@@ -172,7 +229,7 @@ struct sftp_packet *sftp_handle_request(
         handle = get_string(req);
         if (get_err(req))
             goto decode_error;
-        sftpsrv_readdir(srv, rb, handle, INT_MAX, false);
+        sftpsrv_readdir(srv, rb, handle, INT_MAX, false, false);
         break;
 
       case SSH_FXP_WRITE:
@@ -184,6 +241,110 @@ struct sftp_packet *sftp_handle_request(
         sftpsrv_write(srv, rb, handle, offset, data);
         break;
 
+      case SSH_FXP_EXTENDED:
+        extname = get_string(req);
+        if (get_err(req))
+            goto decode_error;
+        if (ptrlen_eq_string(extname, SFTP_EXT_READDIR_NAMES)) {
+            handle = get_string(req);
+            if (get_err(req))
+                goto decode_error;
+            sftpsrv_readdir(srv, rb, handle, INT_MAX, true, true);
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_COMPRESSED_READ)) {
+            handle = get_string(req);
+            offset = get_uint64(req);
+            length = get_uint32(req);
+            ptrlen codec = get_string(req);
+            if (get_err(req))
+                goto decode_error;
+            if (!ptrlen_eq_string(codec, SFTP_COMPRESSION_CODEC)) {
+                fxp_reply_error(rb, SSH_FX_OP_UNSUPPORTED,
+                                "Unsupported compression codec");
+            } else {
+                /* The reply builder does the compressing */
+                dsrb.compress_data = true;
+                if (length > SFTP_SERVER_MAX_DATA)
+                    length = SFTP_SERVER_MAX_DATA;
+                sftpsrv_read(srv, rb, handle, offset, length);
+            }
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_COMPRESSED_WRITE)) {
+            handle = get_string(req);
+            offset = get_uint64(req);
+            ptrlen codec = get_string(req);
+            length = get_uint32(req);
+            data = get_string(req);
+            if (get_err(req))
+                goto decode_error;
+            if (!ptrlen_eq_string(codec, SFTP_COMPRESSION_CODEC)) {
+                fxp_reply_error(rb, SSH_FX_OP_UNSUPPORTED,
+                                "Unsupported compression codec");
+            } else if (length > SFTP_COMPRESSED_WRITE_MAX) {
+                fxp_reply_error(rb, SSH_FX_BAD_MESSAGE,
+                                "Compressed write too large");
+            } else {
+                char *buf = snewn(length ? length : 1, char);
+                if (!lz4_block_decompress(data, buf, length)) {
+                    fxp_reply_error(rb, SSH_FX_BAD_MESSAGE,
+                                    "Unable to decompress write data");
+                } else {
+                    sftpsrv_write(srv, rb, handle, offset,
+                                  make_ptrlen(buf, length));
+                }
+                sfree(buf);
+            }
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_LIMITS)) {
+            reply->type = SSH_FXP_EXTENDED_REPLY;
+            put_uint64(reply, SFTP_SERVER_MAX_PACKET);
+            put_uint64(reply, SFTP_SERVER_MAX_DATA); /* max read */
+            put_uint64(reply, SFTP_SERVER_MAX_DATA); /* max write */
+            put_uint64(reply, 0);      /* no limit on open handles */
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_STATVFS)) {
+            path = get_string(req);
+            if (get_err(req))
+                goto decode_error;
+            sftpsrv_statvfs(srv, rb, path);
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_FSYNC)) {
+            handle = get_string(req);
+            if (get_err(req))
+                goto decode_error;
+            sftpsrv_fsync(srv, rb, handle);
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_COPY_DATA)) {
+            handle = get_string(req);
+            offset = get_uint64(req);
+            length64 = get_uint64(req);
+            dsthandle = get_string(req);
+            dstoffset = get_uint64(req);
+            if (get_err(req))
+                goto decode_error;
+            sftpsrv_copy_data(srv, rb, handle, offset, length64,
+                              dsthandle, dstoffset);
+        } else if (ptrlen_eq_string(extname, SFTP_EXT_CHECK_FILE_HANDLE) ||
+                   ptrlen_eq_string(extname, SFTP_EXT_CHECK_FILE_NAME)) {
+            bool by_name = ptrlen_eq_string(
+                extname, SFTP_EXT_CHECK_FILE_NAME);
+            path = get_string(req);    /* or handle */
+            ptrlen algorithms = get_string(req);
+            offset = get_uint64(req);
+            length64 = get_uint64(req);
+            uint32_t blocksize = get_uint32(req);
+            if (get_err(req))
+                goto decode_error;
+            if (blocksize != 0 && blocksize < 256) {
+                fxp_reply_error(rb, SSH_FX_BAD_MESSAGE,
+                                "check-file block size too small");
+            } else if (by_name) {
+                check_file_name(srv, rb, reply, path, algorithms,
+                                offset, length64, blocksize);
+            } else {
+                check_file_handle(srv, rb, reply, path, algorithms,
+                                  offset, length64, blocksize);
+            }
+        } else {
+            fxp_reply_error(rb, SSH_FX_OP_UNSUPPORTED,
+                            "Unrecognised extended request");
+        }
+        break;
+
       default:
         if (get_err(req))
             goto decode_error;
@@ -195,6 +356,12 @@ struct sftp_packet *sftp_handle_request(
         fxp_reply_error(rb, SSH_FX_BAD_MESSAGE, "Unable to decode request");
     }
 
+    if (dsrb.deferred) {
+        /* The answer will turn up later, via the sink */
+        sftp_pkt_free(reply);
+        return NULL;
+    }
+
     return reply;
 }
 
@@ -212,6 +379,11 @@ static void default_reply_error(
 {
     DefaultSftpReplyBuilder *d =
         container_of(reply, DefaultSftpReplyBuilder, rb);
+    if (d->data_start) {
+        /* Throw away the space we handed out for data */
+        d->pkt->length = d->data_start;
+        d->data_start = 0;
+    }
     d->pkt->type = SSH_FXP_STATUS;
     put_uint32(d->pkt, code);
     put_stringz(d->pkt, msg);
@@ -250,10 +422,61 @@ static void default_reply_handle(SftpReplyBuilder *reply, ptrlen handle)
     put_stringpl(d->pkt, handle);
 }
 
+static void *default_reply_data_buffer(
+    SftpReplyBuilder *reply, size_t maxlen)
+{
+    DefaultSftpReplyBuilder *d =
+        container_of(reply, DefaultSftpReplyBuilder, rb);
+    struct sftp_packet *pkt = d->pkt;
+
+    if (d->compress_data)
+        return NULL;           /* the data's going to be rewritten anyway */
+
+    /*
+     * Lay out the FXP_DATA string with a dummy length, and leave room
+     * after it for the data, which default_reply_data will find
+     * already in place.
+     */
+    assert(!d->data_start);
+    d->data_start = pkt->length;
+    put_uint32(pkt, 0);
+    sgrowarrayn_nm(pkt->data, pkt->maxlen, pkt->length, maxlen);
+    return pkt->data + pkt->length;
+}
+
 static void default_reply_data(SftpReplyBuilder *reply, ptrlen data)
 {
     DefaultSftpReplyBuilder *d =
         container_of(reply, DefaultSftpReplyBuilder, rb);
+
+    if (d->data_start) {
+        struct sftp_packet *pkt = d->pkt;
+        assert(data.ptr == pkt->data + d->data_start + 4);
+        PUT_32BIT_MSB_FIRST(pkt->data + d->data_start, data.len);
+        pkt->length = d->data_start + 4 + data.len;
+        pkt->type = SSH_FXP_DATA;
+        d->data_start = 0;
+        return;
+    }
+
+    if (d->compress_data) {
+        strbuf *z = strbuf_new_nm();
+        lz4_block_compress(data, z);
+        d->pkt->type = SSH_FXP_EXTENDED_REPLY;
+        if (z->len < data.len) {
+            put_stringz(d->pkt, SFTP_COMPRESSION_CODEC);
+            put_uint32(d->pkt, data.len);
+            put_stringsb(d->pkt, z);
+        } else {
+            /* Not worth it: send the data as it is */
+            strbuf_free(z);
+            put_stringz(d->pkt, "none");
+            put_uint32(d->pkt, data.len);
+            put_stringpl(d->pkt, data);
+        }
+        return;
+    }
+
     d->pkt->type = SSH_FXP_DATA;
     put_stringpl(d->pkt, data);
 }
@@ -267,6 +490,72 @@ static void default_reply_attrs(
     put_fxp_attrs(d->pkt, attrs);
 }
 
+static void default_reply_statvfs(
+    SftpReplyBuilder *reply, const struct fxp_statvfs *st)
+{
+    DefaultSftpReplyBuilder *d =
+        container_of(reply, DefaultSftpReplyBuilder, rb);
+    d->pkt->type = SSH_FXP_EXTENDED_REPLY;
+    put_uint64(d->pkt, st->bsize);
+    put_uint64(d->pkt, st->frsize);
+    put_uint64(d->pkt, st->blocks);
+    put_uint64(d->pkt, st->bfree);
+    put_uint64(d->pkt, st->bavail);
+    put_uint64(d->pkt, st->files);
+    put_uint64(d->pkt, st->ffree);
+    put_uint64(d->pkt, st->favail);
+    put_uint64(d->pkt, st->fsid);
+    put_uint64(d->pkt, st->flag);
+    put_uint64(d->pkt, st->namemax);
+}
+
+static const SftpReplyBuilderVtable DeferredSftpReplyBuilder_vt;
+
+static SftpReplyBuilder *default_reply_defer(SftpReplyBuilder *reply)
+{
+    DefaultSftpReplyBuilder *d =
+        container_of(reply, DefaultSftpReplyBuilder, rb);
+    if (!d->sink)
+        return NULL;
+
+    assert(!d->deferred);
+    d->deferred = true;
+    d->sink->outstanding++;
+
+    DefaultSftpReplyBuilder *later = snew(DefaultSftpReplyBuilder);
+    later->rb.vt = &DeferredSftpReplyBuilder_vt;
+    later->pkt = sftp_pkt_init(0);
+    put_uint32(later->pkt, d->id);
+    later->id = d->id;
+    later->sink = d->sink;
+    later->deferred = false;
+    later->compress_data = d->compress_data;
+    later->data_start = 0;
+    return &later->rb;
+}
+
+static void deferred_reply_send(SftpReplyBuilder *reply)
+{
+    DefaultSftpReplyBuilder *d =
+        container_of(reply, DefaultSftpReplyBuilder, rb);
+    SftpReplySink *sink = d->sink;
+    struct sftp_packet *pkt = d->pkt;
+    sfree(d);
+    assert(sink->outstanding > 0);
+    sink->outstanding--;
+    sink->deliver(sink, pkt);
+}
+
+static void deferred_reply_abandon(SftpReplyBuilder *reply)
+{
+    DefaultSftpReplyBuilder *d =
+        container_of(reply, DefaultSftpReplyBuilder, rb);
+    assert(d->sink->outstanding > 0);
+    d->sink->outstanding--;
+    sftp_pkt_free(d->pkt);
+    sfree(d);
+}
+
 const SftpReplyBuilderVtable DefaultSftpReplyBuilder_vt = {
     .reply_ok = default_reply_ok,
     .reply_error = default_reply_error,
@@ -276,4 +565,433 @@ const SftpReplyBuilderVtable DefaultSftpReplyBuilder_vt = {
     .reply_handle = default_reply_handle,
     .reply_data = default_reply_data,
     .reply_attrs = default_reply_attrs,
+    .reply_statvfs = default_reply_statvfs,
+    .data_buffer = default_reply_data_buffer,
+    .defer = default_reply_defer,
+};
+
+/*
+ * A reply that was deferred by the server fills in its packet in the
+ * same way, but can't be deferred again, and knows how to deliver
+ * itself to the sink when it's finished.
+ */
+static const SftpReplyBuilderVtable DeferredSftpReplyBuilder_vt = {
+    .reply_ok = default_reply_ok,
+    .reply_error = default_reply_error,
+    .reply_simple_name = default_reply_simple_name,
+    .reply_name_count = default_reply_name_count,
+    .reply_full_name = default_reply_full_name,
+    .reply_handle = default_reply_handle,
+    .reply_data = default_reply_data,
+    .reply_attrs = default_reply_attrs,
+    .reply_statvfs = default_reply_statvfs,
+    .data_buffer = default_reply_data_buffer,
+    .send = deferred_reply_send,
+    .abandon = deferred_reply_abandon,
+};
+
+/*
+ * check-file is answered here rather than by the SftpServer, by
+ * reading the file through the ordinary read method into a private
+ * reply builder which just keeps whatever it's given. The plain
+ * version has no 'defer' method, so its requests happen synchronously;
+ * the one used by a CheckFileJob (below) lets the server answer its
+ * reads in the background.
+ */
+typedef struct CheckFileReader {
+    SftpReplyBuilder rb;
+    unsigned code;
+    char *errmsg;
+    strbuf *data;              /* from reply_data or reply_handle */
+    bool reserved;             /* data_buffer has been called */
+} CheckFileReader;
+
+static void cfr_reply_ok(SftpReplyBuilder *reply)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    cfr->code = SSH_FX_OK;
+}
+
+static void cfr_reply_error(
+    SftpReplyBuilder *reply, unsigned code, const char *msg)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    cfr->code = code;
+    if (cfr->reserved) {
+        strbuf_clear(cfr->data);
+        cfr->reserved = false;
+    }
+    sfree(cfr->errmsg);
+    cfr->errmsg = dupstr(msg);
+}
+
+static void cfr_reply_unexpected(CheckFileReader *cfr)
+{
+    cfr_reply_error(&cfr->rb, SSH_FX_FAILURE, "Unexpected reply type");
+}
+
+static void cfr_reply_simple_name(SftpReplyBuilder *reply, ptrlen name)
+{ cfr_reply_unexpected(container_of(reply, CheckFileReader, rb)); }
+static void cfr_reply_name_count(SftpReplyBuilder *reply, unsigned count)
+{ cfr_reply_unexpected(container_of(reply, CheckFileReader, rb)); }
+static void cfr_reply_full_name(SftpReplyBuilder *reply, ptrlen name,
+                                ptrlen longname, struct fxp_attrs attrs)
+{ cfr_reply_unexpected(container_of(reply, CheckFileReader, rb)); }
+static void cfr_reply_attrs(SftpReplyBuilder *reply, struct fxp_attrs attrs)
+{ cfr_reply_unexpected(container_of(reply, CheckFileReader, rb)); }
+static void cfr_reply_statvfs(SftpReplyBuilder *reply,
+                              const struct fxp_statvfs *st)
+{ cfr_reply_unexpected(container_of(reply, CheckFileReader, rb)); }
+
+static void *cfr_data_buffer(SftpReplyBuilder *reply, size_t maxlen)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    assert(!cfr->reserved && !cfr->data->len);
+    cfr->reserved = true;
+    return strbuf_append(cfr->data, maxlen);
+}
+
+static void cfr_reply_data(SftpReplyBuilder *reply, ptrlen data)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    cfr->code = SSH_FX_OK;
+    if (cfr->reserved) {
+        /* The data was read straight into our buffer */
+        assert(data.ptr == cfr->data->u);
+        strbuf_shrink_to(cfr->data, data.len);
+        cfr->reserved = false;
+        return;
+    }
+    put_datapl(cfr->data, data);
+}
+
+static const SftpReplyBuilderVtable CheckFileReader_vt = {
+    .reply_ok = cfr_reply_ok,
+    .reply_error = cfr_reply_error,
+    .reply_simple_name = cfr_reply_simple_name,
+    .reply_name_count = cfr_reply_name_count,
+    .reply_full_name = cfr_reply_full_name,
+    .reply_handle = cfr_reply_data,
+    .reply_data = cfr_reply_data,
+    .reply_attrs = cfr_reply_attrs,
+    .reply_statvfs = cfr_reply_statvfs,
+    .data_buffer = cfr_data_buffer,
+};
+
+static void cfr_init(CheckFileReader *cfr)
+{
+    cfr->rb.vt = &CheckFileReader_vt;
+    cfr->code = SSH_FX_FAILURE;
+    cfr->errmsg = NULL;
+    cfr->data = strbuf_new_nm();
+    cfr->reserved = false;
+}
+
+static void cfr_reset(CheckFileReader *cfr)
+{
+    cfr->code = SSH_FX_FAILURE;
+    sfree(cfr->errmsg);
+    cfr->errmsg = NULL;
+    strbuf_clear(cfr->data);
+    cfr->reserved = false;
+}
+
+static void cfr_free(CheckFileReader *cfr)
+{
+    sfree(cfr->errmsg);
+    strbuf_free(cfr->data);
+}
+
+/* Pass on whatever error the SftpServer gave us */
+static void cfr_forward_error(CheckFileReader *cfr, SftpReplyBuilder *rb)
+{
+    fxp_reply_error(rb, cfr->code,
+                    cfr->errmsg ? cfr->errmsg : "Unexpected reply type");
+}
+
+#define CHECK_FILE_CHUNK 65536
+
+/*
+ * A check-file request in progress. It hashes the file one chunk at
+ * a time, and if the server answers a read later rather than at
+ * once, the job carries on from the reader's 'send' method when the
+ * data arrives. So a long check-file doesn't hold up the rest of the
+ * session, and a whole file's worth of reading never happens in one
+ * go on the thread that runs the event loop.
+ */
+typedef struct CheckFileJob {
+    CheckFileReader cfr;
+    SftpServer *srv;
+    SftpReplyBuilder *out;     /* where to send the answer */
+    SftpReplyBuilder *later;   /* 'out', if we deferred it; else NULL */
+    struct sftp_packet *pkt;   /* the packet inside 'out' */
+    strbuf *handle;
+    bool close_handle;         /* we opened it, so we close it */
+    const char *algname;
+    const ssh_hashalg *alg;
+    ssh_hash *h;
+    strbuf *hashes;
+    uint64_t pos, end, inblock;
+    uint32_t blocksize;
+    bool waiting;              /* a read is being answered later */
+    bool looping;              /* cfj_run is active further up the stack */
+} CheckFileJob;
+
+static bool cfj_got_data(CheckFileJob *cfj);
+static void cfj_finish(CheckFileJob *cfj);
+static void cfj_run(CheckFileJob *cfj);
+
+static SftpReplyBuilder *cfj_defer(SftpReplyBuilder *reply)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    CheckFileJob *cfj = container_of(cfr, CheckFileJob, cfr);
+    if (!cfj->later)
+        return NULL;      /* our own caller wants its answer right now */
+    assert(!cfj->waiting);
+    cfj->waiting = true;
+    return &cfr->rb;
+}
+
+static void cfj_send(SftpReplyBuilder *reply)
+{
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    CheckFileJob *cfj = container_of(cfr, CheckFileJob, cfr);
+    assert(cfj->waiting);
+    cfj->waiting = false;
+    if (cfj->looping)
+        return;               /* answered before sftpsrv_read returned */
+    if (cfj_got_data(cfj))
+        cfj_run(cfj);
+    else
+        cfj_finish(cfj);
+}
+
+static void cfj_free(CheckFileJob *cfj)
+{
+    ssh_hash_free(cfj->h);
+    strbuf_free(cfj->hashes);
+    strbuf_free(cfj->handle);
+    cfr_free(&cfj->cfr);
+    sfree(cfj);
+}
+
+static void cfj_abandon(SftpReplyBuilder *reply)
+{
+    /* The server is going away, so there's nobody left to answer */
+    CheckFileReader *cfr = container_of(reply, CheckFileReader, rb);
+    CheckFileJob *cfj = container_of(cfr, CheckFileJob, cfr);
+    fxp_reply_abandon(cfj->later);
+    cfj_free(cfj);
+}
+
+static const SftpReplyBuilderVtable CheckFileJob_vt = {
+    .reply_ok = cfr_reply_ok,
+    .reply_error = cfr_reply_error,
+    .reply_simple_name = cfr_reply_simple_name,
+    .reply_name_count = cfr_reply_name_count,
+    .reply_full_name = cfr_reply_full_name,
+    .reply_handle = cfr_reply_data,
+    .reply_data = cfr_reply_data,
+    .reply_attrs = cfr_reply_attrs,
+    .reply_statvfs = cfr_reply_statvfs,
+    .data_buffer = cfr_data_buffer,
+    .defer = cfj_defer,
+    .send = cfj_send,
+    .abandon = cfj_abandon,
 };
+
+/*
+ * Absorb the answer to one read. Returns false if that was the last
+ * one we need, either because the range is finished or because
+ * something went wrong (in which case the error has been sent).
+ */
+static bool cfj_got_data(CheckFileJob *cfj)
+{
+    CheckFileReader *cfr = &cfj->cfr;
+    unsigned char digest[MAX_HASH_LEN];
+
+    if (cfr->code == SSH_FX_EOF)
+        return false;
+    if (cfr->code != SSH_FX_OK) {
+        cfr_forward_error(cfr, cfj->out);
+        cfj->out = NULL;
+        return false;
+    }
+    if (cfr->data->len == 0)
+        return false;
+
+    put_datapl(cfj->h, ptrlen_from_strbuf(cfr->data));
+    cfj->pos += cfr->data->len;
+    cfj->inblock += cfr->data->len;
+
+    if (cfj->blocksize && cfj->inblock == cfj->blocksize) {
+        ssh_hash_digest(cfj->h, digest);
+        put_data(cfj->hashes, digest, cfj->alg->hlen);
+        ssh_hash_reset(cfj->h);
+        cfj->inblock = 0;
+
+        if (cfj->hashes->len > SFTP_SERVER_MAX_DATA) {
+            fxp_reply_error(cfj->out, SSH_FX_FAILURE,
+                            "Too many check-file blocks requested");
+            cfj->out = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void cfj_finish(CheckFileJob *cfj)
+{
+    unsigned char digest[MAX_HASH_LEN];
+
+    if (cfj->out) {
+        /* A short last block gets a hash of its own, and so does the
+         * whole range if we weren't asked to split it up */
+        if (!cfj->blocksize || cfj->inblock > 0) {
+            ssh_hash_digest(cfj->h, digest);
+            put_data(cfj->hashes, digest, cfj->alg->hlen);
+        }
+
+        cfj->pkt->type = SSH_FXP_EXTENDED_REPLY;
+        put_stringz(cfj->pkt, SFTP_EXT_CHECK_FILE);
+        put_stringz(cfj->pkt, cfj->algname);
+        put_datapl(cfj->pkt, ptrlen_from_strbuf(cfj->hashes));
+    }
+
+    if (cfj->close_handle) {
+        cfr_reset(&cfj->cfr);
+        cfj->cfr.rb.vt = &CheckFileReader_vt;   /* no deferring the close */
+        sftpsrv_close(cfj->srv, &cfj->cfr.rb, ptrlen_from_strbuf(cfj->handle));
+    }
+
+    if (cfj->later)
+        fxp_reply_send(cfj->later);
+    cfj_free(cfj);
+}
+
+/*
+ * Issue reads until one of them is answered later, or we've finished.
+ */
+static void cfj_run(CheckFileJob *cfj)
+{
+    cfj->looping = true;
+    while (cfj->pos < cfj->end) {
+        uint64_t want = cfj->end - cfj->pos;
+        if (want > CHECK_FILE_CHUNK)
+            want = CHECK_FILE_CHUNK;
+        if (cfj->blocksize && want > cfj->blocksize - cfj->inblock)
+            want = cfj->blocksize - cfj->inblock;
+
+        cfr_reset(&cfj->cfr);
+        sftpsrv_read(cfj->srv, &cfj->cfr.rb,
+                     ptrlen_from_strbuf(cfj->handle), cfj->pos, want);
+        if (cfj->waiting) {
+            /* cfj_send will bring us back here */
+            cfj->looping = false;
+            return;
+        }
+        if (!cfj_got_data(cfj))
+            break;
+    }
+    cfj->looping = false;
+    cfj_finish(cfj);
+}
+
+/* Look up the first algorithm in the client's list that we know */
+static const ssh_hashalg *check_file_alg(ptrlen algorithms,
+                                         const char **algname)
+{
+    while (algorithms.len) {
+        ptrlen word = ptrlen_get_word(&algorithms, ",");
+        for (size_t i = 0; i < lenof(check_file_hashes); i++) {
+            if (ptrlen_eq_string(word, check_file_hashes[i].name)) {
+                *algname = check_file_hashes[i].name;
+                return check_file_hashes[i].alg;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Start a check-file job on a handle, taking ownership of 'handle'.
+ * The job frees itself when it's done.
+ */
+static void check_file_start(
+    SftpServer *srv, SftpReplyBuilder *rb, struct sftp_packet *reply,
+    strbuf *handle, bool close_handle, const char *algname,
+    const ssh_hashalg *alg, uint64_t offset, uint64_t length,
+    uint32_t blocksize)
+{
+    CheckFileJob *cfj = snew(CheckFileJob);
+    cfr_init(&cfj->cfr);
+    cfj->cfr.rb.vt = &CheckFileJob_vt;
+    cfj->srv = srv;
+    cfj->handle = handle;
+    cfj->close_handle = close_handle;
+    cfj->algname = algname;
+    cfj->alg = alg;
+    cfj->h = ssh_hash_new(alg);
+    cfj->hashes = strbuf_new();
+    cfj->pos = offset;
+    cfj->end = (length && offset + length > offset) ?
+        offset + length : UINT64_MAX;
+    cfj->inblock = 0;
+    cfj->blocksize = blocksize;
+    cfj->waiting = cfj->looping = false;
+
+    if ((cfj->later = fxp_reply_defer(rb)) != NULL) {
+        cfj->out = cfj->later;
+        cfj->pkt = container_of(cfj->later, DefaultSftpReplyBuilder, rb)->pkt;
+    } else {
+        cfj->out = rb;
+        cfj->pkt = reply;
+    }
+
+    cfj_run(cfj);
+}
+
+static void check_file_handle(
+    SftpServer *srv, SftpReplyBuilder *rb, struct sftp_packet *reply,
+    ptrlen handle, ptrlen algorithms, uint64_t offset, uint64_t length,
+    uint32_t blocksize)
+{
+    const char *algname = NULL;
+    const ssh_hashalg *alg = check_file_alg(algorithms, &algname);
+    if (!alg) {
+        fxp_reply_error(rb, SSH_FX_OP_UNSUPPORTED,
+                        "No supported check-file hash algorithm");
+        return;
+    }
+
+    check_file_start(srv, rb, reply, strbuf_dup(handle), false,
+                     algname, alg, offset, length, blocksize);
+}
+
+static void check_file_name(
+    SftpServer *srv, SftpReplyBuilder *rb, struct sftp_packet *reply,
+    ptrlen path, ptrlen algorithms, uint64_t offset, uint64_t length,
+    uint32_t blocksize)
+{
+    const char *algname = NULL;
+    const ssh_hashalg *alg = check_file_alg(algorithms, &algname);
+    if (!alg) {
+        fxp_reply_error(rb, SSH_FX_OP_UNSUPPORTED,
+                        "No supported check-file hash algorithm");
+        return;
+    }
+
+    CheckFileReader cfr;
+    cfr_init(&cfr);
+    sftpsrv_open(srv, &cfr.rb, path, SSH_FXF_READ, no_attrs);
+    if (cfr.code != SSH_FX_OK) {
+        cfr_forward_error(&cfr, rb);
+        cfr_free(&cfr);
+        return;
+    }
+
+    check_file_start(srv, rb, reply, strbuf_dup(ptrlen_from_strbuf(cfr.data)),
+                     true, algname, alg, offset, length, blocksize);
+    cfr_free(&cfr);
+}
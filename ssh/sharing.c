@@ -148,11 +148,39 @@ struct ssh_sharing_state {
     ConnectionLayer *cl;             /* instance of the ssh connection layer */
     char *server_verstring;          /* server version string after "SSH-" */
 
+    /* Scheduling of channel data sent upstream by downstreams. */
+    bool upstream_throttled;         /* SSH connection's output is backed up */
+    bool sched_pending;              /* share_sched_run is queued */
+    size_t sched_bytes;              /* total data queued in all connstates */
+    unsigned sched_next;             /* connstate id to start next round at */
+
+    bool retired;                    /* no longer advertised to new PuTTYs */
+
     Plug plug;
 };
 
 struct share_globreq;
 
+/*
+ * Downstream channel data waiting to be passed to the connection
+ * layer. Each connstate has one of these queues per scheduling class.
+ */
+struct share_queued_pkt {
+    struct share_queued_pkt *next;
+    struct share_channel *chan;
+    int type;
+    int pktlen;
+    /* packet data follows */
+};
+
+struct share_pktqueue {
+    struct share_queued_pkt *head, *tail;
+    size_t bytes;
+    size_t deficit;                  /* deficit round-robin credit */
+};
+
+enum { SCHED_INTERACTIVE, SCHED_BULK, SCHED_NCLASSES };
+
 struct ssh_sharing_connstate {
     unsigned id;    /* used to identify this downstream in log messages */
 
@@ -202,6 +230,11 @@ struct ssh_sharing_connstate {
     /* Global requests we've sent on to the server, pending replies. */
     struct share_globreq *globreq_head, *globreq_tail;
 
+    /* Channel data held back by the upstream scheduler, and whether
+     * we've frozen the downstream socket because there's too much. */
+    struct share_pktqueue sched[SCHED_NCLASSES];
+    bool sched_frozen;
+
     Plug plug;
 };
 
@@ -238,6 +271,14 @@ struct share_channel {
     char *x11_auth_data;
     int x11_auth_datalen;
     bool x11_one_shot;
+    /*
+     * Scheduling state: whether downstream has asked for a pty on
+     * this channel (which we take as a sign that a human is typing
+     * into it), and how many of its data packets are queued.
+     */
+    bool interactive;
+    int sched_class;
+    unsigned sched_queued;
 };
 
 struct share_forwarding {
@@ -464,6 +505,8 @@ static void share_xchannel_free(struct share_xchannel *xc)
     sfree(xc);
 }
 
+static void share_sched_discard(struct ssh_sharing_connstate *cs);
+
 static void share_connstate_free(struct ssh_sharing_connstate *cs)
 {
     struct share_halfchannel *hc;
@@ -471,6 +514,8 @@ static void share_connstate_free(struct ssh_sharing_connstate *cs)
     struct share_channel *chan;
     struct share_forwarding *fwd;
 
+    share_sched_discard(cs);
+
     while ((hc = (struct share_halfchannel *)
             delpos234(cs->halfchannels, 0)) != NULL)
         sfree(hc);
@@ -514,7 +559,13 @@ void sharestate_free(ssh_sharing_state *sharestate)
 {
     struct ssh_sharing_connstate *cs;
 
-    platform_ssh_share_cleanup(sharestate->sockname);
+    /*
+     * If we've already retired, the socket name may since have been
+     * taken over by a new upstream, so we mustn't clean it up.
+     */
+    if (!sharestate->retired)
+        platform_ssh_share_cleanup(sharestate->sockname);
+    delete_callbacks_for_context(sharestate);
 
     while ((cs = (struct ssh_sharing_connstate *)
             delpos234(sharestate->connections, 0)) != NULL) {
@@ -574,6 +625,9 @@ static struct share_channel *share_add_channel(
     chan->x11_auth_proto = -1;
     chan->x11_auth_datalen = 0;
     chan->x11_one_shot = false;
+    chan->interactive = false;
+    chan->sched_class = SCHED_BULK;
+    chan->sched_queued = 0;
     if (add234(cs->channels_by_us, chan) != chan) {
         sfree(chan);
         return NULL;
@@ -614,9 +668,252 @@ static struct share_channel *share_find_channel_by_server(
     return find234(cs->channels_by_server, &dummychan, NULL);
 }
 
+/*
+ * Scheduling of channel data on its way from downstreams to the
+ * server.
+ *
+ * While the SSH connection is keeping up, downstream packets are
+ * passed straight to the connection layer, as they always were. But
+ * once its output backs up (the connection layer tells us so via
+ * share_set_upstream_throttled), CHANNEL_DATA and
+ * CHANNEL_EXTENDED_DATA from downstreams are held in per-connstate
+ * queues instead, and released by deficit round robin: each round,
+ * every downstream with data waiting gets to send up to
+ * SHARE_SCHED_QUANTUM bytes times the weight of the queue's class.
+ * Channels on which downstream has requested a pty are 'interactive'
+ * and are served before any bulk data in the same round, so that one
+ * downstream copying a large file can't hold up keystrokes and
+ * terminal output belonging to another.
+ *
+ * Data on one channel must stay in order with respect to everything
+ * else on that channel, so any other message about a channel with
+ * data queued flushes that channel's queued data first. (Except
+ * WINDOW_ADJUST, which concerns the opposite direction.) A channel's
+ * class is only changed when nothing of it is queued.
+ *
+ * If one downstream's queues grow beyond SHARE_SCHED_DOWNSTREAM_LIMIT,
+ * we stop reading from it until they've drained.
+ */
+#define SHARE_SCHED_QUANTUM 4096
+#define SHARE_SCHED_BUDGET SSH_MAX_BACKLOG  /* bytes released per callback */
+#define SHARE_SCHED_DOWNSTREAM_LIMIT 65536
+
+static const unsigned share_sched_weights[SCHED_NCLASSES] = {
+    [SCHED_INTERACTIVE] = 4,
+    [SCHED_BULK] = 1,
+};
+
+static void share_sched_run(void *ctx);
+
+static size_t share_sched_connstate_bytes(struct ssh_sharing_connstate *cs)
+{
+    size_t total = 0;
+    for (int i = 0; i < SCHED_NCLASSES; i++)
+        total += cs->sched[i].bytes;
+    return total;
+}
+
+static void share_sched_unlink(struct ssh_sharing_connstate *cs,
+                               struct share_pktqueue *q,
+                               struct share_queued_pkt *prev,
+                               struct share_queued_pkt *qp)
+{
+    if (prev)
+        prev->next = qp->next;
+    else
+        q->head = qp->next;
+    if (q->tail == qp)
+        q->tail = prev;
+
+    q->bytes -= qp->pktlen;
+    cs->parent->sched_bytes -= qp->pktlen;
+    qp->chan->sched_queued--;
+
+    if (cs->sched_frozen && cs->sock && share_sched_connstate_bytes(cs) <
+        SHARE_SCHED_DOWNSTREAM_LIMIT / 2) {
+        cs->sched_frozen = false;
+        sk_set_frozen(cs->sock, false);
+    }
+}
+
+static void share_sched_release(struct ssh_sharing_connstate *cs,
+                                struct share_queued_pkt *qp)
+{
+    ssh_send_packet_from_downstream(cs->parent->cl, cs->id, qp->type,
+                                    snew_plus_get_aux(qp), qp->pktlen, NULL);
+    smemclr(qp, sizeof(*qp) + qp->pktlen);
+    sfree(qp);
+}
+
+static void share_sched_send(struct ssh_sharing_connstate *cs,
+                             struct share_channel *chan, int type,
+                             const void *pkt, int pktlen)
+{
+    struct ssh_sharing_state *sharestate = cs->parent;
+    struct share_queued_pkt *qp;
+    struct share_pktqueue *q;
+
+    if (!chan->sched_queued)
+        chan->sched_class = (chan->interactive ? SCHED_INTERACTIVE :
+                             SCHED_BULK);
+
+    if (!sharestate->upstream_throttled && !sharestate->sched_bytes) {
+        /* Nothing to be fair about: pass it straight on. */
+        ssh_send_packet_from_downstream(sharestate->cl, cs->id,
+                                        type, pkt, pktlen, NULL);
+        return;
+    }
+
+    qp = snew_plus(struct share_queued_pkt, pktlen);
+    qp->next = NULL;
+    qp->chan = chan;
+    qp->type = type;
+    qp->pktlen = pktlen;
+    memcpy(snew_plus_get_aux(qp), pkt, pktlen);
+
+    q = &cs->sched[chan->sched_class];
+    if (q->tail)
+        q->tail->next = qp;
+    else
+        q->head = qp;
+    q->tail = qp;
+    q->bytes += pktlen;
+    sharestate->sched_bytes += pktlen;
+    chan->sched_queued++;
+
+    if (!cs->sched_frozen && cs->sock && share_sched_connstate_bytes(cs) >
+        SHARE_SCHED_DOWNSTREAM_LIMIT) {
+        cs->sched_frozen = true;
+        sk_set_frozen(cs->sock, true);
+    }
+
+    if (!sharestate->upstream_throttled && !sharestate->sched_pending) {
+        sharestate->sched_pending = true;
+        queue_toplevel_callback(share_sched_run, sharestate);
+    }
+}
+
+/*
+ * Take everything queued for one channel out of its queue, and
+ * either send it on (because downstream has sent something about
+ * that channel that must not overtake it) or discard it (because the
+ * channel is going away).
+ */
+static void share_sched_flush_channel(struct ssh_sharing_connstate *cs,
+                                      struct share_channel *chan, bool send)
+{
+    struct share_pktqueue *q = &cs->sched[chan->sched_class];
+    struct share_queued_pkt *prev = NULL, *qp, *next;
+
+    for (qp = q->head; qp && chan->sched_queued; qp = next) {
+        next = qp->next;
+        if (qp->chan == chan) {
+            share_sched_unlink(cs, q, prev, qp);
+            if (send) {
+                share_sched_release(cs, qp);
+            } else {
+                smemclr(qp, sizeof(*qp) + qp->pktlen);
+                sfree(qp);
+            }
+        } else {
+            prev = qp;
+        }
+    }
+}
+
+/* Throw away everything queued for a connstate we're about to free. */
+static void share_sched_discard(struct ssh_sharing_connstate *cs)
+{
+    for (int i = 0; i < SCHED_NCLASSES; i++) {
+        struct share_pktqueue *q = &cs->sched[i];
+        while (q->head) {
+            struct share_queued_pkt *qp = q->head;
+            share_sched_unlink(cs, q, NULL, qp);
+            smemclr(qp, sizeof(*qp) + qp->pktlen);
+            sfree(qp);
+        }
+    }
+}
+
+static void share_sched_run(void *ctx)
+{
+    struct ssh_sharing_state *sharestate = (struct ssh_sharing_state *)ctx;
+    size_t budget = SHARE_SCHED_BUDGET;
+
+    sharestate->sched_pending = false;
+
+    while (sharestate->sched_bytes && !sharestate->upstream_throttled &&
+           budget > 0) {
+        int n = count234(sharestate->connections), start;
+        struct ssh_sharing_connstate *cs, dummy;
+
+        /*
+         * Start each round one downstream further on than the last,
+         * so that nobody is always first in the queue.
+         */
+        dummy.id = sharestate->sched_next;
+        cs = findrelpos234(sharestate->connections, &dummy, NULL,
+                           REL234_GE, &start);
+        if (!cs) {
+            start = 0;
+            cs = index234(sharestate->connections, 0);
+        }
+        sharestate->sched_next = cs->id + 1;
+
+        for (int class = 0; class < SCHED_NCLASSES; class++) {
+            for (int i = 0; i < n; i++) {
+                struct share_pktqueue *q;
+
+                cs = index234(sharestate->connections, (start + i) % n);
+                q = &cs->sched[class];
+                if (!q->head) {
+                    q->deficit = 0;
+                    continue;
+                }
+
+                q->deficit += SHARE_SCHED_QUANTUM *
+                    share_sched_weights[class];
+                while (q->head && q->head->pktlen <= q->deficit) {
+                    struct share_queued_pkt *qp = q->head;
+                    q->deficit -= qp->pktlen;
+                    budget -= (budget < qp->pktlen ? budget : qp->pktlen);
+                    share_sched_unlink(cs, q, NULL, qp);
+                    share_sched_release(cs, qp);
+                }
+                if (!q->head)
+                    q->deficit = 0;
+            }
+        }
+    }
+
+    /*
+     * If we stopped because of the budget, come back after the
+     * connection layer has had a chance to write out what we've just
+     * given it (and perhaps tell us it's now backed up).
+     */
+    if (sharestate->sched_bytes && !sharestate->upstream_throttled) {
+        sharestate->sched_pending = true;
+        queue_toplevel_callback(share_sched_run, sharestate);
+    }
+}
+
+void share_set_upstream_throttled(ssh_sharing_state *sharestate,
+                                  bool throttled)
+{
+    sharestate->upstream_throttled = throttled;
+    if (!throttled && sharestate->sched_bytes && !sharestate->sched_pending) {
+        sharestate->sched_pending = true;
+        queue_toplevel_callback(share_sched_run, sharestate);
+    }
+}
+
 static void share_remove_channel(struct ssh_sharing_connstate *cs,
                                  struct share_channel *chan)
 {
+    /* Anything still queued here was sent by downstream after its
+     * own CHANNEL_CLOSE, so the server mustn't see it anyway. */
+    share_sched_flush_channel(cs, chan, false);
+
     del234(cs->channels_by_us, chan);
     del234(cs->channels_by_server, chan);
     if (chan->x11_auth_upstream)
@@ -843,6 +1140,8 @@ static void share_try_cleanup(struct ssh_sharing_connstate *cs)
         strbuf *packet;
 
         if (chan->state != SENT_CLOSE && chan->state != UNACKNOWLEDGED) {
+            share_sched_flush_channel(cs, chan, true);
+
             packet = strbuf_new();
             put_uint32(packet, chan->server_id);
             ssh_send_packet_from_downstream(
@@ -1572,9 +1871,22 @@ static void share_got_pkt_from_downstream(struct ssh_sharing_connstate *cs,
       case SSH2_MSG_DEBUG:
         server_id = get_uint32(src);
 
+        /*
+         * Data is subject to the upstream scheduler; anything else
+         * about the same channel must not overtake it.
+         */
+        chan = share_find_channel_by_server(cs, server_id);
+        if (chan && type != SSH2_MSG_CHANNEL_DATA &&
+            type != SSH2_MSG_CHANNEL_EXTENDED_DATA &&
+            type != SSH2_MSG_CHANNEL_WINDOW_ADJUST)
+            share_sched_flush_channel(cs, chan, true);
+
         if (type == SSH2_MSG_CHANNEL_REQUEST) {
             request_name = get_string(src);
 
+            if (chan && ptrlen_eq_string(request_name, "pty-req"))
+                chan->interactive = true;
+
             /*
              * Agent forwarding requests from downstream are treated
              * specially. Because OpenSSHD doesn't let us enable agent
@@ -1702,8 +2014,12 @@ static void share_got_pkt_from_downstream(struct ssh_sharing_connstate *cs,
             }
         }
 
-        ssh_send_packet_from_downstream(cs->parent->cl, cs->id,
-                                        type, pkt, pktlen, NULL);
+        if (chan && (type == SSH2_MSG_CHANNEL_DATA ||
+                     type == SSH2_MSG_CHANNEL_EXTENDED_DATA))
+            share_sched_send(cs, chan, type, pkt, pktlen);
+        else
+            ssh_send_packet_from_downstream(cs->parent->cl, cs->id,
+                                            type, pkt, pktlen, NULL);
         if (type == SSH2_MSG_CHANNEL_CLOSE && pktlen >= 4) {
             chan = share_find_channel_by_server(cs, server_id);
             if (chan) {
@@ -1865,6 +2181,25 @@ int share_ndownstreams(ssh_sharing_state *sharestate)
     return count234(sharestate->connections);
 }
 
+void share_retire(ssh_sharing_state *sharestate)
+{
+    /*
+     * Indication from connection layer that we intend to close soon,
+     * so new PuTTYs should stop finding us.
+     *
+     * The platform code removes our name under the same lock that
+     * downstreams hold while connecting, so afterwards, any
+     * downstream has either already connected (and will be accepted,
+     * because we leave the listening socket itself open), or will
+     * fail to find us and start its own upstream.
+     */
+    if (sharestate->retired)
+        return;
+    platform_ssh_share_retire(sharestate->sockname);
+    sharestate->retired = true;
+    log_general(sharestate, "Stopped accepting new downstreams");
+}
+
 void share_activate(ssh_sharing_state *sharestate,
                     const char *server_verstring)
 {
@@ -1951,6 +2286,8 @@ static int share_listen_accepting(Plug *plug,
     cs->xchannels_by_server = newtree234(share_xchannel_server_cmp);
     cs->forwardings = newtree234(share_forwarding_cmp);
     cs->globreq_head = cs->globreq_tail = NULL;
+    memset(cs->sched, 0, sizeof(cs->sched));
+    cs->sched_frozen = false;
 
     peerinfo = sk_peer_info(cs->sock);
     log_downstream(cs, "connected%s%s",
@@ -2090,6 +2427,11 @@ Socket *ssh_connection_sharing_init(
     sharestate->plug.vt = &ssh_sharing_listen_plugvt;
     sharestate->listensock = NULL;
     sharestate->cl = NULL;
+    sharestate->upstream_throttled = false;
+    sharestate->sched_pending = false;
+    sharestate->sched_bytes = 0;
+    sharestate->sched_next = 0;
+    sharestate->retired = false;
 
     /*
      * Now hand off to a per-platform routine that either connects to
@@ -371,9 +371,8 @@ static void ssh_bpp_output_raw_data_callback(void *vctx)
     if (!ssh->s)
         return;
 
+    size_t backlog = 0;
     while (bufchain_size(&ssh->out_raw) > 0) {
-        size_t backlog;
-
         ptrlen data = bufchain_prefix(&ssh->out_raw);
 
         if (ssh->logctx)
@@ -389,6 +388,15 @@ static void ssh_bpp_output_raw_data_callback(void *vctx)
         }
     }
 
+    /*
+     * Only now that everything the BPP gave us has reached the
+     * socket is it safe to let local data streams go again. Doing it
+     * as soon as the socket's own backlog cleared, while out_raw was
+     * still full, let bulk channels pile up an unbounded queue here
+     * in front of anything interactive.
+     */
+    ssh_throttle_all(ssh, false, backlog);
+
     ssh_check_frozen(ssh);
 
     if (ssh->pending_close) {
@@ -653,13 +661,12 @@ static void ssh_sent(Plug *plug, size_t bufsize)
 {
     Ssh *ssh = container_of(plug, Ssh, plug);
     /*
-     * If the send backlog on the SSH socket itself clears, we should
-     * unthrottle the whole world if it was throttled. Also trigger an
+     * If the send backlog on the SSH socket itself clears, trigger an
      * extra call to the consumer of the BPP's output, to try to send
-     * some more data off its bufchain.
+     * some more data off its bufchain. That will unthrottle the whole
+     * world, if it was throttled, once the bufchain is empty.
      */
     if (bufsize < SSH_MAX_BACKLOG) {
-        ssh_throttle_all(ssh, false, bufsize);
         queue_idempotent_callback(&ssh->ic_out_raw);
         ssh_sendbuffer_changed(ssh);
     }
@@ -793,6 +800,8 @@ static char *connect_to_host(
      * nothing, because here we only need to care if we're a
      * downstream and need to do our connection setup differently.
      */
+    bool upstream_only = conf_get_bool(
+        ssh->conf, CONF_ssh_connection_sharing_upstream_only);
     ssh->connshare = NULL;
     ssh->attempting_connshare = true;  /* affects socket logging behaviour */
     ssh->s = ssh_connection_sharing_init(
@@ -801,7 +810,14 @@ static char *connect_to_host(
     if (ssh->connshare)
         ssh_connshare_provide_connlayer(ssh->connshare, &ssh->cl_dummy);
     ssh->attempting_connshare = false;
-    if (ssh->s != NULL) {
+    if (ssh->s != NULL && upstream_only) {
+        /*
+         * Someone else got there first, so we aren't needed.
+         */
+        sk_close(ssh->s);
+        ssh->s = NULL;
+        return dupstr("A connection-sharing upstream already exists");
+    } else if (ssh->s != NULL) {
         /*
          * We are a downstream.
          */
@@ -823,6 +839,9 @@ static char *connect_to_host(
          * We're not a downstream, so open a normal socket.
          */
 
+        if (!ssh->connshare && upstream_only)
+            return dupstr("Unable to become a connection-sharing upstream");
+
         /*
          * Try to find host.
          */
@@ -1095,8 +1114,10 @@ static size_t ssh_sendbuffer(Backend *be)
     /*
      * If the SSH socket itself has backed up, add the total backup
      * size on that to any individual buffer on the stdin channel.
+     * (Except in SSH-2, where the stdin channel is the interactive
+     * one, which is allowed to overtake that backlog.)
      */
-    if (ssh->throttled_all)
+    if (ssh->throttled_all && ssh->version != 2)
         backlog += ssh->overall_bufsize;
 
     return backlog;
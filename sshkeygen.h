@@ -251,6 +251,10 @@ typedef struct PrimeGenerationContext PrimeGenerationContext;
 
 struct PrimeGenerationContext {
     const PrimeGenerationPolicy *vt;
+
+    /* Number of threads to test candidates on (if the platform
+     * supports it at all). 1 means test them on the calling thread. */
+    unsigned threads;
 };
 
 struct PrimeGenerationPolicy {
@@ -282,6 +286,9 @@ static inline mp_int *primegen_generate(
 static inline strbuf *primegen_mpu_certificate(
     PrimeGenerationContext *ctx, mp_int *p)
 { return ctx->vt->mpu_certificate(ctx, p); }
+static inline void primegen_set_threads(
+    PrimeGenerationContext *ctx, unsigned threads)
+{ ctx->threads = threads ? threads : 1; }
 
 extern const PrimeGenerationPolicy primegen_probabilistic;
 extern const PrimeGenerationPolicy primegen_provable_fast;
@@ -120,6 +120,19 @@ char *host_ca_delete(const char *name); /* likewise */
 host_ca *host_ca_new(void);  /* initialises to default settings */
 void host_ca_free(host_ca *);
 
+/* ----------------------------------------------------------------------
+ * Functions to access PuTTY's record of host certificates whose CA
+ * signatures have already been verified, so that later sessions can
+ * skip verifying them again. Each certificate is identified by the
+ * hash from opensshcert_sig_cache_id, written in hex.
+ *
+ * This is only a cache: the stored list is bounded in size, oldest
+ * entries being discarded first, and failing to store an entry is
+ * not treated as an error.
+ */
+bool check_verified_cert(const char *id);
+void store_verified_cert(const char *id);
+
 /* ----------------------------------------------------------------------
  * Functions to access PuTTY's random number seed file.
  */
@@ -0,0 +1,751 @@
+/*
+ * cryptbench: measure the speed of PuTTY's cryptographic primitives.
+ *
+ * testcrypt exposes all the primitives to cryptsuite.py so that their
+ * output can be checked; this program times the same set of them,
+ * using the same list in testcrypt-enum.h, so that anything added
+ * there is automatically benchmarked too. That covers every hash,
+ * MAC, cipher, Diffie-Hellman group, ECDH curve and signature
+ * algorithm, and to those we add the NTRU Prime / Curve25519 hybrid
+ * key exchange, which testcrypt only exposes in pieces.
+ *
+ * Where an algorithm has more than one implementation, such as AES
+ * with and without AES-NI, testcrypt-enum.h lists the selector that
+ * picks the best one at run time ('aes128_ctr') alongside each
+ * implementation forced on explicitly ('aes128_ctr_sw',
+ * 'aes128_ctr_ni'), and all of them are timed here. Implementations
+ * that this CPU can't run are skipped, with a note on standard error.
+ *
+ * The public-key algorithms have no such variants, but their bignum
+ * arithmetic may have an accelerated multiplication kernel, selected
+ * globally by mp_mul_set_accel. So key exchange and signature
+ * algorithms are timed once with the portable kernel and once with
+ * the accelerated one, if this CPU can run it. The NTRU Prime hybrid
+ * is timed in the same way with each of NTRU's own ring arithmetic
+ * kernels (ntru_set_accel), with the bignum kernel left at its
+ * default. RSA signing is also timed with the key's cached CRT
+ * parameters turned off (rsa_set_crt_cache), so that every signature
+ * recomputes them as it used to; those lines have 'impl' set to
+ * 'nocache'.
+ *
+ * Hashes, MACs and ciphers are timed on messages of several sizes.
+ * Key exchange methods are timed for one complete exchange by each
+ * side, and signature algorithms for one signature and one
+ * verification of a 64-byte message (the size of a SHA-512 exchange
+ * hash). Key generation isn't timed.
+ *
+ * The results go to standard output as CSV, with one line per
+ * measurement, in the columns
+ *
+ *   type,name,impl,kernel,ssh_name,op,bytes,count,seconds,ops_per_sec,
+ *   mb_per_sec
+ *
+ * where 'name' is the testcrypt name with any implementation suffix
+ * removed, 'impl' is that suffix ('sw', 'ni', 'neon', ...) or
+ * 'default' for the run-time selector (or 'nocache', as above),
+ * 'kernel' is the name of the arithmetic kernel in use ('portable',
+ * 'mulx_adx', 'avx2', ...), or empty for primitives that don't have
+ * one, and 'ssh_name' is the name
+ * used in SSH algorithm negotiation, if there is one. 'bytes' and
+ * 'mb_per_sec' (in units of 10^6 bytes) are empty for measurements
+ * that don't process a message of variable size.
+ *
+ * Command-line arguments other than options are wildcards, matched
+ * against the type and the testcrypt name of each algorithm, to
+ * restrict which ones are measured: for example, 'cryptbench kex'
+ * or 'cryptbench "aes*_gcm*" hash'.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "defs.h"
+#include "putty.h"
+#include "ssh.h"
+#include "sshkeygen.h"
+#include "misc.h"
+#include "mpint.h"
+#include "crypto/ntru.h"
+#include "proxy/cproxy.h"
+
+static NORETURN PRINTF_LIKE(1, 2) void fatal_error(const char *p, ...)
+{
+    va_list ap;
+    fprintf(stderr, "cryptbench: ");
+    va_start(ap, p);
+    vfprintf(stderr, p, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+void out_of_memory(void) { fatal_error("out of memory"); }
+void old_keyfile_warning(void) { }
+
+/*
+ * Key generation and key exchange need random numbers, but they
+ * needn't be good ones, and it's more useful for runs to be
+ * repeatable. So we use a PRNG with a fixed seed.
+ */
+static prng *bench_prng;
+void random_read(void *buf, size_t size)
+{
+    prng_read(bench_prng, buf, size);
+}
+
+uint64_t prng_reseed_time_ms(void)
+{
+    static uint64_t previous_time = 0;
+    return previous_time += 200;
+}
+
+void dputs(const char *buf)
+{
+    fputs(buf, stderr);
+}
+
+static double bench_seconds = 0.2;
+static size_t *sizes;
+static size_t nsizes, sizesize;
+static int rsa_bits = 2048;
+static char **patterns;
+static size_t npatterns;
+
+static unsigned char *bench_data;
+static size_t bench_data_len;
+
+/* The arithmetic kernel being timed, for the 'kernel' column */
+static const char *bench_kernel;
+
+/* If not NULL, overrides the 'impl' column */
+static const char *bench_impl;
+
+static bool selected(const char *type, const char *name)
+{
+    if (!npatterns)
+        return true;
+    for (size_t i = 0; i < npatterns; i++)
+        if (wc_match(patterns[i], type) || wc_match(patterns[i], name))
+            return true;
+    return false;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_field(const char *s)
+{
+    fputs(s ? s : "", stdout);
+}
+
+typedef void (*bench_fn)(void *ctx);
+
+/*
+ * Run fn repeatedly, in batches of increasing size, until at least
+ * bench_seconds have passed, and print a line of results. 'bytes' is
+ * the size of the message each call processes, or 0 if that isn't
+ * meaningful.
+ */
+static void bench(const char *type, const char *name, const char *ssh_name,
+                  const char *op, size_t bytes, bench_fn fn, void *ctx)
+{
+    static const char *const impl_suffixes[] = {
+        "_sw", "_ni", "_neon", "_clmul", "_ref_poly",
+    };
+    ptrlen pl = ptrlen_from_asciz(name);
+    const char *impl = bench_impl ? bench_impl : "default";
+    for (size_t i = 0; i < lenof(impl_suffixes); i++) {
+        if (ptrlen_endswith(pl, ptrlen_from_asciz(impl_suffixes[i]), &pl)) {
+            impl = impl_suffixes[i] + 1;
+            break;
+        }
+    }
+
+    uint64_t count = 0, batch = 1;
+    double start = now(), elapsed;
+    do {
+        for (uint64_t i = 0; i < batch; i++)
+            fn(ctx);
+        count += batch;
+        batch *= 2;
+        elapsed = now() - start;
+    } while (elapsed < bench_seconds);
+
+    printf("%s,%.*s,%s,", type, PTRLEN_PRINTF(pl), impl);
+    print_field(bench_kernel);
+    printf(",");
+    print_field(ssh_name);
+    printf(",%s,", op);
+    if (bytes)
+        printf("%"SIZEu, bytes);
+    printf(",%"PRIu64",%.6f,%.1f,", count, elapsed, count / elapsed);
+    if (bytes)
+        printf("%.2f", count * (double)bytes / elapsed / 1e6);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void unavailable(const char *type, const char *name)
+{
+    fprintf(stderr, "cryptbench: %s %s: not available on this machine\n",
+            type, name);
+}
+
+/*
+ * A switchable arithmetic kernel: a function that turns acceleration
+ * on or off, returning whether it ended up on, and one that names the
+ * kernel currently selected.
+ */
+typedef struct KernelSwitch {
+    bool (*set_accel)(bool enable);
+    const char *(*kernel_name)(void);
+} KernelSwitch;
+
+static const KernelSwitch mp_kernels = {
+    mp_mul_set_accel, mp_mul_kernel_name,
+};
+
+static const KernelSwitch ntru_kernels = {
+    ntru_set_accel, ntru_kernel_name,
+};
+
+/*
+ * Call fn with the portable kernel, and then again with the
+ * accelerated one if it's available. Either way, leave acceleration
+ * turned back on afterwards.
+ */
+static void under_each_kernel(const KernelSwitch *ks, bench_fn fn, void *ctx)
+{
+    for (int accel = 0; accel < 2; accel++) {
+        if (ks->set_accel(accel) != accel)
+            continue;
+        bench_kernel = ks->kernel_name();
+        fn(ctx);
+    }
+    ks->set_accel(true);
+    bench_kernel = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+
+struct hash_ctx {
+    ssh_hash *h;
+    size_t len;
+    unsigned char out[MAX_HASH_LEN];
+};
+
+static void hash_one(void *vctx)
+{
+    struct hash_ctx *ctx = (struct hash_ctx *)vctx;
+    ssh_hash_reset(ctx->h);
+    put_data(ctx->h, bench_data, ctx->len);
+    ssh_hash_digest(ctx->h, ctx->out);
+}
+
+static void bench_hashalg(const char *name, const ssh_hashalg *alg)
+{
+    if (!selected("hash", name))
+        return;
+
+    struct hash_ctx ctx[1];
+    ctx->h = ssh_hash_new(alg);
+    if (!ctx->h) {
+        unavailable("hash", name);
+        return;
+    }
+
+    for (size_t i = 0; i < nsizes; i++) {
+        ctx->len = sizes[i];
+        bench("hash", name, NULL, "hash", ctx->len, hash_one, ctx);
+    }
+
+    ssh_hash_free(ctx->h);
+}
+
+/* ---------------------------------------------------------------------- */
+
+struct mac_ctx {
+    ssh2_mac *m;
+    size_t len;
+    unsigned char out[64];
+};
+
+static void mac_one(void *vctx)
+{
+    struct mac_ctx *ctx = (struct mac_ctx *)vctx;
+    ssh2_mac_start(ctx->m);
+    put_data(ctx->m, bench_data, ctx->len);
+    ssh2_mac_genresult(ctx->m, ctx->out);
+}
+
+static void bench_macalg(const char *name, const ssh2_macalg *alg)
+{
+    if (!selected("mac", name))
+        return;
+
+    /*
+     * The MACs that belong to an AEAD cipher get their keys from a
+     * cipher instance, as they do in SSH, so make one of those first.
+     */
+    ssh_cipher *c = NULL;
+    if (strstartswith(name, "poly1305"))
+        c = ssh_cipher_new(&ssh2_chacha20_poly1305);
+    else if (strstartswith(name, "aesgcm"))
+        c = ssh_cipher_new(&ssh_aes128_gcm);
+
+    struct mac_ctx ctx[1];
+    ctx->m = ssh2_mac_new(alg, c);
+    if (!ctx->m) {
+        unavailable("mac", name);
+        if (c)
+            ssh_cipher_free(c);
+        return;
+    }
+    assert(alg->len <= sizeof(ctx->out));
+
+    if (c) {
+        ssh_cipher_setkey(c, bench_data);
+        ssh_cipher_setiv(c, bench_data);
+    } else {
+        ssh2_mac_setkey(ctx->m, make_ptrlen(bench_data, alg->keylen));
+    }
+
+    for (size_t i = 0; i < nsizes; i++) {
+        ctx->len = sizes[i];
+        bench("mac", name, alg->name, "mac", ctx->len, mac_one, ctx);
+    }
+
+    ssh2_mac_free(ctx->m);
+    if (c)
+        ssh_cipher_free(c);
+}
+
+/* ---------------------------------------------------------------------- */
+
+struct cipher_ctx {
+    ssh_cipher *c;
+    unsigned char *buf;
+    size_t len;
+};
+
+static void encrypt_one(void *vctx)
+{
+    struct cipher_ctx *ctx = (struct cipher_ctx *)vctx;
+    ssh_cipher_encrypt(ctx->c, ctx->buf, ctx->len);
+}
+
+static void decrypt_one(void *vctx)
+{
+    struct cipher_ctx *ctx = (struct cipher_ctx *)vctx;
+    ssh_cipher_decrypt(ctx->c, ctx->buf, ctx->len);
+}
+
+static void bench_cipheralg(const char *name, const ssh_cipheralg *alg)
+{
+    if (!selected("cipher", name))
+        return;
+
+    struct cipher_ctx ctx[1];
+    ctx->c = ssh_cipher_new(alg);
+    if (!ctx->c) {
+        unavailable("cipher", name);
+        return;
+    }
+    ctx->buf = snewn(bench_data_len, unsigned char);
+    memcpy(ctx->buf, bench_data, bench_data_len);
+
+    ssh_cipher_setkey(ctx->c, bench_data);
+    ssh_cipher_setiv(ctx->c, bench_data);
+
+    /*
+     * An AEAD cipher's MAC is what sets up its per-packet state
+     * (ChaCha20's nonce, for instance), so start one. Its own cost is
+     * measured separately, under its own name.
+     */
+    ssh2_mac *m = NULL;
+    if (alg->required_mac) {
+        m = ssh2_mac_new(alg->required_mac, ctx->c);
+        ssh2_mac_start(m);
+    }
+
+    for (size_t i = 0; i < nsizes; i++) {
+        ctx->len = sizes[i];
+        if (ctx->len % alg->blksize)
+            continue;
+        bench("cipher", name, alg->ssh2_id, "encrypt", ctx->len,
+              encrypt_one, ctx);
+        bench("cipher", name, alg->ssh2_id, "decrypt", ctx->len,
+              decrypt_one, ctx);
+    }
+
+    if (m)
+        ssh2_mac_free(m);
+    ssh_cipher_free(ctx->c);
+    sfree(ctx->buf);
+}
+
+/* ---------------------------------------------------------------------- */
+
+struct dh_ctx_bench {
+    const char *name;
+    const ssh_kex *kex;
+    mp_int *f;
+};
+
+static void dh_one(void *vctx)
+{
+    struct dh_ctx_bench *ctx = (struct dh_ctx_bench *)vctx;
+    dh_ctx *dh = dh_setup_group(ctx->kex);
+    dh_create_e(dh);                   /* owned by dh */
+    if (dh_validate_f(dh, ctx->f))
+        fatal_error("kex %s: peer's value rejected", ctx->kex->name);
+    mp_free(dh_find_K(dh, ctx->f));
+    dh_cleanup(dh);
+}
+
+static void dh_bench(void *vctx)
+{
+    struct dh_ctx_bench *ctx = (struct dh_ctx_bench *)vctx;
+    /* Both sides of a DH exchange do the same work, so just time one */
+    bench("kex", ctx->name, ctx->kex->name, "exchange", 0, dh_one, ctx);
+}
+
+static void bench_dh_group(const char *name, const ssh_kex *kex)
+{
+    if (!selected("kex", name))
+        return;
+
+    struct dh_ctx_bench ctx[1];
+    ctx->name = name;
+    ctx->kex = kex;
+    dh_ctx *peer = dh_setup_group(kex);
+    ctx->f = mp_copy(dh_create_e(peer));
+    dh_cleanup(peer);
+
+    under_each_kernel(&mp_kernels, dh_bench, ctx);
+
+    mp_free(ctx->f);
+}
+
+struct ecdh_ctx_bench {
+    const char *name;
+    const ssh_kex *kex;
+    bool is_server;
+    ptrlen remote, cpub, spub;
+};
+
+static void ecdh_one(void *vctx)
+{
+    struct ecdh_ctx_bench *ctx = (struct ecdh_ctx_bench *)vctx;
+    strbuf *pub = strbuf_new_nm(), *K = strbuf_new_nm();
+    ecdh_key *key = ecdh_key_new(ctx->kex, ctx->is_server);
+
+    /* Each side calls these in the order the SSH kex does */
+    if (!ctx->is_server)
+        ecdh_key_getpublic(key, BinarySink_UPCAST(pub));
+    if (!ecdh_key_getkey(key, ctx->remote, BinarySink_UPCAST(K)))
+        fatal_error("kex %s: peer's value rejected", ctx->kex->name);
+    if (ctx->is_server)
+        ecdh_key_getpublic(key, BinarySink_UPCAST(pub));
+
+    ecdh_key_free(key);
+    strbuf_free(pub);
+    strbuf_free(K);
+}
+
+static void ecdh_bench(void *vctx)
+{
+    struct ecdh_ctx_bench *ctx = (struct ecdh_ctx_bench *)vctx;
+    ctx->is_server = false;
+    ctx->remote = ctx->spub;
+    bench("kex", ctx->name, ctx->kex->name, "client", 0, ecdh_one, ctx);
+    ctx->is_server = true;
+    ctx->remote = ctx->cpub;
+    bench("kex", ctx->name, ctx->kex->name, "server", 0, ecdh_one, ctx);
+}
+
+static void bench_ecdh_kex(const char *name, const ssh_kex *kex,
+                           const KernelSwitch *kernels)
+{
+    if (!selected("kex", name))
+        return;
+
+    /*
+     * Do one exchange in advance, to get a public value from each side
+     * to give to the other side in the timed runs. (In the NTRU
+     * hybrid, the server's public value depends on the client's, and
+     * the two sides do quite different amounts of work.)
+     */
+    strbuf *cpub = strbuf_new_nm(), *spub = strbuf_new_nm();
+    strbuf *K = strbuf_new_nm();
+    ecdh_key *client = ecdh_key_new(kex, false);
+    ecdh_key *server = ecdh_key_new(kex, true);
+    ecdh_key_getpublic(client, BinarySink_UPCAST(cpub));
+    if (!ecdh_key_getkey(server, ptrlen_from_strbuf(cpub),
+                         BinarySink_UPCAST(K)))
+        fatal_error("kex %s: server rejected client's value", kex->name);
+    ecdh_key_getpublic(server, BinarySink_UPCAST(spub));
+    ecdh_key_free(client);
+    ecdh_key_free(server);
+
+    struct ecdh_ctx_bench ctx[1];
+    ctx->name = name;
+    ctx->kex = kex;
+    ctx->cpub = ptrlen_from_strbuf(cpub);
+    ctx->spub = ptrlen_from_strbuf(spub);
+    under_each_kernel(kernels, ecdh_bench, ctx);
+
+    strbuf_free(cpub);
+    strbuf_free(spub);
+    strbuf_free(K);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void bench_ecdh_alg(const char *name, const ssh_kex *kex)
+{
+    bench_ecdh_kex(name, kex, &mp_kernels);
+}
+
+static ProgressReceiver null_progress = { .vt = &null_progress_vt };
+
+static ssh_key *generate_key(const ssh_keyalg *alg)
+{
+    if (alg == &ssh_rsa) {
+        PrimeGenerationContext *pgc =
+            primegen_new_context(&primegen_probabilistic);
+        RSAKey *rsa = snew(RSAKey);
+        rsa_generate(rsa, rsa_bits, false, pgc, &null_progress);
+        primegen_free_context(pgc);
+        return &rsa->sshk;
+    } else if (alg == &ssh_dsa) {
+        PrimeGenerationContext *pgc =
+            primegen_new_context(&primegen_probabilistic);
+        struct dsa_key *dsa = snew(struct dsa_key);
+        dsa_generate(dsa, 1024, pgc, &null_progress);
+        primegen_free_context(pgc);
+        return &dsa->sshk;
+    } else if (alg == &ssh_ecdsa_ed25519 || alg == &ssh_ecdsa_ed448) {
+        struct eddsa_key *ek = snew(struct eddsa_key);
+        eddsa_generate(ek, alg == &ssh_ecdsa_ed25519 ? 255 : 448);
+        return &ek->sshk;
+    } else if (alg == &ssh_ecdsa_nistp256 || alg == &ssh_ecdsa_nistp384 ||
+               alg == &ssh_ecdsa_nistp521) {
+        struct ecdsa_key *ek = snew(struct ecdsa_key);
+        ecdsa_generate(ek, (alg == &ssh_ecdsa_nistp256 ? 256 :
+                            alg == &ssh_ecdsa_nistp384 ? 384 : 521));
+        return &ek->sshk;
+    } else {
+        /* Certificate types: timing them would only repeat the
+         * figures for the underlying key type */
+        return NULL;
+    }
+}
+
+struct sign_ctx {
+    const char *name;
+    ssh_key *key;
+    ptrlen data, sig;
+};
+
+static void sign_one(void *vctx)
+{
+    struct sign_ctx *ctx = (struct sign_ctx *)vctx;
+    strbuf *sig = strbuf_new_nm();
+    ssh_key_sign(ctx->key, ctx->data, 0, BinarySink_UPCAST(sig));
+    strbuf_free(sig);
+}
+
+static void verify_one(void *vctx)
+{
+    struct sign_ctx *ctx = (struct sign_ctx *)vctx;
+    if (!ssh_key_verify(ctx->key, ctx->sig, ctx->data))
+        fatal_error("%s: signature failed to verify", ctx->key->vt->ssh_id);
+}
+
+static void sign_bench(void *vctx)
+{
+    struct sign_ctx *ctx = (struct sign_ctx *)vctx;
+    const char *ssh_id = ctx->key->vt->ssh_id;
+    bench("sign", ctx->name, ssh_id, "sign", 0, sign_one, ctx);
+    bench("sign", ctx->name, ssh_id, "verify", 0, verify_one, ctx);
+}
+
+static void sign_nocache_bench(void *vctx)
+{
+    struct sign_ctx *ctx = (struct sign_ctx *)vctx;
+    bench("sign", ctx->name, ctx->key->vt->ssh_id, "sign", 0, sign_one, ctx);
+}
+
+static void bench_keyalg(const char *name, const ssh_keyalg *alg)
+{
+    if (!selected("sign", name))
+        return;
+
+    struct sign_ctx ctx[1];
+    ctx->name = name;
+    ctx->key = generate_key(alg);
+    if (!ctx->key)
+        return;
+    ctx->data = make_ptrlen(bench_data, 64);
+
+    strbuf *sig = strbuf_new_nm();
+    ssh_key_sign(ctx->key, ctx->data, 0, BinarySink_UPCAST(sig));
+    ctx->sig = ptrlen_from_strbuf(sig);
+
+    under_each_kernel(&mp_kernels, sign_bench, ctx);
+
+    if (alg == &ssh_rsa) {
+        rsa_set_crt_cache(false);
+        bench_impl = "nocache";
+        under_each_kernel(&mp_kernels, sign_nocache_bench, ctx);
+        bench_impl = NULL;
+        rsa_set_crt_cache(true);
+    }
+
+    strbuf_free(sig);
+    ssh_key_free(ctx->key);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * For testcrypt-enum.h: the types of the enumerations we use. The
+ * others are ignored below, but their values still need a type.
+ */
+typedef const ssh_hashalg *TD_hashalg;
+typedef const ssh2_macalg *TD_macalg;
+typedef const ssh_keyalg *TD_keyalg;
+typedef const ssh_cipheralg *TD_cipheralg;
+typedef const ssh_kex *TD_dh_group;
+typedef const ssh_kex *TD_ecdh_alg;
+typedef RsaSsh1Order TD_rsaorder;
+typedef const PrimeGenerationPolicy *TD_primegenpolicy;
+typedef Argon2Flavour TD_argon2flavour;
+typedef FingerprintType TD_fptype;
+typedef HttpDigestHash TD_httpdigesthash;
+
+#define IGNORE_ENUM(name, value) ((void)(name), (void)(value))
+#define bench_rsaorder IGNORE_ENUM
+#define bench_primegenpolicy IGNORE_ENUM
+#define bench_argon2flavour IGNORE_ENUM
+#define bench_fptype IGNORE_ENUM
+#define bench_httpdigesthash IGNORE_ENUM
+
+static void bench_all(void)
+{
+    printf("type,name,impl,kernel,ssh_name,op,bytes,count,seconds,"
+           "ops_per_sec,mb_per_sec\n");
+
+#define BEGIN_ENUM_TYPE(name)                                   \
+    {                                                           \
+        static const struct {                                   \
+            const char *key;                                    \
+            TD_##name value;                                    \
+        } mapping[] = {
+#define ENUM_VALUE(name, value) {name, value},
+#define END_ENUM_TYPE(name)                                     \
+        };                                                      \
+        for (size_t i = 0; i < lenof(mapping); i++)             \
+            bench_##name(mapping[i].key, mapping[i].value);     \
+    }
+#include "testcrypt-enum.h"
+#undef BEGIN_ENUM_TYPE
+#undef ENUM_VALUE
+#undef END_ENUM_TYPE
+
+    for (int i = 0; i < ssh_ntru_hybrid_kex.nkexes; i++) {
+        const ssh_kex *kex = ssh_ntru_hybrid_kex.list[i];
+        bench_ecdh_kex("sntrup761x25519", kex, &ntru_kernels);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool doing_opts = true;
+    const char *pname = argv[0];
+
+    patterns = snewn(argc, char *);
+
+    while (--argc > 0) {
+        char *p = *++argv;
+
+        if (p[0] == '-' && doing_opts) {
+            if (!strcmp(p, "-t") || !strcmp(p, "--time")) {
+                if (--argc <= 0)
+                    fatal_error("'%s' expects a number of seconds", p);
+                bench_seconds = atof(*++argv);
+            } else if (!strcmp(p, "-s") || !strcmp(p, "--size")) {
+                if (--argc <= 0)
+                    fatal_error("'%s' expects a message size", p);
+                size_t size = strtoul(*++argv, NULL, 0);
+                if (!size)
+                    fatal_error("message size must be positive");
+                sgrowarray(sizes, sizesize, nsizes);
+                sizes[nsizes++] = size;
+            } else if (!strcmp(p, "--rsa-bits")) {
+                if (--argc <= 0)
+                    fatal_error("'%s' expects a key size", p);
+                rsa_bits = atoi(*++argv);
+            } else if (!strcmp(p, "--")) {
+                doing_opts = false;
+            } else if (!strcmp(p, "--help")) {
+                printf("  usage: %s [options] [pattern...]\n", pname);
+                printf("options: -t, --time <seconds>  "
+                       "time each measurement for this long\n");
+                printf("         -s, --size <bytes>    "
+                       "message size for bulk primitives (may repeat)\n");
+                printf("         --rsa-bits <bits>     "
+                       "size of RSA key to sign with\n");
+                printf("   also: --help                "
+                       "display this text\n");
+                printf("patterns are wildcards matched against "
+                       "type (hash, mac, cipher, kex, sign)\n"
+                       "and name (as in testcrypt)\n");
+                return 0;
+            } else {
+                fatal_error("unknown command line option '%s'", p);
+            }
+        } else {
+            patterns[npatterns++] = p;
+        }
+    }
+
+    if (!nsizes) {
+        static const size_t default_sizes[] = {
+            16, 64, 256, 1024, 8192, 32768,
+        };
+        sgrowarray(sizes, sizesize, lenof(default_sizes) - 1);
+        memcpy(sizes, default_sizes, sizeof(default_sizes));
+        nsizes = lenof(default_sizes);
+    }
+
+    /* Enough data for the largest message, and for any key or IV */
+    bench_data_len = 64;
+    for (size_t i = 0; i < nsizes; i++)
+        if (bench_data_len < sizes[i])
+            bench_data_len = sizes[i];
+
+    bench_prng = prng_new(&ssh_sha256);
+    prng_seed_begin(bench_prng);
+    put_asciz(bench_prng, "cryptbench");
+    prng_seed_finish(bench_prng);
+
+    bench_data = snewn(bench_data_len, unsigned char);
+    random_read(bench_data, bench_data_len);
+
+    bench_all();
+
+    sfree(bench_data);
+    sfree(sizes);
+    sfree(patterns);
+    prng_free(bench_prng);
+    return 0;
+}
@@ -374,6 +374,41 @@ class mpint(MyTestBase):
         bm = mp_copy(bi)
         self.assertEqual(int(mp_mul(am, bm)), ai * bi)
 
+    def testMulKernels(self):
+        # Run a spread of multiplications through both the portable
+        # inner loop and whatever accelerated kernel the CPU supports
+        # (which may be none, in which case this repeats itself).
+        # Sizes are chosen to straddle the Karatsuba threshold and to
+        # exercise the remainder handling in an unrolled kernel, and
+        # the truncated products test discarding the top of a row.
+        def mul_tests():
+            for abits, bbits in [(64, 64), (192, 320), (1024, 1536),
+                                 (1600, 1600), (4096, 4096), (6208, 960)]:
+                ai = (1 << abits) - 1 - (1 << (abits // 3))
+                bi = (1 << bbits) // 7
+                am, bm = mp_copy(ai), mp_copy(bi)
+                self.assertEqual(int(mp_mul(am, bm)), ai * bi)
+                for bits in [64, 192, abits + 64, abits + bbits - 64]:
+                    cm = mp_new(bits)
+                    mp_mul_into(cm, am, bm)
+                    self.assertEqual(int(cm), (ai * bi) & mp_mask(cm))
+
+            m = (1 << 2048) - 1942289
+            base, exponent = 3**1000 % m, m - 2
+            self.assertEqual(int(mp_modpow(base, exponent, m)),
+                             pow(base, exponent, m))
+
+        try:
+            for accel in [False, True]:
+                got = mp_mul_set_accel(accel)
+                if not accel:
+                    self.assertFalse(got)
+                    self.assertEqual(mp_mul_kernel_name(), b"portable")
+                with self.subTest(kernel=mp_mul_kernel_name()):
+                    mul_tests()
+        finally:
+            mp_mul_set_accel(True)
+
     def testAddInteger(self):
         initial = mp_copy(4444444444444444444444444)
 
@@ -423,6 +458,9 @@ class mpint(MyTestBase):
                     # No tests we can do after that last one - we just
                     # insist that it isn't allowed to have crashed!
 
+                    if d < 2**32:
+                        self.assertEqual(mp_mod_known_integer(n, d), r)
+
     def testNthRoot(self):
         roots = [1, 13, 1234567654321,
                  57721566490153286060651209008240243104215933593992]
@@ -928,6 +966,113 @@ class ecc(MyTestBase):
             self.assertEqual(int(x), int(rGi.x))
             self.assertEqual(int(y), int(rGi.y))
 
+    def testEdwardsMultiscalar(self):
+        # Check the multi-scalar multiply against the sum of separate
+        # multiplications, with the scalars deliberately of different
+        # sizes, since a short one skips the top windows.
+        for curve in [ed25519, ed448]:
+            ec = ecc_edwards_curve(curve.p, int(curve.d), int(curve.a), None)
+            rpoints = [curve.G * k for k in [1, 7, 12345, 2**100 + 1]]
+            epoints = [ecc_edwards_point_new(ec, int(rP.x), int(rP.y))
+                       for rP in rpoints]
+            big = curve.G_order - 1
+            for scalars in [[1, 2, 3, 4], [0, 0, 0, 0], [big, 15, 16, big],
+                            [2**127 + 5, big, 1, 2**64 - 1]]:
+                rS = curve.point(0, 1)
+                for n in range(1, 5):
+                    rS = rS + rpoints[n-1] * scalars[n-1]
+                    eS = ecc_edwards_multiscalar(epoints[:n], scalars[:n])
+                    x, y = ecc_edwards_get_affine(eS)
+                    self.assertEqual(int(x), int(rS.x))
+                    self.assertEqual(int(y), int(rS.y))
+
+    def testBaseTableMultiply(self):
+        # The fixed-base multiply functions use the ordinary ladder for
+        # their first few calls and a precomputed table after that, so
+        # running enough test cases through them checks both. Unlike
+        # the plain multiply functions, multipliers larger than the
+        # order are allowed.
+        ints = set(i % p256.G_order for i in fibonacci_scattered(10))
+        ints.remove(0)
+        ints.update([1, 2, 15, 16, 17, p256.G_order - 1, p256.G_order + 5,
+                     2**300 + 3])
+
+        for curve in [p256, p384, p521]:
+            wc = ecc_weierstrass_curve(curve.p, int(curve.a), int(curve.b),
+                                       None)
+            wG = ecc_weierstrass_point_new(wc, int(curve.G.x), int(curve.G.y))
+            table = ecc_weierstrass_base_table_new(wG, curve.G_order)
+            for i in sorted(ints):
+                wGi = ecc_weierstrass_base_table_multiply(table, i)
+                x, y = ecc_weierstrass_get_affine(wGi)
+                rGi = curve.G * (i % curve.G_order)
+                self.assertEqual(int(x), int(rGi.x))
+                self.assertEqual(int(y), int(rGi.y))
+
+        for curve in [ed25519, ed448]:
+            ec = ecc_edwards_curve(curve.p, int(curve.d), int(curve.a), None)
+            eG = ecc_edwards_point_new(ec, int(curve.G.x), int(curve.G.y))
+            table = ecc_edwards_base_table_new(eG, curve.G_order)
+            for i in sorted(ints):
+                eGi = ecc_edwards_base_table_multiply(table, i)
+                x, y = ecc_edwards_get_affine(eGi)
+                rGi = curve.G * (i % curve.G_order)
+                self.assertEqual(int(x), int(rGi.x))
+                self.assertEqual(int(y), int(rGi.y))
+
+    def testSpecialisedFieldSpecialCases(self):
+        # P-256 and the 2^255-19 curves get their own fixed-size field
+        # arithmetic (see ecc-field.c). The multiply tests above cover
+        # the common paths through it; this checks the special cases
+        # of Weierstrass add_general on a full-sized curve, in the
+        # same way as testWeierstrassSimple does on a toy one.
+        wc = ecc_weierstrass_curve(p256.p, int(p256.a), int(p256.b), None)
+
+        def check_point(wp, rp):
+            self.assertTrue(ecc_weierstrass_point_valid(wp))
+            is_id = ecc_weierstrass_is_identity(wp)
+            x, y = ecc_weierstrass_get_affine(wp)
+            if rp.infinite:
+                self.assertEqual(is_id, 1)
+            else:
+                self.assertEqual(is_id, 0)
+                self.assertEqual(int(x), int(rp.x))
+                self.assertEqual(int(y), int(rp.y))
+
+        def make_point(rp):
+            return ecc_weierstrass_point_new(wc, int(rp.x), int(rp.y)), rp
+
+        wI, rI = ecc_weierstrass_point_new_identity(wc), p256.point()
+        wP, rP = make_point(p256.G * 12345)
+        wQ, rQ = make_point(p256.G * 67890)
+        wmP, rmP = make_point(-rP)
+
+        check_point(ecc_weierstrass_add(wP, wQ), rP + rQ)
+        check_point(ecc_weierstrass_double(wP), rP + rP)
+        check_point(ecc_weierstrass_add_general(wP, wQ), rP + rQ)
+        check_point(ecc_weierstrass_add_general(wP, wP), rP + rP)
+        check_point(ecc_weierstrass_add_general(wI, wP), rP)
+        check_point(ecc_weierstrass_add_general(wP, wI), rP)
+        check_point(ecc_weierstrass_add_general(wI, wI), rI)
+        check_point(ecc_weierstrass_add_general(wmP, wP), rI)
+        check_point(ecc_weierstrass_add_general(wP, wmP), rI)
+
+        # Edwards addition is complete, so there are no special cases
+        # to select between, but check it directly anyway, including
+        # the identity.
+        ec = ecc_edwards_curve(ed25519.p, int(ed25519.d), int(ed25519.a),
+                               None)
+        rP, rQ = ed25519.G * 12345, ed25519.G * 67890
+        eP = ecc_edwards_point_new(ec, int(rP.x), int(rP.y))
+        eQ = ecc_edwards_point_new(ec, int(rQ.x), int(rQ.y))
+        eI = ecc_edwards_point_new(ec, 0, 1)
+        for eS, rS in [(ecc_edwards_add(eP, eQ), rP + rQ),
+                       (ecc_edwards_add(eP, eP), rP + rP),
+                       (ecc_edwards_add(eP, eI), rP)]:
+            x, y = ecc_edwards_get_affine(eS)
+            self.assertEqual(int(x), int(rS.x))
+            self.assertEqual(int(y), int(rS.y))
+
 class keygen(MyTestBase):
     def testPrimeCandidateSource(self):
         def inspect(pcs):
@@ -1000,6 +1145,24 @@ class keygen(MyTestBase):
                 for p in [2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61]:
                     self.assertNotEqual(n % p, 0)
 
+        # Check the whole sieve, for all the primes up to 2^16 (which
+        # pcs_generate tests several at a time) on a Sophie Germain
+        # search, in which each prime has two residues to avoid.
+        sieve = bytearray([1]) * 65536
+        for p in range(2, 256):
+            if sieve[p]:
+                sieve[p*p::p] = bytes(len(sieve[p*p::p]))
+        smallprimes = [p for p in range(3, 65536) if sieve[p]]
+        pcs = pcs_new(256)
+        pcs_try_sophie_germain(pcs)
+        pcs_ready(pcs)
+        with random_prng("test seed"):
+            for i in range(10):
+                n = int(pcs_generate(pcs))
+                for p in smallprimes:
+                    self.assertNotEqual(n % p, 0)
+                    self.assertNotEqual((2*n+1) % p, 0)
+
     def testPocklePositive(self):
         def add_small(po, *ps):
             for p in ps:
@@ -1256,6 +1419,39 @@ class keygen(MyTestBase):
         assert(pow(2, n-1, n) == 1) # Fermat test would pass, but ...
         self.assertEqual(miller_rabin_test(mr, 2), "failed") # ... this fails
 
+    def testThreadedPrimeGeneration(self):
+        # With several threads testing candidates at once, both kinds
+        # of policy should still come up with primes of the right
+        # size.
+        def fermat(n):
+            return all(pow(w, n-1, n) == 1 for w in [2, 3, 5, 7])
+
+        for policy in ['probabilistic', 'provable_maurer_simple']:
+            pgc = primegen_new_context(policy)
+            primegen_set_threads(pgc, 4)
+            with random_prng("threaded primegen " + policy):
+                for i in range(3):
+                    p = int(primegen_generate(pgc, pcs_new(512)))
+                    self.assertEqual(p.bit_length(), 512)
+                    self.assertTrue(fermat(p))
+
+        # A oneshot PrimeCandidateSource runs out after the first
+        # candidate, which the threaded search must still report
+        # correctly, whichever way that candidate's test went.
+        pgc = primegen_new_context('probabilistic')
+        primegen_set_threads(pgc, 4)
+        with random_prng("threaded primegen oneshot"):
+            gotnone = gotprime = False
+            while not (gotnone and gotprime):
+                pcs = pcs_new(512)
+                pcs_set_oneshot(pcs)
+                p = primegen_generate(pgc, pcs)
+                if p is None:
+                    gotnone = True
+                else:
+                    self.assertTrue(fermat(int(p)))
+                    gotprime = True
+
         # A white-box test for the side-channel-safe M-R
         # implementation, which has to check a^e against +-1 for every
         # exponent e of the form floor((n-1) / power of 2), so as to
@@ -1276,27 +1472,78 @@ class keygen(MyTestBase):
         self.assertEqual(miller_rabin_test(mr, 0x251), "failed")
 
 class ntru(MyTestBase):
+    def kernels(self):
+        # Run a test under the portable ring arithmetic, and then
+        # under whatever accelerated kernel the CPU supports.
+        try:
+            for accel in [False, True]:
+                got = ntru_set_accel(accel)
+                if not accel:
+                    self.assertFalse(got)
+                    self.assertEqual(ntru_kernel_name(), b"portable")
+                yield ntru_kernel_name()
+        finally:
+            ntru_set_accel(True)
+
     def testMultiply(self):
-        self.assertEqual(
-            ntru_ring_multiply([1,1,1,1,1,1], [1,1,1,1,1,1], 11, 59),
-            [1,2,3,4,5,6,5,4,3,2,1])
-        self.assertEqual(ntru_ring_multiply(
-            [1,0,1,2,0,0,1,2,0,1,2], [2,0,0,1,0,1,2,2,2,0,2], 11, 3),
-                         [1,0,0,0,0,0,0,0,0,0,0])
+        for kernel in self.kernels():
+            with self.subTest(kernel=kernel):
+                self.assertEqual(
+                    ntru_ring_multiply([1,1,1,1,1,1], [1,1,1,1,1,1], 11, 59),
+                    [1,2,3,4,5,6,5,4,3,2,1])
+                self.assertEqual(ntru_ring_multiply(
+                    [1,0,1,2,0,0,1,2,0,1,2], [2,0,0,1,0,1,2,2,2,0,2], 11, 3),
+                                 [1,0,0,0,0,0,0,0,0,0,0])
 
     def testInvert(self):
-        # Over GF(3), x^11-x-1 factorises as
-        # (x^3+x^2+2) * (x^8+2*x^7+x^6+2*x^4+2*x^3+x^2+x+1)
-        # so we expect that 2,0,1,1 has no inverse, being one of those factors.
-        self.assertEqual(ntru_ring_invert([0], 11, 3), None)
-        self.assertEqual(ntru_ring_invert([1], 11, 3),
-                         [1,0,0,0,0,0,0,0,0,0,0])
-        self.assertEqual(ntru_ring_invert([2,0,1,1], 11, 3), None)
-        self.assertEqual(ntru_ring_invert([1,0,1,2,0,0,1,2,0,1,2], 11, 3),
-                         [2,0,0,1,0,1,2,2,2,0,2])
-
-        self.assertEqual(ntru_ring_invert([1,0,1,2,0,0,1,2,0,1,2], 11, 59),
-                         [1,26,10,1,38,48,34,37,53,3,53])
+        for kernel in self.kernels():
+            with self.subTest(kernel=kernel):
+                # Over GF(3), x^11-x-1 factorises as
+                # (x^3+x^2+2) * (x^8+2*x^7+x^6+2*x^4+2*x^3+x^2+x+1)
+                # so we expect that 2,0,1,1 has no inverse, being one of
+                # those factors.
+                self.assertEqual(ntru_ring_invert([0], 11, 3), None)
+                self.assertEqual(ntru_ring_invert([1], 11, 3),
+                                 [1,0,0,0,0,0,0,0,0,0,0])
+                self.assertEqual(ntru_ring_invert([2,0,1,1], 11, 3), None)
+                self.assertEqual(ntru_ring_invert(
+                    [1,0,1,2,0,0,1,2,0,1,2], 11, 3),
+                                 [2,0,0,1,0,1,2,2,2,0,2])
+
+                self.assertEqual(ntru_ring_invert(
+                    [1,0,1,2,0,0,1,2,0,1,2], 11, 59),
+                                 [1,26,10,1,38,48,34,37,53,3,53])
+
+    def testKernelsAgree(self):
+        # Compare the accelerated ring arithmetic against the portable
+        # code on pseudorandom inputs, at the sntrup761 sizes (where
+        # the vector code's accumulators have to be reduced part way
+        # through a multiplication) as well as tiny ones.
+        def poly(seed, p, q):
+            data = hashlib.shake_256(seed.encode()).digest(2*p)
+            return [int.from_bytes(data[2*i:2*i+2], 'little') % q
+                    for i in range(p)]
+
+        for p, q in [(11, 3), (11, 59), (761, 3), (761, 4591)]:
+            for i in range(4):
+                a = poly(f"a {p} {q} {i}", p, q)
+                b = poly(f"b {p} {q} {i}", p, q)
+                results = {}
+                for kernel in self.kernels():
+                    results[kernel] = (ntru_ring_multiply(a, b, p, q),
+                                       ntru_ring_invert(a, p, q))
+                with self.subTest(p=p, q=q, i=i):
+                    self.assertEqual(len(set(map(repr, results.values()))), 1)
+                    prod, inv = results[b"portable"]
+                    if inv is not None:
+                        self.assertEqual(ntru_ring_multiply(a, inv, p, q),
+                                         [1] + [0]*(p-1))
+
+        # And the failure case at full size
+        for kernel in self.kernels():
+            with self.subTest(kernel=kernel):
+                self.assertEqual(ntru_ring_invert([0]*761, 761, 4591), None)
+                self.assertEqual(ntru_ring_invert([0]*761, 761, 3), None)
 
     def testMod3Round3(self):
         # Try a prime congruent to 1 mod 3
@@ -2362,6 +2609,111 @@ culpa qui officia deserunt mollit anim id est laborum.
         failure_test(n, e, d, 1, q, iqmp)
         failure_test(n, e, d, p, 1, iqmp)
 
+    def testRSARepeatedPrivateOps(self):
+        # An RSA key caches the precomputed parts of its CRT private
+        # operation after the first use. Make sure repeated uses of one
+        # key object agree with a fresh key each time, including when
+        # rsa_verify has had to swap p and q on loading.
+        p = 0xf49e4d21c1ec3d1c20dc8656cc29aadb2644a12c98ed6c81a6161839d20d398d
+        q = 0xa5f0bc464bf23c4c83cf17a2f396b15136fbe205c07cb3bb3bdb7ed357d1cd13
+        n = p*q
+        e = 37
+        d = int(mp_invert(e, (p-1)*(q-1)))
+        iqmp = int(mp_invert(q, p))
+
+        pubblob = ssh_string(b"ssh-rsa") + ssh2_mpint(e) + ssh2_mpint(n)
+        for pp, qq in [(p, q), (q, p)]:
+            privblob = (ssh2_mpint(d) + ssh2_mpint(pp) +
+                        ssh2_mpint(qq) + ssh2_mpint(iqmp))
+            key = ssh_key_new_priv('rsa', pubblob, privblob)
+            for i in range(4):
+                msg = "message {:d}".format(i).encode('ASCII')
+                fresh = ssh_key_new_priv('rsa', pubblob, privblob)
+                sig = ssh_key_sign(key, msg, 0)
+                self.assertEqualBin(sig, ssh_key_sign(fresh, msg, 0))
+                self.assertTrue(ssh_key_verify(key, sig, msg))
+
+                # And with the cache turned off, which cryptbench
+                # does to measure what it saves
+                try:
+                    self.assertFalse(rsa_set_crt_cache(False))
+                    self.assertEqualBin(sig, ssh_key_sign(key, msg, 0))
+                finally:
+                    rsa_set_crt_cache(True)
+
+        # Public-key operations cache a Montgomery context in the same
+        # way, so check a public-only key gives consistent answers too.
+        pubkey = ssh_key_new_pub('rsa', pubblob)
+        for i in range(4):
+            msg = "message {:d}".format(i).encode('ASCII')
+            sig = ssh_key_sign(key, msg, 0)
+            self.assertTrue(ssh_key_verify(pubkey, sig, msg))
+            self.assertFalse(ssh_key_verify(pubkey, sig, msg + b"!"))
+
+        privblob = (ssh_uint32(nbits(n)) + ssh1_mpint(n) + ssh1_mpint(e) +
+                    ssh1_mpint(d) + ssh1_mpint(iqmp) +
+                    ssh1_mpint(q) + ssh1_mpint(p))
+        privkey = get_rsa_ssh1_priv_agent(privblob)
+        pubkey = ssh_rsakex_newkey(pubblob)
+        for plain in [2, 0x123456789abcdef, 0xfedcba987654321]:
+            with queued_random_data(64, "rsakex repeat {:x}".format(plain)):
+                cipher = ssh_rsakex_encrypt(pubkey, 'sha1', ssh2_mpint(plain))
+            decoded = ssh_rsakex_decrypt(privkey, 'sha1', cipher)
+            self.assertEqual(int(decoded), plain)
+
+    def testEdDSABatchVerify(self):
+        for alg, bits in [('ed25519', 255), ('ed448', 448)]:
+            with random_prng("batch verify " + alg):
+                keys = [eddsa_generate(bits) for i in range(3)]
+            keys.append(keys[0]) # the same key can appear twice
+            msgs = ["message {:d}".format(i).encode('ASCII')
+                    for i in range(len(keys))]
+            sigs = [ssh_key_sign(key, msg, 0)
+                    for key, msg in zip(keys, msgs)]
+
+            self.assertTrue(eddsa_verify_batch(keys, sigs, msgs))
+            self.assertTrue(eddsa_verify_batch(keys[:1], sigs[:1], msgs[:1]))
+            self.assertTrue(eddsa_verify_batch([], [], []))
+
+            # Any one bad signature must spoil the batch, whether it's
+            # unparseable, or well-formed but wrong
+            for i in range(len(keys)):
+                for pos in [-1, -40, 30]:
+                    bad = list(sigs)
+                    sig = bytearray(bad[i])
+                    sig[pos] ^= 1
+                    bad[i] = bytes(sig)
+                    self.assertFalse(eddsa_verify_batch(keys, bad, msgs))
+                bad = list(sigs)
+                bad[i] = sigs[i][:-1]
+                self.assertFalse(eddsa_verify_batch(keys, bad, msgs))
+            self.assertFalse(eddsa_verify_batch(keys, sigs, msgs[::-1]))
+            self.assertFalse(eddsa_verify_batch(keys[::-1], sigs, msgs))
+
+        # The batch check is cofactored, unlike ssh_key_verify. Make a
+        # public key with an order-2 component added, and a signature
+        # that only fails the cofactorless check because of it.
+        def enc(P):
+            return (int(P.y) | (int(P.x) & 1) << 255).to_bytes(32, 'little')
+        L = ed25519.G_order
+        a, r = 0x123456789, 0x987654321
+        A = ed25519.G * a + ed25519.point(0, ed25519.p - 1)
+        R = ed25519.G * r
+        for i in itertools.count():
+            msg = "torsion {:d}".format(i).encode('ASCII')
+            H = int.from_bytes(hashlib.sha512(
+                enc(R) + enc(A) + msg).digest(), 'little') % L
+            if H & 1:
+                break
+        s = (r + H * a) % L
+        key = ssh_key_new_pub('ed25519', ssh_string(b"ssh-ed25519") +
+                              ssh_string(enc(A)))
+        sig = ssh_string(b"ssh-ed25519") + ssh_string(
+            enc(R) + s.to_bytes(32, 'little'))
+        self.assertFalse(ssh_key_verify(key, sig, msg))
+        self.assertTrue(eddsa_verify_batch([key, key], [sig, sig],
+                                           [msg, msg]))
+
     def testKeyMethods(self):
         # Exercise all the methods of the ssh_key trait on all key
         # types, and ensure that they're consistent with each other.
@@ -2762,6 +3114,26 @@ Private-MAC: 5b1f6f4cc43eb0060d2c3e181bc0129343adba2b
             self.assertEqual(result, False)
             self.assertEqual(err[:22], b'Certificate expired at')
 
+            # A certificate whose signature has been verified once is
+            # remembered, so as not to verify it again, but all the
+            # other checks must still be done on it
+            opensshcert_sig_cache_clear()
+            self.assertFalse(opensshcert_sig_cache_check(certified_key))
+            result, err = certified_key.check_cert(
+                False, b'username', 1000, '')
+            self.assertEqual(result, True)
+            self.assertTrue(opensshcert_sig_cache_check(certified_key))
+            result, err = certified_key.check_cert(
+                True, b'username', 1000, '')
+            self.assertEqual(result, False)
+            result, err = certified_key.check_cert(
+                False, b'someoneelse', 1000, '')
+            self.assertEqual(result, False)
+            result, err = certified_key.check_cert(
+                False, b'username', 2000, '')
+            self.assertEqual(result, False)
+            self.assertEqual(err[:22], b'Certificate expired at')
+
             # Modify the certificate so that the signature doesn't validate
             username_position = cert_pub.index(b'username')
             bytelist = list(cert_pub)
@@ -2772,6 +3144,7 @@ Private-MAC: 5b1f6f4cc43eb0060d2c3e181bc0129343adba2b
                 False, b'username', 1000, '')
             self.assertEqual(result, False)
             self.assertEqual(err, b"Certificate's signature is invalid")
+            self.assertFalse(opensshcert_sig_cache_check(miscertified_key))
 
             # Make a certificate containing a critical option, to test we
             # reject it
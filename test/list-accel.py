@@ -36,3 +36,11 @@ list_mac_implementations("aesgcm")
 list_hash_implementations("sha1")
 list_hash_implementations("sha256")
 list_hash_implementations("sha512")
+
+mp_mul_set_accel(True)
+print("Implementation of bignum multiplication:")
+print(f"  {mp_mul_kernel_name().decode('ASCII'):<32s} in use")
+
+ntru_set_accel(True)
+print("Implementation of NTRU Prime ring arithmetic:")
+print(f"  {ntru_kernel_name().decode('ASCII'):<32s} in use")
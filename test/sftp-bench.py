@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+
+# Measure the throughput of PuTTY's SFTP server when the client keeps
+# many requests outstanding at once, which is the workload the
+# background I/O in unix/sftpserver.c is there to speed up.
+#
+# The server is psusan, run as a proxy command by Plink in bare
+# ssh-connection mode, so that the SFTP subsystem's packets go
+# straight through Plink's standard input and output with no
+# cryptography in the way. For each queue depth, the script reads a
+# test file with that many FXP_READs in flight (checking the data that
+# comes back, in whatever order it arrives), and then writes a file
+# the same way.
+#
+# To see the difference the page cache makes, point --dir at a
+# filesystem of interest and drop the caches between runs.
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+SSH_FXP_INIT, SSH_FXP_VERSION = 1, 2
+SSH_FXP_OPEN, SSH_FXP_CLOSE, SSH_FXP_READ, SSH_FXP_WRITE = 3, 4, 5, 6
+SSH_FXP_STATUS, SSH_FXP_HANDLE, SSH_FXP_DATA = 101, 102, 103
+SSH_FXF_READ, SSH_FXF_WRITE, SSH_FXF_CREAT, SSH_FXF_TRUNC = 1, 2, 8, 16
+SSH_FX_OK, SSH_FX_EOF = 0, 1
+
+def string(s):
+    return struct.pack(">L", len(s)) + s
+
+class SftpClient:
+    def __init__(self, argv):
+        self.proc = subprocess.Popen(argv, stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, bufsize=0)
+        self.next_id = 1
+        self.send(SSH_FXP_INIT, struct.pack(">L", 3))
+        ptype, _ = self.recv()
+        assert ptype == SSH_FXP_VERSION, ptype
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait()
+
+    def send(self, ptype, payload):
+        self.proc.stdin.write(struct.pack(">LB", len(payload) + 1, ptype) +
+                              payload)
+
+    def read_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.proc.stdout.read(n - len(data))
+            if not chunk:
+                sys.exit("sftp-bench: server connection closed")
+            data += chunk
+        return data
+
+    def recv(self):
+        length, ptype = struct.unpack(">LB", self.read_exact(5))
+        return ptype, self.read_exact(length - 1)
+
+    def request(self, ptype, payload):
+        reqid = self.next_id
+        self.next_id += 1
+        self.send(ptype, struct.pack(">L", reqid) + payload)
+        return reqid
+
+    def reply(self):
+        ptype, payload = self.recv()
+        reqid, = struct.unpack(">L", payload[:4])
+        return reqid, ptype, payload[4:]
+
+    def call(self, ptype, payload):
+        reqid = self.request(ptype, payload)
+        rid, rtype, rpayload = self.reply()
+        assert rid == reqid
+        return rtype, rpayload
+
+    def open(self, path, flags):
+        rtype, payload = self.call(SSH_FXP_OPEN, string(path.encode()) +
+                                   struct.pack(">LL", flags, 0))
+        if rtype != SSH_FXP_HANDLE:
+            sys.exit("sftp-bench: unable to open {}".format(path))
+        length, = struct.unpack(">L", payload[:4])
+        return payload[4:4+length]
+
+    def close_handle(self, handle):
+        rtype, payload = self.call(SSH_FXP_CLOSE, string(handle))
+        assert rtype == SSH_FXP_STATUS
+
+def status_code(payload):
+    return struct.unpack(">L", payload[:4])[0]
+
+def bench_read(client, path, expected, depth, chunk):
+    handle = client.open(path, SSH_FXF_READ)
+    pending = {}
+    offset = 0
+    eof = False
+    got = 0
+    start = time.perf_counter()
+    while pending or not eof:
+        while not eof and len(pending) < depth:
+            reqid = client.request(SSH_FXP_READ, string(handle) +
+                                   struct.pack(">QL", offset, chunk))
+            pending[reqid] = offset
+            offset += chunk
+            if offset >= len(expected):
+                eof = True
+        reqid, rtype, payload = client.reply()
+        roffset = pending.pop(reqid)
+        if rtype == SSH_FXP_DATA:
+            length, = struct.unpack(">L", payload[:4])
+            data = payload[4:4+length]
+            if data != expected[roffset:roffset+len(data)]:
+                sys.exit("sftp-bench: wrong data at offset {:d}".format(
+                    roffset))
+            got += len(data)
+        else:
+            assert rtype == SSH_FXP_STATUS
+            assert status_code(payload) == SSH_FX_EOF
+    elapsed = time.perf_counter() - start
+    client.close_handle(handle)
+    assert got == len(expected)
+    return elapsed
+
+def bench_write(client, path, data, depth, chunk):
+    handle = client.open(path, SSH_FXF_WRITE | SSH_FXF_CREAT | SSH_FXF_TRUNC)
+    pending = set()
+    offset = 0
+    start = time.perf_counter()
+    while pending or offset < len(data):
+        while offset < len(data) and len(pending) < depth:
+            pending.add(client.request(
+                SSH_FXP_WRITE, string(handle) + struct.pack(">Q", offset) +
+                string(data[offset:offset+chunk])))
+            offset += chunk
+        reqid, rtype, payload = client.reply()
+        pending.remove(reqid)
+        assert rtype == SSH_FXP_STATUS
+        assert status_code(payload) == SSH_FX_OK
+    client.close_handle(handle)
+    elapsed = time.perf_counter() - start
+    with open(path, "rb") as f:
+        if f.read() != data:
+            sys.exit("sftp-bench: file written wrongly")
+    return elapsed
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark the SFTP server with many outstanding "
+        "requests.")
+    parser.add_argument("--plink", default="plink",
+                        help="Plink binary to run")
+    parser.add_argument("--psusan", default="psusan",
+                        help="psusan binary to run as the server")
+    parser.add_argument("--dir", help="Directory to put test files in")
+    parser.add_argument("--size", type=int, default=64,
+                        help="Size of test file in MiB")
+    parser.add_argument("--chunk", type=int, default=32768,
+                        help="Bytes per read or write request")
+    parser.add_argument("--depth", type=int, nargs="+",
+                        default=[1, 4, 16, 64],
+                        help="Numbers of requests to keep outstanding")
+    args = parser.parse_args()
+
+    client = SftpClient([args.plink, "-batch", "-ssh-connection",
+                         "-proxycmd", args.psusan, "-s", "sftp-bench",
+                         "sftp"])
+
+    with tempfile.TemporaryDirectory(dir=args.dir) as tmpdir:
+        data = os.urandom(args.size << 20)
+        srcpath = os.path.join(tmpdir, "src")
+        dstpath = os.path.join(tmpdir, "dst")
+        with open(srcpath, "wb") as f:
+            f.write(data)
+
+        for depth in args.depth:
+            t = bench_read(client, srcpath, data, depth, args.chunk)
+            print("read  depth {:4d}: {:8.1f} MiB/s".format(
+                depth, args.size / t))
+            t = bench_write(client, dstpath, data, depth, args.chunk)
+            print("write depth {:4d}: {:8.1f} MiB/s".format(
+                depth, args.size / t))
+
+    client.close()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,348 @@
+#!/usr/bin/env python3
+
+# Functional tests for PuTTY's SFTP server, and for the PSFTP commands
+# that depend on its protocol extensions.
+#
+# The server is psusan. Raw protocol tests run it as a proxy command
+# of Plink in bare ssh-connection mode, so that the SFTP subsystem's
+# packets go straight through Plink's standard input and output; the
+# PSFTP tests run PSFTP against it in the same way. The binaries are
+# found on $PATH, unless overridden by the environment variables
+# PUTTY_PSUSAN, PUTTY_PLINK and PUTTY_PSFTP.
+
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+assert sys.version_info[:2] >= (3,0), "This is Python 3 code"
+
+PSUSAN = os.environ.get("PUTTY_PSUSAN", "psusan")
+PLINK = os.environ.get("PUTTY_PLINK", "plink")
+PSFTP = os.environ.get("PUTTY_PSFTP", "psftp")
+
+SSH_FXP_INIT, SSH_FXP_VERSION = 1, 2
+SSH_FXP_OPEN, SSH_FXP_CLOSE, SSH_FXP_READ, SSH_FXP_WRITE = 3, 4, 5, 6
+SSH_FXP_STAT = 17
+SSH_FXP_STATUS, SSH_FXP_HANDLE, SSH_FXP_DATA, SSH_FXP_ATTRS = \
+    101, 102, 103, 105
+SSH_FXP_EXTENDED, SSH_FXP_EXTENDED_REPLY = 200, 201
+SSH_FXF_READ, SSH_FXF_WRITE, SSH_FXF_CREAT, SSH_FXF_TRUNC = 1, 2, 8, 16
+SSH_FX_OK, SSH_FX_EOF, SSH_FX_FAILURE = 0, 1, 4
+
+def string(s):
+    if isinstance(s, str):
+        s = s.encode()
+    return struct.pack(">L", len(s)) + s
+
+def get_string(payload):
+    length, = struct.unpack(">L", payload[:4])
+    return payload[4:4+length], payload[4+length:]
+
+class SftpClient:
+    """A minimal SFTP client talking to psusan through Plink."""
+    def __init__(self):
+        self.proc = subprocess.Popen(
+            [PLINK, "-batch", "-ssh-connection", "-proxycmd", PSUSAN,
+             "-s", "sftptest", "sftp"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0)
+        self.next_id = 1
+        self.send(SSH_FXP_INIT, struct.pack(">L", 3))
+        ptype, _ = self.recv()
+        assert ptype == SSH_FXP_VERSION, ptype
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait(timeout=60)
+        self.proc.stdout.close()
+
+    def send(self, ptype, payload):
+        self.proc.stdin.write(struct.pack(">LB", len(payload) + 1, ptype) +
+                              payload)
+
+    def read_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.proc.stdout.read(n - len(data))
+            if not chunk:
+                raise EOFError("server connection closed")
+            data += chunk
+        return data
+
+    def recv(self):
+        length, ptype = struct.unpack(">LB", self.read_exact(5))
+        return ptype, self.read_exact(length - 1)
+
+    def request(self, ptype, payload):
+        reqid = self.next_id
+        self.next_id += 1
+        self.send(ptype, struct.pack(">L", reqid) + payload)
+        return reqid
+
+    def reply(self):
+        ptype, payload = self.recv()
+        reqid, = struct.unpack(">L", payload[:4])
+        return reqid, ptype, payload[4:]
+
+    def call(self, ptype, payload):
+        reqid = self.request(ptype, payload)
+        rid, rtype, rpayload = self.reply()
+        assert rid == reqid
+        return rtype, rpayload
+
+    def extended(self, name, payload):
+        return self.call(SSH_FXP_EXTENDED, string(name) + payload)
+
+    def open(self, path, flags):
+        rtype, payload = self.call(SSH_FXP_OPEN, string(path) +
+                                   struct.pack(">LL", flags, 0))
+        assert rtype == SSH_FXP_HANDLE, rtype
+        return get_string(payload)[0]
+
+    def close_handle(self, handle):
+        rtype, payload = self.call(SSH_FXP_CLOSE, string(handle))
+        assert rtype == SSH_FXP_STATUS
+
+def status_code(rtype, payload):
+    assert rtype == SSH_FXP_STATUS, rtype
+    return struct.unpack(">L", payload[:4])[0]
+
+def run_psftp(cwd, commands):
+    """Run a batch of PSFTP commands in a directory, and return the
+    output. Errors don't stop the batch."""
+    with tempfile.NamedTemporaryFile("w", suffix=".txt") as script:
+        script.write("".join(cmd + "\n" for cmd in commands))
+        script.flush()
+        return subprocess.run(
+            [PSFTP, "-batch", "-ssh-connection", "-proxycmd", PSUSAN,
+             "-be", "-b", script.name, "dummy"],
+            cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+            stdin=subprocess.DEVNULL, timeout=60, check=True).stdout
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+def read_file(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+class psftp_cp(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dir = self.tmp.name
+        self.data = os.urandom(100000)
+        self.src = os.path.join(self.dir, "src")
+        write_file(self.src, self.data)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def testCopy(self):
+        # An existing destination longer than the source must end up
+        # the same length as the source.
+        dst = os.path.join(self.dir, "dst")
+        write_file(dst, os.urandom(300000))
+        run_psftp(self.dir, ["cp src dst", "mkdir sub", "cp src sub"])
+        self.assertEqual(read_file(dst), self.data)
+        self.assertEqual(read_file(os.path.join(self.dir, "sub", "src")),
+                         self.data)
+
+    def testCopyOntoItself(self):
+        # None of these may destroy the source, whether PSFTP spots
+        # that the names are the same or the server spots that the
+        # files are.
+        os.link(self.src, os.path.join(self.dir, "hard"))
+        os.symlink("src", os.path.join(self.dir, "soft"))
+        out = run_psftp(self.dir, ["cp src src", "cp src .", "cp src hard",
+                                   "cp src soft", "cp ./src ../{}/src".format(
+                                       os.path.basename(self.dir))])
+        self.assertEqual(read_file(self.src), self.data)
+        self.assertNotIn(b" -> ", out)
+
+class psftp_delta(unittest.TestCase):
+    # Matches DELTA_BLOCKSIZE in psftp.c
+    BLOCK = 65536
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dir = self.tmp.name
+        self.old = os.urandom(10 * self.BLOCK + 1234)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def transfer(self, cmd, src, dst, old, new):
+        # Run "get -d" or "put -d" with the destination starting off
+        # as 'old' and the source as 'new', and return how many bytes
+        # PSFTP said it sent.
+        srcpath = os.path.join(self.dir, src)
+        dstpath = os.path.join(self.dir, dst)
+        write_file(srcpath, new)
+        write_file(dstpath, old)
+        out = run_psftp(self.dir, ["{} -d {} {}".format(cmd, src, dst)])
+        self.assertEqual(read_file(dstpath), new)
+        for line in out.splitlines():
+            if b"(delta: " in line:
+                sent, total = line.split(b"(delta: ")[1].split(b" bytes")[
+                    0].split(b" of ")
+                self.assertEqual(int(total), len(new))
+                return int(sent)
+        self.fail("no delta summary in output: {!r}".format(out))
+
+    def both(self, old, new, expected):
+        # psusan runs in the same directory as PSFTP, so the "remote"
+        # and "local" files are side by side, and each direction can
+        # be tested on the same pair of files.
+        self.assertEqual(self.transfer("get", "remote", "local", old, new),
+                         expected)
+        self.assertEqual(self.transfer("put", "local", "remote", old, new),
+                         expected)
+
+    def testUnchanged(self):
+        self.both(self.old, self.old, 0)
+
+    def testAppended(self):
+        self.both(self.old, self.old + os.urandom(5000), 5000)
+
+    def testTruncated(self):
+        self.both(self.old, self.old[:4 * self.BLOCK + 100], 0)
+
+    def testChangedBlock(self):
+        new = bytearray(self.old)
+        new[3 * self.BLOCK + 17] ^= 1
+        self.both(self.old, bytes(new), self.BLOCK)
+
+    def testChangedShortLastBlock(self):
+        new = bytearray(self.old)
+        new[-1] ^= 1
+        self.both(self.old, bytes(new), 1234)
+
+    def testInserted(self):
+        # Blocks are only compared at the same offset, so everything
+        # after an insertion is sent again. But it must still be right.
+        new = self.old[:2 * self.BLOCK] + b"x" + self.old[2 * self.BLOCK:]
+        self.both(self.old, new, len(new) - 2 * self.BLOCK)
+
+    def testNoDestination(self):
+        write_file(os.path.join(self.dir, "remote"), self.old)
+        run_psftp(self.dir, ["get -d remote local"])
+        self.assertEqual(read_file(os.path.join(self.dir, "local")),
+                         self.old)
+
+class sftp_server(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dir = self.tmp.name
+        self.client = SftpClient()
+
+    def tearDown(self):
+        self.client.close()
+        self.tmp.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.dir, name)
+
+    def copy_data(self, src, srcoffset, length, dst, dstoffset):
+        return status_code(*self.client.extended(
+            "copy-data", string(src) + struct.pack(">QQ", srcoffset, length) +
+            string(dst) + struct.pack(">Q", dstoffset)))
+
+    def testCopyData(self):
+        data = os.urandom(200000)
+        write_file(self.path("src"), data)
+        src = self.client.open(self.path("src"), SSH_FXF_READ)
+        dst = self.client.open(self.path("dst"), SSH_FXF_WRITE |
+                               SSH_FXF_CREAT | SSH_FXF_TRUNC)
+        # Length 0 means up to the end of the source
+        self.assertEqual(self.copy_data(src, 0, 0, dst, 0), SSH_FX_OK)
+        self.assertEqual(self.copy_data(src, 1000, 5000, dst, 300000),
+                         SSH_FX_OK)
+        self.client.close_handle(src)
+        self.client.close_handle(dst)
+        self.assertEqual(read_file(self.path("dst")),
+                         data + bytes(100000) + data[1000:6000])
+
+    def testCopyDataOverlap(self):
+        data = os.urandom(100000)
+        write_file(self.path("src"), data)
+        h = self.client.open(self.path("src"), SSH_FXF_READ | SSH_FXF_WRITE)
+        self.assertEqual(self.copy_data(h, 0, 50000, h, 40000),
+                         SSH_FX_FAILURE)
+        # Adjacent ranges of the same file are fine
+        self.assertEqual(self.copy_data(h, 0, 50000, h, 50000), SSH_FX_OK)
+        self.client.close_handle(h)
+        self.assertEqual(read_file(self.path("src")),
+                         data[:50000] + data[:50000])
+
+    def testFsync(self):
+        h = self.client.open(self.path("f"), SSH_FXF_WRITE | SSH_FXF_CREAT)
+        self.assertEqual(status_code(*self.client.call(
+            SSH_FXP_WRITE, string(h) + struct.pack(">Q", 0) +
+            string(b"hello"))), SSH_FX_OK)
+        self.assertEqual(status_code(*self.client.extended(
+            "fsync@openssh.com", string(h))), SSH_FX_OK)
+        self.client.close_handle(h)
+        self.assertEqual(read_file(self.path("f")), b"hello")
+
+    def check_file_request(self, by_name, target, algs, offset, length,
+                           blocksize):
+        return (SSH_FXP_EXTENDED,
+                string("check-file-name" if by_name else
+                       "check-file-handle") + string(target) +
+                string(algs) + struct.pack(">QQL", offset, length,
+                                           blocksize))
+
+    def check_file(self, *args):
+        rtype, payload = self.client.call(*self.check_file_request(*args))
+        self.assertEqual(rtype, SSH_FXP_EXTENDED_REPLY)
+        name, payload = get_string(payload)
+        self.assertEqual(name, b"check-file")
+        alg, hashes = get_string(payload)
+        return alg.decode(), hashes
+
+    def testCheckFile(self):
+        data = os.urandom(300000)
+        write_file(self.path("f"), data)
+        h = self.client.open(self.path("f"), SSH_FXF_READ)
+        for by_name, target in [(True, self.path("f")), (False, h)]:
+            # The server picks the first algorithm it knows
+            self.assertEqual(
+                self.check_file(by_name, target, "foo,sha1,sha256",
+                                0, 0, 0),
+                ("sha1", hashlib.sha1(data).digest()))
+            self.assertEqual(
+                self.check_file(by_name, target, "sha256", 1000, 5000, 0),
+                ("sha256", hashlib.sha256(data[1000:6000]).digest()))
+            # Block hashes, with a short one at the end
+            self.assertEqual(
+                self.check_file(by_name, target, "md5", 0, 0, 100000 - 1),
+                ("md5", b"".join(
+                    hashlib.md5(data[i:i+99999]).digest()
+                    for i in range(0, len(data), 99999))))
+        self.client.close_handle(h)
+        rtype, payload = self.client.call(*self.check_file_request(
+            True, self.path("nonexistent"), "sha256", 0, 0, 0))
+        self.assertNotEqual(status_code(rtype, payload), SSH_FX_OK)
+
+    def testCheckFileDoesNotBlock(self):
+        # A check-file on a big file mustn't hold up a request sent
+        # after it, which only the event loop's thread can answer.
+        size = 256 << 20
+        with open(self.path("big"), "wb") as f:
+            f.truncate(size)
+        checkid = self.client.request(*self.check_file_request(
+            True, self.path("big"), "sha256", 0, 0, 0))
+        statid = self.client.request(SSH_FXP_STAT, string(self.dir))
+        replies = [self.client.reply() for _ in range(2)]
+        self.assertEqual([r[0] for r in replies], [statid, checkid])
+        self.assertEqual(replies[0][1], SSH_FXP_ATTRS)
+        self.assertEqual(replies[1][1], SSH_FXP_EXTENDED_REPLY)
+        hashes = get_string(get_string(replies[1][2])[1])[1]
+        self.assertEqual(hashes, hashlib.sha256(bytes(size)).digest())
+
+if __name__ == "__main__":
+    unittest.main()
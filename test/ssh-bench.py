@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+
+# Measure the performance of PuTTY's SSH-2 implementation end to end,
+# by running Uppity as a server on loopback and driving it with Plink,
+# so that the whole of the client side (transport, userauth and
+# connection layers) is exercised by real connections.
+#
+# Three things are measured:
+#
+#  - handshakes per second: complete connections (key exchange,
+#    authentication, a session channel running 'true', and close),
+#    with several clients connecting at once;
+#
+#  - bulk throughput: the rate at which Plink can receive data from
+#    'cat' on the server, for each combination of cipher, MAC and
+#    compression given with --combo, again with several connections
+#    at once;
+#
+#  - channel-open latency: the time taken to open a port-forwarding
+#    channel on an existing connection and get a byte back through it
+#    from a local echo server.
+#
+# A combination is written CIPHER[:MAC][+zlib], using SSH protocol
+# names, e.g. 'aes128-ctr:hmac-sha2-256+zlib'. Uppity is restricted to
+# offering just those algorithms, so the test fails if the client
+# doesn't support them. (For AEAD ciphers the MAC is implied.)
+#
+# Plink and puttygen are run with HOME pointing at a temporary
+# directory, so nothing is written to your real PuTTY configuration.
+
+import argparse
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+DEFAULT_COMBOS = [
+    "chacha20-poly1305@openssh.com",
+    "aes256-gcm@openssh.com",
+    "aes128-ctr:hmac-sha2-256",
+    "aes256-ctr:hmac-sha2-256-etm@openssh.com",
+    "aes256-ctr:hmac-sha1",
+    "aes128-ctr:hmac-sha2-256+zlib",
+]
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+class Bench:
+    def __init__(self, args, tmpdir):
+        self.args = args
+        self.tmpdir = tmpdir
+        self.env = dict(os.environ, HOME=tmpdir)
+
+        self.hostkey = os.path.join(tmpdir, "hostkey.ppk")
+        empty = os.path.join(tmpdir, "empty")
+        open(empty, "w").close()
+        subprocess.check_call([args.puttygen, "-q", "-t", "ed25519",
+                               "-o", self.hostkey, "--new-passphrase", empty],
+                              env=self.env)
+        self.fingerprint = subprocess.check_output(
+            [args.puttygen, "-O", "fingerprint", self.hostkey],
+            env=self.env).decode("ASCII").strip()
+
+    def start_server(self, cipher=None, mac=None, comp=None):
+        port = free_port()
+        argv = [self.args.uppity, "--listen", str(port),
+                "--hostkey", self.hostkey, "--allow-auth", "none",
+                "--sessiondir", self.tmpdir]
+        for direction in ["cs", "sc"]:
+            if cipher is not None:
+                argv += ["--kexinit-{}cipher".format(direction), cipher]
+            if mac is not None:
+                argv += ["--kexinit-{}mac".format(direction), mac]
+            if comp is not None:
+                argv += ["--kexinit-{}comp".format(direction), comp]
+        server = subprocess.Popen(argv, stderr=subprocess.PIPE, env=self.env)
+        # Wait until it's listening before letting anyone connect
+        while True:
+            line = server.stderr.readline()
+            if not line:
+                sys.exit("ssh-bench: uppity failed to start")
+            if b"listening on port" in line:
+                break
+        threading.Thread(target=server.stderr.read, daemon=True).start()
+        return server, port
+
+    def plink_argv(self, port, options, command=[]):
+        return [self.args.plink, "-batch", "-ssh", "-P", str(port),
+                "-l", "bench", "-hostkey", self.fingerprint,
+                *options, "127.0.0.1", *command]
+
+    def in_parallel(self, fn):
+        # Run fn(i) in as many threads as there are clients, and
+        # return the time until they've all finished. fn reports
+        # failure by returning an error message.
+        errors = []
+        def wrapper(i):
+            err = fn(i)
+            if err is not None:
+                errors.append(err)
+        threads = [threading.Thread(target=wrapper, args=(i,))
+                   for i in range(self.args.clients)]
+        start = time.perf_counter()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        if errors:
+            sys.exit("ssh-bench: " + errors[0])
+        return time.perf_counter() - start
+
+    def handshakes(self):
+        server, port = self.start_server()
+        argv = self.plink_argv(port, [], ["true"])
+        counts = [0] * self.args.clients
+        deadline = time.perf_counter() + self.args.seconds
+
+        def client(i):
+            while time.perf_counter() < deadline:
+                if subprocess.call(argv, stderr=subprocess.DEVNULL,
+                                   env=self.env) != 0:
+                    return "connection failed in handshake test"
+                counts[i] += 1
+
+        elapsed = self.in_parallel(client)
+        server.terminate()
+        server.wait()
+        print("handshakes: {:8.1f} /s  ({:d} clients)".format(
+            sum(counts) / elapsed, self.args.clients))
+
+    def bulk(self, combo):
+        comp = None
+        if combo.endswith("+zlib"):
+            combo, comp = combo[:-len("+zlib")], "zlib"
+        cipher, _, mac = combo.partition(":")
+        server, port = self.start_server(cipher, mac or None, comp)
+        extra = ["-C"] if comp else []
+        argv = self.plink_argv(port, extra, ["cat", self.datafile])
+        size = os.path.getsize(self.datafile)
+
+        def client(i):
+            proc = subprocess.Popen(argv, stdout=subprocess.PIPE,
+                                    stderr=subprocess.DEVNULL, env=self.env)
+            got = 0
+            while True:
+                data = proc.stdout.read(65536)
+                if not data:
+                    break
+                got += len(data)
+            if proc.wait() != 0 or got != size:
+                return "bulk transfer failed for {}".format(combo)
+
+        elapsed = self.in_parallel(client)
+        server.terminate()
+        server.wait()
+        print("bulk {:45s} {:8.1f} MiB/s".format(
+            combo + ("+zlib" if comp else ""),
+            size * self.args.clients / elapsed / 1048576))
+
+    def channel_open(self):
+        # A local echo server for the forwarded channels to reach
+        echo = socket.socket()
+        echo.bind(("127.0.0.1", 0))
+        echo.listen(16)
+        def echo_one(conn):
+            with conn:
+                while True:
+                    data = conn.recv(4096)
+                    if not data:
+                        break
+                    conn.sendall(data)
+        def echo_server():
+            while True:
+                conn, _ = echo.accept()
+                threading.Thread(target=echo_one, args=(conn,),
+                                 daemon=True).start()
+        threading.Thread(target=echo_server, daemon=True).start()
+
+        server, port = self.start_server()
+        fwdport = free_port()
+        plink = subprocess.Popen(
+            self.plink_argv(port, ["-N", "-L", "{:d}:127.0.0.1:{:d}".format(
+                fwdport, echo.getsockname()[1])]),
+            stderr=subprocess.DEVNULL, env=self.env)
+
+        # Wait for the forwarding to be set up
+        deadline = time.perf_counter() + 10
+        while True:
+            try:
+                socket.create_connection(("127.0.0.1", fwdport)).close()
+                break
+            except ConnectionRefusedError:
+                if time.perf_counter() > deadline:
+                    sys.exit("ssh-bench: port forwarding never started")
+                time.sleep(0.05)
+
+        times = []
+        for i in range(self.args.channels):
+            start = time.perf_counter()
+            with socket.create_connection(("127.0.0.1", fwdport)) as s:
+                s.sendall(b"x")
+                if s.recv(1) != b"x":
+                    sys.exit("ssh-bench: forwarded channel failed")
+                times.append(time.perf_counter() - start)
+
+        plink.terminate()
+        plink.wait()
+        server.terminate()
+        server.wait()
+        times.sort()
+        print("channel open: median {:.3f} ms, 90th percentile {:.3f} ms"
+              .format(times[len(times) // 2] * 1000,
+                      times[len(times) * 9 // 10] * 1000))
+
+    def run(self):
+        self.datafile = os.path.join(self.tmpdir, "data")
+        with open(self.datafile, "wb") as f:
+            # Half random, half text, so compression has something to
+            # do but doesn't get it all for free
+            half = self.args.size << 19
+            f.write(os.urandom(half))
+            line = b"The quick brown fox jumps over the lazy dog. %d\n"
+            written = 0
+            i = 0
+            while written < half:
+                chunk = line % i
+                f.write(chunk)
+                written += len(chunk)
+                i += 1
+
+        if "handshake" in self.args.tests:
+            self.handshakes()
+        if "bulk" in self.args.tests:
+            for combo in self.args.combo or DEFAULT_COMBOS:
+                self.bulk(combo)
+        if "channel" in self.args.tests:
+            self.channel_open()
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark PuTTY's SSH implementation against Uppity.")
+    parser.add_argument("--plink", default="plink",
+                        help="Plink binary to run")
+    parser.add_argument("--uppity", default="uppity",
+                        help="Uppity binary to run as the server")
+    parser.add_argument("--puttygen", default="puttygen",
+                        help="puttygen binary, to make a host key")
+    parser.add_argument("--clients", type=int, default=4,
+                        help="Number of connections to run at once")
+    parser.add_argument("--seconds", type=float, default=5,
+                        help="How long to run the handshake test for")
+    parser.add_argument("--size", type=int, default=64,
+                        help="Size of bulk data per connection in MiB")
+    parser.add_argument("--channels", type=int, default=200,
+                        help="Number of channels to open in the latency test")
+    parser.add_argument("--combo", action="append",
+                        help="Cipher/MAC/compression combination to test "
+                        "(may be repeated)")
+    parser.add_argument("tests", nargs="*",
+                        help="Which tests to run, out of 'handshake', "
+                        "'bulk' and 'channel' (default all)")
+    args = parser.parse_args()
+    all_tests = ["handshake", "bulk", "channel"]
+    for test in args.tests:
+        if test not in all_tests:
+            parser.error("unknown test '{}'".format(test))
+    args.tests = args.tests or all_tests
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        Bench(args, tmpdir).run()
+
+if __name__ == "__main__":
+    main()
@@ -41,6 +41,9 @@ host_ca_enum *enum_host_ca_start(void) { return NULL; }
 bool enum_host_ca_next(host_ca_enum *handle, strbuf *out) { return false; }
 void enum_host_ca_finish(host_ca_enum *handle) {}
 host_ca *host_ca_load(const char *name) { return NULL; }
+bool check_verified_cert(const char *id) { return false; }
+void store_verified_cert(const char *id)
+{ unreachable("no actual host certificates in this application"); }
 
 void old_keyfile_warning(void) { }
 
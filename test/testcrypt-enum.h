@@ -38,7 +38,6 @@ BEGIN_ENUM_TYPE(macalg)
     ENUM_VALUE("hmac_sha512", &ssh_hmac_sha512)
     ENUM_VALUE("poly1305", &ssh2_poly1305)
     ENUM_VALUE("aesgcm", &ssh2_aesgcm_mac)
-    ENUM_VALUE("aesgcm", &ssh2_aesgcm_mac)
     ENUM_VALUE("aesgcm_sw", &ssh2_aesgcm_mac_sw)
     ENUM_VALUE("aesgcm_ref_poly", &ssh2_aesgcm_mac_ref_poly)
 #if HAVE_CLMUL
@@ -118,6 +118,8 @@ FUNC(void, mp_mul_into, ARG(val_mpint, dest), ARG(val_mpint, a),
 FUNC(val_mpint, mp_add, ARG(val_mpint, x), ARG(val_mpint, y))
 FUNC(val_mpint, mp_sub, ARG(val_mpint, x), ARG(val_mpint, y))
 FUNC(val_mpint, mp_mul, ARG(val_mpint, x), ARG(val_mpint, y))
+FUNC(boolean, mp_mul_set_accel, ARG(boolean, enable))
+FUNC(val_string_asciz_const, mp_mul_kernel_name, VOID)
 FUNC(void, mp_and_into, ARG(val_mpint, dest), ARG(val_mpint, a),
      ARG(val_mpint, b))
 FUNC(void, mp_or_into, ARG(val_mpint, dest), ARG(val_mpint, a),
@@ -144,6 +146,7 @@ FUNC(void, mp_divmod_into, ARG(val_mpint, n), ARG(val_mpint, d),
      ARG(opt_val_mpint, q), ARG(opt_val_mpint, r))
 FUNC(val_mpint, mp_div, ARG(val_mpint, n), ARG(val_mpint, d))
 FUNC(val_mpint, mp_mod, ARG(val_mpint, x), ARG(val_mpint, modulus))
+FUNC(uint, mp_mod_known_integer, ARG(val_mpint, x), ARG(uint, m))
 FUNC(val_mpint, mp_nthroot, ARG(val_mpint, y), ARG(uint, n),
      ARG(opt_val_mpint, remainder))
 FUNC(void, mp_reduce_mod_2to, ARG(val_mpint, x), ARG(uint, p))
@@ -220,6 +223,10 @@ FUNC(val_wpoint, ecc_weierstrass_add, ARG(val_wpoint, P), ARG(val_wpoint, Q))
 FUNC(val_wpoint, ecc_weierstrass_double, ARG(val_wpoint, P))
 FUNC(val_wpoint, ecc_weierstrass_multiply, ARG(val_wpoint, B),
      ARG(val_mpint, n))
+FUNC(val_wbasetable, ecc_weierstrass_base_table_new, ARG(val_wpoint, B),
+     ARG(val_mpint, order))
+FUNC(val_wpoint, ecc_weierstrass_base_table_multiply,
+     ARG(val_wbasetable, table), ARG(val_mpint, n))
 FUNC(uint, ecc_weierstrass_is_identity, ARG(val_wpoint, P))
 /* The output pointers in get_affine all become extra output values */
 FUNC(void, ecc_weierstrass_get_affine, ARG(val_wpoint, P),
@@ -244,6 +251,12 @@ FUNC(val_epoint, ecc_edwards_point_new_from_y, ARG(val_ecurve, curve),
 FUNC(val_epoint, ecc_edwards_point_copy, ARG(val_epoint, orig))
 FUNC(val_epoint, ecc_edwards_add, ARG(val_epoint, P), ARG(val_epoint, Q))
 FUNC(val_epoint, ecc_edwards_multiply, ARG(val_epoint, B), ARG(val_mpint, n))
+FUNC(val_ebasetable, ecc_edwards_base_table_new, ARG(val_epoint, B),
+     ARG(val_mpint, order))
+FUNC(val_epoint, ecc_edwards_base_table_multiply,
+     ARG(val_ebasetable, table), ARG(val_mpint, n))
+FUNC_WRAPPED(val_epoint, ecc_edwards_multiscalar, ARG(epoint_list, points),
+             ARG(mpint_list, scalars))
 FUNC(uint, ecc_edwards_eq, ARG(val_epoint, P), ARG(val_epoint, Q))
 FUNC(void, ecc_edwards_get_affine, ARG(val_epoint, P), ARG(out_val_mpint, x),
      ARG(out_val_mpint, y))
@@ -315,6 +328,8 @@ FUNC_WRAPPED(boolean, ssh_key_check_cert, ARG(val_key, key),
              ARG(boolean, host), ARG(val_string_ptrlen, principal),
              ARG(uint, time), ARG(val_string_ptrlen, options),
              ARG(out_val_string_binarysink, error))
+FUNC_WRAPPED(boolean, opensshcert_sig_cache_check, ARG(val_key, key))
+FUNC(void, opensshcert_sig_cache_clear, VOID)
 
 /*
  * Accessors to retrieve the innards of a 'key_components'.
@@ -373,6 +388,8 @@ FUNC_WRAPPED(int16_list, ntru_ring_multiply, ARG(int16_list, a),
              ARG(int16_list, b), ARG(uint, p), ARG(uint, q))
 FUNC_WRAPPED(opt_int16_list, ntru_ring_invert, ARG(int16_list, r),
              ARG(uint, p), ARG(uint, q))
+FUNC(boolean, ntru_set_accel, ARG(boolean, enable))
+FUNC(val_string_asciz_const, ntru_kernel_name, VOID)
 FUNC_WRAPPED(int16_list, ntru_mod3, ARG(int16_list, r),
              ARG(uint, p), ARG(uint, q))
 FUNC_WRAPPED(int16_list, ntru_round3, ARG(int16_list, r),
@@ -430,6 +447,7 @@ FUNC(void, rsa_ssh1_public_blob, ARG(out_val_string_binarysink, blob),
 FUNC(int, rsa_ssh1_public_blob_len, ARG(val_string_ptrlen, data))
 FUNC(void, rsa_ssh1_private_blob_agent, ARG(out_val_string_binarysink, blob),
      ARG(val_rsa, key))
+FUNC(boolean, rsa_set_crt_cache, ARG(boolean, enable))
 
 /*
  * The PRNG type. Similarly to hashes and MACs, I've invented an extra
@@ -508,6 +526,7 @@ FUNC(val_pgc, primegen_new_context, ARG(primegenpolicy, policy))
 FUNC_WRAPPED(opt_val_mpint, primegen_generate, ARG(val_pgc, ctx),
              ARG(consumed_val_pcs, pcs))
 FUNC(val_string, primegen_mpu_certificate, ARG(val_pgc, ctx), ARG(val_mpint, p))
+FUNC(void, primegen_set_threads, ARG(val_pgc, ctx), ARG(uint, threads))
 FUNC(val_pcs, pcs_new, ARG(uint, bits))
 FUNC(val_pcs, pcs_new_with_firstbits, ARG(uint, bits), ARG(uint, first),
      ARG(uint, nfirst))
@@ -541,6 +560,8 @@ FUNC(mr_result, miller_rabin_test, ARG(val_millerrabin, mr), ARG(val_mpint, w))
  */
 FUNC(val_wpoint, ecdsa_public, ARG(val_mpint, private_key), ARG(keyalg, alg))
 FUNC(val_epoint, eddsa_public, ARG(val_mpint, private_key), ARG(keyalg, alg))
+FUNC_WRAPPED(boolean, eddsa_verify_batch, ARG(key_list, keys),
+             ARG(string_list, sigs), ARG(string_list, data))
 FUNC_WRAPPED(val_string, des_encrypt_xdmauth, ARG(val_string_ptrlen, key),
              ARG(val_string_ptrlen, blk))
 FUNC_WRAPPED(val_string, des_decrypt_xdmauth, ARG(val_string_ptrlen, key),
@@ -79,10 +79,12 @@ uint64_t prng_reseed_time_ms(void)
     X(monty, MontyContext *, monty_free(v))                             \
     X(wcurve, WeierstrassCurve *, ecc_weierstrass_curve_free(v))        \
     X(wpoint, WeierstrassPoint *, ecc_weierstrass_point_free(v))        \
+    X(wbasetable, WeierstrassBaseTable *, ecc_weierstrass_base_table_free(v)) \
     X(mcurve, MontgomeryCurve *, ecc_montgomery_curve_free(v))          \
     X(mpoint, MontgomeryPoint *, ecc_montgomery_point_free(v))          \
     X(ecurve, EdwardsCurve *, ecc_edwards_curve_free(v))                \
     X(epoint, EdwardsPoint *, ecc_edwards_point_free(v))                \
+    X(ebasetable, EdwardsBaseTable *, ecc_edwards_base_table_free(v))   \
     X(hash, ssh_hash *, ssh_hash_free(v))                               \
     X(key, ssh_key *, ssh_key_free(v))                                  \
     X(cipher, ssh_cipher *, ssh_cipher_free(v))                         \
@@ -224,6 +226,9 @@ typedef RsaSsh1Order TD_rsaorder;
 typedef key_components *TD_keycomponents;
 typedef const PrimeGenerationPolicy *TD_primegenpolicy;
 typedef struct mpint_list TD_mpint_list;
+typedef struct epoint_list TD_epoint_list;
+typedef struct key_list TD_key_list;
+typedef struct string_list TD_string_list;
 typedef struct int16_list *TD_int16_list;
 typedef PockleStatus TD_pocklestatus;
 typedef struct mr_result TD_mr_result;
@@ -389,6 +394,66 @@ static struct mpint_list get_mpint_list(BinarySource *in)
     return mpl;
 }
 
+struct epoint_list {
+    size_t n;
+    EdwardsPoint **points;
+};
+
+static struct epoint_list get_epoint_list(BinarySource *in)
+{
+    size_t n = get_uint(in);
+
+    struct epoint_list epl;
+    epl.n = n;
+
+    epl.points = snewn(n, EdwardsPoint *);
+    for (size_t i = 0; i < n; i++)
+        epl.points[i] = get_val_epoint(in);
+
+    add_finaliser(finaliser_sfree, epl.points);
+    return epl;
+}
+
+struct key_list {
+    size_t n;
+    ssh_key **keys;
+};
+
+static struct key_list get_key_list(BinarySource *in)
+{
+    size_t n = get_uint(in);
+
+    struct key_list kl;
+    kl.n = n;
+
+    kl.keys = snewn(n, ssh_key *);
+    for (size_t i = 0; i < n; i++)
+        kl.keys[i] = get_val_key(in);
+
+    add_finaliser(finaliser_sfree, kl.keys);
+    return kl;
+}
+
+struct string_list {
+    size_t n;
+    ptrlen *strings;
+};
+
+static struct string_list get_string_list(BinarySource *in)
+{
+    size_t n = get_uint(in);
+
+    struct string_list sl;
+    sl.n = n;
+
+    sl.strings = snewn(n, ptrlen);
+    for (size_t i = 0; i < n; i++)
+        sl.strings[i] = get_val_string_ptrlen(in);
+
+    add_finaliser(finaliser_sfree, sl.strings);
+    return sl;
+}
+
 typedef struct int16_list {
     size_t n;
     uint16_t *integers;
@@ -864,6 +929,13 @@ static bool ssh_key_check_cert_wrapper(
     return ssh_key_check_cert(key, host, principal, time, &opts, error);
 }
 
+static bool opensshcert_sig_cache_check_wrapper(ssh_key *key)
+{
+    unsigned char id[CERT_SIG_CACHE_ID_LEN];
+    opensshcert_sig_cache_id(key, id);
+    return opensshcert_sig_cache_check(id);
+}
+
 bool dh_validate_f_wrapper(dh_ctx *dh, mp_int *f)
 {
     return dh_validate_f(dh, f) == NULL;
@@ -886,6 +958,30 @@ static RSAKey *rsa_new(void)
     return rsa;
 }
 
+EdwardsPoint *ecc_edwards_multiscalar_wrapper(
+    struct epoint_list epl, struct mpint_list mpl)
+{
+    if (epl.n != mpl.n || epl.n == 0)
+        fatal_error("ecc_edwards_multiscalar: need equal non-zero numbers "
+                    "of points and scalars");
+    return ecc_edwards_multiscalar(epl.n, epl.points, mpl.integers);
+}
+
+bool eddsa_verify_batch_wrapper(
+    struct key_list kl, struct string_list sigs, struct string_list data)
+{
+    if (sigs.n != kl.n || data.n != kl.n)
+        fatal_error("eddsa_verify_batch: need one signature and one "
+                    "message per key");
+    for (size_t i = 0; i < kl.n; i++)
+        if (kl.keys[i]->vt != kl.keys[0]->vt ||
+            (kl.keys[i]->vt != &ssh_ecdsa_ed25519 &&
+             kl.keys[i]->vt != &ssh_ecdsa_ed448))
+            fatal_error("eddsa_verify_batch: keys must all be the same "
+                        "EdDSA type");
+    return eddsa_verify_batch(kl.n, kl.keys, sigs.strings, data.strings);
+}
+
 strbuf *ecdh_key_getkey_wrapper(ecdh_key *ek, ptrlen remoteKey)
 {
     /* Fold the boolean return value in C into the string return value
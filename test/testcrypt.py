@@ -199,6 +199,14 @@ def make_argword(arg, argtype, fnname, argindex, argname, to_preserve):
             sublist.append(make_argword(val, ("val_mpint", False),
                                         fnname, argindex, argname, to_preserve))
         return b" ".join(coerce_to_bytes(sub) for sub in sublist)
+    if typename in {"epoint_list", "key_list", "string_list"}:
+        elttype = "val_" + typename[:-5]
+        sublist = [make_argword(len(arg), ("uint", False),
+                                fnname, argindex, argname, to_preserve)]
+        for val in arg:
+            sublist.append(make_argword(val, (elttype, False),
+                                        fnname, argindex, argname, to_preserve))
+        return b" ".join(coerce_to_bytes(sub) for sub in sublist)
     if typename == "int16_list":
         sublist = [make_argword(len(arg), ("uint", False),
                                 fnname, argindex, argname, to_preserve)]
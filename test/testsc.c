@@ -265,6 +265,17 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
 #define IF_CLMUL(x)
 #endif
 
+#if HAVE_MULX_ADX
+#define IF_MULX_ADX(x) x
+#else
+#define IF_MULX_ADX(x)
+#endif
+#if HAVE_AVX2
+#define IF_AVX2(x) x
+#else
+#define IF_AVX2(x)
+#endif
+
 #if HAVE_NEON_CRYPTO
 #define IF_NEON_CRYPTO(x) x
 #else
@@ -399,6 +410,7 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
     X(mp_add)                                   \
     X(mp_sub)                                   \
     X(mp_mul)                                   \
+    IF_MULX_ADX(X(mp_mul_portable))             \
     X(mp_rshift_safe)                           \
     X(mp_divmod)                                \
     X(mp_nthroot)                               \
@@ -406,6 +418,7 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
     X(mp_modsub)                                \
     X(mp_modmul)                                \
     X(mp_modpow)                                \
+    IF_MULX_ADX(X(mp_modpow_portable))          \
     X(mp_invert_mod_2to)                        \
     X(mp_invert)                                \
     X(mp_modsqrt)                               \
@@ -413,6 +426,7 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
     X(ecc_weierstrass_double)                   \
     X(ecc_weierstrass_add_general)              \
     X(ecc_weierstrass_multiply)                 \
+    X(ecc_weierstrass_base_table_multiply)      \
     X(ecc_weierstrass_is_identity)              \
     X(ecc_weierstrass_get_affine)               \
     X(ecc_weierstrass_decompress)               \
@@ -422,6 +436,7 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
     X(ecc_montgomery_get_affine)                \
     X(ecc_edwards_add)                          \
     X(ecc_edwards_multiply)                     \
+    X(ecc_edwards_base_table_multiply)          \
     X(ecc_edwards_eq)                           \
     X(ecc_edwards_get_affine)                   \
     X(ecc_edwards_decompress)                   \
@@ -431,6 +446,7 @@ VOLATILE_WRAPPED_DEFN(static, size_t, looplimit, (size_t x))
     X(argon2)                                   \
     X(primegen_probabilistic)                   \
     X(ntru)                                     \
+    IF_AVX2(X(ntru_portable))                   \
     /* end of list */
 
 static void test_mp_get_nbits(void)
@@ -648,6 +664,20 @@ static void test_mp_mul(void)
     test_mp_arithmetic(mp_mul);
 }
 
+#if HAVE_MULX_ADX
+/*
+ * The plain tests above use whichever multiplication kernel the CPU
+ * supports, so if that's an accelerated one, test the portable code
+ * separately as well.
+ */
+static void test_mp_mul_portable(void)
+{
+    mp_mul_set_accel(false);
+    test_mp_arithmetic(mp_mul);
+    mp_mul_set_accel(true);
+}
+#endif
+
 static void test_mp_invert(void)
 {
     test_mp_arithmetic(mp_invert);
@@ -750,6 +780,15 @@ static void test_mp_modpow(void)
     test_mp_modarith(mp_modpow);
 }
 
+#if HAVE_MULX_ADX
+static void test_mp_modpow_portable(void)
+{
+    mp_mul_set_accel(false);
+    test_mp_modarith(mp_modpow);
+    mp_mul_set_accel(true);
+}
+#endif
+
 static void test_mp_invert_mod_2to(void)
 {
     mp_int *x = mp_new(512);
@@ -947,6 +986,40 @@ static void test_ecc_weierstrass_multiply(void)
     mp_free(exponent);
 }
 
+static void test_ecc_weierstrass_base_table_multiply(void)
+{
+    WeierstrassCurve *wc = wcurve();
+    WeierstrassPoint *B = wpoint(wc, 1);
+    /* Not the real order of B, but all that matters here is the
+     * pattern of the computation, not whether its answer is right */
+    mp_int *order = MP_LITERAL(0xc19337603dc856acf31e01375a696fdf5451);
+    WeierstrassBaseTable *wt = ecc_weierstrass_base_table_new(B, order);
+    mp_int *exponent = mp_new(56);
+
+    /* Make sure the table is built before we start measuring */
+    for (size_t i = 0; i < 4; i++) {
+        mp_random_fill(exponent);
+        ecc_weierstrass_point_free(
+            ecc_weierstrass_base_table_multiply(wt, exponent));
+    }
+
+    for (size_t i = 1; i < looplimit(5); i++) {
+        mp_random_fill(exponent);
+
+        log_start();
+        WeierstrassPoint *r = ecc_weierstrass_base_table_multiply(
+            wt, exponent);
+        log_end();
+
+        ecc_weierstrass_point_free(r);
+    }
+    ecc_weierstrass_base_table_free(wt);
+    ecc_weierstrass_point_free(B);
+    ecc_weierstrass_curve_free(wc);
+    mp_free(order);
+    mp_free(exponent);
+}
+
 static void test_ecc_weierstrass_is_identity(void)
 {
     WeierstrassCurve *wc = wcurve();
@@ -1279,6 +1352,36 @@ static void test_ecc_edwards_multiply(void)
     mp_free(exponent);
 }
 
+static void test_ecc_edwards_base_table_multiply(void)
+{
+    EdwardsCurve *ec = ecurve();
+    EdwardsPoint *B = epoint(ec, 1);
+    /* As in the Weierstrass case, an arbitrary stand-in for the order */
+    mp_int *order = MP_LITERAL(0xfce2dac1704095de0b5c48876c45063cd475);
+    EdwardsBaseTable *et = ecc_edwards_base_table_new(B, order);
+    mp_int *exponent = mp_new(56);
+
+    for (size_t i = 0; i < 4; i++) {
+        mp_random_fill(exponent);
+        ecc_edwards_point_free(ecc_edwards_base_table_multiply(et, exponent));
+    }
+
+    for (size_t i = 1; i < looplimit(5); i++) {
+        mp_random_fill(exponent);
+
+        log_start();
+        EdwardsPoint *r = ecc_edwards_base_table_multiply(et, exponent);
+        log_end();
+
+        ecc_edwards_point_free(r);
+    }
+    ecc_edwards_base_table_free(et);
+    ecc_edwards_point_free(B);
+    ecc_edwards_curve_free(ec);
+    mp_free(order);
+    mp_free(exponent);
+}
+
 static void test_ecc_edwards_eq(void)
 {
     EdwardsCurve *ec = ecurve();
@@ -1744,6 +1847,15 @@ static void test_ntru(void)
     strbuf_free(buffer);
 }
 
+#if HAVE_AVX2
+static void test_ntru_portable(void)
+{
+    ntru_set_accel(false);
+    test_ntru();
+    ntru_set_accel(true);
+}
+#endif
+
 static const struct test tests[] = {
 #define STRUCT_TEST(X) { #X, test_##X },
 TESTLIST(STRUCT_TEST)
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+
+# Client of the testcrypt system that measures signature verification
+# throughput: Ed25519 and Ed448 signatures checked one at a time and
+# in batches via eddsa_verify_batch, and RSA signatures checked with a
+# long-lived key object (which keeps its Montgomery context between
+# verifications) and with a fresh key object each time.
+#
+# As with modexp-bench.py, the timings include the round trips
+# through the testcrypt pipe.
+
+import argparse
+import time
+
+from testcrypt import *
+
+def rate(fn, count, seconds):
+    # Run fn repeatedly for at least the given time, and return the
+    # number of verifications per second, given that each call to fn
+    # does 'count' of them.
+    calls = 0
+    start = time.perf_counter()
+    while True:
+        fn()
+        calls += 1
+        elapsed = time.perf_counter() - start
+        if elapsed >= seconds:
+            return calls * count / elapsed
+
+def message(i):
+    return "verify-bench message {:d}".format(i).encode('ASCII')
+
+def bench_eddsa(alg, bits, batch, seconds):
+    random_make_prng('sha256', "verify-bench " + alg)
+    keys = [eddsa_generate(bits) for i in range(batch)]
+    random_clear()
+    msgs = [message(i) for i in range(batch)]
+    sigs = [ssh_key_sign(key, msg, 0) for key, msg in zip(keys, msgs)]
+    assert eddsa_verify_batch(keys, sigs, msgs)
+
+    def single():
+        assert ssh_key_verify(keys[0], sigs[0], msgs[0])
+    def batched():
+        assert eddsa_verify_batch(keys, sigs, msgs)
+
+    return rate(single, 1, seconds), rate(batched, batch, seconds)
+
+def bench_rsa(bits, seconds):
+    random_make_prng('sha256', "verify-bench rsa {:d}".format(bits))
+    key = rsa_generate(bits, False, primegen_new_context('probabilistic'))
+    random_clear()
+    pubblob = ssh_key_public_blob(key)
+    pubkey = ssh_key_new_pub('rsa', pubblob)
+    msg = message(0)
+    sig = ssh_key_sign(key, msg, 0)
+
+    def cached():
+        assert ssh_key_verify(pubkey, sig, msg)
+    def fresh():
+        assert ssh_key_verify(ssh_key_new_pub('rsa', pubblob), sig, msg)
+
+    return rate(fresh, 1, seconds), rate(cached, 1, seconds)
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark signature verification throughput.")
+    parser.add_argument("--batch", type=int, default=64,
+                        help="number of signatures per EdDSA batch")
+    parser.add_argument("--seconds", type=float, default=2.0,
+                        help="time to spend on each measurement")
+    args = parser.parse_args()
+
+    print(f"{'algorithm':>10s}  {'one at a time':>14s}  {'batched':>14s}"
+          f"  {'speedup':>8s}")
+    for alg, bits in [('ed25519', 255), ('ed448', 448)]:
+        single, batched = bench_eddsa(alg, bits, args.batch, args.seconds)
+        print(f"{alg:>10s}  {single:12.1f}/s  {batched:12.1f}/s"
+              f"  {batched/single:7.2f}x")
+
+    print()
+    print(f"{'algorithm':>10s}  {'fresh key':>14s}  {'cached key':>14s}"
+          f"  {'speedup':>8s}")
+    for bits in [2048, 4096]:
+        fresh, cached = bench_rsa(bits, args.seconds)
+        name = "rsa{:d}".format(bits)
+        print(f"{name:>10s}  {fresh:12.1f}/s  {cached:12.1f}/s"
+              f"  {cached/fresh:7.2f}x")
+
+if __name__ == "__main__":
+    main()
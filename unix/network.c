@@ -89,6 +89,19 @@ struct NetSocket {
      */
     NetSocket *parent, *child;
 
+    /*
+     * In direct relay mode (see sk_net_start_relay), data arriving on
+     * this socket is spliced straight through relay_pipe to
+     * relay_peer, without ever being passed to the plug.
+     * relay_pending counts the bytes currently sitting in the pipe;
+     * we don't read any more until it's been emptied again, so it's
+     * the equivalent of output_data on the peer for the purposes of
+     * flow control.
+     */
+    NetSocket *relay_peer;
+    int relay_pipe[2];
+    size_t relay_pending, relay_limit;
+
     Socket sock;
 };
 
@@ -139,6 +152,32 @@ struct SockAddr {
 
 static tree234 *sktree;
 
+/*
+ * Size of the buffer we read into in net_select_result, and the
+ * maximum amount of data we'll read from one socket in response to a
+ * single readability event before going back to the event loop.
+ */
+#define NET_RECV_BUFSIZE 65536
+#define NET_RECV_BUDGET (4 * NET_RECV_BUFSIZE)
+
+/*
+ * Most unsent data we let the kernel hold on a connection made with
+ * nodelay set, where the OS supports limiting it.
+ */
+#define NET_NOTSENT_LOWAT 16384
+
+/*
+ * Most connections we'll accept on a listening socket in response to
+ * one readability event. Accepting just one per trip round the event
+ * loop makes a burst of incoming connections wait for each other's
+ * processing (e.g. a queue of Pageant clients each wanting a slow
+ * signature), so we take what's waiting, up to a limit.
+ */
+#define NET_ACCEPT_BUDGET 16
+
+/* The listener we're accepting on, or NULL if it's been closed meanwhile */
+static NetSocket *net_accepting_listener;
+
 static void uxsel_tell(NetSocket *s);
 
 static int cmpfortree(void *av, void *bv)
@@ -525,6 +564,9 @@ static Socket *sk_net_accept(accept_ctx_t ctx, Plug *plug)
     s->incomingeof = false;
     s->listener = false;
     s->parent = s->child = NULL;
+    s->relay_peer = NULL;
+    s->relay_pipe[0] = s->relay_pipe[1] = -1;
+    s->relay_pending = 0;
     s->addr = NULL;
     s->connected = true;
 
@@ -603,6 +645,19 @@ static int try_connect(NetSocket *sock)
             close(s);
             goto ret;
         }
+
+#ifdef TCP_NOTSENT_LOWAT
+        /*
+         * Keep the kernel from accepting much more than it can send
+         * straight away, so that the backlog on a latency-sensitive
+         * connection stays in our own buffers, where the SSH layer
+         * can still put interactive data ahead of bulk. Best effort:
+         * if the kernel won't do it, we just lose that benefit.
+         */
+        b = NET_NOTSENT_LOWAT;
+        setsockopt(s, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                   (void *) &b, sizeof(b));
+#endif
     }
 
     if (sock->keepalive) {
@@ -768,6 +823,9 @@ Socket *sk_new(SockAddr *addr, int port, bool privport, bool oobinline,
     s->localhost_only = false;    /* unused, but best init anyway */
     s->pending_error = 0;
     s->parent = s->child = NULL;
+    s->relay_peer = NULL;
+    s->relay_pipe[0] = s->relay_pipe[1] = -1;
+    s->relay_pending = 0;
     s->oobpending = false;
     s->outgoingeof = EOF_NO;
     s->incomingeof = false;
@@ -821,6 +879,9 @@ Socket *sk_newlistener(const char *srcaddr, int port, Plug *plug,
     s->localhost_only = local_host_only;
     s->pending_error = 0;
     s->parent = s->child = NULL;
+    s->relay_peer = NULL;
+    s->relay_pipe[0] = s->relay_pipe[1] = -1;
+    s->relay_pending = 0;
     s->oobpending = false;
     s->outgoingeof = EOF_NO;
     s->incomingeof = false;
@@ -866,6 +927,7 @@ Socket *sk_newlistener(const char *srcaddr, int port, Plug *plug,
     }
 
     cloexec(fd);
+    nonblock(fd);                      /* so we can accept in a loop */
 
     s->oobinline = false;
 
@@ -996,6 +1058,8 @@ Socket *sk_newlistener(const char *srcaddr, int port, Plug *plug,
     return &s->sock;
 }
 
+static void sk_net_relay_stop(NetSocket *s);
+
 static void sk_net_close(Socket *sock)
 {
     NetSocket *s = container_of(sock, NetSocket, sock);
@@ -1003,6 +1067,12 @@ static void sk_net_close(Socket *sock)
     if (s->child)
         sk_net_close(&s->child->sock);
 
+    if (s->relay_peer)
+        sk_net_relay_stop(s);
+
+    if (s == net_accepting_listener)
+        net_accepting_listener = NULL;
+
     bufchain_clear(&s->output_data);
 
     del234(sktree, s);
@@ -1264,10 +1334,173 @@ static void sk_net_write_eof(Socket *sock)
     uxsel_tell(s);
 }
 
+/*
+ * Direct relay mode. A pair of connected sockets can be told to pass
+ * data between each other without involving their plugs, using
+ * splice() through a pipe in each direction so that the data never
+ * has to be copied into userspace at all.
+ *
+ * Only the data path is short-circuited. Each plug still gets
+ * plug_closing when its socket sees EOF or an error, and is expected
+ * to respond in the usual way (typically by calling sk_write_eof or
+ * sk_close on the other socket). Data already queued in output_data
+ * on either socket when the relay starts is sent before anything
+ * that arrives through the relay.
+ */
+static bool sk_net_relay_make_pipe(NetSocket *s, size_t limit)
+{
+    if (pipe(s->relay_pipe) < 0)
+        return false;
+    for (size_t i = 0; i < 2; i++) {
+        nonblock(s->relay_pipe[i]);
+        cloexec(s->relay_pipe[i]);
+    }
+    splice_set_pipe_size(s->relay_pipe[1], limit);
+    s->relay_limit = limit;
+    s->relay_pending = 0;
+    return true;
+}
+
+static void sk_net_relay_close_pipe(NetSocket *s)
+{
+    for (size_t i = 0; i < 2; i++) {
+        if (s->relay_pipe[i] >= 0)
+            close(s->relay_pipe[i]);
+        s->relay_pipe[i] = -1;
+    }
+    s->relay_pending = 0;
+}
+
+bool sk_net_start_relay(Socket *sa, Socket *sb, size_t limit)
+{
+    NetSocket *a, *b;
+
+    if (!splice_available())
+        return false;
+    if (sa->vt != &NetSocket_sockvt || sb->vt != &NetSocket_sockvt)
+        return false;
+    a = container_of(sa, NetSocket, sock);
+    b = container_of(sb, NetSocket, sock);
+
+    /* We don't try to relay urgent data, or half-set-up sockets */
+    if (a == b || a->listener || b->listener ||
+        !a->connected || !b->connected || a->oobinline || b->oobinline ||
+        a->relay_peer || b->relay_peer || a->pending_error || b->pending_error)
+        return false;
+
+    if (!sk_net_relay_make_pipe(a, limit))
+        return false;
+    if (!sk_net_relay_make_pipe(b, limit)) {
+        sk_net_relay_close_pipe(a);
+        return false;
+    }
+
+    a->relay_peer = b;
+    b->relay_peer = a;
+    uxsel_tell(a);
+    uxsel_tell(b);
+    return true;
+}
+
+static void sk_net_relay_stop(NetSocket *s)
+{
+    NetSocket *peer = s->relay_peer;
+
+    /*
+     * Anything still in either pipe is discarded: if we're stopping
+     * because one end is closing, there's nowhere left to send it.
+     */
+    sk_net_relay_close_pipe(s);
+    sk_net_relay_close_pipe(peer);
+    s->relay_peer = peer->relay_peer = NULL;
+    uxsel_tell(peer);
+}
+
+/*
+ * Move as much as we can of the data in s's relay pipe to its peer.
+ */
+static void sk_net_relay_flush(NetSocket *s)
+{
+    NetSocket *peer = s->relay_peer;
+
+    while (s->relay_pending > 0) {
+        ptrdiff_t ret;
+
+        /*
+         * Anything queued through the ordinary sk_write path has to
+         * go first.
+         */
+        if (peer->sending_oob || bufchain_size(&peer->output_data) ||
+            peer->pending_error || peer->outgoingeof != EOF_NO)
+            break;
+
+        ret = splice_nonblock(s->relay_pipe[0], peer->s, s->relay_pending);
+        noise_ultralight(NOISE_SOURCE_IOLEN, ret);
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                peer->writable = false;
+            } else {
+                /* Same deferred error handling as in try_send */
+                peer->pending_error = errno;
+                queue_toplevel_callback(socket_error_callback, peer);
+            }
+            break;
+        }
+        if (ret == 0)
+            break;
+        s->relay_pending -= ret;
+    }
+
+    uxsel_tell(s);
+    uxsel_tell(peer);
+}
+
+static void sk_net_relay_receive(NetSocket *s)
+{
+    size_t total = 0;
+
+    /*
+     * As in the ordinary receive path, keep going while the socket
+     * has more to give us and the peer keeps taking it, up to the
+     * same per-event budget.
+     */
+    while (!s->relay_pending && total < NET_RECV_BUDGET) {
+        ptrdiff_t ret = splice_nonblock(s->s, s->relay_pipe[1],
+                                        s->relay_limit);
+        noise_ultralight(NOISE_SOURCE_IOLEN, ret);
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                plug_closing_errno(s->plug, errno);
+            return;
+        } else if (ret == 0) {
+            /*
+             * The pipe is always empty when we read, so there's
+             * nothing left to deliver before reporting EOF.
+             */
+            s->incomingeof = true;
+            uxsel_tell(s);
+            plug_closing_normal(s->plug);
+            return;
+        }
+
+        if (s->addr) {
+            sk_addr_free(s->addr);
+            s->addr = NULL;
+        }
+        s->relay_pending = ret;
+        total += ret;
+        sk_net_relay_flush(s);
+
+        /* A pending error on the peer will close us both shortly */
+        if (s->relay_peer->pending_error)
+            return;
+    }
+}
+
 static void net_select_result(int fd, int event)
 {
     int ret;
-    char buf[20480];                   /* nice big buffer for plenty of speed */
+    char buf[NET_RECV_BUFSIZE];        /* nice big buffer for plenty of speed */
     NetSocket *s;
     bool atmark = true;
 
@@ -1322,26 +1555,31 @@ static void net_select_result(int fd, int event)
              * On a listening socket, the readability event means a
              * connection is ready to be accepted.
              */
-            union sockaddr_union su;
-            socklen_t addrlen = sizeof(su);
-            accept_ctx_t actx;
-            int t;  /* socket of connection */
-
-            memset(&su, 0, addrlen);
-            t = accept(s->s, &su.sa, &addrlen);
-            if (t < 0) {
-                break;
-            }
+            net_accepting_listener = s;
+            for (int i = 0; i < NET_ACCEPT_BUDGET &&
+                     net_accepting_listener == s; i++) {
+                union sockaddr_union su;
+                socklen_t addrlen = sizeof(su);
+                accept_ctx_t actx;
+                int t;  /* socket of connection */
+
+                memset(&su, 0, addrlen);
+                t = accept(s->s, &su.sa, &addrlen);
+                if (t < 0) {
+                    break;
+                }
 
-            nonblock(t);
-            actx.i = t;
+                nonblock(t);
+                actx.i = t;
 
-            if ((!s->addr || s->addr->superfamily != UNIX) &&
-                s->localhost_only && !sockaddr_is_loopback(&su.sa)) {
-                close(t);              /* someone let nonlocal through?! */
-            } else if (plug_accepting(s->plug, sk_net_accept, actx)) {
-                close(t);              /* denied or error */
+                if ((!s->addr || s->addr->superfamily != UNIX) &&
+                    s->localhost_only && !sockaddr_is_loopback(&su.sa)) {
+                    close(t);          /* someone let nonlocal through?! */
+                } else if (plug_accepting(s->plug, sk_net_accept, actx)) {
+                    close(t);          /* denied or error */
+                }
             }
+            net_accepting_listener = NULL;
             break;
         }
 
@@ -1354,46 +1592,83 @@ static void net_select_result(int fd, int event)
         if (s->frozen)
             break;
 
+        if (s->relay_peer) {
+            sk_net_relay_receive(s);
+            break;
+        }
+
         /*
-         * We have received data on the socket. For an oobinline
-         * socket, this might be data _before_ an urgent pointer,
-         * in which case we send it to the back end with type==1
-         * (data prior to urgent).
+         * Drain the socket in a loop, so that a fast sender doesn't
+         * cost us a separate trip round the event loop for every
+         * buffer's worth of data. We stop as soon as a read comes
+         * back short (meaning we've probably emptied the kernel
+         * buffer), or the plug freezes or closes the socket, or we
+         * exceed NET_RECV_BUDGET in total so that one busy socket
+         * can't starve everything else that's waiting on select.
          */
-        if (s->oobinline && s->oobpending) {
-            int atmark_from_ioctl;
-            if (ioctl(s->s, SIOCATMARK, &atmark_from_ioctl) == 0) {
-                atmark = atmark_from_ioctl;
-                if (atmark)
-                    s->oobpending = false; /* clear this indicator */
-            }
-        } else
-            atmark = true;
+        {
+            size_t total = 0;
 
-        ret = recv(s->s, buf, s->oobpending ? 1 : sizeof(buf), 0);
-        noise_ultralight(NOISE_SOURCE_IOLEN, ret);
-        if (ret < 0) {
-            if (errno == EWOULDBLOCK) {
-                break;
-            }
-        }
-        if (ret < 0) {
-            plug_closing_errno(s->plug, errno);
-        } else if (0 == ret) {
-            s->incomingeof = true;     /* stop trying to read now */
-            uxsel_tell(s);
-            plug_closing_normal(s->plug);
-        } else {
-            /*
-             * Receiving actual data on a socket means we can
-             * stop falling back through the candidate
-             * addresses to connect to.
-             */
-            if (s->addr) {
-                sk_addr_free(s->addr);
-                s->addr = NULL;
+            while (true) {
+                size_t toread;
+
+                /*
+                 * We have received data on the socket. For an
+                 * oobinline socket, this might be data _before_ an
+                 * urgent pointer, in which case we send it to the
+                 * back end with type==1 (data prior to urgent).
+                 */
+                if (s->oobinline && s->oobpending) {
+                    int atmark_from_ioctl;
+                    if (ioctl(s->s, SIOCATMARK, &atmark_from_ioctl) == 0) {
+                        atmark = atmark_from_ioctl;
+                        if (atmark)
+                            s->oobpending = false; /* clear this indicator */
+                    }
+                } else
+                    atmark = true;
+
+                toread = s->oobpending ? 1 : sizeof(buf);
+                ret = recv(s->s, buf, toread, 0);
+                noise_ultralight(NOISE_SOURCE_IOLEN, ret);
+                if (ret < 0) {
+                    if (errno == EWOULDBLOCK) {
+                        break;
+                    }
+                }
+                if (ret < 0) {
+                    plug_closing_errno(s->plug, errno);
+                    break;
+                } else if (0 == ret) {
+                    s->incomingeof = true;     /* stop trying to read now */
+                    uxsel_tell(s);
+                    plug_closing_normal(s->plug);
+                    break;
+                }
+
+                /*
+                 * Receiving actual data on a socket means we can
+                 * stop falling back through the candidate
+                 * addresses to connect to.
+                 */
+                if (s->addr) {
+                    sk_addr_free(s->addr);
+                    s->addr = NULL;
+                }
+                plug_receive(s->plug, atmark ? 0 : 1, buf, ret);
+                total += ret;
+
+                /*
+                 * plug_receive may have closed the socket (in which
+                 * case s is now freed, and must not be dereferenced
+                 * until we've checked it's still in the tree), or
+                 * frozen it.
+                 */
+                if ((size_t)ret < toread || total >= NET_RECV_BUDGET ||
+                    find234(sktree, &fd, cmpforsearch) != s ||
+                    s->frozen || s->incomingeof)
+                    break;
             }
-            plug_receive(s->plug, atmark ? 0 : 1, buf, ret);
         }
         break;
       case SELECT_W:                   /* writable */
@@ -1465,6 +1740,8 @@ static void net_select_result(int fd, int event)
             bufsize_after = s->sending_oob + bufchain_size(&s->output_data);
             if (bufsize_after < bufsize_before)
                 plug_sent(s->plug, bufsize_after);
+            if (s->relay_peer && s->relay_peer->relay_pending)
+                sk_net_relay_flush(s->relay_peer);
         }
         break;
     }
@@ -1576,9 +1853,11 @@ static void uxsel_tell(NetSocket *s)
         } else {
             if (!s->connected)
                 rwx |= SELECT_W;       /* write == connect */
-            if (s->connected && !s->frozen && !s->incomingeof)
+            if (s->connected && !s->frozen && !s->incomingeof &&
+                !s->relay_pending)
                 rwx |= SELECT_R | SELECT_X;
-            if (bufchain_size(&s->output_data))
+            if (bufchain_size(&s->output_data) ||
+                (s->relay_peer && s->relay_peer->relay_pending))
                 rwx |= SELECT_W;
         }
     }
@@ -1692,6 +1971,9 @@ Socket *new_unix_listener(SockAddr *listenaddr, Plug *plug)
     s->localhost_only = true;
     s->pending_error = 0;
     s->parent = s->child = NULL;
+    s->relay_peer = NULL;
+    s->relay_pipe[0] = s->relay_pipe[1] = -1;
+    s->relay_pending = 0;
     s->oobpending = false;
     s->outgoingeof = EOF_NO;
     s->incomingeof = false;
@@ -1711,6 +1993,7 @@ Socket *new_unix_listener(SockAddr *listenaddr, Plug *plug)
     }
 
     cloexec(fd);
+    nonblock(fd);                      /* so we can accept in a loop */
 
     s->oobinline = false;
 
@@ -19,8 +19,13 @@
 #include "putty.h"
 #include "ssh.h"
 #include "misc.h"
+#include "mpint.h"
 #include "pageant.h"
 
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 void cmdline_error(const char *fmt, ...)
 {
     va_list ap;
@@ -32,6 +37,141 @@ void cmdline_error(const char *fmt, ...)
 
 static void setup_sigchld_handler(void);
 
+#if HAVE_PTHREAD
+
+/*
+ * A pool of threads to compute signatures in, if --sign-threads asked
+ * for one. The threads only ever look at the PageantSignJobs handed
+ * to them, and pass finished ones back to the main thread through a
+ * pipe watched by uxsel. The pool is started on first use, so that
+ * the threads belong to the agent process after it's forked off.
+ */
+static unsigned sign_threads = 0;
+
+static struct {
+    bool tried, ok;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    PageantSignJob *todo_head, *todo_tail;
+    PageantSignJob *done_head, *done_tail;
+    int pipefd[2];
+    bool woken;
+} signpool;
+
+static void *signpool_thread(void *ctx)
+{
+    pthread_mutex_lock(&signpool.mutex);
+    while (true) {
+        while (!signpool.todo_head)
+            pthread_cond_wait(&signpool.work_cond, &signpool.mutex);
+        PageantSignJob *job = signpool.todo_head;
+        if (!(signpool.todo_head = job->next))
+            signpool.todo_tail = NULL;
+        pthread_mutex_unlock(&signpool.mutex);
+
+        ssh_key_sign(job->key, ptrlen_from_strbuf(job->data), job->flags,
+                     BinarySink_UPCAST(job->signature));
+
+        pthread_mutex_lock(&signpool.mutex);
+        job->next = NULL;
+        if (signpool.done_tail)
+            signpool.done_tail->next = job;
+        else
+            signpool.done_head = job;
+        signpool.done_tail = job;
+        if (!signpool.woken) {
+            signpool.woken = true;
+            if (write(signpool.pipefd[1], "", 1) < 0) {
+                /* the pipe can only be full if a wakeup is pending anyway */
+            }
+        }
+    }
+    return NULL;
+}
+
+static void signpool_select_result(int fd, int event)
+{
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        { /* drain the pipe */ }
+
+    pthread_mutex_lock(&signpool.mutex);
+    signpool.woken = false;
+    PageantSignJob *job = signpool.done_head;
+    signpool.done_head = signpool.done_tail = NULL;
+    pthread_mutex_unlock(&signpool.mutex);
+
+    while (job) {
+        PageantSignJob *next = job->next;
+        job->done(job);
+        job = next;
+    }
+}
+
+static bool signpool_start(void)
+{
+    if (signpool.tried)
+        return signpool.ok;
+    signpool.tried = true;
+
+    if (pipe(signpool.pipefd) < 0)
+        return false;
+    cloexec(signpool.pipefd[0]);
+    cloexec(signpool.pipefd[1]);
+    nonblock(signpool.pipefd[0]);
+    nonblock(signpool.pipefd[1]);
+
+    /*
+     * Some of the crypto code picks an implementation on first use
+     * and remembers it in a global variable. Make sure that's all
+     * happened in this thread before any other thread signs anything.
+     */
+    mp_mul_kernel_name();
+    ssh_hash_free(ssh_hash_new(&ssh_sha1));
+    ssh_hash_free(ssh_hash_new(&ssh_sha256));
+    ssh_hash_free(ssh_hash_new(&ssh_sha512));
+
+    pthread_mutex_init(&signpool.mutex, NULL);
+    pthread_cond_init(&signpool.work_cond, NULL);
+
+    unsigned nthreads = 0;
+    for (unsigned i = 0; i < sign_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, signpool_thread, NULL) == 0) {
+            pthread_detach(thread);
+            nthreads++;
+        }
+    }
+    if (!nthreads) {
+        close(signpool.pipefd[0]);
+        close(signpool.pipefd[1]);
+        return false;
+    }
+
+    uxsel_set(signpool.pipefd[0], SELECT_R, signpool_select_result);
+    signpool.ok = true;
+    return true;
+}
+
+static bool signpool_submit(PageantSignJob *job)
+{
+    if (!signpool_start())
+        return false;
+
+    pthread_mutex_lock(&signpool.mutex);
+    job->next = NULL;
+    if (signpool.todo_tail)
+        signpool.todo_tail->next = job;
+    else
+        signpool.todo_head = job;
+    signpool.todo_tail = job;
+    pthread_cond_signal(&signpool.work_cond);
+    pthread_mutex_unlock(&signpool.mutex);
+    return true;
+}
+
+#endif /* HAVE_PTHREAD */
+
 typedef enum RuntimePromptType {
     RTPROMPT_UNAVAILABLE,
     RTPROMPT_DEBUG,
@@ -212,6 +352,8 @@ static void usage(void)
     printf("  -v           verbose mode (in agent mode)\n");
     printf("  -s -c        force POSIX or C shell syntax (in agent mode)\n");
     printf("  --symlink path   create symlink to socket (in agent mode)\n");
+    printf("  --sign-threads n compute RSA signatures in n threads "
+           "(in agent mode)\n");
     printf("  --encrypted  when adding keys, don't decrypt\n");
     printf("  -E alg, --fptype alg   fingerprint type for -l (sha256, md5)\n");
     printf("  --tty-prompt force tty-based passphrase prompt\n");
@@ -1119,6 +1261,10 @@ void run_agent(FILE *logfp, const char *symlink_path)
     const struct cmdline_key_action *act;
 
     pageant_init();
+#if HAVE_PTHREAD
+    if (sign_threads)
+        pageant_set_sign_worker(signpool_submit);
+#endif
 
     /*
      * Start by loading any keys provided on the command line.
@@ -1406,6 +1552,27 @@ int main(int argc, char **argv)
                             "after --symlink\n");
                     exit(1);
                 }
+            } else if (!strcmp(p, "--sign-threads")) {
+                if (--argc <= 0) {
+                    fprintf(stderr, "pageant: expected a number of threads "
+                            "after --sign-threads\n");
+                    exit(1);
+                }
+                int n = atoi(*++argv);
+#if HAVE_PTHREAD
+                if (n < 0) {
+                    fprintf(stderr, "pageant: number of threads must not "
+                            "be negative\n");
+                    exit(1);
+                }
+                sign_threads = n;
+#else
+                if (n > 0) {
+                    fprintf(stderr, "pageant: this build does not support "
+                            "--sign-threads\n");
+                    exit(1);
+                }
+#endif
             } else if (!strcmp(p, "-E") || !strcmp(p, "--fptype")) {
                 const char *keyword;
                 if (--argc > 0) {
@@ -365,6 +365,7 @@ bool init_ucs(struct unicode_data *ucsdata, char *line_codepage,
  */
 void *sk_getxdmdata(Socket *sock, int *lenp);
 int sk_net_get_fd(Socket *sock);
+bool sk_net_start_relay(Socket *a, Socket *b, size_t limit);
 SockAddr *unix_sock_addr(const char *path);
 Socket *new_unix_listener(SockAddr *listenaddr, Plug *plug);
 
@@ -387,6 +388,13 @@ extern const struct BackendVtable serial_backend;
  */
 bool so_peercred(int fd, int *pid, int *uid, int *gid);
 
+/*
+ * splice.c, wrapping the Linux splice(2) call.
+ */
+bool splice_available(void);
+ptrdiff_t splice_nonblock(int infd, int outfd, size_t len);
+void splice_set_pipe_size(int fd, size_t size);
+
 /*
  * fd-socket.c.
  */
@@ -14,6 +14,7 @@
 #include <pwd.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include "putty.h"
 #include "ssh.h"
@@ -392,6 +393,36 @@ static SeatPromptResult plink_get_userpass_input(Seat *seat, prompts_t *p)
     return spr;
 }
 
+/*
+ * In a background connection-sharing upstream started by
+ * spawn_persistent_upstream, this is the pipe on which we tell the
+ * Plink that started us that we've finished logging in.
+ */
+static int upstream_ready_fd = -1;
+
+static void plink_notify_session_started(Seat *seat)
+{
+    if (upstream_ready_fd >= 0) {
+        /*
+         * We've finished any interaction with the user, so tell our
+         * parent to go ahead, and detach from the terminal.
+         */
+        int fd = open("/dev/null", O_RDWR);
+        if (fd >= 0) {
+            dup2(fd, STDIN_FILENO);
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            if (fd > STDERR_FILENO)
+                close(fd);
+        }
+        setsid();
+        if (write(upstream_ready_fd, "", 1) < 0)
+            /* our parent has gone away, but we're still useful */;
+        close(upstream_ready_fd);
+        upstream_ready_fd = -1;
+    }
+}
+
 static bool plink_seat_interactive(Seat *seat)
 {
     return (!*conf_get_str(conf, CONF_remote_cmd) &&
@@ -405,7 +436,7 @@ static const SeatVtable plink_seat_vt = {
     .sent = nullseat_sent,
     .banner = nullseat_banner_to_stderr,
     .get_userpass_input = plink_get_userpass_input,
-    .notify_session_started = nullseat_notify_session_started,
+    .notify_session_started = plink_notify_session_started,
     .notify_remote_exit = nullseat_notify_remote_exit,
     .notify_remote_disconnect = nullseat_notify_remote_disconnect,
     .connection_fatal = console_connection_fatal,
@@ -573,6 +604,8 @@ static void usage(void)
     printf("            control what happens when a log file already exists\n");
     printf("  -shareexists\n");
     printf("            test whether a connection-sharing upstream exists\n");
+    printf("  -sharepersist seconds\n");
+    printf("            share connections, keeping an idle upstream open\n");
     exit(1);
 }
 
@@ -665,6 +698,76 @@ static void plink_pw_check(void *vctx, pollwrapper *pw)
         try_output(true);
 }
 
+/*
+ * Start a connection-sharing upstream in the background, which will
+ * outlive us, and wait until it's ready for us to connect to.
+ *
+ * Returns in both processes. The new one (recognisable by
+ * upstream_ready_fd being set) should go on to make the connection
+ * with its Conf adjusted to suit an upstream; the original one should
+ * carry on as normal, finding the new upstream if it succeeded or
+ * making its own connection if not.
+ */
+static void spawn_persistent_upstream(Conf *conf)
+{
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return;                        /* never mind, just don't bother */
+
+    /*
+     * Fork twice, so that the upstream isn't our child, and nobody
+     * has to wait for it when it eventually exits.
+     */
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        pid = fork();
+        if (pid != 0)
+            _exit(0);
+
+        cloexec(fds[1]);
+        upstream_ready_fd = fds[1];
+
+        conf_set_bool(conf, CONF_ssh_no_shell, true);
+        conf_set_bool(conf, CONF_ssh_connection_sharing_upstream_only, true);
+        /* Port forwardings belong to the downstream that asked for them */
+        {
+            char *key;
+            while ((key = conf_get_str_nthstrkey(conf, CONF_portfwd, 0))) {
+                key = dupstr(key);
+                conf_del_str_str(conf, CONF_portfwd, key);
+                sfree(key);
+            }
+        }
+        console_antispoof_prompt = false;
+        seen_stdin_eof = true;
+        return;
+    }
+
+    close(fds[1]);
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+        { /* retry */ }
+
+    /*
+     * Wait for the upstream to finish logging in (or to give up, in
+     * which case we'll see EOF). Until then it may be prompting the
+     * user on the terminal, so we stay out of the way.
+     */
+    {
+        char c;
+        while (read(fds[0], &c, 1) < 0 && errno == EINTR)
+            { /* retry */ }
+    }
+    close(fds[0]);
+}
+
 static bool plink_continue(void *vctx, bool found_any_fd,
                            bool ran_any_callback)
 {
@@ -934,6 +1037,20 @@ int main(int argc, char **argv)
             return 1;
     }
 
+    /*
+     * If we've been asked to keep a shared connection around after
+     * we finish, and there isn't one already, start one.
+     */
+    if (backvt->test_for_upstream &&
+        conf_get_bool(conf, CONF_ssh_connection_sharing) &&
+        conf_get_bool(conf, CONF_ssh_connection_sharing_upstream) &&
+        conf_get_bool(conf, CONF_ssh_connection_sharing_downstream) &&
+        conf_get_int(conf, CONF_ssh_connection_sharing_persist) > 0 &&
+        !conf_get_bool(conf, CONF_ssh_no_shell) &&
+        !backvt->test_for_upstream(conf_get_str(conf, CONF_host),
+                                   conf_get_int(conf, CONF_port), conf))
+        spawn_persistent_upstream(conf);
+
     /*
      * Start up the connection.
      */
@@ -954,7 +1071,9 @@ int main(int argc, char **argv)
                              &realhost, nodelay,
                              conf_get_bool(conf, CONF_tcp_keepalives));
         if (error) {
-            fprintf(stderr, "Unable to open connection:\n%s\n", error);
+            /* A background upstream leaves its parent to report errors */
+            if (upstream_ready_fd < 0)
+                fprintf(stderr, "Unable to open connection:\n%s\n", error);
             sfree(error);
             return 1;
         }
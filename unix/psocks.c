@@ -130,6 +130,7 @@ static void start_subcommand(strbuf *args)
 static const PsocksPlatform platform = {
     open_pipes,
     start_subcommand,
+    sk_net_start_relay,
 };
 
 static bool psocks_pw_setup(void *ctx, pollwrapper *pw)
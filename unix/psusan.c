@@ -35,6 +35,7 @@
 #include <pwd.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include "putty.h"
 #include "mpint.h"
@@ -161,6 +162,8 @@ static void show_help(FILE *fp)
     fputs("usage:   psusan [options]\n"
           "options: --listen SOCKETPATH  listen for connections on a Unix-domain socket\n"
           "         --listen-once        (with --listen) stop after one connection\n"
+          "         --fork               (with --listen) serve each connection in\n"
+          "                                a separate process\n"
           "         --verbose            print log messages to standard error\n"
           "         --sessiondir DIR     cwd for session subprocess (default $HOME)\n"
           "         --sshlog FILE        write ssh-connection packet log to FILE\n"
@@ -180,13 +183,17 @@ static void show_version_and_exit(void)
 const bool buildinfo_gtk_relevant = false;
 
 static bool listening = false, listen_once = false;
+static bool fork_workers = false, is_worker = false;
 static bool finished = false;
 void server_instance_terminated(LogPolicy *lp)
 {
     struct server_instance *inst = container_of(
         lp, struct server_instance, logpolicy);
 
-    if (listening && !listen_once) {
+    if (is_worker) {
+        log_to_stderr(inst->id, "connection terminated");
+        finished = true;
+    } else if (listening && !listen_once) {
         log_to_stderr(inst->id, "connection terminated");
     } else {
         finished = true;
@@ -278,6 +285,83 @@ static void server_closing(Plug *plug, PlugCloseType type,
         log_to_stderr(-1, error_msg);
 }
 
+/*
+ * In --fork mode, the main process does nothing but accept
+ * connections, and hands each one to a child process of its own, so
+ * that a heavy file transfer on one connection can't hold up the
+ * event loop serving another. The children are reaped via SIGCHLD,
+ * as in psocks.
+ */
+static int signalpipe[2] = { -1, -1 };
+static void sigchld(int signum)
+{
+    if (write(signalpipe[1], "x", 1) <= 0)
+        /* not much we can do about it */;
+}
+
+static bool psusan_pw_setup(void *ctx, pollwrapper *pw)
+{
+    if (signalpipe[0] >= 0)
+        pollwrap_add_fd_rwx(pw, signalpipe[0], SELECT_R);
+    return true;
+}
+
+static void psusan_pw_check(void *ctx, pollwrapper *pw)
+{
+    if (signalpipe[0] >= 0 &&
+        pollwrap_check_fd_rwx(pw, signalpipe[0], SELECT_R)) {
+        char c[64];
+        if (read(signalpipe[0], c, sizeof(c)) <= 0)
+            /* ignore error */;
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+    }
+}
+
+static void start_forking(void)
+{
+    if (pipe(signalpipe) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    cloexec(signalpipe[0]);
+    cloexec(signalpipe[1]);
+    nonblock(signalpipe[0]);
+    nonblock(signalpipe[1]);
+    putty_signal(SIGCHLD, sigchld);
+}
+
+/*
+ * Returns true in the child process, which goes on to serve the
+ * connection, and false in the parent.
+ */
+static bool fork_worker(struct server_config *cfg, accept_ctx_t ctx)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        char *msg = dupprintf("unable to fork: %s", strerror(errno));
+        close(ctx.i);
+        log_to_stderr(cfg->next_id, msg);
+        sfree(msg);
+        return false;
+    }
+
+    if (pid > 0) {
+        close(ctx.i);             /* the child has its own copy */
+        cfg->next_id++;           /* keep connection ids unique */
+        return false;
+    }
+
+    /* In the child: drop everything that belongs to the parent */
+    sk_close(cfg->listening_socket);
+    cfg->listening_socket = NULL;
+    close(signalpipe[0]);
+    close(signalpipe[1]);
+    signalpipe[0] = signalpipe[1] = -1;
+    putty_signal(SIGCHLD, SIG_DFL);
+    is_worker = true;
+    return true;
+}
+
 static int server_accepting(Plug *p, accept_fn_t constructor, accept_ctx_t ctx)
 {
     struct server_config *cfg = container_of(
@@ -292,6 +376,9 @@ static int server_accepting(Plug *p, accept_fn_t constructor, accept_ctx_t ctx)
             return 1;
         sk_close(cfg->listening_socket);
         cfg->listening_socket = NULL;
+    } else if (fork_workers) {
+        if (!fork_worker(cfg, ctx))
+            return 0;
     }
 
     Plug *plug = server_conn_plug(cfg, &inst);
@@ -385,6 +472,8 @@ int main(int argc, char **argv)
             listen_socket = val;
         } else if (!strcmp(arg, "--listen-once")) {
             listen_once = true;
+        } else if (longoptnoarg(arg, "--fork")) {
+            fork_workers = true;
         } else {
             fprintf(stderr, "%s: unrecognised option '%s'\n", appname, arg);
             exit(1);
@@ -404,6 +493,8 @@ int main(int argc, char **argv)
         scfg.listening_plug.vt = &server_plugvt;
         SockAddr *addr = unix_sock_addr(listen_socket);
         scfg.listening_socket = new_unix_listener(addr, &scfg.listening_plug);
+        if (fork_workers && !listen_once)
+            start_forking();
         char *msg = dupprintf("listening on Unix socket %s", listen_socket);
         log_to_stderr(-1, msg);
         sfree(msg);
@@ -414,8 +505,7 @@ int main(int argc, char **argv)
         log_to_stderr(inst->id, "running directly on stdio");
     }
 
-    cli_main_loop(cliloop_no_pw_setup, cliloop_no_pw_check,
-                  psusan_continue, NULL);
+    cli_main_loop(psusan_pw_setup, psusan_pw_check, psusan_continue, NULL);
 
     return 0;
 }
@@ -86,6 +86,13 @@ struct Pty {
 
 #define PTY_MAX_BACKLOG 32768
 
+/*
+ * Maximum amount of output we'll read from the pty master in response
+ * to one readability event, before returning to the event loop to
+ * give other fds a turn.
+ */
+#define PTY_READ_BUDGET 65536
+
 /*
  * We store all the (active) PtyFd structures in a tree sorted by fd,
  * so that when we get an uxsel notification we know which backend
@@ -598,7 +605,7 @@ static void pty_uxsel_setup(Pty *pty);
 
 static void pty_real_select_result(Pty *pty, int fd, int event, int status)
 {
-    char buf[4096];
+    char buf[16384];
     int ret;
     bool finished = false;
 
@@ -633,56 +640,82 @@ static void pty_real_select_result(Pty *pty, int fd, int event, int status)
     } else {
         if (event == SELECT_R) {
             bool is_stdout = (fd == pty->master_o);
-
-            ret = read(fd, buf, sizeof(buf));
+            size_t total = 0;
 
             /*
-             * Treat EIO on a pty master as equivalent to EOF (because
-             * that's how the kernel seems to report the event where
-             * the last process connected to the other end of the pty
-             * went away).
+             * Read repeatedly from the pty master while it keeps
+             * filling our buffer, so that a fast-scrolling
+             * subprocess doesn't cost an event loop iteration per
+             * buffer. We give up once the seat reports enough
+             * backlog to throttle us, or once we've read
+             * PTY_READ_BUDGET in one go. Only the pty master itself
+             * is non-blocking, so the stdout/stderr pipes in
+             * non-pty mode still get one read per event.
              */
-            if (fd == pty->master_fd && ret < 0 && errno == EIO)
-                ret = 0;
+            while (true) {
+                ret = read(fd, buf, sizeof(buf));
 
-            if (ret == 0) {
                 /*
-                 * EOF on this input fd, so to begin with, we may as
-                 * well close it, and remove all references to it in
-                 * the pty's fd fields.
+                 * Treat EIO on a pty master as equivalent to EOF
+                 * (because that's how the kernel seems to report the
+                 * event where the last process connected to the
+                 * other end of the pty went away).
                  */
-                uxsel_del(fd);
-                close(fd);
-                if (pty->master_fd == fd)
-                    pty->master_fd = -1;
-                if (pty->master_o == fd)
-                    pty->master_o = -1;
-                if (pty->master_e == fd)
-                    pty->master_e = -1;
-
-                if (is_stdout) {
+                if (fd == pty->master_fd && ret < 0 && errno == EIO)
+                    ret = 0;
+
+                if (ret < 0 && total > 0 &&
+                    (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;             /* drained it */
+
+                if (ret == 0) {
                     /*
-                     * We assume a clean exit if the pty (or stdout
-                     * pipe) has closed, but the actual child process
-                     * hasn't. The only way I can imagine this
-                     * happening is if it detaches itself from the pty
-                     * and goes daemonic - in which case the expected
-                     * usage model would precisely _not_ be for the
-                     * pterm window to hang around!
+                     * EOF on this input fd, so to begin with, we may
+                     * as well close it, and remove all references to
+                     * it in the pty's fd fields.
                      */
-                    finished = true;
-                    pty_try_wait(); /* one last effort to collect exit code */
-                    if (!pty->child_dead)
-                        pty->exit_code = 0;
+                    uxsel_del(fd);
+                    close(fd);
+                    if (pty->master_fd == fd)
+                        pty->master_fd = -1;
+                    if (pty->master_o == fd)
+                        pty->master_o = -1;
+                    if (pty->master_e == fd)
+                        pty->master_e = -1;
+
+                    if (is_stdout) {
+                        /*
+                         * We assume a clean exit if the pty (or
+                         * stdout pipe) has closed, but the actual
+                         * child process hasn't. The only way I can
+                         * imagine this happening is if it detaches
+                         * itself from the pty and goes daemonic - in
+                         * which case the expected usage model would
+                         * precisely _not_ be for the pterm window to
+                         * hang around!
+                         */
+                        finished = true;
+                        pty_try_wait(); /* one last effort to collect exit code */
+                        if (!pty->child_dead)
+                            pty->exit_code = 0;
+                    }
+                    break;
+                } else if (ret < 0) {
+                    perror("read pty master");
+                    exit(1);
                 }
-            } else if (ret < 0) {
-                perror("read pty master");
-                exit(1);
-            } else if (ret > 0) {
+
                 pty->output_backlog = seat_output(
                     pty->seat, !is_stdout, buf, ret);
-                pty_uxsel_setup(pty);
+                total += ret;
+
+                if ((size_t)ret < sizeof(buf) || fd != pty->master_fd ||
+                    pty->output_backlog >= PTY_MAX_BACKLOG ||
+                    total >= PTY_READ_BUDGET)
+                    break;
             }
+            if (total > 0)
+                pty_uxsel_setup(pty);
         } else if (event == SELECT_W) {
             /*
              * Attempt to send data down the pty.
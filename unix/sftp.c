@@ -217,6 +217,22 @@ WFile *open_existing_wfile(const char *name, uint64_t *size)
     return f;
 }
 
+WFile *open_update_wfile(const char *name)
+{
+    int fd;
+    WFile *f;
+
+    fd = open(name, O_WRONLY);
+    if (fd < 0)
+        return NULL;
+
+    f = snew(WFile);
+    f->fd = fd;
+    f->name = dupstr(name);
+
+    return f;
+}
+
 int write_to_file(WFile *f, void *buffer, int length)
 {
     char *p = (char *)buffer;
@@ -286,6 +302,11 @@ uint64_t get_file_posn(WFile *f)
     return lseek(f->fd, (off_t) 0, SEEK_CUR);
 }
 
+int set_file_size(WFile *f, uint64_t size)
+{
+    return ftruncate(f->fd, size) == 0 ? 0 : -1;
+}
+
 int file_type(const char *name)
 {
     struct stat statbuf;
@@ -3,12 +3,22 @@
  * really operating on the Unix filesystem).
  */
 
+#if HAVE_CMAKE_H
+#include "cmake.h"
+#endif
+
+#if HAVE_COPY_FILE_RANGE
+#define _GNU_SOURCE
+#include <features.h>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <fcntl.h>
@@ -24,6 +34,10 @@
 #include "ssh/sftp.h"
 #include "tree234.h"
 
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 typedef struct UnixSftpServer UnixSftpServer;
 
 struct UnixSftpServer {
@@ -36,12 +50,44 @@ struct UnixSftpServer {
 
     char handlekey[8];
 
+    /* One-entry caches of user and group names for READDIR longnames,
+     * since a directory's files mostly all have the same owner */
+    bool have_cached_uid, have_cached_gid;
+    uid_t cached_uid;
+    gid_t cached_gid;
+    char *cached_user, *cached_group;
+
+#if HAVE_PTHREAD
+    struct uss_fdaio *fdaio;
+    size_t fdaiosize;
+    unsigned aio_pending;     /* protected by uss_pool.mutex */
+#endif
+
     SftpServer srv;
 };
 
 struct uss_dirhandle {
     int index;
     DIR *dp;
+    struct uss_dirbatch *pending;      /* READDIR reply still being built */
+};
+
+/*
+ * A batch of directory entries read by one READDIR, waiting to be
+ * statted and sent back.
+ */
+struct uss_dirent {
+    char *name;
+    bool stat_ok;
+    struct stat st;
+};
+struct uss_dirbatch {
+    struct uss_dirhandle *udh;
+    SftpReplyBuilder *reply;           /* if deferred */
+    bool omit_longname;
+    struct uss_dirent *entries;
+    size_t nentries, entriessize;
+    unsigned parts_left;
 };
 
 #define USS_DIRHANDLE_SEQ (0xFFFFFFFFU)
@@ -57,6 +103,673 @@ static int uss_dirhandle_cmp(void *av, void *bv)
     return 0;
 }
 
+static void uss_error(UnixSftpServer *uss, SftpReplyBuilder *reply);
+static void uss_dirbatch_stat(
+    struct uss_dirbatch *batch, size_t start, size_t count);
+static void uss_dirbatch_reply(UnixSftpServer *uss,
+                               struct uss_dirbatch *batch,
+                               SftpReplyBuilder *reply);
+static void uss_dirbatch_free(struct uss_dirbatch *batch);
+
+#define USS_COPY_CHUNK 65536
+
+/*
+ * Copy a range of bytes from one file to another, for copy-data.
+ * Returns 0 on success or an errno value. This may be called on a
+ * worker thread, so it mustn't touch anything but its arguments.
+ */
+static int uss_copy_range(int srcfd, uint64_t srcoffset,
+                          int dstfd, uint64_t dstoffset, uint64_t length)
+{
+    uint64_t done = 0;
+
+#if HAVE_COPY_FILE_RANGE
+    /*
+     * Let the kernel do the copy if it can, which may mean the data
+     * never even gets read (e.g. on filesystems that can share
+     * extents between files). If it won't do this pair of files,
+     * fall back to doing it ourselves.
+     */
+    while (done < length) {
+        off_t inoff = srcoffset + done, outoff = dstoffset + done;
+        uint64_t want = length - done;
+        if (want > 0x40000000)
+            want = 0x40000000;
+        ssize_t n = copy_file_range(srcfd, &inoff, dstfd, &outoff, want, 0);
+        if (n < 0) {
+            if (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                errno == EOPNOTSUPP)
+                break;
+            return errno;
+        }
+        if (n == 0)
+            return 0;                  /* end of the source file */
+        done += n;
+    }
+#endif
+
+    char *buf = NULL;
+    while (done < length) {
+        if (!buf && (buf = malloc(USS_COPY_CHUNK)) == NULL)
+            return ENOMEM;
+
+        size_t want = (length - done < USS_COPY_CHUNK ?
+                       length - done : USS_COPY_CHUNK);
+        ssize_t n = pread(srcfd, buf, want, srcoffset + done);
+        if (n < 0) {
+            int err = errno;
+            free(buf);
+            return err;
+        }
+        if (n == 0)
+            break;
+
+        for (ssize_t written = 0; written < n ;) {
+            ssize_t w = pwrite(dstfd, buf + written, n - written,
+                               dstoffset + done + written);
+            if (w < 0) {
+                int err = errno;
+                free(buf);
+                return err;
+            }
+            written += w;
+        }
+        done += n;
+    }
+    free(buf);
+    return 0;
+}
+
+#if HAVE_PTHREAD
+
+/*
+ * Background file I/O.
+ *
+ * When the SftpReplyBuilder we're given for an FXP_READ or FXP_WRITE
+ * will let us defer the reply, we hand the actual pread or pwrite to
+ * a pool of worker threads, and send the reply from the main thread
+ * when it finishes. That way a client with lots of requests
+ * outstanding gets them serviced in parallel, and a slow disk doesn't
+ * stall the whole event loop.
+ *
+ * The worker threads don't touch anything except the uss_aio they're
+ * working on and the queues in uss_pool. They tell the main thread
+ * there's something to collect by writing to a pipe, which is watched
+ * with uxsel in the usual way.
+ *
+ * Replies can go back out of order, which SFTP permits. But we don't
+ * let operations on the same file overtake each other in ways a
+ * client could notice: reads can run concurrently with each other,
+ * but a write waits for everything before it on that handle to
+ * finish, and everything after it waits for the write. And anything
+ * else that touches the fd (close, fstat, fsetstat) first waits for
+ * all of its background operations to finish.
+ *
+ * The pool also does the fstatat calls for READDIR, split into chunks
+ * so that several threads can work on one big directory at once, and
+ * the copying and syncing for copy-data and fsync, which can take far
+ * longer than any single read or write.
+ */
+
+#define USS_AIO_THREADS 4
+#define USS_AIO_STAT_CHUNK 32
+
+typedef enum {
+    USS_AIO_READ, USS_AIO_WRITE, USS_AIO_COPY, USS_AIO_FSYNC
+} uss_aio_kind;
+
+typedef struct uss_aio uss_aio;
+struct uss_aio {
+    UnixSftpServer *uss;
+    SftpReplyBuilder *reply;           /* a deferred one */
+    int fd;
+    uss_aio_kind kind;
+    bool is_write;              /* changes the file, so can't overlap */
+    uint64_t offset;
+    char *buf;
+    bool own_buf;               /* else it belongs to the reply builder */
+    size_t len, done;
+    int err;
+    int srcfd;                  /* for a copy, whose destination is fd */
+    uint64_t srcoffset, copylen;
+    struct uss_dirbatch *batch;        /* if this is a chunk of stats */
+    size_t start, count;
+    uss_aio *next;
+};
+
+struct uss_fdaio {
+    bool seekable;
+    unsigned running;           /* operations passed to the pool */
+    bool writing;               /* one of those is a write */
+    uss_aio *waithead, *waittail;      /* held back to preserve order */
+};
+
+static struct {
+    bool tried, ok;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond, done_cond;
+    uss_aio *todo_head, *todo_tail;
+    uss_aio *done_head, *done_tail;
+    int pipefd[2];
+    bool woken;
+} uss_pool;
+
+static void uss_aio_perform(uss_aio *op)
+{
+    if (op->batch) {
+        uss_dirbatch_stat(op->batch, op->start, op->count);
+        return;
+    }
+
+    op->err = 0;
+    if (op->kind == USS_AIO_COPY) {
+        op->err = uss_copy_range(op->srcfd, op->srcoffset,
+                                 op->fd, op->offset, op->copylen);
+        return;
+    }
+    if (op->kind == USS_AIO_FSYNC) {
+        if (fsync(op->fd) < 0)
+            op->err = errno;
+        return;
+    }
+
+    while (op->done < op->len) {
+        ssize_t status;
+        if (op->kind == USS_AIO_WRITE)
+            status = pwrite(op->fd, op->buf + op->done, op->len - op->done,
+                            op->offset + op->done);
+        else
+            status = pread(op->fd, op->buf + op->done, op->len - op->done,
+                           op->offset + op->done);
+        if (status < 0) {
+            if (errno == EINTR)
+                continue;
+            op->err = errno;
+            break;
+        }
+        if (status == 0)
+            break;                     /* EOF, or a write going nowhere */
+        op->done += status;
+    }
+}
+
+static void *uss_pool_thread(void *ctx)
+{
+    pthread_mutex_lock(&uss_pool.mutex);
+    while (true) {
+        while (!uss_pool.todo_head)
+            pthread_cond_wait(&uss_pool.work_cond, &uss_pool.mutex);
+        uss_aio *op = uss_pool.todo_head;
+        if (!(uss_pool.todo_head = op->next))
+            uss_pool.todo_tail = NULL;
+        pthread_mutex_unlock(&uss_pool.mutex);
+
+        uss_aio_perform(op);
+
+        pthread_mutex_lock(&uss_pool.mutex);
+        op->next = NULL;
+        if (uss_pool.done_tail)
+            uss_pool.done_tail->next = op;
+        else
+            uss_pool.done_head = op;
+        uss_pool.done_tail = op;
+        op->uss->aio_pending--;
+        if (!uss_pool.woken) {
+            uss_pool.woken = true;
+            if (write(uss_pool.pipefd[1], "", 1) < 0) {
+                /* the pipe can only be full if a wakeup is pending anyway */
+            }
+        }
+        pthread_cond_broadcast(&uss_pool.done_cond);
+    }
+    return NULL;
+}
+
+/*
+ * Remove and return the finished operations belonging to a particular
+ * server (or to all of them, if uss is NULL). Caller holds the mutex.
+ */
+static uss_aio *uss_pool_take_done(UnixSftpServer *uss)
+{
+    uss_aio *head = NULL, **tail = &head, **pp = &uss_pool.done_head;
+    uss_aio *prev = NULL;
+
+    while (*pp) {
+        uss_aio *op = *pp;
+        if (!uss || op->uss == uss) {
+            *pp = op->next;
+            op->next = NULL;
+            *tail = op;
+            tail = &op->next;
+        } else {
+            prev = op;
+            pp = &op->next;
+        }
+    }
+    uss_pool.done_tail = prev;
+    return head;
+}
+
+static void uss_aio_complete(uss_aio *op);
+
+static void uss_pool_select_result(int fd, int event)
+{
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0);
+
+    pthread_mutex_lock(&uss_pool.mutex);
+    uss_pool.woken = false;
+    uss_aio *op = uss_pool_take_done(NULL);
+    pthread_mutex_unlock(&uss_pool.mutex);
+
+    while (op) {
+        uss_aio *next = op->next;
+        uss_aio_complete(op);
+        op = next;
+    }
+}
+
+static bool uss_pool_start(void)
+{
+    if (uss_pool.tried)
+        return uss_pool.ok;
+    uss_pool.tried = true;
+
+    if (pipe(uss_pool.pipefd) < 0)
+        return false;
+    cloexec(uss_pool.pipefd[0]);
+    cloexec(uss_pool.pipefd[1]);
+    nonblock(uss_pool.pipefd[0]);
+    nonblock(uss_pool.pipefd[1]);
+
+    pthread_mutex_init(&uss_pool.mutex, NULL);
+    pthread_cond_init(&uss_pool.work_cond, NULL);
+    pthread_cond_init(&uss_pool.done_cond, NULL);
+
+    unsigned nthreads = 0;
+    for (unsigned i = 0; i < USS_AIO_THREADS; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, uss_pool_thread, NULL) == 0) {
+            pthread_detach(thread);
+            nthreads++;
+        }
+    }
+    if (!nthreads) {
+        close(uss_pool.pipefd[0]);
+        close(uss_pool.pipefd[1]);
+        return false;
+    }
+
+    uxsel_set(uss_pool.pipefd[0], SELECT_R, uss_pool_select_result);
+    uss_pool.ok = true;
+    return true;
+}
+
+static void uss_aio_new_fd(UnixSftpServer *uss, int fd)
+{
+    if (fd >= uss->fdaiosize) {
+        size_t old_size = uss->fdaiosize;
+        sgrowarray(uss->fdaio, uss->fdaiosize, fd);
+        memset(uss->fdaio + old_size, 0,
+               (uss->fdaiosize - old_size) * sizeof(*uss->fdaio));
+    }
+    struct uss_fdaio *fa = &uss->fdaio[fd];
+    assert(!fa->running && !fa->waithead);
+    fa->seekable = (lseek(fd, 0, SEEK_CUR) >= 0);
+    fa->writing = false;
+}
+
+/*
+ * Return a deferred reply builder, if this operation can be done in
+ * the background.
+ */
+static SftpReplyBuilder *uss_aio_defer(
+    UnixSftpServer *uss, SftpReplyBuilder *reply, int fd)
+{
+    if (!uss->fdaio[fd].seekable)
+        return NULL;               /* pread and pwrite won't work anyway */
+    return fxp_reply_defer(reply);
+}
+
+static void uss_pool_enqueue(UnixSftpServer *uss, uss_aio *op)
+{
+    pthread_mutex_lock(&uss_pool.mutex);
+    op->next = NULL;
+    if (uss_pool.todo_tail)
+        uss_pool.todo_tail->next = op;
+    else
+        uss_pool.todo_head = op;
+    uss_pool.todo_tail = op;
+    uss->aio_pending++;
+    pthread_cond_signal(&uss_pool.work_cond);
+    pthread_mutex_unlock(&uss_pool.mutex);
+}
+
+/*
+ * Record that an operation is under way on its fd (and, for a copy,
+ * on its source fd too, so that nothing writes to that meanwhile).
+ */
+static void uss_aio_count(UnixSftpServer *uss, uss_aio *op)
+{
+    struct uss_fdaio *fa = &uss->fdaio[op->fd];
+    fa->running++;
+    if (op->is_write)
+        fa->writing = true;
+    if (op->kind == USS_AIO_COPY)
+        uss->fdaio[op->srcfd].running++;
+}
+
+static void uss_aio_start(UnixSftpServer *uss, uss_aio *op)
+{
+    uss_aio_count(uss, op);
+    uss_pool_enqueue(uss, op);
+}
+
+static inline bool uss_aio_can_start(struct uss_fdaio *fa, bool is_write)
+{
+    return is_write ? fa->running == 0 : !fa->writing;
+}
+
+static void uss_aio_release_waiting(UnixSftpServer *uss, int fd)
+{
+    struct uss_fdaio *fa = &uss->fdaio[fd];
+    while (fa->waithead && uss_aio_can_start(fa, fa->waithead->is_write)) {
+        uss_aio *op = fa->waithead;
+        if (!(fa->waithead = op->next))
+            fa->waittail = NULL;
+        uss_aio_start(uss, op);
+    }
+}
+
+static uss_aio *uss_aio_new(UnixSftpServer *uss, SftpReplyBuilder *later,
+                            int fd, uss_aio_kind kind)
+{
+    uss_aio *op = snew(uss_aio);
+    memset(op, 0, sizeof(*op));
+    op->uss = uss;
+    op->reply = later;
+    op->fd = fd;
+    op->kind = kind;
+    op->is_write = (kind == USS_AIO_WRITE || kind == USS_AIO_COPY);
+    op->srcfd = -1;
+    return op;
+}
+
+static void uss_aio_dispatch(UnixSftpServer *uss, uss_aio *op)
+{
+    struct uss_fdaio *fa = &uss->fdaio[op->fd];
+
+    if (!uss_pool_start()) {
+        /* No threads after all, so just do it here and now */
+        uss_aio_perform(op);
+        uss_aio_count(uss, op);
+        uss_aio_complete(op);
+    } else if (!fa->waithead && uss_aio_can_start(fa, op->is_write)) {
+        uss_aio_start(uss, op);
+    } else {
+        if (fa->waittail)
+            fa->waittail->next = op;
+        else
+            fa->waithead = op;
+        fa->waittail = op;
+    }
+}
+
+static void uss_aio_submit(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int fd, bool is_write,
+    uint64_t offset, char *buf, bool own_buf, size_t len)
+{
+    uss_aio *op = uss_aio_new(uss, later, fd,
+                              is_write ? USS_AIO_WRITE : USS_AIO_READ);
+    op->offset = offset;
+    op->buf = buf;
+    op->own_buf = own_buf;
+    op->len = len;
+    uss_aio_dispatch(uss, op);
+}
+
+/*
+ * The caller of these two must already have drained the fds
+ * involved, so that the operation can start straight away.
+ */
+static void uss_aio_submit_copy(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int srcfd,
+    uint64_t srcoffset, uint64_t length, int dstfd, uint64_t dstoffset)
+{
+    uss_aio *op = uss_aio_new(uss, later, dstfd, USS_AIO_COPY);
+    op->offset = dstoffset;
+    op->srcfd = srcfd;
+    op->srcoffset = srcoffset;
+    op->copylen = length;
+    uss_aio_dispatch(uss, op);
+}
+
+static void uss_aio_submit_fsync(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int fd)
+{
+    uss_aio_dispatch(uss, uss_aio_new(uss, later, fd, USS_AIO_FSYNC));
+}
+
+static void uss_aio_free(uss_aio *op)
+{
+    if (op->own_buf)
+        free(op->buf);
+    sfree(op);
+}
+
+/*
+ * Farm out the stats for a READDIR batch, if we can. Returns false if
+ * the caller should do them itself.
+ */
+static bool uss_aio_stat_batch(UnixSftpServer *uss, SftpReplyBuilder *reply,
+                               struct uss_dirbatch *batch)
+{
+#if HAVE_FSTATAT && HAVE_DIRFD
+    if (batch->nentries < USS_AIO_STAT_CHUNK / 4)
+        return false;          /* not worth the round trip to the pool */
+    if (!uss_pool_start())
+        return false;
+    if (!(batch->reply = fxp_reply_defer(reply)))
+        return false;
+
+    batch->udh->pending = batch;
+    batch->parts_left = 0;
+    for (size_t start = 0; start < batch->nentries;
+         start += USS_AIO_STAT_CHUNK) {
+        uss_aio *op = snew(uss_aio);
+        memset(op, 0, sizeof(*op));
+        op->uss = uss;
+        op->fd = -1;
+        op->batch = batch;
+        op->start = start;
+        op->count = batch->nentries - start;
+        if (op->count > USS_AIO_STAT_CHUNK)
+            op->count = USS_AIO_STAT_CHUNK;
+        batch->parts_left++;
+        uss_pool_enqueue(uss, op);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void uss_aio_complete(uss_aio *op)
+{
+    UnixSftpServer *uss = op->uss;
+
+    if (op->batch) {
+        struct uss_dirbatch *batch = op->batch;
+        sfree(op);
+        if (--batch->parts_left == 0) {
+            batch->udh->pending = NULL;
+            uss_dirbatch_reply(uss, batch, batch->reply);
+            fxp_reply_send(batch->reply);
+            uss_dirbatch_free(batch);
+        }
+        return;
+    }
+
+    struct uss_fdaio *fa = &uss->fdaio[op->fd];
+    int fd = op->fd, srcfd = op->srcfd;
+
+    assert(fa->running > 0);
+    fa->running--;
+    if (op->is_write)
+        fa->writing = false;
+    if (op->kind == USS_AIO_COPY) {
+        assert(uss->fdaio[srcfd].running > 0);
+        uss->fdaio[srcfd].running--;
+    }
+
+    if (op->err) {
+        errno = op->err;
+        uss_error(uss, op->reply);
+    } else if (op->kind == USS_AIO_WRITE) {
+        if (op->done < op->len)
+            fxp_reply_error(op->reply, SSH_FX_FAILURE, "Short write");
+        else
+            fxp_reply_ok(op->reply);
+    } else if (op->kind != USS_AIO_READ) {
+        fxp_reply_ok(op->reply);
+    } else if (op->done == 0) {
+        fxp_reply_error(op->reply, SSH_FX_EOF, "End of file");
+    } else {
+        fxp_reply_data(op->reply, make_ptrlen(op->buf, op->done));
+    }
+    fxp_reply_send(op->reply);
+    uss_aio_free(op);
+
+    uss_aio_release_waiting(uss, fd);
+    if (srcfd >= 0 && srcfd != fd)
+        uss_aio_release_waiting(uss, srcfd);
+}
+
+/*
+ * Wait for at least one of a server's background operations to
+ * finish, and send the replies for whatever has.
+ */
+static void uss_aio_wait(UnixSftpServer *uss)
+{
+    uss_aio *op;
+
+    pthread_mutex_lock(&uss_pool.mutex);
+    while (!(op = uss_pool_take_done(uss)))
+        pthread_cond_wait(&uss_pool.done_cond, &uss_pool.mutex);
+    pthread_mutex_unlock(&uss_pool.mutex);
+
+    while (op) {
+        uss_aio *next = op->next;
+        uss_aio_complete(op);
+        op = next;
+    }
+}
+
+/*
+ * Block until there's no background I/O left on a given fd.
+ */
+static void uss_aio_drain_fd(UnixSftpServer *uss, int fd)
+{
+    if (fd >= uss->fdaiosize)
+        return;
+    struct uss_fdaio *fa = &uss->fdaio[fd];
+
+    while (fa->running || fa->waithead)
+        uss_aio_wait(uss);
+}
+
+/*
+ * Block until a directory handle's previous READDIR has been answered.
+ */
+static void uss_aio_drain_dir(UnixSftpServer *uss, struct uss_dirhandle *udh)
+{
+    while (udh->pending)
+        uss_aio_wait(uss);
+}
+
+/*
+ * Throw away all of a server's background operations without
+ * replying, when the server is being freed. The ones already in a
+ * worker thread's hands have to be waited for.
+ */
+static void uss_aio_cancel_all(UnixSftpServer *uss)
+{
+    uss_aio *head = NULL, **tail = &head;
+
+    if (!uss_pool.ok)
+        return;
+
+    pthread_mutex_lock(&uss_pool.mutex);
+    for (uss_aio **pp = &uss_pool.todo_head; *pp ;) {
+        uss_aio *op = *pp;
+        if (op->uss == uss) {
+            *pp = op->next;
+            *tail = op;
+            tail = &op->next;
+            uss->aio_pending--;
+        } else {
+            pp = &op->next;
+        }
+    }
+    uss_pool.todo_tail = NULL;
+    for (uss_aio *op = uss_pool.todo_head; op; op = op->next)
+        uss_pool.todo_tail = op;
+
+    while (uss->aio_pending)
+        pthread_cond_wait(&uss_pool.done_cond, &uss_pool.mutex);
+    *tail = uss_pool_take_done(uss);
+    pthread_mutex_unlock(&uss_pool.mutex);
+
+    for (size_t fd = 0; fd < uss->fdaiosize; fd++) {
+        while (*tail)
+            tail = &(*tail)->next;
+        *tail = uss->fdaio[fd].waithead;
+        uss->fdaio[fd].waithead = uss->fdaio[fd].waittail = NULL;
+    }
+
+    while (head) {
+        uss_aio *next = head->next;
+        if (head->batch) {
+            struct uss_dirbatch *batch = head->batch;
+            if (--batch->parts_left == 0) {
+                batch->udh->pending = NULL;
+                fxp_reply_abandon(batch->reply);
+                uss_dirbatch_free(batch);
+            }
+        } else {
+            fxp_reply_abandon(head->reply);
+        }
+        uss_aio_free(head);
+        head = next;
+    }
+}
+
+#else /* HAVE_PTHREAD */
+
+static inline void uss_aio_new_fd(UnixSftpServer *uss, int fd) {}
+static inline SftpReplyBuilder *uss_aio_defer(
+    UnixSftpServer *uss, SftpReplyBuilder *reply, int fd) { return NULL; }
+static inline void uss_aio_submit(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int fd, bool is_write,
+    uint64_t offset, char *buf, bool own_buf, size_t len)
+{ unreachable("no background I/O without threads"); }
+static inline void uss_aio_submit_copy(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int srcfd,
+    uint64_t srcoffset, uint64_t length, int dstfd, uint64_t dstoffset)
+{ unreachable("no background I/O without threads"); }
+static inline void uss_aio_submit_fsync(
+    UnixSftpServer *uss, SftpReplyBuilder *later, int fd)
+{ unreachable("no background I/O without threads"); }
+static inline void uss_aio_drain_fd(UnixSftpServer *uss, int fd) {}
+static inline void uss_aio_drain_dir(
+    UnixSftpServer *uss, struct uss_dirhandle *udh) {}
+static inline bool uss_aio_stat_batch(
+    UnixSftpServer *uss, SftpReplyBuilder *reply,
+    struct uss_dirbatch *batch) { return false; }
+static inline void uss_aio_cancel_all(UnixSftpServer *uss) {}
+
+#endif /* HAVE_PTHREAD */
+
 static SftpServer *uss_new(const SftpServerVtable *vt)
 {
     UnixSftpServer *uss = snew(UnixSftpServer);
@@ -76,6 +789,11 @@ static void uss_free(SftpServer *srv)
     UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
     struct uss_dirhandle *udh;
 
+    uss_aio_cancel_all(uss);
+#if HAVE_PTHREAD
+    sfree(uss->fdaio);
+#endif
+
     for (size_t i = 0; i < uss->fdsize; i++)
         if (uss->fdsopen[i])
             close(i);
@@ -86,6 +804,8 @@ static void uss_free(SftpServer *srv)
         sfree(udh);
     }
 
+    sfree(uss->cached_user);
+    sfree(uss->cached_group);
     sfree(uss);
 }
 
@@ -129,6 +849,7 @@ static void uss_return_new_handle(
     }
     assert(!uss->fdsopen[fd]);
     uss->fdsopen[fd] = true;
+    uss_aio_new_fd(uss, fd);
     if (++uss->fdseqs[fd] == USS_DIRHANDLE_SEQ)
         uss->fdseqs[fd] = 0;
     uss_return_handle_raw(uss, reply, fd, uss->fdseqs[fd]);
@@ -161,6 +882,7 @@ static void uss_return_new_dirhandle(
     struct uss_dirhandle *udh = snew(struct uss_dirhandle);
     udh->index = uss->last_dirhandle_index++;
     udh->dp = dp;
+    udh->pending = NULL;
     struct uss_dirhandle *added = add234(uss->dirhandles, udh);
     assert(added == udh);
     uss_return_handle_raw(uss, reply, udh->index, USS_DIRHANDLE_SEQ);
@@ -248,6 +970,14 @@ static void uss_open(SftpServer *srv, SftpReplyBuilder *reply,
     if (fd < 0) {
         uss_error(uss, reply);
     } else {
+#if HAVE_POSIX_FADVISE
+        /*
+         * SFTP and SCP clients nearly always read a file from one end
+         * to the other, so ask for more aggressive readahead.
+         */
+        if (flags & SSH_FXF_READ)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
         uss_return_new_handle(uss, reply, fd);
     }
 }
@@ -276,11 +1006,13 @@ static void uss_close(SftpServer *srv, SftpReplyBuilder *reply,
     struct uss_dirhandle *udh;
 
     if ((udh = uss_try_lookup_dirhandle(uss, handle)) != NULL) {
+        uss_aio_drain_dir(uss, udh);
         closedir(udh->dp);
         del234(uss->dirhandles, udh);
         sfree(udh);
         fxp_reply_ok(reply);
     } else if ((fd = uss_lookup_fd(uss, reply, handle)) >= 0) {
+        uss_aio_drain_fd(uss, fd);
         close(fd);
         assert(0 <= fd && fd <= uss->fdsize);
         uss->fdsopen[fd] = false;
@@ -404,6 +1136,7 @@ static void uss_fstat(SftpServer *srv, SftpReplyBuilder *reply,
 
     if ((fd = uss_lookup_fd(uss, reply, handle)) < 0)
         return;
+    uss_aio_drain_fd(uss, fd);
     int status = fstat(fd, &st);
 
     if (status < 0) {
@@ -476,6 +1209,7 @@ static void uss_fsetstat(SftpServer *srv, SftpReplyBuilder *reply,
 
     if ((fd = uss_lookup_fd(uss, reply, handle)) < 0)
         return;
+    uss_aio_drain_fd(uss, fd);
 
     bool success = true;
     SETSTAT_GUTS(FD_PREFIX, fd, attrs, success);
@@ -493,19 +1227,39 @@ static void uss_read(SftpServer *srv, SftpReplyBuilder *reply,
     UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
     int fd;
     char *buf;
+    bool own_buf = false;
 
     if ((fd = uss_lookup_fd(uss, reply, handle)) < 0)
         return;
 
-    if ((buf = malloc(length)) == NULL) {
-        /* A rare case in which I bother to check malloc failure,
-         * because in this case we can localise the problem easily by
-         * turning it into a failure response from this one sftp
-         * request */
-        fxp_reply_error(reply, SSH_FX_FAILURE,
-                        "Out of memory for read buffer");
+    SftpReplyBuilder *later = uss_aio_defer(uss, reply, fd);
+    if (later)
+        reply = later;
+
+    /*
+     * If we can, read straight into the reply packet, so that the
+     * data doesn't have to be copied again on its way out.
+     */
+    if ((buf = fxp_reply_data_buffer(reply, length)) == NULL) {
+        if ((buf = malloc(length)) == NULL) {
+            /* A rare case in which I bother to check malloc failure,
+             * because in this case we can localise the problem
+             * easily by turning it into a failure response from this
+             * one sftp request */
+            fxp_reply_error(reply, SSH_FX_FAILURE,
+                            "Out of memory for read buffer");
+            if (later)
+                fxp_reply_send(later);
+            return;
+        }
+        own_buf = true;
+    }
+
+    if (later) {
+        uss_aio_submit(uss, later, fd, false, offset, buf, own_buf, length);
         return;
     }
+    uss_aio_drain_fd(uss, fd);
 
     char *p = buf;
 
@@ -541,7 +1295,8 @@ static void uss_read(SftpServer *srv, SftpReplyBuilder *reply,
         fxp_reply_data(reply, make_ptrlen(buf, p - buf));
     }
 
-    free(buf);
+    if (own_buf)
+        free(buf);
 }
 
 static void uss_write(SftpServer *srv, SftpReplyBuilder *reply,
@@ -553,6 +1308,22 @@ static void uss_write(SftpServer *srv, SftpReplyBuilder *reply,
     if ((fd = uss_lookup_fd(uss, reply, handle)) < 0)
         return;
 
+    SftpReplyBuilder *later = uss_aio_defer(uss, reply, fd);
+    if (later) {
+        /* The request packet won't outlive this call, so copy the data */
+        char *buf = malloc(data.len ? data.len : 1);
+        if (!buf) {
+            fxp_reply_error(later, SSH_FX_FAILURE,
+                            "Out of memory for write buffer");
+            fxp_reply_send(later);
+            return;
+        }
+        memcpy(buf, data.ptr, data.len);
+        uss_aio_submit(uss, later, fd, true, offset, buf, true, data.len);
+        return;
+    }
+    uss_aio_drain_fd(uss, fd);
+
     const char *p = data.ptr;
     unsigned length = data.len;
 
@@ -579,8 +1350,142 @@ static void uss_write(SftpServer *srv, SftpReplyBuilder *reply,
     }
 }
 
+static const char *uss_user_name(UnixSftpServer *uss, uid_t uid)
+{
+    if (!uss->have_cached_uid || uss->cached_uid != uid) {
+        struct passwd *pwd = getpwuid(uid);
+        sfree(uss->cached_user);
+        uss->cached_user = pwd ? dupstr(pwd->pw_name) :
+            dupprintf("%u", (unsigned)uid);
+        uss->cached_uid = uid;
+        uss->have_cached_uid = true;
+    }
+    return uss->cached_user;
+}
+
+static const char *uss_group_name(UnixSftpServer *uss, gid_t gid)
+{
+    if (!uss->have_cached_gid || uss->cached_gid != gid) {
+        struct group *grp = getgrgid(gid);
+        sfree(uss->cached_group);
+        uss->cached_group = grp ? dupstr(grp->gr_name) :
+            dupprintf("%u", (unsigned)gid);
+        uss->cached_gid = gid;
+        uss->have_cached_gid = true;
+    }
+    return uss->cached_group;
+}
+
+static char *uss_format_longname(UnixSftpServer *uss, const struct stat *st,
+                                 const char *name)
+{
+    char perms[11];
+    struct tm tm;
+
+    strcpy(perms, "----------");
+    switch (st->st_mode & S_IFMT) {
+      case S_IFBLK: perms[0] = 'b'; break;
+      case S_IFCHR: perms[0] = 'c'; break;
+      case S_IFDIR: perms[0] = 'd'; break;
+      case S_IFIFO: perms[0] = 'p'; break;
+      case S_IFLNK: perms[0] = 'l'; break;
+      case S_IFSOCK: perms[0] = 's'; break;
+    }
+    if (st->st_mode & S_IRUSR)
+        perms[1] = 'r';
+    if (st->st_mode & S_IWUSR)
+        perms[2] = 'w';
+    if (st->st_mode & S_IXUSR)
+        perms[3] = (st->st_mode & S_ISUID ? 's' : 'x');
+    else
+        perms[3] = (st->st_mode & S_ISUID ? 'S' : '-');
+    if (st->st_mode & S_IRGRP)
+        perms[4] = 'r';
+    if (st->st_mode & S_IWGRP)
+        perms[5] = 'w';
+    if (st->st_mode & S_IXGRP)
+        perms[6] = (st->st_mode & S_ISGID ? 's' : 'x');
+    else
+        perms[6] = (st->st_mode & S_ISGID ? 'S' : '-');
+    if (st->st_mode & S_IROTH)
+        perms[7] = 'r';
+    if (st->st_mode & S_IWOTH)
+        perms[8] = 'w';
+    if (st->st_mode & S_IXOTH)
+        perms[9] = 'x';
+
+    tm = *localtime(&st->st_mtime);
+
+    return dupprintf(
+        "%s %3u %-8s %-8s %8"PRIuMAX" %.3s %2d %02d:%02d %s",
+        perms, (unsigned)st->st_nlink, uss_user_name(uss, st->st_uid),
+        uss_group_name(uss, st->st_gid), (uintmax_t)st->st_size,
+        (&"JanFebMarAprMayJunJulAugSepOctNovDec"[3*tm.tm_mon]),
+        tm.tm_mday, tm.tm_hour, tm.tm_min, name);
+}
+
+/*
+ * Stat some of the entries in a READDIR batch. This can be called
+ * from a worker thread, so it mustn't touch anything else.
+ */
+static void uss_dirbatch_stat(
+    struct uss_dirbatch *batch, size_t start, size_t count)
+{
+#if HAVE_FSTATAT && HAVE_DIRFD
+    int dfd = dirfd(batch->udh->dp);
+    for (size_t i = start; i < start + count; i++) {
+        struct uss_dirent *ent = &batch->entries[i];
+        ent->stat_ok = !fstatat(dfd, ent->name, &ent->st,
+                                AT_SYMLINK_NOFOLLOW);
+    }
+#endif
+}
+
+static void uss_dirbatch_reply(UnixSftpServer *uss,
+                               struct uss_dirbatch *batch,
+                               SftpReplyBuilder *reply)
+{
+    fxp_reply_name_count(reply, batch->nentries);
+    for (size_t i = 0; i < batch->nentries; i++) {
+        struct uss_dirent *ent = &batch->entries[i];
+        ptrlen longname = PTRLEN_LITERAL("");
+        char *longnamebuf = NULL;
+        struct fxp_attrs attrs = no_attrs;
+
+        if (ent->stat_ok) {
+            attrs = uss_translate_struct_stat(&ent->st);
+            if (!batch->omit_longname) {
+                longnamebuf = uss_format_longname(uss, &ent->st, ent->name);
+                longname = ptrlen_from_asciz(longnamebuf);
+            }
+        }
+
+        fxp_reply_full_name(reply, ptrlen_from_asciz(ent->name),
+                            longname, attrs);
+        sfree(longnamebuf);
+    }
+}
+
+static void uss_dirbatch_free(struct uss_dirbatch *batch)
+{
+    for (size_t i = 0; i < batch->nentries; i++)
+        sfree(batch->entries[i].name);
+    sfree(batch->entries);
+    sfree(batch);
+}
+
+/*
+ * Limits on the size of a single READDIR response. The client asks
+ * for more by sending another READDIR, so this just has to be big
+ * enough to amortise the round trip, and small enough that one reply
+ * doesn't hog the channel window.
+ */
+#define USS_READDIR_MAX_ENTRIES 1024
+#define USS_READDIR_MAX_BYTES 32768
+
 static void uss_readdir(SftpServer *srv, SftpReplyBuilder *reply,
-                        ptrlen handle, int max_entries, bool omit_longname)
+                        ptrlen handle, int max_entries, bool omit_longname,
+                        bool omit_attrs)
 {
     UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
     struct dirent *de;
@@ -589,96 +1494,159 @@ static void uss_readdir(SftpServer *srv, SftpReplyBuilder *reply,
     if ((udh = uss_lookup_dirhandle(uss, reply, handle)) == NULL)
         return;
 
+    /* Don't let two READDIRs on the same handle overtake each other */
+    uss_aio_drain_dir(uss, udh);
+
+    struct uss_dirbatch *batch = snew(struct uss_dirbatch);
+    memset(batch, 0, sizeof(*batch));
+    batch->udh = udh;
+    batch->omit_longname = omit_longname || omit_attrs;
+
+    /*
+     * Collect as many entries as will fit. readdir() itself fetches
+     * them from the kernel many at a time, so this is cheap; it's the
+     * stats that cost.
+     */
+    size_t bytes = 0;
     errno = 0;
-    de = readdir(udh->dp);
-    if (!de) {
+    while (batch->nentries < max_entries &&
+           batch->nentries < USS_READDIR_MAX_ENTRIES &&
+           bytes < USS_READDIR_MAX_BYTES && (de = readdir(udh->dp)) != NULL) {
+        size_t namelen = strlen(de->d_name);
+        sgrowarray(batch->entries, batch->entriessize, batch->nentries);
+        struct uss_dirent *ent = &batch->entries[batch->nentries++];
+        ent->name = dupstr(de->d_name);
+        ent->stat_ok = false;
+
+        /* Rough size of this entry in the NAME reply */
+        bytes += 12 + namelen;
+        if (!omit_attrs)
+            bytes += 32 + (omit_longname ? 0 : 56 + namelen);
+        errno = 0;
+    }
+
+    if (batch->nentries == 0) {
         if (errno == 0) {
             fxp_reply_error(reply, SSH_FX_EOF, "End of directory");
         } else {
             uss_error(uss, reply);
         }
+        uss_dirbatch_free(batch);
+        return;
+    }
+
+    if (!omit_attrs) {
+        if (uss_aio_stat_batch(uss, reply, batch))
+            return;                    /* reply will be sent later */
+        uss_dirbatch_stat(batch, 0, batch->nentries);
+    }
+
+    uss_dirbatch_reply(uss, batch, reply);
+    uss_dirbatch_free(batch);
+}
+
+static void uss_fsync(SftpServer *srv, SftpReplyBuilder *reply,
+                      ptrlen handle)
+{
+    UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
+    int fd;
+
+    if ((fd = uss_lookup_fd(uss, reply, handle)) < 0)
+        return;
+    uss_aio_drain_fd(uss, fd);
+
+    SftpReplyBuilder *later = uss_aio_defer(uss, reply, fd);
+    if (later) {
+        uss_aio_submit_fsync(uss, later, fd);
+        return;
+    }
+
+    if (fsync(fd) < 0) {
+        uss_error(uss, reply);
     } else {
-        ptrlen longname = PTRLEN_LITERAL("");
-        char *longnamebuf = NULL;
-        struct fxp_attrs attrs = no_attrs;
+        fxp_reply_ok(reply);
+    }
+}
 
-#if HAVE_FSTATAT && HAVE_DIRFD
-        struct stat st;
-        if (!fstatat(dirfd(udh->dp), de->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
-            char perms[11], *uidbuf = NULL, *gidbuf = NULL;
-            struct passwd *pwd;
-            struct group *grp;
-            const char *user, *group;
-            struct tm tm;
-
-            attrs = uss_translate_struct_stat(&st);
-
-            if (!omit_longname) {
-
-                strcpy(perms, "----------");
-                switch (st.st_mode & S_IFMT) {
-                  case S_IFBLK: perms[0] = 'b'; break;
-                  case S_IFCHR: perms[0] = 'c'; break;
-                  case S_IFDIR: perms[0] = 'd'; break;
-                  case S_IFIFO: perms[0] = 'p'; break;
-                  case S_IFLNK: perms[0] = 'l'; break;
-                  case S_IFSOCK: perms[0] = 's'; break;
-                }
-                if (st.st_mode & S_IRUSR)
-                    perms[1] = 'r';
-                if (st.st_mode & S_IWUSR)
-                    perms[2] = 'w';
-                if (st.st_mode & S_IXUSR)
-                    perms[3] = (st.st_mode & S_ISUID ? 's' : 'x');
-                else
-                    perms[3] = (st.st_mode & S_ISUID ? 'S' : '-');
-                if (st.st_mode & S_IRGRP)
-                    perms[4] = 'r';
-                if (st.st_mode & S_IWGRP)
-                    perms[5] = 'w';
-                if (st.st_mode & S_IXGRP)
-                    perms[6] = (st.st_mode & S_ISGID ? 's' : 'x');
-                else
-                    perms[6] = (st.st_mode & S_ISGID ? 'S' : '-');
-                if (st.st_mode & S_IROTH)
-                    perms[7] = 'r';
-                if (st.st_mode & S_IWOTH)
-                    perms[8] = 'w';
-                if (st.st_mode & S_IXOTH)
-                    perms[9] = 'x';
-
-                if ((pwd = getpwuid(st.st_uid)) != NULL)
-                    user = pwd->pw_name;
-                else
-                    user = uidbuf = dupprintf("%u", (unsigned)st.st_uid);
-                if ((grp = getgrgid(st.st_gid)) != NULL)
-                    group = grp->gr_name;
-                else
-                    group = gidbuf = dupprintf("%u", (unsigned)st.st_gid);
-
-                tm = *localtime(&st.st_mtime);
-
-                longnamebuf = dupprintf(
-                    "%s %3u %-8s %-8s %8"PRIuMAX" %.3s %2d %02d:%02d %s",
-                    perms, (unsigned)st.st_nlink, user, group,
-                    (uintmax_t)st.st_size,
-                    (&"JanFebMarAprMayJunJulAugSepOctNovDec"[3*tm.tm_mon]),
-                    tm.tm_mday, tm.tm_hour, tm.tm_min, de->d_name);
-                longname = ptrlen_from_asciz(longnamebuf);
+static void uss_statvfs(SftpServer *srv, SftpReplyBuilder *reply,
+                        ptrlen path)
+{
+    UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
+    struct statvfs sv;
 
-                sfree(uidbuf);
-                sfree(gidbuf);
-            }
-        }
-#endif
+    char *pathstr = mkstr(path);
+    int status = statvfs(pathstr, &sv);
+    free(pathstr);
 
-        /* FIXME: be able to return more than one, in which case we
-         * must also check max_entries */
-        fxp_reply_name_count(reply, 1);
-        fxp_reply_full_name(reply, ptrlen_from_asciz(de->d_name),
-                            longname, attrs);
+    if (status < 0) {
+        uss_error(uss, reply);
+        return;
+    }
 
-        sfree(longnamebuf);
+    struct fxp_statvfs st;
+    st.bsize = sv.f_bsize;
+    st.frsize = sv.f_frsize;
+    st.blocks = sv.f_blocks;
+    st.bfree = sv.f_bfree;
+    st.bavail = sv.f_bavail;
+    st.files = sv.f_files;
+    st.ffree = sv.f_ffree;
+    st.favail = sv.f_favail;
+    st.fsid = sv.f_fsid;
+    st.flag = 0;
+    if (sv.f_flag & ST_RDONLY)
+        st.flag |= SFTP_STATVFS_RDONLY;
+    if (sv.f_flag & ST_NOSUID)
+        st.flag |= SFTP_STATVFS_NOSUID;
+    st.namemax = sv.f_namemax;
+    fxp_reply_statvfs(reply, &st);
+}
+
+static void uss_copy_data(SftpServer *srv, SftpReplyBuilder *reply,
+                          ptrlen srchandle, uint64_t srcoffset,
+                          uint64_t length, ptrlen dsthandle,
+                          uint64_t dstoffset)
+{
+    UnixSftpServer *uss = container_of(srv, UnixSftpServer, srv);
+    int srcfd, dstfd;
+    struct stat srcst, dstst;
+
+    if ((srcfd = uss_lookup_fd(uss, reply, srchandle)) < 0 ||
+        (dstfd = uss_lookup_fd(uss, reply, dsthandle)) < 0)
+        return;
+    uss_aio_drain_fd(uss, srcfd);
+    uss_aio_drain_fd(uss, dstfd);
+
+    if (fstat(srcfd, &srcst) < 0 || fstat(dstfd, &dstst) < 0) {
+        uss_error(uss, reply);
+        return;
+    }
+
+    if (length == 0) {
+        /* Zero means copy everything up to the end of the file */
+        length = (srcst.st_size > srcoffset ? srcst.st_size - srcoffset : 0);
+    }
+
+    if (srcst.st_dev == dstst.st_dev && srcst.st_ino == dstst.st_ino &&
+        srcoffset < dstoffset + length && dstoffset < srcoffset + length) {
+        fxp_reply_error(reply, SSH_FX_FAILURE,
+                        "copy-data source and destination overlap");
+        return;
+    }
+
+    SftpReplyBuilder *later = uss_aio_defer(uss, reply, dstfd);
+    if (later) {
+        uss_aio_submit_copy(uss, later, srcfd, srcoffset, length,
+                            dstfd, dstoffset);
+        return;
+    }
+
+    int err = uss_copy_range(srcfd, srcoffset, dstfd, dstoffset, length);
+    if (err) {
+        errno = err;
+        uss_error(uss, reply);
+    } else {
+        fxp_reply_ok(reply);
     }
 }
 
@@ -700,4 +1668,7 @@ const SftpServerVtable unix_live_sftpserver_vt = {
     .read = uss_read,
     .write = uss_write,
     .readdir = uss_readdir,
+    .fsync = uss_fsync,
+    .statvfs = uss_statvfs,
+    .copy_data = uss_copy_data,
 };
@@ -338,6 +338,44 @@ int platform_ssh_share(const char *pi_name, Conf *conf,
     return SHARE_NONE;
 }
 
+void platform_ssh_share_retire(const char *name)
+{
+    char *dirname, *lockname, *sockname, *logtext;
+    int lockfd;
+
+    dirname = make_dirname(name, &logtext);
+    if (!dirname) {
+        sfree(logtext);                /* we can't do much with this */
+        return;
+    }
+
+    /*
+     * Remove the socket while holding the same lock that
+     * platform_ssh_share holds while deciding whether to connect to
+     * it. So any downstream either connected before we did this (and
+     * the upstream will still accept it), or will find no socket at
+     * all and become an upstream itself. If we can't get the lock,
+     * remove the socket anyway; the race is no worse than it would
+     * be when the upstream closes.
+     */
+    lockname = dupcat(dirname, "/lock");
+    lockfd = open(lockname, O_CREAT | O_RDWR, 0600);
+    if (lockfd >= 0 && flock(lockfd, LOCK_EX) < 0) {
+        close(lockfd);
+        lockfd = -1;
+    }
+
+    sockname = dupcat(dirname, "/socket");
+    remove(sockname);
+
+    if (lockfd >= 0)
+        close(lockfd);
+
+    sfree(sockname);
+    sfree(lockname);
+    sfree(dirname);
+}
+
 void platform_ssh_share_cleanup(const char *name)
 {
     char *dirname, *filename, *logtext;
@@ -0,0 +1,54 @@
+/*
+ * Unix: wrapper for the Linux splice(2) system call, conditionalised
+ * on appropriate autoconfery. On platforms without it, the wrapper
+ * functions report that it's unavailable and callers fall back to
+ * copying data through userspace.
+ */
+
+#if HAVE_CMAKE_H
+#include "cmake.h"
+#endif
+
+#if HAVE_SPLICE
+#define _GNU_SOURCE
+#include <features.h>
+#include <fcntl.h>
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "putty.h"
+
+bool splice_available(void)
+{
+    return HAVE_SPLICE;
+}
+
+/*
+ * Move up to len bytes from infd to outfd without blocking. One of
+ * the two fds must be a pipe. Returns the number of bytes moved, 0 on
+ * end of file, or -1 with errno set (EAGAIN if nothing could be moved
+ * right now).
+ */
+ptrdiff_t splice_nonblock(int infd, int outfd, size_t len)
+{
+#if HAVE_SPLICE
+    return splice(infd, NULL, outfd, NULL, len,
+                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * Try to set the capacity of a pipe. Failure is not fatal: the
+ * kernel's default capacity will do.
+ */
+void splice_set_pipe_size(int fd, size_t size)
+{
+#if HAVE_SPLICE && defined F_SETPIPE_SZ
+    fcntl(fd, F_SETPIPE_SZ, (int)size);
+#endif
+}
@@ -14,6 +14,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <pwd.h>
 #include "putty.h"
@@ -28,7 +29,9 @@
 
 enum {
     INDEX_DIR, INDEX_HOSTKEYS, INDEX_HOSTKEYS_TMP, INDEX_RANDSEED,
-    INDEX_SESSIONDIR, INDEX_SESSION, INDEX_HOSTCADIR, INDEX_HOSTCA
+    INDEX_SESSIONDIR, INDEX_SESSION, INDEX_HOSTCADIR, INDEX_HOSTCA,
+    INDEX_VERIFIEDCERTS, INDEX_VERIFIEDCERTS_TMP, INDEX_HOSTKEYS_IDX,
+    INDEX_HOSTKEYS_IDX_TMP
 };
 
 static const char hex[16] = "0123456789ABCDEF";
@@ -193,6 +196,18 @@ static char *make_filename(int index, const char *subname)
         sfree(tmp);
         return ret;
     }
+    if (index == INDEX_HOSTKEYS_IDX) {
+        tmp = make_filename(INDEX_HOSTKEYS, NULL);
+        ret = dupprintf("%s.idx", tmp);
+        sfree(tmp);
+        return ret;
+    }
+    if (index == INDEX_HOSTKEYS_IDX_TMP) {
+        tmp = make_filename(INDEX_HOSTKEYS_IDX, NULL);
+        ret = dupprintf("%s.tmp.%lu", tmp, (unsigned long)getpid());
+        sfree(tmp);
+        return ret;
+    }
     if (index == INDEX_RANDSEED) {
         env = getenv("PUTTYRANDOMSEED");
         if (env)
@@ -219,6 +234,23 @@ static char *make_filename(int index, const char *subname)
         make_session_filename(subname, sb);
         return strbuf_to_str(sb);
     }
+    if (index == INDEX_VERIFIEDCERTS) {
+        env = getenv("PUTTYSSHVERIFIEDCERTS");
+        if (env)
+            return dupstr(env);
+        tmp = make_filename(INDEX_DIR, NULL);
+        ret = dupprintf("%s/sshverifiedcerts", tmp);
+        sfree(tmp);
+        return ret;
+    }
+    if (index == INDEX_VERIFIEDCERTS_TMP) {
+        /* Include the pid, because several PuTTY tools connecting at
+         * once might all want to update this file */
+        tmp = make_filename(INDEX_VERIFIEDCERTS, NULL);
+        ret = dupprintf("%s.tmp.%lu", tmp, (unsigned long)getpid());
+        sfree(tmp);
+        return ret;
+    }
     tmp = make_filename(INDEX_DIR, NULL);
     ret = dupprintf("%s/ERROR", tmp);
     sfree(tmp);
@@ -738,6 +770,251 @@ char *host_ca_delete(const char *name)
     return err;
 }
 
+/*
+ * Index of the host keys file, so that checking a host key doesn't
+ * need a linear scan of a file that may have accumulated thousands
+ * of entries (e.g. after importing an OpenSSH known_hosts file).
+ *
+ * The text file remains the only authoritative copy of the data. The
+ * index sits beside it ("sshhostkeys.idx"), and consists of a header
+ * identifying the exact version of the text file it describes
+ * (device, inode, size and mtime), followed by the byte offset of
+ * every line, sorted by the "type@port:hostname" field at the start
+ * of the line. A lookup memory-maps both files and binary-searches.
+ *
+ * If the index is missing or doesn't match the text file (because
+ * store_host_key was run by an older PuTTY, or the user edited the
+ * file by hand), we do the lookup the slow way and then write a new
+ * index, via a temporary file and rename() so that concurrent
+ * readers never see a half-written one. Any failure to read or write
+ * the index just means falling back to the linear scan.
+ *
+ * The index is only ever used as a hint about where to look: every
+ * line it points at is checked against the text file itself, so a
+ * stale index that slips past the header check can at worst fail to
+ * find a key, never report a match the text file doesn't contain.
+ */
+
+#define HOSTKEY_INDEX_MAGIC "PuTTYhki"
+#define HOSTKEY_INDEX_VERSION 1
+#define HOSTKEY_INDEX_HDRLEN 48
+
+typedef struct HostKeyMap {
+    const unsigned char *data;
+    size_t len;
+    struct stat st;
+} HostKeyMap;
+
+static bool hostkey_map_file(const char *filename, HostKeyMap *map)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &map->st) < 0 || !S_ISREG(map->st.st_mode) ||
+        map->st.st_size <= 0 || map->st.st_size > 0xFFFFFFFF) {
+        close(fd);
+        return false;
+    }
+    map->len = map->st.st_size;
+    void *p = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    map->data = p;
+    return true;
+}
+
+static void hostkey_unmap_file(HostKeyMap *map)
+{
+    munmap((void *)map->data, map->len);
+}
+
+static void hostkey_index_put_stat(unsigned char *hdr, const struct stat *st)
+{
+    memcpy(hdr, HOSTKEY_INDEX_MAGIC, 8);
+    PUT_32BIT_MSB_FIRST(hdr + 8, HOSTKEY_INDEX_VERSION);
+    /* hdr+12 is the entry count, filled in separately */
+    PUT_64BIT_MSB_FIRST(hdr + 16, (uint64_t)st->st_dev);
+    PUT_64BIT_MSB_FIRST(hdr + 24, (uint64_t)st->st_ino);
+    PUT_64BIT_MSB_FIRST(hdr + 32, (uint64_t)st->st_size);
+    PUT_64BIT_MSB_FIRST(hdr + 40, (uint64_t)st->st_mtime);
+}
+
+/*
+ * Return the extent of the header field of the line starting at
+ * offset 'off', or a NULL ptrlen if the line has no space in it (in
+ * which case check_stored_host_key could never match it).
+ */
+static ptrlen hostkey_line_header(const HostKeyMap *text, size_t off)
+{
+    const unsigned char *p = text->data + off, *end = text->data + text->len;
+    for (const unsigned char *q = p; q < end && *q != '\n'; q++)
+        if (*q == ' ')
+            return make_ptrlen(p, q - p);
+    return make_ptrlen(NULL, 0);
+}
+
+static int hostkey_header_cmp(ptrlen a, ptrlen b)
+{
+    int c = memcmp(a.ptr, b.ptr, a.len < b.len ? a.len : b.len);
+    if (c)
+        return c;
+    return a.len < b.len ? -1 : a.len > b.len ? +1 : 0;
+}
+
+/*
+ * Look up a header using the index. Returns the same values as
+ * check_stored_host_key, or -1 if the index can't be used.
+ */
+static int hostkey_index_lookup(ptrlen header, const char *key)
+{
+    HostKeyMap text, idx;
+    int ret = -1;
+
+    char *filename = make_filename(INDEX_HOSTKEYS, NULL);
+    bool got_text = hostkey_map_file(filename, &text);
+    sfree(filename);
+    if (!got_text)
+        return -1;
+
+    filename = make_filename(INDEX_HOSTKEYS_IDX, NULL);
+    bool got_idx = hostkey_map_file(filename, &idx);
+    sfree(filename);
+    if (!got_idx) {
+        hostkey_unmap_file(&text);
+        return -1;
+    }
+
+    unsigned char hdr[HOSTKEY_INDEX_HDRLEN];
+    hostkey_index_put_stat(hdr, &text.st);
+    if (idx.len < HOSTKEY_INDEX_HDRLEN ||
+        memcmp(idx.data, hdr, 12) ||
+        memcmp(idx.data + 16, hdr + 16, HOSTKEY_INDEX_HDRLEN - 16))
+        goto out;
+    size_t nentries = GET_32BIT_MSB_FIRST(idx.data + 12);
+    if (idx.len != HOSTKEY_INDEX_HDRLEN + 4 * nentries)
+        goto out;
+    const unsigned char *offsets = idx.data + HOSTKEY_INDEX_HDRLEN;
+
+    /*
+     * Find the first entry whose header is >= the one we want. The
+     * index is sorted stably, so if there's more than one line with
+     * this header, that gets us the earliest, which is the one the
+     * linear scan would have found.
+     */
+    size_t lo = 0, hi = nentries;
+    ptrlen found = make_ptrlen(NULL, 0);
+    size_t found_off = 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t off = GET_32BIT_MSB_FIRST(offsets + 4 * mid);
+        if (off >= text.len || (off > 0 && text.data[off - 1] != '\n'))
+            goto out;                  /* index is nonsense */
+        ptrlen this = hostkey_line_header(&text, off);
+        if (!this.ptr)
+            goto out;
+        if (hostkey_header_cmp(this, header) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+            found = this;
+            found_off = off;
+        }
+    }
+
+    if (!found.ptr || hostkey_header_cmp(found, header)) {
+        ret = 1;                       /* key does not exist */
+    } else {
+        const char *p = (const char *)text.data + found_off + found.len + 1;
+        const char *end = (const char *)text.data + text.len;
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        if (ptrlen_eq_string(make_ptrlen(p, eol - p), key))
+            ret = 0;                   /* key matched OK */
+        else
+            ret = 2;                   /* key mismatch */
+    }
+
+  out:
+    hostkey_unmap_file(&idx);
+    hostkey_unmap_file(&text);
+    return ret;
+}
+
+typedef struct HostKeyIndexEntry {
+    ptrlen header;
+    uint32_t offset;
+} HostKeyIndexEntry;
+
+static int hostkey_index_entry_cmp(const void *av, const void *bv)
+{
+    const HostKeyIndexEntry *a = av, *b = bv;
+    int c = hostkey_header_cmp(a->header, b->header);
+    if (c)
+        return c;
+    return a->offset < b->offset ? -1 : a->offset > b->offset ? +1 : 0;
+}
+
+/*
+ * Write a fresh index for the current contents of the host keys file.
+ */
+static void hostkey_index_rebuild(void)
+{
+    HostKeyMap text;
+    char *filename = make_filename(INDEX_HOSTKEYS, NULL);
+    bool got_text = hostkey_map_file(filename, &text);
+    sfree(filename);
+    if (!got_text) {
+        /* Nothing to index, so make sure no old index hangs around */
+        filename = make_filename(INDEX_HOSTKEYS_IDX, NULL);
+        unlink(filename);
+        sfree(filename);
+        return;
+    }
+
+    HostKeyIndexEntry *entries = NULL;
+    size_t nentries = 0, entrysize = 0;
+    for (size_t off = 0; off < text.len ;) {
+        ptrlen header = hostkey_line_header(&text, off);
+        if (header.ptr) {
+            sgrowarray(entries, entrysize, nentries);
+            entries[nentries].header = header;
+            entries[nentries].offset = off;
+            nentries++;
+        }
+        const unsigned char *eol = memchr(
+            text.data + off, '\n', text.len - off);
+        off = eol ? eol + 1 - text.data : text.len;
+    }
+    qsort(entries, nentries, sizeof(*entries), hostkey_index_entry_cmp);
+
+    strbuf *sb = strbuf_new();
+    unsigned char *hdr = strbuf_append(sb, HOSTKEY_INDEX_HDRLEN);
+    hostkey_index_put_stat(hdr, &text.st);
+    PUT_32BIT_MSB_FIRST(hdr + 12, nentries);
+    for (size_t i = 0; i < nentries; i++) {
+        unsigned char *p = strbuf_append(sb, 4);
+        PUT_32BIT_MSB_FIRST(p, entries[i].offset);
+    }
+    sfree(entries);
+    hostkey_unmap_file(&text);
+
+    filename = make_filename(INDEX_HOSTKEYS_IDX, NULL);
+    char *tmpfilename = make_filename(INDEX_HOSTKEYS_IDX_TMP, NULL);
+    FILE *fp = fopen(tmpfilename, "wb");
+    if (fp) {
+        bool ok = fwrite(sb->s, 1, sb->len, fp) == sb->len;
+        if (fclose(fp) < 0)
+            ok = false;
+        if (!ok || rename(tmpfilename, filename) < 0)
+            unlink(tmpfilename);
+    }
+    sfree(tmpfilename);
+    sfree(filename);
+    strbuf_free(sb);
+}
+
 /*
  * Lines in the host keys file are of the form
  *
@@ -755,6 +1032,19 @@ int check_stored_host_key(const char *hostname, int port,
     char *line;
     int ret;
 
+    /*
+     * Try the index first. It can only be used if the header we're
+     * looking for contains no spaces, because it indexes each line by
+     * the text before its first space.
+     */
+    if (!strchr(keytype, ' ') && !strchr(hostname, ' ')) {
+        char *header = dupprintf("%s@%d:%s", keytype, port, hostname);
+        ret = hostkey_index_lookup(ptrlen_from_asciz(header), key);
+        sfree(header);
+        if (ret >= 0)
+            return ret;
+    }
+
     filename = make_filename(INDEX_HOSTKEYS, NULL);
     fp = fopen(filename, "r");
     sfree(filename);
@@ -813,6 +1103,10 @@ int check_stored_host_key(const char *hostname, int port,
     }
 
     fclose(fp);
+
+    /* The index was unusable, so make a new one for next time. */
+    hostkey_index_rebuild();
+
     return ret;
 }
 
@@ -890,6 +1184,8 @@ void store_host_key(Seat *seat, const char *hostname, int port,
         seat_nonfatal(seat, "Unable to store host key: rename(\"%s\",\"%s\")"
                       " returned '%s'", tmpfilename, filename,
                       strerror(errno));
+    } else {
+        hostkey_index_rebuild();
     }
 
     sfree(tmpfilename);
@@ -897,6 +1193,89 @@ void store_host_key(Seat *seat, const char *hostname, int port,
     sfree(newtext);
 }
 
+/* Maximum number of entries kept in the verified-certificates file */
+#define VERIFIED_CERTS_MAX 256
+
+bool check_verified_cert(const char *id)
+{
+    char *filename = make_filename(INDEX_VERIFIEDCERTS, NULL);
+    FILE *fp = fopen(filename, "r");
+    sfree(filename);
+    if (!fp)
+        return false;
+
+    bool found = false;
+    char *line;
+    while (!found && (line = fgetline(fp)) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        found = !strcmp(line, id);
+        sfree(line);
+    }
+
+    fclose(fp);
+    return found;
+}
+
+void store_verified_cert(const char *id)
+{
+    char *filename = make_filename(INDEX_VERIFIEDCERTS, NULL);
+    char *tmpfilename = make_filename(INDEX_VERIFIEDCERTS_TMP, NULL);
+    char **lines = NULL;
+    size_t nlines = 0, linesize = 0;
+    FILE *fp;
+
+    /*
+     * Read in the existing entries, except for any copy of this one,
+     * which we'll put at the end as the most recent.
+     */
+    if ((fp = fopen(filename, "r")) != NULL) {
+        char *line;
+        while ((line = fgetline(fp)) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+            if (!*line || !strcmp(line, id)) {
+                sfree(line);
+                continue;
+            }
+            sgrowarray(lines, linesize, nlines);
+            lines[nlines++] = line;
+        }
+        fclose(fp);
+    }
+
+    /*
+     * Write out the new list to a temporary file, dropping the oldest
+     * entries if it's got too long, and then rename it into place.
+     * This is only a cache, so if anything goes wrong, we just give
+     * up quietly.
+     */
+    fp = fopen(tmpfilename, "w");
+    if (!fp && errno == ENOENT) {
+        char *dir = make_filename(INDEX_DIR, NULL);
+        char *errmsg = make_dir_path(dir, 0700);
+        if (!errmsg)
+            fp = fopen(tmpfilename, "w");
+        sfree(errmsg);
+        sfree(dir);
+    }
+    if (fp) {
+        size_t start = 0;
+        if (nlines >= VERIFIED_CERTS_MAX)
+            start = nlines - (VERIFIED_CERTS_MAX - 1);
+        for (size_t i = start; i < nlines; i++)
+            fprintf(fp, "%s\n", lines[i]);
+        fprintf(fp, "%s\n", id);
+
+        if (fclose(fp) != 0 || rename(tmpfilename, filename) < 0)
+            remove(tmpfilename);
+    }
+
+    for (size_t i = 0; i < nlines; i++)
+        sfree(lines[i]);
+    sfree(lines);
+    sfree(tmpfilename);
+    sfree(filename);
+}
+
 void read_random_seed(noise_consumer_t consumer)
 {
     int fd;
@@ -16,6 +16,12 @@
 
 #define BUFFER_MIN_GRANULE  512
 
+/*
+ * Large additions are split into granules no bigger than this, so
+ * that they stay within the size classes handled by spool_alloc.
+ */
+#define BUFFER_MAX_GRANULE  65536
+
 struct bufchain_granule {
     struct bufchain_granule *next;
     char *bufpos, *bufend, *bufmax;
@@ -40,8 +46,7 @@ void bufchain_clear(bufchain *ch)
     while (ch->head) {
         b = ch->head;
         ch->head = ch->head->next;
-        smemclr(b, sizeof(*b));
-        sfree(b);
+        spool_free(b);
     }
     ch->tail = NULL;
     ch->buffersize = 0;
@@ -80,10 +85,11 @@ void bufchain_add(bufchain *ch, const void *data, size_t len)
             size_t grainlen =
                 max(sizeof(struct bufchain_granule) + len, BUFFER_MIN_GRANULE);
             struct bufchain_granule *newbuf;
-            newbuf = smalloc(grainlen);
+            grainlen = min(grainlen, BUFFER_MAX_GRANULE);
+            newbuf = spool_alloc(grainlen);
             newbuf->bufpos = newbuf->bufend =
                 (char *)newbuf + sizeof(struct bufchain_granule);
-            newbuf->bufmax = (char *)newbuf + grainlen;
+            newbuf->bufmax = (char *)newbuf + spool_usable_size(newbuf);
             newbuf->next = NULL;
             if (ch->tail)
                 ch->tail->next = newbuf;
@@ -111,8 +117,7 @@ void bufchain_consume(bufchain *ch, size_t len)
             ch->head = tmp->next;
             if (!ch->head)
                 ch->tail = NULL;
-            smemclr(tmp, sizeof(*tmp));
-            sfree(tmp);
+            spool_free(tmp);
         } else
             ch->head->bufpos += remlen;
         ch->buffersize -= remlen;
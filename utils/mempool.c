@@ -0,0 +1,233 @@
+/*
+ * Size-classed free-list allocator for small, short-lived objects
+ * that are allocated and freed at a high rate, such as bufchain
+ * granules and SSH packets.
+ *
+ * Each block carries a small header recording the size the caller
+ * asked for and the size class it came from. Blocks up to
+ * SPOOL_MAX_CLASS_SIZE bytes are rounded up to a power of two; when
+ * freed, they're wiped and then kept on a per-class free list (up to
+ * a limit), so that the next allocation of the same class can reuse
+ * them without a round trip through malloc. Larger blocks are simply
+ * passed through to the ordinary allocator, but still wiped on free.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "defs.h"
+#include "puttymem.h"
+#include "misc.h"
+
+#define SPOOL_MIN_CLASS_LOG2 6         /* 64 bytes */
+#define SPOOL_MAX_CLASS_LOG2 16        /* 64Kb */
+#define SPOOL_NCLASSES (SPOOL_MAX_CLASS_LOG2 - SPOOL_MIN_CLASS_LOG2 + 1)
+#define SPOOL_MAX_CLASS_SIZE ((size_t)1 << SPOOL_MAX_CLASS_LOG2)
+#define SPOOL_UNPOOLED SPOOL_NCLASSES
+
+/*
+ * The most memory we're prepared to keep idle on each class's free
+ * list. Small classes are allowed at least SPOOL_MIN_FREE blocks
+ * regardless.
+ */
+#define SPOOL_MAX_FREE_BYTES 262144
+#define SPOOL_MIN_FREE 4
+
+typedef union SpoolHeader SpoolHeader;
+union SpoolHeader {
+    struct {
+        SpoolHeader *next;             /* link on a free list */
+        size_t size;                   /* size requested by the caller */
+        unsigned sizeclass;
+    } h;
+
+    /* Pad the header so the caller's data is as aligned as malloc's */
+    unsigned char padding[32];
+};
+
+static SpoolHeader *spool_freelists[SPOOL_NCLASSES];
+static size_t spool_nfree[SPOOL_NCLASSES];
+static SpoolStats spool_stats;
+
+static unsigned spool_size_class(size_t size)
+{
+    unsigned cls = 0;
+    if (size > SPOOL_MAX_CLASS_SIZE)
+        return SPOOL_UNPOOLED;
+    while (((size_t)1 << (cls + SPOOL_MIN_CLASS_LOG2)) < size)
+        cls++;
+    return cls;
+}
+
+static size_t spool_class_size(unsigned cls)
+{
+    return (size_t)1 << (cls + SPOOL_MIN_CLASS_LOG2);
+}
+
+static size_t spool_max_free(unsigned cls)
+{
+    size_t n = SPOOL_MAX_FREE_BYTES / spool_class_size(cls);
+    return n < SPOOL_MIN_FREE ? SPOOL_MIN_FREE : n;
+}
+
+void *spool_alloc(size_t size)
+{
+    unsigned cls = spool_size_class(size);
+    SpoolHeader *hdr;
+
+    spool_stats.allocs++;
+
+    if (cls != SPOOL_UNPOOLED && spool_freelists[cls]) {
+        hdr = spool_freelists[cls];
+        spool_freelists[cls] = hdr->h.next;
+        spool_nfree[cls]--;
+        spool_stats.hits++;
+    } else {
+        size_t blocksize = (cls == SPOOL_UNPOOLED ? size :
+                            spool_class_size(cls));
+        hdr = snmalloc(1, sizeof(SpoolHeader), blocksize);
+    }
+
+    hdr->h.next = NULL;
+    hdr->h.size = size;
+    hdr->h.sizeclass = cls;
+    return hdr + 1;
+}
+
+void spool_free(void *p)
+{
+    SpoolHeader *hdr;
+    unsigned cls;
+
+    if (!p)
+        return;
+
+    hdr = (SpoolHeader *)p - 1;
+    cls = hdr->h.sizeclass;
+    assert(cls <= SPOOL_UNPOOLED);
+
+    /* The only wipe this block gets, whichever way it's going */
+    smemclr(p, hdr->h.size);
+    spool_stats.frees++;
+
+#ifndef MINEFIELD /* don't hide use-after-free from the malloc debugger */
+    if (cls != SPOOL_UNPOOLED && spool_nfree[cls] < spool_max_free(cls)) {
+        hdr->h.next = spool_freelists[cls];
+        spool_freelists[cls] = hdr;
+        spool_nfree[cls]++;
+        spool_stats.recycled++;
+        return;
+    }
+#endif
+
+    smemclr(hdr, sizeof(*hdr));
+    sfree(hdr);
+}
+
+size_t spool_usable_size(void *p)
+{
+    SpoolHeader *hdr = (SpoolHeader *)p - 1;
+
+    /*
+     * Once the caller knows it may write to the whole block, the
+     * whole block must be wiped when it's freed.
+     */
+    if (hdr->h.sizeclass != SPOOL_UNPOOLED)
+        hdr->h.size = spool_class_size(hdr->h.sizeclass);
+    return hdr->h.size;
+}
+
+void spool_get_stats(SpoolStats *stats)
+{
+    *stats = spool_stats;
+    stats->idle_bytes = 0;
+    for (unsigned cls = 0; cls < SPOOL_NCLASSES; cls++)
+        stats->idle_bytes += spool_nfree[cls] * spool_class_size(cls);
+}
+
+void spool_release_all(void)
+{
+    for (unsigned cls = 0; cls < SPOOL_NCLASSES; cls++) {
+        while (spool_freelists[cls]) {
+            SpoolHeader *hdr = spool_freelists[cls];
+            spool_freelists[cls] = hdr->h.next;
+            sfree(hdr);
+        }
+        spool_nfree[cls] = 0;
+    }
+}
+
+#ifdef TEST
+
+/*
+ * Test code for the pool allocator. Run test_mempool; it exits
+ * nonzero on failure.
+ */
+
+static int fails, passes;
+
+void out_of_memory(void) { fprintf(stderr, "out of memory\n"); abort(); }
+
+#define CHECK(cond) do {                                        \
+        if (cond) {                                             \
+            passes++;                                           \
+        } else {                                                \
+            printf("%d: failed: %s\n", __LINE__, #cond);        \
+            fails++;                                            \
+        }                                                       \
+    } while (0)
+
+int main(void)
+{
+    SpoolStats st;
+    unsigned char *a, *b, *c;
+    void *many[200];
+
+    /* A freed block is handed back for the next same-class request */
+    a = spool_alloc(500);
+    memset(a, 0x5A, 500);
+    spool_free(a);
+    b = spool_alloc(300);
+    CHECK(b == a);
+    CHECK(spool_usable_size(b) == 512);
+    /* ... and it was wiped on the way through the free list */
+    CHECK(b[0] == 0 && b[299] == 0);
+    spool_free(b);
+
+    /* Different classes don't share free lists */
+    c = spool_alloc(2000);
+    CHECK(c != a);
+    CHECK(spool_usable_size(c) == 2048);
+    spool_free(c);
+
+    /* Oversized blocks go straight through to malloc */
+    a = spool_alloc(SPOOL_MAX_CLASS_SIZE + 1);
+    CHECK(spool_usable_size(a) == SPOOL_MAX_CLASS_SIZE + 1);
+    memset(a, 1, SPOOL_MAX_CLASS_SIZE + 1);
+    spool_free(a);
+
+    /* Free lists are bounded */
+    spool_release_all();
+    for (size_t i = 0; i < lenof(many); i++)
+        many[i] = spool_alloc(16384);
+    for (size_t i = 0; i < lenof(many); i++)
+        spool_free(many[i]);
+    spool_get_stats(&st);
+    CHECK(st.idle_bytes == SPOOL_MAX_FREE_BYTES);
+
+    spool_free(NULL);                  /* harmless */
+
+    spool_get_stats(&st);
+    CHECK(st.allocs == st.frees);
+    CHECK(st.hits == 1);
+
+    spool_release_all();
+    spool_get_stats(&st);
+    CHECK(st.idle_bytes == 0);
+
+    printf("passed %d failed %d total %d\n", passes, fails, passes+fails);
+    return fails != 0 ? 1 : 0;
+}
+
+#endif
@@ -189,6 +189,8 @@ static void usage(void)
     printf("            control what happens when a log file already exists\n");
     printf("  -shareexists\n");
     printf("            test whether a connection-sharing upstream exists\n");
+    printf("  -sharepersist seconds\n");
+    printf("            share connections, keeping an idle upstream open\n");
     exit(1);
 }
 
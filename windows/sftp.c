@@ -192,6 +192,12 @@ WFile *open_existing_wfile(const char *name, uint64_t *size)
     return f;
 }
 
+WFile *open_update_wfile(const char *name)
+{
+    /* open_existing_wfile doesn't append on Windows, so it will do */
+    return open_existing_wfile(name, NULL);
+}
+
 int write_to_file(WFile *f, void *buffer, int length)
 {
     DWORD written;
@@ -254,6 +260,13 @@ uint64_t get_file_posn(WFile *f)
     return uint64_from_words(hi, lo);
 }
 
+int set_file_size(WFile *f, uint64_t size)
+{
+    if (seek_file(f, size, FROM_START) < 0)
+        return -1;
+    return SetEndOfFile(f->h) ? 0 : -1;
+}
+
 int file_type(const char *name)
 {
     DWORD attr;
@@ -111,3 +111,12 @@ int platform_ssh_share(const char *pi_name, Conf *conf,
 void platform_ssh_share_cleanup(const char *name)
 {
 }
+
+void platform_ssh_share_retire(const char *name)
+{
+    /*
+     * A named pipe can't be unpublished without closing the listening
+     * handle, so an upstream on Windows goes on accepting downstreams
+     * until it actually closes.
+     */
+}
@@ -22,6 +22,9 @@ static const char *const reg_jumplist_key = PUTTY_REG_POS "\\Jumplist";
 static const char *const reg_jumplist_value = "Recent sessions";
 static const char *const puttystr = PUTTY_REG_POS "\\Sessions";
 static const char *const host_ca_key = PUTTY_REG_POS "\\SshHostCAs";
+static const char *const verified_certs_key =
+    PUTTY_REG_POS "\\SshVerifiedCerts";
+static const char *const verified_certs_value = "Certificates";
 
 static bool tried_shgetfolderpath = false;
 static HMODULE shell32_module = NULL;
@@ -389,6 +392,70 @@ void store_host_key(Seat *seat, const char *hostname, int port,
     strbuf_free(regname);
 }
 
+/* Maximum number of entries kept in the verified-certificates list */
+#define VERIFIED_CERTS_MAX 256
+
+/*
+ * The list of verified certificates is stored as a single registry
+ * string, containing their ids separated by spaces, oldest first.
+ */
+bool check_verified_cert(const char *id)
+{
+    HKEY rkey = open_regkey_ro(HKEY_CURRENT_USER, verified_certs_key);
+    if (!rkey)
+        return false;
+
+    char *list = get_reg_sz(rkey, verified_certs_value);
+    close_regkey(rkey);
+    if (!list)
+        return false;
+
+    bool found = false;
+    ptrlen pl = ptrlen_from_asciz(list);
+    while (!found && pl.len) {
+        ptrlen word = ptrlen_get_word(&pl, " ");
+        found = ptrlen_eq_string(word, id);
+    }
+
+    sfree(list);
+    return found;
+}
+
+void store_verified_cert(const char *id)
+{
+    HKEY rkey = create_regkey(HKEY_CURRENT_USER, verified_certs_key);
+    if (!rkey)
+        return;                        /* this is only a cache anyway */
+
+    char *list = get_reg_sz(rkey, verified_certs_value);
+    ptrlen *words = NULL;
+    size_t nwords = 0, wordsize = 0;
+    if (list) {
+        ptrlen pl = ptrlen_from_asciz(list);
+        while (pl.len) {
+            ptrlen word = ptrlen_get_word(&pl, " ");
+            if (!word.len || ptrlen_eq_string(word, id))
+                continue;
+            sgrowarray(words, wordsize, nwords);
+            words[nwords++] = word;
+        }
+    }
+
+    strbuf *sb = strbuf_new();
+    size_t start = 0;
+    if (nwords >= VERIFIED_CERTS_MAX)
+        start = nwords - (VERIFIED_CERTS_MAX - 1);
+    for (size_t i = start; i < nwords; i++)
+        put_fmt(sb, "%.*s ", PTRLEN_PRINTF(words[i]));
+    put_fmt(sb, "%s", id);
+    put_reg_sz(rkey, verified_certs_value, sb->s);
+    close_regkey(rkey);
+
+    strbuf_free(sb);
+    sfree(words);
+    sfree(list);
+}
+
 struct host_ca_enum {
     HKEY key;
     int i;